@@ -0,0 +1,461 @@
+// Нагрузочные тесты поискового сервера на синтетическом корпусе с распределением слов по Ципфу.
+// Результаты (пропускная способность, p50/p99 задержек, память) выводятся в JSON и могут
+// сравниваться с результатами предыдущего запуска (--baseline). Параметры запуска - см. PrintUsage()
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <execution>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "corpus_generator.h"
+#include "corpus_loader.h"
+#include "histogram.h"
+#include "ingest_pipeline.h"
+#include "process_queries.h"
+#include "read_input_functions.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace
+{
+using Clock = chrono::steady_clock;
+
+struct BenchmarkOptions
+{
+    CorpusConfig corpus;
+    size_t query_count = 1'000;
+    size_t batch_size = 100;
+    string output_path;         // Пустой путь - вывод в stdout
+    string baseline_path;
+    double max_regression_percent = 10.0;
+};
+
+struct BenchmarkResult
+{
+    string name;
+    uint64_t operations = 0;
+    double seconds = 0.0;
+    Histogram latency;
+    int64_t rss_kb = 0;         // Резидентная память процесса после теста
+    int64_t rss_growth_kb = 0;  // Рост резидентной памяти за время теста
+};
+
+// Текущий объём резидентной памяти процесса в КБ (0, если недоступен)
+int64_t GetResidentMemoryKb()
+{
+#if defined(__linux__)
+    ifstream statm("/proc/self/statm"s);
+    int64_t total_pages = 0;
+    int64_t resident_pages = 0;
+    if (statm >> total_pages >> resident_pages)
+    {
+        return resident_pages * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+#endif
+    return 0;
+}
+
+// Пиковый объём резидентной памяти процесса в КБ (0, если недоступен)
+int64_t GetPeakMemoryKb()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#if defined(__APPLE__)
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Выполняет operation(i) для i = 0..count-1, замеряя задержку каждого вызова
+template <typename Operation>
+BenchmarkResult Measure(string name, size_t count, Operation operation)
+{
+    BenchmarkResult result;
+    result.name = move(name);
+    result.operations = count;
+    const int64_t start_rss_kb = GetResidentMemoryKb();
+
+    const auto start = Clock::now();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto operation_start = Clock::now();
+        operation(i);
+        result.latency.Record(static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(Clock::now() - operation_start).count()));
+    }
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    result.rss_kb = GetResidentMemoryKb();
+    result.rss_growth_kb = result.rss_kb - start_rss_kb;
+
+    cerr << result.name << ": "s << result.operations << " ops, "s << result.seconds << " s"s << endl;
+    return result;
+}
+
+double GetThroughput(const BenchmarkResult& result)
+{
+    return result.seconds > 0.0 ? result.operations / result.seconds : 0.0;
+}
+
+void PrintUsage(ostream& out)
+{
+    out << "Usage: search_benchmark [options]\n"s
+        << "  --documents N        corpus size (default 10000)\n"s
+        << "  --vocabulary N       vocabulary size (default 50000)\n"s
+        << "  --zipf S             Zipf exponent of word frequencies (default 1.07)\n"s
+        << "  --queries N          queries per query benchmark (default 1000)\n"s
+        << "  --seed N             random seed (default 42)\n"s
+        << "  --output PATH        write JSON report to PATH instead of stdout\n"s
+        << "  --baseline PATH      compare with a previous JSON report\n"s
+        << "  --max-regression P   fail if throughput drops by more than P percent (default 10)\n"s;
+}
+
+BenchmarkOptions ParseOptions(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const string argument = argv[i];
+        if (argument == "--help"s)
+        {
+            PrintUsage(cout);
+            exit(0);
+        }
+        if (i + 1 >= argc)
+        {
+            throw invalid_argument("Missing value for "s + argument);
+        }
+        const string value = argv[++i];
+        if (argument == "--documents"s)
+        {
+            options.corpus.document_count = stoull(value);
+        }
+        else if (argument == "--vocabulary"s)
+        {
+            options.corpus.vocabulary_size = stoull(value);
+        }
+        else if (argument == "--zipf"s)
+        {
+            options.corpus.zipf_exponent = stod(value);
+        }
+        else if (argument == "--queries"s)
+        {
+            options.query_count = stoull(value);
+        }
+        else if (argument == "--seed"s)
+        {
+            options.corpus.seed = stoull(value);
+        }
+        else if (argument == "--output"s)
+        {
+            options.output_path = value;
+        }
+        else if (argument == "--baseline"s)
+        {
+            options.baseline_path = value;
+        }
+        else if (argument == "--max-regression"s)
+        {
+            options.max_regression_percent = stod(value);
+        }
+        else
+        {
+            throw invalid_argument("Unknown option "s + argument);
+        }
+    }
+    return options;
+}
+
+vector<BenchmarkResult> RunBenchmarks(const BenchmarkOptions& options)
+{
+    vector<BenchmarkResult> results;
+
+    cerr << "Generating corpus of "s << options.corpus.document_count << " documents"s << endl;
+    const Corpus corpus = GenerateCorpus(options.corpus);
+
+    SearchServer search_server(corpus.stop_words);
+    results.push_back(Measure("build"s, corpus.documents.size(),
+                              [&](size_t i)
+                              {
+                                  const CorpusDocument& document = corpus.documents[i];
+                                  search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+                              }));
+
+    // Тот же корпус из потока записей (read_input_functions.h) через конвейер загрузки: чтение, разбор
+    // и добавление в индекс идут одновременно. Замеряется один запуск конвейера, operations - число документов
+    {
+        ostringstream records;
+        for (const CorpusDocument& document : corpus.documents)
+        {
+            WriteDocumentRecord(records, document.id, document.status, document.ratings, document.text);
+        }
+        istringstream input(records.str());
+        SearchServer pipeline_server(corpus.stop_words);
+        BenchmarkResult result = Measure("build_pipeline"s, 1,
+                                         [&](size_t)
+                                         {
+                                             IngestPipeline(pipeline_server).Run(input);
+                                         });
+        result.operations = corpus.documents.size();
+        results.push_back(move(result));
+
+        // Те же записи из файла, отображённого в память: части файла разбираются параллельно,
+        // тексты документов не копируются в индекс
+        const string corpus_path = "search_benchmark_corpus.tsv"s;
+        ofstream(corpus_path, ios::binary) << records.str();
+        SearchServer mapped_server(corpus.stop_words);
+        BenchmarkResult mapped_result = Measure("build_mmap"s, 1,
+                                                [&](size_t)
+                                                {
+                                                    LoadCorpusFile(mapped_server, corpus_path);
+                                                });
+        mapped_result.operations = corpus.documents.size();
+        results.push_back(move(mapped_result));
+        remove(corpus_path.c_str());
+    }
+
+    const auto short_queries = GenerateQueries(corpus, options.corpus, QueryMix::SHORT, options.query_count, options.corpus.seed + 1);
+    const auto long_queries = GenerateQueries(corpus, options.corpus, QueryMix::LONG, options.query_count, options.corpus.seed + 2);
+    const auto minus_queries = GenerateQueries(corpus, options.corpus, QueryMix::MINUS_HEAVY, options.query_count, options.corpus.seed + 3);
+    const auto required_queries = GenerateQueries(corpus, options.corpus, QueryMix::REQUIRED, options.query_count, options.corpus.seed + 5);
+
+    results.push_back(Measure("query_short"s, short_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(short_queries[i]);
+                              }));
+    results.push_back(Measure("query_long"s, long_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(long_queries[i]);
+                              }));
+    results.push_back(Measure("query_long_par"s, long_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(execution::par, long_queries[i]);
+                              }));
+    results.push_back(Measure("query_minus_heavy"s, minus_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(minus_queries[i]);
+                              }));
+    results.push_back(Measure("query_required"s, required_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(required_queries[i]);
+                              }));
+
+    // Одинаковое условие "рейтинг >= 4, ACTUAL" в декларативной форме и в виде предиката
+    DocumentFilter filter;
+    filter.min_rating = 4;
+    filter.status_mask = DocumentFilter::StatusMask({ DocumentStatus::ACTUAL });
+    results.push_back(Measure("query_filtered"s, long_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(long_queries[i], filter);
+                              }));
+    results.push_back(Measure("query_filtered_predicate"s, long_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.FindTopDocuments(long_queries[i],
+                                                                 [](int, DocumentStatus status, int rating)
+                                                                 {
+                                                                     return status == DocumentStatus::ACTUAL && rating >= 4;
+                                                                 });
+                              }));
+
+    // Пакетная обработка: операция - пакет из batch_size запросов
+    vector<vector<string>> batches;
+    for (size_t begin = 0; begin < short_queries.size(); begin += options.batch_size)
+    {
+        const size_t end = min(begin + options.batch_size, short_queries.size());
+        batches.emplace_back(short_queries.begin() + begin, short_queries.begin() + end);
+    }
+    results.push_back(Measure("query_batch"s, batches.size(),
+                              [&](size_t i)
+                              {
+                                  ProcessQueries(search_server, batches[i]);
+                              }));
+
+    mt19937_64 generator(options.corpus.seed + 4);
+    uniform_int_distribution<size_t> document_index(0, corpus.documents.size() - 1);
+    results.push_back(Measure("match"s, short_queries.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.MatchDocument(short_queries[i], corpus.documents[document_index(generator)].id);
+                              }));
+
+    // Удаляется 1% документов (не больше 10000)
+    vector<int> removed_ids;
+    for (const CorpusDocument& document : corpus.documents)
+    {
+        removed_ids.push_back(document.id);
+    }
+    shuffle(removed_ids.begin(), removed_ids.end(), generator);
+    removed_ids.resize(min<size_t>(removed_ids.size(), max<size_t>(1, min<size_t>(corpus.documents.size() / 100, 10'000))));
+    results.push_back(Measure("remove"s, removed_ids.size(),
+                              [&](size_t i)
+                              {
+                                  search_server.RemoveDocument(removed_ids[i]);
+                              }));
+
+    // Постоянное обновление индекса: удаляется случайный документ и добавляется новый.
+    // rss_growth_kb показывает, насколько фрагментация кучи увеличивает память процесса
+    // при выделении памяти индекса глобальным распределителем и из пула сервера. Второй тест
+    // может повторно использовать память, освобождённую первым, поэтому режимы точнее сравнивать
+    // отдельными запусками
+    const size_t churn_count = min<size_t>(corpus.documents.size(), 100'000);
+    for (const auto& [name, memory_mode] : { pair{ "churn"s, IndexMemoryMode::DEFAULT },
+                                             pair{ "churn_pool"s, IndexMemoryMode::POOL } })
+    {
+        IndexOptions index_options;
+        index_options.index_memory = memory_mode;
+        SearchServer churn_server(corpus.stop_words, index_options);
+        vector<int> live_ids;
+        int next_id = 0;
+        for (const CorpusDocument& document : corpus.documents)
+        {
+            churn_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            live_ids.push_back(document.id);
+            next_id = max(next_id, document.id + 1);
+        }
+        results.push_back(Measure(name, churn_count,
+                                  [&](size_t)
+                                  {
+                                      int& id = live_ids[document_index(generator)];
+                                      churn_server.RemoveDocument(id);
+                                      id = next_id++;
+                                      const CorpusDocument& document = corpus.documents[document_index(generator)];
+                                      churn_server.AddDocument(id, document.text, document.status, document.ratings);
+                                  }));
+    }
+
+    return results;
+}
+
+void WriteReport(const BenchmarkOptions& options, const vector<BenchmarkResult>& results, ostream& out)
+{
+    // Каждый результат пишется одной строкой, чтобы отчёт можно было читать построчно (см. ReadBaseline())
+    out << "{\n"s;
+    out << "  \"config\": {\"documents\": "s << options.corpus.document_count
+        << ", \"vocabulary\": "s << options.corpus.vocabulary_size
+        << ", \"zipf\": "s << options.corpus.zipf_exponent
+        << ", \"queries\": "s << options.query_count
+        << ", \"seed\": "s << options.corpus.seed << "},\n"s;
+    out << "  \"peak_rss_kb\": "s << GetPeakMemoryKb() << ",\n"s;
+    out << "  \"results\": [\n"s;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        out << "    {\"name\": \""s << result.name << "\""s
+            << ", \"operations\": "s << result.operations
+            << ", \"seconds\": "s << result.seconds
+            << ", \"throughput\": "s << GetThroughput(result)
+            << ", \"p50_ns\": "s << result.latency.GetValueAtPercentile(50.0)
+            << ", \"p99_ns\": "s << result.latency.GetValueAtPercentile(99.0)
+            << ", \"max_ns\": "s << result.latency.GetMax()
+            << ", \"rss_kb\": "s << result.rss_kb
+            << ", \"rss_growth_kb\": "s << result.rss_growth_kb << "}"s
+            << (i + 1 < results.size() ? ",\n"s : "\n"s);
+    }
+    out << "  ]\n}\n"s;
+}
+
+// Пропускная способность тестов из отчёта предыдущего запуска
+map<string, double> ReadBaseline(const string& path)
+{
+    ifstream in(path);
+    if (!in)
+    {
+        throw invalid_argument("Cannot open baseline "s + path);
+    }
+    static const regex RESULT_LINE(R"re("name": "([^"]+)".*"throughput": ([0-9.eE+-]+))re");
+    map<string, double> throughputs;
+    string line;
+    while (getline(in, line))
+    {
+        smatch match;
+        if (regex_search(line, match, RESULT_LINE))
+        {
+            throughputs[match[1]] = stod(match[2]);
+        }
+    }
+    return throughputs;
+}
+
+// Печатает сравнение с предыдущим запуском. Возвращает false, если есть регрессия больше допустимой
+bool CompareWithBaseline(const BenchmarkOptions& options, const vector<BenchmarkResult>& results)
+{
+    const map<string, double> baseline = ReadBaseline(options.baseline_path);
+    bool passed = true;
+    cerr << "\nComparison with "s << options.baseline_path << ":\n"s;
+    for (const BenchmarkResult& result : results)
+    {
+        const auto it = baseline.find(result.name);
+        if (it == baseline.end() || it->second <= 0.0)
+        {
+            cerr << "  "s << result.name << ": no baseline\n"s;
+            continue;
+        }
+        const double change_percent = (GetThroughput(result) / it->second - 1.0) * 100.0;
+        const bool regression = change_percent < -options.max_regression_percent;
+        cerr << "  "s << result.name << ": "s << it->second << " -> "s << GetThroughput(result)
+             << " ops/s ("s << (change_percent >= 0.0 ? "+"s : ""s) << change_percent << "%)"s
+             << (regression ? " REGRESSION"s : ""s) << "\n"s;
+        passed = passed && !regression;
+    }
+    return passed;
+}
+}
+
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        const vector<BenchmarkResult> results = RunBenchmarks(options);
+
+        if (options.output_path.empty())
+        {
+            WriteReport(options, results, cout);
+        }
+        else
+        {
+            ofstream out(options.output_path);
+            WriteReport(options, results, out);
+        }
+
+        if (!options.baseline_path.empty() && !CompareWithBaseline(options, results))
+        {
+            return 1;
+        }
+    }
+    catch (const exception& e)
+    {
+        cerr << "Error: "s << e.what() << endl;
+        PrintUsage(cerr);
+        return 2;
+    }
+    return 0;
+}
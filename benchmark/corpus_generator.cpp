@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "corpus_generator.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+// Слово из случайных латинских букв длиной 2..12 (длины коротких слов встречаются чаще)
+std::string GenerateWord(std::mt19937_64& generator)
+{
+    const size_t length = 2 + std::min<size_t>(std::geometric_distribution<size_t>(0.25)(generator), 10);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::string word(length, ' ');
+    for (char& c : word)
+    {
+        c = static_cast<char>(letter(generator));
+    }
+    return word;
+}
+
+std::vector<std::string> GenerateVocabulary(size_t size, std::mt19937_64& generator)
+{
+    std::vector<std::string> vocabulary;
+    vocabulary.reserve(size);
+    std::unordered_set<std::string> used;
+    while (vocabulary.size() < size)
+    {
+        std::string word = GenerateWord(generator);
+        if (used.insert(word).second)
+        {
+            vocabulary.push_back(std::move(word));
+        }
+    }
+    return vocabulary;
+}
+
+DocumentStatus GenerateStatus(std::mt19937_64& generator)
+{
+    // Большая часть документов актуальна
+    const int value = std::uniform_int_distribution<int>(0, 99)(generator);
+    if (value < 85)
+    {
+        return DocumentStatus::ACTUAL;
+    }
+    if (value < 92)
+    {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (value < 97)
+    {
+        return DocumentStatus::BANNED;
+    }
+    return DocumentStatus::REMOVED;
+}
+}
+
+
+ZipfGenerator::ZipfGenerator(size_t n, double exponent)
+{
+    if (n == 0)
+    {
+        throw std::invalid_argument("Zipf distribution needs at least one rank"s);
+    }
+    cumulative_.resize(n);
+    double sum = 0.0;
+    for (size_t rank = 0; rank < n; ++rank)
+    {
+        sum += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+        cumulative_[rank] = sum;
+    }
+    for (double& value : cumulative_)
+    {
+        value /= sum;
+    }
+}
+
+
+size_t ZipfGenerator::operator()(std::mt19937_64& generator) const
+{
+    const double value = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+    const auto it = std::lower_bound(cumulative_.begin(), cumulative_.end(), value);
+    return std::min(static_cast<size_t>(it - cumulative_.begin()), cumulative_.size() - 1);
+}
+
+
+Corpus GenerateCorpus(const CorpusConfig& config)
+{
+    if (config.min_document_words == 0 || config.min_document_words > config.max_document_words)
+    {
+        throw std::invalid_argument("Invalid document length range"s);
+    }
+    if (config.stop_word_count >= config.vocabulary_size)
+    {
+        throw std::invalid_argument("Too many stop words for vocabulary"s);
+    }
+
+    std::mt19937_64 generator(config.seed);
+    Corpus corpus;
+    corpus.vocabulary = GenerateVocabulary(config.vocabulary_size, generator);
+    for (size_t i = 0; i < config.stop_word_count; ++i)
+    {
+        corpus.stop_words += (i == 0 ? ""s : " "s) + corpus.vocabulary[i];
+    }
+
+    const ZipfGenerator zipf(config.vocabulary_size, config.zipf_exponent);
+    std::uniform_int_distribution<size_t> length(config.min_document_words, config.max_document_words);
+    std::uniform_int_distribution<int> rating(-5, 10);
+    std::uniform_int_distribution<int> rating_count(1, 5);
+
+    corpus.documents.reserve(config.document_count);
+    for (size_t i = 0; i < config.document_count; ++i)
+    {
+        CorpusDocument document;
+        document.id = static_cast<int>(i);
+        const size_t word_count = length(generator);
+        for (size_t j = 0; j < word_count; ++j)
+        {
+            if (j > 0)
+            {
+                document.text.push_back(' ');
+            }
+            document.text += corpus.vocabulary[zipf(generator)];
+        }
+        document.status = GenerateStatus(generator);
+        for (int j = rating_count(generator); j > 0; --j)
+        {
+            document.ratings.push_back(rating(generator));
+        }
+        corpus.documents.push_back(std::move(document));
+    }
+    return corpus;
+}
+
+
+std::vector<std::string> GenerateQueries(const Corpus& corpus, const CorpusConfig& config, QueryMix mix,
+                                         size_t query_count, uint64_t seed)
+{
+    std::mt19937_64 generator(seed);
+    const ZipfGenerator zipf(corpus.vocabulary.size(), config.zipf_exponent);
+    // Запросы редко состоят из стоп-слов: слова выбираются из словаря без них
+    const auto pick_word = [&]()
+    {
+        size_t rank = zipf(generator);
+        while (rank < config.stop_word_count)
+        {
+            rank = zipf(generator);
+        }
+        return corpus.vocabulary[rank];
+    };
+
+    std::vector<std::string> queries;
+    queries.reserve(query_count);
+    for (size_t i = 0; i < query_count; ++i)
+    {
+        size_t plus_count = 0;
+        size_t minus_count = 0;
+        size_t required_count = 0;
+        switch (mix)
+        {
+        case QueryMix::SHORT:
+            plus_count = std::uniform_int_distribution<size_t>(1, 2)(generator);
+            break;
+        case QueryMix::LONG:
+            plus_count = std::uniform_int_distribution<size_t>(8, 15)(generator);
+            break;
+        case QueryMix::MINUS_HEAVY:
+            plus_count = 3;
+            minus_count = 3;
+            break;
+        case QueryMix::REQUIRED:
+            plus_count = 6;
+            required_count = 2;
+            break;
+        }
+
+        std::string query;
+        for (size_t j = 0; j < plus_count + minus_count; ++j)
+        {
+            if (!query.empty())
+            {
+                query.push_back(' ');
+            }
+            if (j >= plus_count)
+            {
+                query.push_back('-');
+            }
+            else if (j < required_count)
+            {
+                query.push_back('+');
+            }
+            query += pick_word();
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+// Генератор рангов по закону Ципфа: ранг k (0..n-1) выпадает с вероятностью, пропорциональной 1 / (k + 1)^s.
+// Частоты слов естественного языка близки к этому закону: немногие частые слова и длинный хвост редких
+class ZipfGenerator
+{
+public:
+    ZipfGenerator(size_t n, double exponent);
+
+    size_t operator()(std::mt19937_64&) const;
+
+private:
+    std::vector<double> cumulative_;    // Нормированная функция распределения по рангам
+};
+
+// Параметры синтетического корпуса
+struct CorpusConfig
+{
+    size_t document_count = 10'000;
+    size_t vocabulary_size = 50'000;
+    double zipf_exponent = 1.07;
+    size_t min_document_words = 20;
+    size_t max_document_words = 60;
+    // Самые частые слова словаря объявляются стоп-словами
+    size_t stop_word_count = 20;
+    uint64_t seed = 42;
+};
+
+struct CorpusDocument
+{
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
+struct Corpus
+{
+    // Слова словаря упорядочены по рангу (частоте): vocabulary[0] - самое частое
+    std::vector<std::string> vocabulary;
+    std::string stop_words;
+    std::vector<CorpusDocument> documents;
+};
+
+// Смесь запросов одного вида
+enum class QueryMix
+{
+    SHORT,          // 1-2 слова
+    LONG,           // 8-15 слов
+    MINUS_HEAVY,    // 3 плюс-слова и 3 минус-слова
+    REQUIRED,       // 2 обязательных слова (+слово) и 4 плюс-слова
+};
+
+// Генерирует корпус. Результат полностью определяется config (в том числе seed)
+Corpus GenerateCorpus(const CorpusConfig&);
+
+// Генерирует запросы: слова выбираются по закону Ципфа из словаря корпуса
+std::vector<std::string> GenerateQueries(const Corpus&, const CorpusConfig&, QueryMix, size_t query_count, uint64_t seed);
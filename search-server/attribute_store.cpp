@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "attribute_store.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+// Размер блока проверки: значения столбцов блока собираются в локальные массивы,
+// после чего условия проверяются простыми циклами без ветвлений
+const size_t FILTER_BLOCK_SIZE = 256;
+}
+
+
+void DocumentAttributeStore::Add(int document_id, int rating, DocumentStatus status, int word_count)
+{
+    ratings_.Set(document_id, rating);
+    statuses_.Set(document_id, static_cast<uint8_t>(status));
+    word_counts_.Set(document_id, word_count);
+}
+
+
+void DocumentAttributeStore::Remove(int document_id)
+{
+    // Рейтинг и статус удалённого документа не читаются, дополнительные атрибуты
+    // сбрасываются, чтобы документ с тем же id начинал со значений по умолчанию
+    for (auto& column : attributes_)
+    {
+        if (column.Get(document_id) != 0.0)
+        {
+            column.Set(document_id, 0.0);
+        }
+    }
+}
+
+
+void DocumentAttributeStore::SetAttribute(int document_id, std::string_view name, double value)
+{
+    auto it = attribute_indexes_.find(name);
+    if (it == attribute_indexes_.end())
+    {
+        it = attribute_indexes_.emplace(std::string(name), attributes_.size()).first;
+        attributes_.emplace_back();
+    }
+    attributes_[it->second].Set(document_id, value);
+}
+
+
+double DocumentAttributeStore::GetAttribute(int document_id, std::string_view name) const
+{
+    return GetAttributeColumn(name).Get(document_id);
+}
+
+
+const DocumentAttributeStore::Column<double>& DocumentAttributeStore::GetAttributeColumn(std::string_view name) const
+{
+    const auto it = attribute_indexes_.find(name);
+    if (it == attribute_indexes_.end())
+    {
+        throw std::invalid_argument("Unknown document attribute "s + std::string(name));
+    }
+    return attributes_[it->second];
+}
+
+
+void DocumentAttributeStore::Filter(const DocumentFilter& filter, const int* ids, size_t count, uint8_t* keep) const
+{
+    if (filter.id_modulo < 0)
+    {
+        throw std::invalid_argument("Document id modulo must be non-negative"s);
+    }
+
+    std::vector<const Column<double>*> attribute_columns;
+    attribute_columns.reserve(filter.attribute_ranges.size());
+    for (const auto& range : filter.attribute_ranges)
+    {
+        attribute_columns.push_back(&GetAttributeColumn(range.name));
+    }
+
+    const int32_t min_rating = filter.min_rating;
+    const int32_t max_rating = filter.max_rating;
+    // Проверка статуса сравнениями с допустимыми статусами (сдвиг на переменную величину
+    // не векторизуется без AVX2)
+    int32_t allowed_statuses[DOCUMENT_STATUS_COUNT];
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+    {
+        allowed_statuses[status] = filter.HasStatus(static_cast<DocumentStatus>(status)) ? static_cast<int32_t>(status) : -1;
+    }
+
+    // Локальные массивы блока одной ширины (32 бита), чтобы циклы проверки векторизовались.
+    // Результат блока копится локально: запись через keep (указатель на байты)
+    // могла бы пересекаться с любыми данными и мешала бы векторизации
+    int32_t ratings[FILTER_BLOCK_SIZE];
+    int32_t statuses[FILTER_BLOCK_SIZE];
+    double values[FILTER_BLOCK_SIZE];
+    int32_t block_keep[FILTER_BLOCK_SIZE];
+
+    for (size_t block_begin = 0; block_begin < count; block_begin += FILTER_BLOCK_SIZE)
+    {
+        const size_t block_size = std::min(FILTER_BLOCK_SIZE, count - block_begin);
+        const int* block_ids = ids + block_begin;
+
+        // Сбор значений столбцов (обращения к страницам), затем проверка условий над плотными массивами
+        for (size_t i = 0; i < block_size; ++i)
+        {
+            ratings[i] = ratings_.Get(block_ids[i]);
+            statuses[i] = statuses_.Get(block_ids[i]);
+        }
+        for (size_t i = 0; i < block_size; ++i)
+        {
+            block_keep[i] = (ratings[i] >= min_rating) & (ratings[i] <= max_rating);
+        }
+        for (size_t i = 0; i < block_size; ++i)
+        {
+            int32_t status_allowed = 0;
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+            {
+                status_allowed |= (statuses[i] == allowed_statuses[status]);
+            }
+            block_keep[i] &= status_allowed;
+        }
+
+        if (filter.id_modulo > 0)
+        {
+            const int modulo = filter.id_modulo;
+            const int remainder = filter.id_remainder;
+            for (size_t i = 0; i < block_size; ++i)
+            {
+                block_keep[i] &= (block_ids[i] % modulo == remainder);
+            }
+        }
+
+        for (size_t attribute = 0; attribute < attribute_columns.size(); ++attribute)
+        {
+            const Column<double>& column = *attribute_columns[attribute];
+            const double min_value = filter.attribute_ranges[attribute].min_value;
+            const double max_value = filter.attribute_ranges[attribute].max_value;
+            for (size_t i = 0; i < block_size; ++i)
+            {
+                values[i] = column.Get(block_ids[i]);
+            }
+            for (size_t i = 0; i < block_size; ++i)
+            {
+                // Выбор вместо &: маски сравнения double и int32 разной ширины, так цикл векторизуется
+                const double value = values[i];
+                block_keep[i] = (value >= min_value && value <= max_value) ? block_keep[i] : 0;
+            }
+        }
+
+        for (size_t i = 0; i < block_size; ++i)
+        {
+            keep[block_begin + i] = static_cast<uint8_t>(block_keep[i]);
+        }
+    }
+}
+
+
+size_t DocumentAttributeStore::EstimateAddMemory(int document_id) const
+{
+    return ratings_.EstimateSetMemory(document_id) + statuses_.EstimateSetMemory(document_id)
+        + word_counts_.EstimateSetMemory(document_id);
+}
+
+
+size_t DocumentAttributeStore::GetMemoryUsage() const
+{
+    size_t result = ratings_.GetMemoryUsage() + statuses_.GetMemoryUsage() + word_counts_.GetMemoryUsage()
+        + EstimateTreeMemory(attribute_indexes_) + EstimateVectorMemory(attributes_);
+    for (const auto& [name, index] : attribute_indexes_)
+    {
+        result += EstimateStringMemory(name);
+    }
+    for (const auto& column : attributes_)
+    {
+        result += column.GetMemoryUsage();
+    }
+    return result;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "memory_usage.h"
+
+// Декларативный фильтр документов для FindTopDocuments().
+// В отличие от произвольного предиката, проверяется блоками по столбцам атрибутов
+// без ветвлений, что позволяет компилятору векторизовать проверку
+struct DocumentFilter
+{
+    // Диапазон дополнительного числового атрибута документа (границы включаются)
+    struct AttributeRange
+    {
+        std::string name;
+        double min_value = std::numeric_limits<double>::lowest();
+        double max_value = std::numeric_limits<double>::max();
+    };
+
+    // Диапазон рейтинга (границы включаются)
+    int min_rating = std::numeric_limits<int>::min();
+    int max_rating = std::numeric_limits<int>::max();
+
+    // Множество допустимых статусов: бит i соответствует статусу со значением i.
+    // По умолчанию - только актуальные документы, как у FindTopDocuments() без статуса
+    uint32_t status_mask = StatusMask({ DocumentStatus::ACTUAL });
+
+    // Условие id % id_modulo == id_remainder (0 - без условия)
+    int id_modulo = 0;
+    int id_remainder = 0;
+
+    std::vector<AttributeRange> attribute_ranges;
+
+    static constexpr uint32_t StatusMask(std::initializer_list<DocumentStatus> statuses)
+    {
+        uint32_t mask = 0;
+        for (DocumentStatus status : statuses)
+        {
+            mask |= 1u << static_cast<uint32_t>(status);
+        }
+        return mask;
+    }
+
+    bool HasStatus(DocumentStatus status) const
+    {
+        return (status_mask >> static_cast<uint32_t>(status)) & 1u;
+    }
+};
+
+// Столбцовое хранилище атрибутов документов (структура массивов).
+// Каждый атрибут - отдельный столбец, индексируемый id документа. Столбец разбит на страницы
+// по PAGE_SIZE значений, страницы выделяются при первой записи в их диапазон id.
+// Кроме рейтинга, статуса и длины документа можно заводить дополнительные числовые атрибуты (по умолчанию 0)
+class DocumentAttributeStore
+{
+public:
+    static constexpr size_t PAGE_SIZE = 4096;
+
+    // word_count - число слов документа без стоп-слов (длина документа для ранжирования)
+    void Add(int document_id, int rating, DocumentStatus, int word_count);
+
+    // Сбрасывает дополнительные атрибуты документа
+    void Remove(int document_id);
+
+    int GetRating(int document_id) const
+    {
+        return ratings_.Get(document_id);
+    }
+
+    DocumentStatus GetStatus(int document_id) const
+    {
+        return static_cast<DocumentStatus>(statuses_.Get(document_id));
+    }
+
+    int GetWordCount(int document_id) const
+    {
+        return word_counts_.Get(document_id);
+    }
+
+    // Записывает в word_counts[i] длину документа ids[i] (для блочного вычисления BM25)
+    void GatherWordCounts(const int* ids, size_t count, int32_t* word_counts) const
+    {
+        word_counts_.Gather(ids, count, word_counts);
+    }
+
+    // Вызывает function(имя, значение) для всех дополнительных атрибутов документа
+    template <typename Function>
+    void ForEachAttribute(int document_id, Function function) const
+    {
+        for (const auto& [name, index] : attribute_indexes_)
+        {
+            function(std::string_view(name), attributes_[index].Get(document_id));
+        }
+    }
+
+    // Записывает значение дополнительного атрибута, заводя столбец при первом использовании имени
+    void SetAttribute(int document_id, std::string_view name, double value);
+
+    // Значение дополнительного атрибута. Для неизвестного имени выбрасывает std::invalid_argument
+    double GetAttribute(int document_id, std::string_view name) const;
+
+    // Проверяет документы ids[0..count) фильтром: keep[i] = 1, если документ проходит фильтр, иначе 0.
+    // Для неизвестного имени атрибута или отрицательного id_modulo выбрасывает std::invalid_argument
+    void Filter(const DocumentFilter&, const int* ids, size_t count, uint8_t* keep) const;
+
+    // Объём динамической памяти хранилища в байтах
+    size_t GetMemoryUsage() const;
+
+    // Оценка памяти, которую выделит Add() для документа (новые страницы столбцов)
+    size_t EstimateAddMemory(int document_id) const;
+
+private:
+    template <typename Type>
+    class Column
+    {
+    public:
+        Type Get(int document_id) const
+        {
+            const size_t page = static_cast<size_t>(document_id) / PAGE_SIZE;
+            if (page >= pages_.size() || !pages_[page])
+            {
+                return Type{};
+            }
+            return pages_[page][static_cast<size_t>(document_id) % PAGE_SIZE];
+        }
+
+        // values[i] = Get(ids[i]). Соседние id списков обычно лежат на одной странице,
+        // поэтому страница ищется заново только при смене номера страницы
+        void Gather(const int* ids, size_t count, Type* values) const
+        {
+            size_t current_page = static_cast<size_t>(-1);
+            const Type* page_values = nullptr;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const size_t page = static_cast<size_t>(ids[i]) / PAGE_SIZE;
+                if (page != current_page)
+                {
+                    current_page = page;
+                    page_values = (page < pages_.size()) ? pages_[page].get() : nullptr;
+                }
+                values[i] = page_values ? page_values[static_cast<size_t>(ids[i]) % PAGE_SIZE] : Type{};
+            }
+        }
+
+        void Set(int document_id, Type value)
+        {
+            const size_t page = static_cast<size_t>(document_id) / PAGE_SIZE;
+            if (page >= pages_.size())
+            {
+                pages_.resize(page + 1);
+            }
+            if (!pages_[page])
+            {
+                pages_[page] = std::make_unique<Type[]>(PAGE_SIZE);
+            }
+            pages_[page][static_cast<size_t>(document_id) % PAGE_SIZE] = value;
+        }
+
+        // Оценка памяти, которую выделит Set() для документа
+        size_t EstimateSetMemory(int document_id) const
+        {
+            const size_t page = static_cast<size_t>(document_id) / PAGE_SIZE;
+            if (page < pages_.size() && pages_[page])
+            {
+                return 0;
+            }
+            size_t result = EstimateAllocation(PAGE_SIZE * sizeof(Type));
+            if (page >= pages_.capacity())
+            {
+                // resize() как минимум удваивает ёмкость массива страниц
+                result += EstimateAllocation(std::max(2 * pages_.capacity(), page + 1) * sizeof(pages_[0]))
+                    - EstimateVectorMemory(pages_);
+            }
+            return result;
+        }
+
+        size_t GetMemoryUsage() const
+        {
+            size_t result = EstimateVectorMemory(pages_);
+            for (const auto& page : pages_)
+            {
+                result += page ? EstimateAllocation(PAGE_SIZE * sizeof(Type)) : 0;
+            }
+            return result;
+        }
+
+    private:
+        std::vector<std::unique_ptr<Type[]>> pages_;
+    };
+
+    Column<int32_t> ratings_;
+    Column<uint8_t> statuses_;
+    Column<int32_t> word_counts_;
+
+    // Дополнительные атрибуты: имя - номер столбца
+    std::map<std::string, size_t, std::less<>> attribute_indexes_;
+    std::vector<Column<double>> attributes_;
+
+    const Column<double>& GetAttributeColumn(std::string_view) const;
+};
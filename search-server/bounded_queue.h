@@ -0,0 +1,93 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Потокобезопасная очередь ограниченной ёмкости для связи этапов конвейера.
+// Push() ждёт, пока в очереди есть место, Pop() - пока в ней есть элемент, поэтому быстрый этап
+// не накапливает неограниченно данные для медленного. После Close() новые элементы не принимаются,
+// а Pop() возвращает оставшиеся и затем false
+template <typename Type>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : capacity_(capacity)
+    {
+        using namespace std::string_literals;
+        if (capacity_ == 0)
+        {
+            throw std::invalid_argument("Queue capacity must be positive"s);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    // Возвращает false, если очередь закрыта (элемент не добавлен)
+    bool Push(Type value)
+    {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this]
+                       {
+                           return closed_ || items_.size() < capacity_;
+                       });
+        if (closed_)
+        {
+            return false;
+        }
+        items_.push_back(std::move(value));
+        lock.unlock();
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Возвращает false, если очередь закрыта и пуста
+    bool Pop(Type& value)
+    {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this]
+                        {
+                            return closed_ || !items_.empty();
+                        });
+        if (items_.empty())
+        {
+            return false;
+        }
+        value = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+        return true;
+    }
+
+    // Пробуждает все ожидающие потоки
+    void Close()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t GetCapacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+    std::deque<Type> items_;
+    bool closed_ = false;
+};
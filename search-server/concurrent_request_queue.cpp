@@ -0,0 +1,194 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "concurrent_request_queue.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+std::atomic<uint64_t> next_queue_id{ 0 };
+}
+
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const SearchServer& search_server, std::chrono::seconds window)
+    : search_server_(search_server)
+    , window_seconds_(window.count())
+    , start_time_(Clock::now())
+    , id_(next_queue_id.fetch_add(1, std::memory_order_relaxed))
+{
+    if (window_seconds_ <= 0)
+    {
+        throw std::invalid_argument("Statistics window must be positive"s);
+    }
+}
+
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(std::string_view raw_query, DocumentStatus status)
+{
+    return AddFindRequest(raw_query, DocumentStatusFilter{ status });
+}
+
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(std::string_view raw_query)
+{
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+
+void ConcurrentRequestQueue::RecordRequest(size_t result_count, Clock::duration latency, Clock::time_point finish)
+{
+    const int64_t second = ToSecond(finish);
+    if (second < 0)
+    {
+        // Запрос завершился до создания очереди
+        return;
+    }
+    const uint64_t latency_ns = static_cast<uint64_t>(
+        std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+
+    SecondSlot& slot = GetThreadRecorder().slots[static_cast<size_t>(second % window_seconds_)];
+    const int64_t slot_second = slot.second.load(std::memory_order_relaxed);
+    if (slot_second != second)
+    {
+        // Интервал устарел: в этой ячейке кольца хранилась секунда из прошлого окна
+        if (slot_second > second)
+        {
+            // Запрос старше окна, уже вытесненного более новыми запросами
+            return;
+        }
+        slot.second.store(-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.request_count.store(0, std::memory_order_relaxed);
+        slot.no_result_count.store(0, std::memory_order_relaxed);
+        slot.latency.Reset();
+        slot.second.store(second, std::memory_order_release);
+    }
+    slot.request_count.fetch_add(1, std::memory_order_relaxed);
+    if (result_count == 0)
+    {
+        slot.no_result_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    slot.latency.Record(latency_ns);
+}
+
+
+int ConcurrentRequestQueue::GetNoResultRequests() const
+{
+    return static_cast<int>(GetStatistics().no_result_count);
+}
+
+
+RequestStatistics ConcurrentRequestQueue::GetStatistics() const
+{
+    return GetStatistics(Clock::now());
+}
+
+
+RequestStatistics ConcurrentRequestQueue::GetStatistics(Clock::time_point now) const
+{
+    const int64_t current_second = ToSecond(now);
+    const int64_t first_second = current_second - window_seconds_ + 1;
+
+    RequestStatistics result;
+    Histogram latency;
+    std::lock_guard guard(recorders_mutex_);
+    for (const auto& recorder : recorders_)
+    {
+        for (const SecondSlot& slot : recorder->slots)
+        {
+            const int64_t second = slot.second.load(std::memory_order_acquire);
+            if (second < first_second || second > current_second)
+            {
+                continue;
+            }
+            const uint64_t request_count = slot.request_count.load(std::memory_order_relaxed);
+            const uint64_t no_result_count = slot.no_result_count.load(std::memory_order_relaxed);
+            const Histogram slot_latency = slot.latency.Snapshot();
+            // Интервал сброшен под другую секунду во время чтения - его счётчики не учитываются
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.second.load(std::memory_order_relaxed) != second)
+            {
+                continue;
+            }
+            result.request_count += request_count;
+            result.no_result_count += no_result_count;
+            latency.Merge(slot_latency);
+        }
+    }
+
+    // Пока окно не заполнилось, QPS считается по прошедшему времени
+    const int64_t elapsed_seconds = std::clamp<int64_t>(current_second + 1, 1, window_seconds_);
+    result.queries_per_second = static_cast<double>(result.request_count) / elapsed_seconds;
+    result.no_result_rate = result.request_count == 0
+        ? 0.0
+        : static_cast<double>(result.no_result_count) / result.request_count;
+    result.latency_p50 = std::chrono::nanoseconds(latency.GetValueAtPercentile(50.0));
+    result.latency_p90 = std::chrono::nanoseconds(latency.GetValueAtPercentile(90.0));
+    result.latency_p99 = std::chrono::nanoseconds(latency.GetValueAtPercentile(99.0));
+    result.latency_max = std::chrono::nanoseconds(latency.GetMax());
+    return result;
+}
+
+
+int64_t ConcurrentRequestQueue::ToSecond(Clock::time_point time) const
+{
+    return std::chrono::duration_cast<std::chrono::seconds>(time - start_time_).count();
+}
+
+
+ConcurrentRequestQueue::ThreadRecorder& ConcurrentRequestQueue::GetThreadRecorder()
+{
+    // Кольца потока во всех очередях, в которые он записывал запросы. При завершении потока
+    // кольца освобождаются для других потоков (очередь может быть уже уничтожена - кольцо общее)
+    struct ThreadRecorders
+    {
+        std::vector<std::pair<uint64_t, std::shared_ptr<ThreadRecorder>>> entries;
+
+        ~ThreadRecorders()
+        {
+            for (const auto& [queue_id, recorder] : entries)
+            {
+                recorder->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local ThreadRecorders thread_recorders;
+
+    auto& entries = thread_recorders.entries;
+    for (const auto& [queue_id, recorder] : entries)
+    {
+        if (queue_id == id_)
+        {
+            return *recorder;
+        }
+    }
+    // Кольца уничтоженных очередей есть только у этого потока
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [](const auto& entry)
+                                 {
+                                     return entry.second.use_count() == 1;
+                                 }),
+                  entries.end());
+
+    std::shared_ptr<ThreadRecorder> recorder;
+    {
+        std::lock_guard guard(recorders_mutex_);
+        for (const auto& candidate : recorders_)
+        {
+            bool in_use = false;
+            if (candidate->in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+            {
+                recorder = candidate;
+                break;
+            }
+        }
+        if (!recorder)
+        {
+            recorder = std::make_shared<ThreadRecorder>(static_cast<size_t>(window_seconds_));
+            recorders_.push_back(recorder);
+        }
+    }
+    entries.emplace_back(id_, recorder);
+    return *recorder;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "histogram.h"
+#include "search_server.h"
+
+// Статистика запросов за скользящее окно
+struct RequestStatistics
+{
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    double queries_per_second = 0.0;
+    double no_result_rate = 0.0;    // Доля запросов без результатов (0..1)
+    std::chrono::nanoseconds latency_p50{ 0 };
+    std::chrono::nanoseconds latency_p90{ 0 };
+    std::chrono::nanoseconds latency_p99{ 0 };
+    std::chrono::nanoseconds latency_max{ 0 };
+};
+
+// Потокобезопасная очередь запросов со статистикой за последние window секунд реального времени.
+// Время берётся из монотонных часов, окно состоит из посекундных интервалов.
+// Каждый поток записывает запросы в собственное кольцо интервалов на атомарных счётчиках без блокировок
+// (у кольца один писатель), кольцо заводится при первом запросе потока и после завершения потока
+// достаётся следующему новому потоку. Чтение статистики складывает интервалы колец всех потоков;
+// запросы, записываемые во время чтения, могут не попасть в результат
+class ConcurrentRequestQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ConcurrentRequestQueue(const SearchServer&, std::chrono::seconds window = std::chrono::seconds(60));
+
+    // "обертки" для всех методов поиска, чтобы сохранять результаты для статистики
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(std::string_view, DocumentPredicate);
+
+    std::vector<Document> AddFindRequest(std::string_view, DocumentStatus);
+
+    std::vector<Document> AddFindRequest(std::string_view);
+
+    // Учитывает запрос, выполненный в обход очереди, завершившийся в момент finish
+    void RecordRequest(size_t result_count, Clock::duration latency, Clock::time_point finish = Clock::now());
+
+    // Число запросов без результатов за окно
+    int GetNoResultRequests() const;
+
+    RequestStatistics GetStatistics() const;
+
+    // Статистика на заданный момент времени (для запросов, учтённых с явным finish)
+    RequestStatistics GetStatistics(Clock::time_point now) const;
+
+private:
+    // Запросы, завершившиеся в одну секунду. На время сброса интервала под новую секунду
+    // second равно -1, чтобы читатель не принял сбрасываемые счётчики за данные новой секунды
+    struct SecondSlot
+    {
+        std::atomic<int64_t> second{ -1 };
+        std::atomic<uint64_t> request_count{ 0 };
+        std::atomic<uint64_t> no_result_count{ 0 };
+        AtomicHistogram latency;
+    };
+
+    // Интервалы одного потока. Пишет только поток, владеющий кольцом (in_use), читает GetStatistics()
+    struct ThreadRecorder
+    {
+        explicit ThreadRecorder(size_t window)
+            : slots(window)
+        {
+        }
+
+        std::atomic<bool> in_use{ true };
+        std::vector<SecondSlot> slots;  // Кольцевой буфер: секунда s хранится в slots[s % window]
+    };
+
+    const SearchServer& search_server_;
+    const int64_t window_seconds_;
+    const Clock::time_point start_time_;
+    // Отличает очередь от уничтоженных ранее очередей по тому же адресу
+    const uint64_t id_;
+    // Мьютекс берётся только при заведении кольца потока и при чтении статистики
+    mutable std::mutex recorders_mutex_;
+    std::vector<std::shared_ptr<ThreadRecorder>> recorders_;
+
+    int64_t ToSecond(Clock::time_point) const;
+
+    ThreadRecorder& GetThreadRecorder();
+};
+
+
+template <typename DocumentPredicate>
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(std::string_view raw_query, DocumentPredicate document_predicate)
+{
+    const auto start = Clock::now();
+    auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
+    const auto finish = Clock::now();
+    RecordRequest(result.size(), finish - start, finish);
+    return result;
+}
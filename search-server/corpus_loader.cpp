@@ -0,0 +1,198 @@
+#include "corpus_loader.h"
+
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "metrics.h"
+#include "read_input_functions.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Разобранный документ или исключение разбора записи, обрабатываемое при добавлении в порядке записей
+struct PreparedItem
+{
+    std::optional<SearchServer::PreparedDocument> document;
+    std::exception_ptr error;
+};
+
+// Результат разбора раунда: документы частей по порядку
+struct PreparedRound
+{
+    std::vector<std::vector<PreparedItem>> chunks;
+    Clock::duration time{};
+};
+
+// Делит данные на части примерно по chunk_size байт, каждая часть заканчивается концом строки
+std::vector<std::string_view> SplitIntoChunks(std::string_view data, size_t chunk_size)
+{
+    std::vector<std::string_view> chunks;
+    while (!data.empty())
+    {
+        const size_t line_end = data.find('\n', std::min(chunk_size, data.size()) - 1);
+        const size_t chunk_end = line_end == std::string_view::npos ? data.size() : line_end + 1;
+        chunks.push_back(data.substr(0, chunk_end));
+        data.remove_prefix(chunk_end);
+    }
+    return chunks;
+}
+
+std::vector<PreparedItem> PrepareChunk(const SearchServer& search_server, std::string_view chunk,
+                                       const std::shared_ptr<const void>& text_owner)
+{
+    std::vector<PreparedItem> items;
+    std::vector<int> ratings;
+    while (!chunk.empty())
+    {
+        const size_t line_end = chunk.find('\n');
+        const std::string_view line = chunk.substr(0, line_end);
+        chunk.remove_prefix(line_end == std::string_view::npos ? chunk.size() : line_end + 1);
+        if (line.empty() || line == "\r")
+        {
+            continue;
+        }
+
+        PreparedItem item;
+        try
+        {
+            int document_id = 0;
+            DocumentStatus status = DocumentStatus::ACTUAL;
+            std::string_view text;
+            ParseDocumentRecord(line, document_id, status, ratings, text);
+            item.document = search_server.PrepareDocument(document_id, text, status, ratings, text_owner);
+        }
+        catch (...)
+        {
+            item.error = std::current_exception();
+        }
+        items.push_back(std::move(item));
+    }
+    return items;
+}
+
+bool IsInvalidArgument(const std::exception_ptr& error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::invalid_argument&)
+    {
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+}
+
+
+std::ostream& operator<<(std::ostream& out, const CorpusLoadStatistics& statistics)
+{
+    const auto to_seconds = [](std::chrono::nanoseconds duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    };
+    return out << "added = "s << statistics.added_documents << ", rejected = "s << statistics.rejected_documents
+               << ", bytes = "s << statistics.bytes
+               << ", prepare = "s << to_seconds(statistics.prepare_time) << " s"s
+               << ", index = "s << to_seconds(statistics.index_time) << " s"s
+               << ", elapsed = "s << to_seconds(statistics.elapsed) << " s"s;
+}
+
+
+CorpusLoadStatistics LoadCorpusFile(SearchServer& search_server, const std::string& path,
+                                    const CorpusLoadOptions& options)
+{
+    METRICS_TIMER("ingest.load_corpus");
+
+    if (options.chunk_size == 0)
+    {
+        throw std::invalid_argument("Corpus chunk size must be positive"s);
+    }
+    const size_t round_size = options.parallel_chunks != 0 ? options.parallel_chunks
+                                                           : std::max(1u, std::thread::hardware_concurrency());
+
+    const Clock::time_point start = Clock::now();
+    CorpusLoadStatistics statistics;
+    const auto file = std::make_shared<const MappedFile>(path);
+    const std::shared_ptr<const void> text_owner = options.reference_mapped_text ? file : nullptr;
+    const std::vector<std::string_view> chunks = SplitIntoChunks(file->GetData(), options.chunk_size);
+    statistics.bytes = file->GetData().size();
+
+    // Разбор раунда не зависит от состояния индекса, поэтому следующий раунд разбирается,
+    // пока документы предыдущего добавляются в индекс
+    const auto prepare_round = [&](size_t first_chunk)
+    {
+        const Clock::time_point round_start = Clock::now();
+        const auto first = chunks.begin() + first_chunk;
+        const auto last = chunks.begin() + std::min(first_chunk + round_size, chunks.size());
+        PreparedRound round;
+        round.chunks.resize(last - first);
+        std::transform(std::execution::par, first, last, round.chunks.begin(),
+                       [&search_server, &text_owner](std::string_view chunk)
+                       {
+                           return PrepareChunk(search_server, chunk, text_owner);
+                       });
+        round.time = Clock::now() - round_start;
+        return round;
+    };
+
+    std::future<PreparedRound> next_round;
+    if (!chunks.empty())
+    {
+        next_round = std::async(std::launch::async, prepare_round, 0);
+    }
+    for (size_t first_chunk = 0; first_chunk < chunks.size(); first_chunk += round_size)
+    {
+        PreparedRound round = next_round.get();
+        if (first_chunk + round_size < chunks.size())
+        {
+            next_round = std::async(std::launch::async, prepare_round, first_chunk + round_size);
+        }
+        statistics.prepare_time += round.time;
+
+        const Clock::time_point index_start = Clock::now();
+        for (std::vector<PreparedItem>& items : round.chunks)
+        {
+            for (PreparedItem& item : items)
+            {
+                if (item.document)
+                {
+                    try
+                    {
+                        search_server.AddPreparedDocument(std::move(*item.document));
+                        ++statistics.added_documents;
+                        continue;
+                    }
+                    catch (...)
+                    {
+                        item.error = std::current_exception();
+                    }
+                }
+                if (!options.skip_invalid_documents || !IsInvalidArgument(item.error))
+                {
+                    std::rethrow_exception(item.error);
+                }
+                ++statistics.rejected_documents;
+            }
+        }
+        statistics.index_time += Clock::now() - index_start;
+    }
+
+    statistics.elapsed = Clock::now() - start;
+    return statistics;
+}
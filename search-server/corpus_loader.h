@@ -0,0 +1,45 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "search_server.h"
+
+struct CorpusLoadOptions
+{
+    // Размер части файла, которую разбирает одна задача (конец части сдвигается к концу строки)
+    size_t chunk_size = 16 << 20;
+    // Число частей, разбираемых параллельно за один раунд (0 - по числу аппаратных потоков)
+    size_t parallel_chunks = 0;
+    // true - документы ссылаются на тексты в отображённом файле, и файл остаётся отображённым, пока существует сервер.
+    // false - тексты копируются в индекс, файл освобождается после загрузки
+    bool reference_mapped_text = true;
+    // Некорректные записи и документы (std::invalid_argument) пропускаются и учитываются в rejected_documents.
+    // Иначе загрузка останавливается, и исключение выбрасывается после документов, предшествовавших записи
+    bool skip_invalid_documents = false;
+};
+
+struct CorpusLoadStatistics
+{
+    uint64_t added_documents = 0;
+    uint64_t rejected_documents = 0;
+    uint64_t bytes = 0;
+    // Время разбора раундов и добавления в индекс. Разбор следующего раунда идёт одновременно
+    // с добавлением предыдущего, поэтому их сумма может превышать elapsed
+    std::chrono::nanoseconds prepare_time{ 0 };
+    std::chrono::nanoseconds index_time{ 0 };
+    std::chrono::nanoseconds elapsed{ 0 };
+};
+
+std::ostream& operator<<(std::ostream&, const CorpusLoadStatistics&);
+
+// Загружает файл корпуса - записи в формате DocumentRecord (read_input_functions.h), по одной на строку.
+// Файл отображается в память (mapped_file.h) и делится на части по границам строк. Части разбираются
+// параллельно прямо в отображении, без копирования строк в std::string, а документы добавляются в индекс
+// в порядке записей. При reference_mapped_text тексты документов не копируются в индекс.
+// Для недоступного файла выбрасывает std::runtime_error
+CorpusLoadStatistics LoadCorpusFile(SearchServer&, const std::string& path, const CorpusLoadOptions& options = {});
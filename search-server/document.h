@@ -1,6 +1,7 @@
 #pragma once
 
 // #include для type resolution в объявлениях функций:
+#include <cstddef>
 #include <iostream>
 
 struct Document
@@ -23,3 +24,11 @@ enum class DocumentStatus
     BANNED,
     REMOVED,
 };
+
+// Количество значений DocumentStatus
+const size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Тип хранимой частоты слова в документе (доли слова среди слов документа) в списках документов
+// и прямом индексе. Относительная погрешность одинарной точности (~6e-8) намного меньше точности сравнения
+// релевантности, а элементы списков вдвое компактнее. Вклады в релевантность вычисляются в double
+using TermFreq = float;
@@ -0,0 +1,217 @@
+#include "duplicate_detector.h"
+
+#include <cmath>
+#include <tuple>
+
+
+namespace
+{
+
+// Перемешивание битов (splitmix64) - хеш id слова
+uint64_t MixWordId(uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+}   // namespace
+
+
+DuplicateDetector::DuplicateDetector(std::pmr::memory_resource* resource)
+    : entries_(resource)
+{
+}
+
+
+void DuplicateDetector::AddDocument(int document_id, const std::vector<int>& word_ids)
+{
+    // Запись создаётся сразу в словаре, чтобы список слов был выделен из ресурса словаря
+    Entry& entry = entries_[document_id];
+    entry.set_hash = 0;
+    entry.signature.fill(UINT32_MAX);
+
+    for (int word_id : word_ids)
+    {
+        const uint64_t hash = MixWordId(static_cast<uint64_t>(word_id));
+        // Сумма хешей не зависит от порядка слов
+        entry.set_hash += hash;
+
+        // Семейство хеш-функций h_i = h1 + i * h2 из двух половин одного 64-битного хеша
+        const uint32_t h1 = static_cast<uint32_t>(hash);
+        const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1u;
+        for (size_t i = 0; i < SIGNATURE_SIZE; ++i)
+        {
+            entry.signature[i] = std::min(entry.signature[i], h1 + static_cast<uint32_t>(i) * h2);
+        }
+    }
+    entry.word_ids.assign(word_ids.begin(), word_ids.end());
+}
+
+
+void DuplicateDetector::RemoveDocument(int document_id)
+{
+    entries_.erase(document_id);
+}
+
+
+size_t DuplicateDetector::GetMemoryUsage() const
+{
+    size_t result = EstimateTreeMemory(entries_);
+    for (const auto& [document_id, entry] : entries_)
+    {
+        result += EstimateVectorMemory(entry.word_ids);
+    }
+    return result;
+}
+
+
+size_t DuplicateDetector::GetDocumentMemory(int document_id) const
+{
+    const auto it = entries_.find(document_id);
+    if (it == entries_.end())
+    {
+        return 0;
+    }
+    return EstimateTreeNodeMemory<std::pair<const int, Entry>>() + EstimateVectorMemory(it->second.word_ids);
+}
+
+
+size_t DuplicateDetector::EstimateDocumentMemory(size_t unique_word_count)
+{
+    return EstimateTreeNodeMemory<std::pair<const int, Entry>>() + EstimateAllocation(unique_word_count * sizeof(int));
+}
+
+
+void DuplicateDetector::CheckThreshold(DuplicateMode mode, double threshold)
+{
+    using namespace std::string_literals;
+
+    if (mode == DuplicateMode::JACCARD && !(threshold > 0.0 && threshold <= 1.0))
+    {
+        throw std::invalid_argument("Jaccard threshold must be in (0, 1]"s);
+    }
+}
+
+
+std::vector<DuplicateDetector::EntryRef> DuplicateDetector::CollapseIdenticalSets(std::vector<int>& copies) const
+{
+    std::vector<EntryRef> documents;
+    documents.reserve(entries_.size());
+    for (const auto& document : entries_)
+    {
+        documents.push_back(&document);
+    }
+    std::sort(documents.begin(), documents.end(),
+              [](EntryRef lhs, EntryRef rhs)
+              {
+                  return std::tie(lhs->second.set_hash, lhs->first) < std::tie(rhs->second.set_hash, rhs->first);
+              });
+
+    // Внутри группы с одинаковым отпечатком документ сравнивается с уже выбранными представителями группы.
+    // При коллизии отпечатков у группы окажется несколько представителей
+    std::vector<EntryRef> representatives;
+    for (size_t group_begin = 0; group_begin < documents.size();)
+    {
+        const size_t group_representatives = representatives.size();
+        size_t group_end = group_begin;
+        for (; group_end < documents.size() && documents[group_end]->second.set_hash == documents[group_begin]->second.set_hash; ++group_end)
+        {
+            const EntryRef document = documents[group_end];
+            const bool is_copy = std::any_of(representatives.begin() + group_representatives, representatives.end(),
+                                             [document](EntryRef representative)
+                                             {
+                                                 return representative->second.word_ids == document->second.word_ids;
+                                             });
+            if (is_copy)
+            {
+                copies.push_back(document->first);
+            }
+            else
+            {
+                representatives.push_back(document);
+            }
+        }
+        group_begin = group_end;
+    }
+    std::sort(copies.begin(), copies.end());
+
+    return representatives;
+}
+
+
+size_t DuplicateDetector::ChooseRowsPerBand(double threshold)
+{
+    // Порог срабатывания LSH при b полосах по r строк примерно равен (1/b)^(1/r).
+    // Берём самые длинные полосы (меньше ложных кандидатов), порог которых заметно ниже заданного
+    size_t best_rows = 1;
+    for (size_t rows = 1; rows <= SIGNATURE_SIZE; rows *= 2)
+    {
+        const double bands = static_cast<double>(SIGNATURE_SIZE / rows);
+        if (std::pow(1.0 / bands, 1.0 / rows) <= 0.75 * threshold)
+        {
+            best_rows = rows;
+        }
+    }
+    return best_rows;
+}
+
+
+double DuplicateDetector::ComputeJaccard(const std::pmr::vector<int>& lhs, const std::pmr::vector<int>& rhs)
+{
+    if (lhs.empty() && rhs.empty())
+    {
+        return 1.0;
+    }
+
+    size_t intersection = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end())
+    {
+        if (*lhs_it < *rhs_it)
+        {
+            ++lhs_it;
+        }
+        else if (*rhs_it < *lhs_it)
+        {
+            ++rhs_it;
+        }
+        else
+        {
+            ++intersection;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+
+    return static_cast<double>(intersection) / static_cast<double>(lhs.size() + rhs.size() - intersection);
+}
+
+
+std::vector<int> DuplicateDetector::SelectDuplicates(std::vector<Candidate> pairs)
+{
+    // Документы рассматриваются по возрастанию id: к моменту обработки пар документа
+    // судьба всех документов с меньшими id уже решена
+    std::sort(pairs.begin(), pairs.end(),
+              [](const Candidate& lhs, const Candidate& rhs)
+              {
+                  return std::tie(lhs.second, lhs.first) < std::tie(rhs.second, rhs.first);
+              });
+
+    std::vector<int> duplicates;
+    for (const auto& [kept_id, document_id] : pairs)
+    {
+        if (!duplicates.empty() && duplicates.back() == document_id)
+        {
+            continue;
+        }
+        if (!std::binary_search(duplicates.begin(), duplicates.end(), kept_id))
+        {
+            duplicates.push_back(document_id);
+        }
+    }
+
+    return duplicates;
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <iterator>
+#include <map>
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+
+// Режим поиска дубликатов
+enum class DuplicateMode
+{
+    EXACT,      // Совпадают множества слов документов (частоты слов не учитываются)
+    JACCARD,    // Коэффициент Жаккара множеств слов не меньше заданного порога
+};
+
+// Подсистема поиска дубликатов документов.
+// При добавлении документа вычисляются отпечаток множества его слов и MinHash-сигнатура.
+// Точный режим группирует документы по отпечатку, режим Жаккара ищет пары-кандидаты
+// методом LSH (сигнатура делится на полосы, документы с совпавшей полосой - кандидаты).
+// Кандидаты затем проверяются точным сравнением множеств слов.
+class DuplicateDetector
+{
+public:
+    // Число хеш-функций MinHash-сигнатуры
+    static constexpr size_t SIGNATURE_SIZE = 32;
+
+    // Данные документов выделяются из resource
+    explicit DuplicateDetector(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // Добавляет документ. word_ids - отсортированные id различных слов документа
+    void AddDocument(int, const std::vector<int>& word_ids);
+
+    void RemoveDocument(int);
+
+    // Объём динамической памяти подсистемы в байтах
+    size_t GetMemoryUsage() const;
+
+    // Объём динамической памяти данных документа (0 для неизвестного документа)
+    size_t GetDocumentMemory(int) const;
+
+    // Оценка памяти, которую займёт документ с unique_word_count различными словами
+    static size_t EstimateDocumentMemory(size_t unique_word_count);
+
+    // Возвращает отсортированные id документов-дубликатов.
+    // Из каждой группы дубликатов остаётся документ с наименьшим id.
+    // В режиме JACCARD документ считается дубликатом, если похож на оставшийся документ с меньшим id.
+    // LSH уверенно находит пары с похожестью выше threshold, пары около порога могут быть пропущены
+    template <class ExecutionPolicy>
+    std::vector<int> FindDuplicates(ExecutionPolicy&&, DuplicateMode, double threshold) const;
+
+    // Пары (меньший id, больший id), которые FindDuplicates() проверяет сравнением множеств слов.
+    // В режиме JACCARD документы с одинаковыми множествами слов в пары не входят:
+    // из каждой такой группы в LSH участвует только документ с наименьшим id
+    template <class ExecutionPolicy>
+    std::vector<std::pair<int, int>> FindCandidates(ExecutionPolicy&&, DuplicateMode, double threshold) const;
+
+private:
+    struct Entry
+    {
+        using allocator_type = std::pmr::polymorphic_allocator<int>;
+
+        uint64_t set_hash = 0;      // Отпечаток множества слов, не зависящий от порядка слов
+        std::array<uint32_t, SIGNATURE_SIZE> signature{};
+        std::pmr::vector<int> word_ids;
+
+        explicit Entry(const allocator_type& allocator = {})
+            : word_ids(allocator)
+        {
+        }
+
+        Entry(const Entry& other, const allocator_type& allocator)
+            : set_hash(other.set_hash)
+            , signature(other.signature)
+            , word_ids(other.word_ids, allocator)
+        {
+        }
+
+        Entry(Entry&& other, const allocator_type& allocator)
+            : set_hash(other.set_hash)
+            , signature(other.signature)
+            , word_ids(std::move(other.word_ids), allocator)
+        {
+        }
+    };
+
+    using Candidate = std::pair<int, int>;  // Пара (меньший id, больший id)
+    using EntryRef = const std::pair<const int, Entry>*;
+
+    std::pmr::map<int, Entry> entries_;
+
+    static void CheckThreshold(DuplicateMode, double threshold);
+
+    // Оставляет по одному документу (с наименьшим id) из каждой группы одинаковых множеств слов.
+    // id остальных документов групп дописываются в copies по возрастанию
+    std::vector<EntryRef> CollapseIdenticalSets(std::vector<int>& copies) const;
+
+    // Пары документов с одинаковыми отпечатками множеств слов
+    template <class ExecutionPolicy>
+    std::vector<Candidate> FindExactCandidates(ExecutionPolicy&&) const;
+
+    // Пары документов, у которых совпала хотя бы одна полоса сигнатуры.
+    // Копии документов (одинаковые множества слов) в LSH не участвуют и дописываются в copies
+    template <class ExecutionPolicy>
+    std::vector<Candidate> FindLshCandidates(ExecutionPolicy&&, double threshold, std::vector<int>& copies) const;
+
+    // Число строк в полосе LSH для заданного порога похожести
+    static size_t ChooseRowsPerBand(double threshold);
+
+    static double ComputeJaccard(const std::pmr::vector<int>&, const std::pmr::vector<int>&);
+
+    // Выбирает дубликаты по подтверждённым парам, оставляя документы с меньшими id
+    static std::vector<int> SelectDuplicates(std::vector<Candidate>);
+};
+
+
+template <class ExecutionPolicy>
+std::vector<int> DuplicateDetector::FindDuplicates(ExecutionPolicy&& policy, DuplicateMode mode, double threshold) const
+{
+    CheckThreshold(mode, threshold);
+
+    // Копии уже подтверждены сравнением множеств слов. Копия - дубликат в любом случае:
+    // она совпадает со своим представителем, а тот либо остаётся, либо сам похож на оставшийся документ
+    std::vector<int> copies;
+    const std::vector<Candidate> candidates = (mode == DuplicateMode::EXACT)
+        ? FindExactCandidates(policy)
+        : FindLshCandidates(policy, threshold, copies);
+
+    // Проверяем кандидатов точным сравнением множеств слов
+    std::vector<char> confirmed(candidates.size());
+    std::transform(policy, candidates.begin(), candidates.end(), confirmed.begin(),
+                   [this, mode, threshold](const Candidate& candidate)
+                   {
+                       const auto& lhs = entries_.at(candidate.first).word_ids;
+                       const auto& rhs = entries_.at(candidate.second).word_ids;
+                       return static_cast<char>(mode == DuplicateMode::EXACT
+                                                ? lhs == rhs
+                                                : ComputeJaccard(lhs, rhs) >= threshold);
+                   });
+
+    std::vector<Candidate> duplicate_pairs;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+        if (confirmed[i])
+        {
+            duplicate_pairs.push_back(candidates[i]);
+        }
+    }
+
+    std::vector<int> duplicates = SelectDuplicates(std::move(duplicate_pairs));
+    if (copies.empty())
+    {
+        return duplicates;
+    }
+
+    std::vector<int> result;
+    result.reserve(duplicates.size() + copies.size());
+    std::merge(duplicates.begin(), duplicates.end(), copies.begin(), copies.end(), std::back_inserter(result));
+    return result;
+}
+
+
+template <class ExecutionPolicy>
+std::vector<std::pair<int, int>> DuplicateDetector::FindCandidates(ExecutionPolicy&& policy, DuplicateMode mode, double threshold) const
+{
+    CheckThreshold(mode, threshold);
+
+    std::vector<int> copies;
+    return (mode == DuplicateMode::EXACT)
+        ? FindExactCandidates(policy)
+        : FindLshCandidates(policy, threshold, copies);
+}
+
+
+template <class ExecutionPolicy>
+std::vector<DuplicateDetector::Candidate> DuplicateDetector::FindExactCandidates(ExecutionPolicy&& policy) const
+{
+    std::vector<std::pair<uint64_t, int>> hashes;
+    hashes.reserve(entries_.size());
+    for (const auto& [document_id, entry] : entries_)
+    {
+        hashes.emplace_back(entry.set_hash, document_id);
+    }
+    std::sort(policy, hashes.begin(), hashes.end());
+
+    // Внутри группы с одинаковым отпечатком каждый документ сравнивается с первым (наименьшим id)
+    std::vector<Candidate> candidates;
+    for (size_t group_begin = 0, i = 1; i < hashes.size(); ++i)
+    {
+        if (hashes[i].first != hashes[group_begin].first)
+        {
+            group_begin = i;
+            continue;
+        }
+        candidates.emplace_back(hashes[group_begin].second, hashes[i].second);
+    }
+
+    return candidates;
+}
+
+
+template <class ExecutionPolicy>
+std::vector<DuplicateDetector::Candidate> DuplicateDetector::FindLshCandidates(ExecutionPolicy&& policy, double threshold,
+                                                                                std::vector<int>& copies) const
+{
+    const size_t rows = ChooseRowsPerBand(threshold);
+    const size_t bands = SIGNATURE_SIZE / rows;
+
+    const std::vector<EntryRef> documents = CollapseIdenticalSets(copies);
+
+    // Полосы обрабатываются независимо: документы сортируются по хешу полосы, совпавшие хеши дают пары.
+    // Все документы корзины сравниваются только с первым (наименьшим id), поэтому число пар
+    // линейно по числу документов даже для больших корзин почти одинаковых документов
+    std::vector<size_t> band_indexes(bands);
+    for (size_t band = 0; band < bands; ++band)
+    {
+        band_indexes[band] = band;
+    }
+    std::vector<std::vector<Candidate>> band_candidates(bands);
+    std::for_each(policy, band_indexes.begin(), band_indexes.end(),
+                  [&documents, &band_candidates, rows](size_t band)
+                  {
+                      std::vector<std::pair<uint64_t, int>> band_hashes;
+                      band_hashes.reserve(documents.size());
+                      for (const EntryRef document : documents)
+                      {
+                          uint64_t hash = 14695981039346656037ull;
+                          for (size_t row = band * rows; row < (band + 1) * rows; ++row)
+                          {
+                              hash = (hash ^ document->second.signature[row]) * 1099511628211ull;
+                          }
+                          band_hashes.emplace_back(hash, document->first);
+                      }
+                      std::sort(band_hashes.begin(), band_hashes.end());
+
+                      // id внутри корзины отсортированы, поэтому first < second
+                      auto& result = band_candidates[band];
+                      for (size_t bucket_begin = 0, i = 1; i < band_hashes.size(); ++i)
+                      {
+                          if (band_hashes[i].first != band_hashes[bucket_begin].first)
+                          {
+                              bucket_begin = i;
+                              continue;
+                          }
+                          result.emplace_back(band_hashes[bucket_begin].second, band_hashes[i].second);
+                      }
+                  });
+
+    // Одна и та же пара может встретиться в нескольких полосах - проверяем её один раз
+    size_t total_size = 0;
+    for (const auto& band_result : band_candidates)
+    {
+        total_size += band_result.size();
+    }
+    std::vector<Candidate> candidates;
+    candidates.reserve(total_size);
+    for (const auto& band_result : band_candidates)
+    {
+        candidates.insert(candidates.end(), band_result.begin(), band_result.end());
+    }
+    std::sort(policy, candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    return candidates;
+}
@@ -0,0 +1,330 @@
+#include "search_server_tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "durable_search_server.h"
+
+using namespace std;
+
+namespace
+{
+// Файлы контрольной точки и журнала теста. Удаляются при создании и уничтожении объекта
+class DurabilityFiles
+{
+public:
+    DurabilityFiles()
+        : checkpoint_path(GetTestFilePath("checkpoint"sv))
+        , log_path(GetTestFilePath("mutation_log"sv))
+    {
+        Remove();
+    }
+
+    ~DurabilityFiles()
+    {
+        Remove();
+    }
+
+    void Remove() const
+    {
+        filesystem::remove(checkpoint_path);
+        filesystem::remove(checkpoint_path + ".tmp"s);
+        filesystem::remove(log_path);
+    }
+
+    const string checkpoint_path;
+    const string log_path;
+};
+
+vector<Document> FindInAllStatuses(const SearchServer& server, const string& query)
+{
+    return server.FindTopDocuments(query, [](int, DocumentStatus, int)
+                                   {
+                                       return true;
+                                   });
+}
+
+// Совпадают ли документы, их атрибуты и результаты запросов двух серверов
+bool AreSameServers(const SearchServer& lhs, const SearchServer& rhs)
+{
+    if (!equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()))
+    {
+        return false;
+    }
+    for (int id : lhs)
+    {
+        if (lhs.GetDocumentText(id) != rhs.GetDocumentText(id) || lhs.GetDocumentRating(id) != rhs.GetDocumentRating(id)
+            || lhs.GetDocumentStatus(id) != rhs.GetDocumentStatus(id)
+            || lhs.GetDocumentAttributes(id) != rhs.GetDocumentAttributes(id))
+        {
+            return false;
+        }
+    }
+    for (const string& query : { "cat dog"s, "bird -cat"s, "fish"s })
+    {
+        const vector<Document> lhs_found = FindInAllStatuses(lhs, query);
+        const vector<Document> rhs_found = FindInAllStatuses(rhs, query);
+        if (GetDocumentIds(lhs_found) != GetDocumentIds(rhs_found))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < lhs_found.size(); ++i)
+        {
+            if (abs(lhs_found[i].relevance - rhs_found[i].relevance) > EPSILON)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+string GenerateText(mt19937& generator)
+{
+    static const vector<string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "and"s, "big"s, "small"s, "red"s };
+    string text;
+    for (size_t length = 3 + generator() % 6, i = 0; i < length; ++i)
+    {
+        text += (i > 0 ? " "s : ""s) + words[generator() % words.size()];
+    }
+    return text;
+}
+
+void TestMutationRecords()
+{
+    Mutation add;
+    add.lsn = 1;
+    add.document_id = 42;
+    add.text = "пушистый кот"s;
+    add.status = DocumentStatus::BANNED;
+    add.ratings = { 5, -2, 3 };
+    Mutation remove;
+    remove.lsn = 2;
+    remove.type = MutationType::REMOVE_DOCUMENT;
+    remove.document_id = 42;
+    Mutation attribute;
+    attribute.lsn = 3;
+    attribute.type = MutationType::SET_ATTRIBUTE;
+    attribute.document_id = 7;
+    attribute.attribute_name = "price"s;
+    attribute.attribute_value = 12.5;
+
+    string buffer;
+    for (const Mutation& mutation : { add, remove, attribute })
+    {
+        AppendMutationRecord(buffer, mutation);
+    }
+    {
+        istringstream input(buffer);
+        Mutation read;
+        ASSERT(ReadMutationRecord(input, read));
+        ASSERT(read.lsn == 1 && read.type == MutationType::ADD_DOCUMENT && read.document_id == 42);
+        ASSERT(read.text == add.text && read.status == DocumentStatus::BANNED && read.ratings == add.ratings);
+        ASSERT(ReadMutationRecord(input, read));
+        ASSERT(read.lsn == 2 && read.type == MutationType::REMOVE_DOCUMENT && read.document_id == 42);
+        ASSERT(ReadMutationRecord(input, read));
+        ASSERT(read.type == MutationType::SET_ATTRIBUTE && read.attribute_name == "price"s && read.attribute_value == 12.5);
+        ASSERT(!ReadMutationRecord(input, read));
+    }
+    {
+        // Недописанная запись
+        istringstream input(buffer.substr(0, buffer.size() - 3));
+        Mutation read;
+        ASSERT(ReadMutationRecord(input, read));
+        ASSERT(ReadMutationRecord(input, read));
+        ASSERT(!ReadMutationRecord(input, read));
+    }
+    {
+        // Повреждённые данные не проходят проверку контрольной суммы
+        string corrupted = buffer;
+        corrupted[12] ^= 0x20;
+        istringstream input(corrupted);
+        Mutation read;
+        ASSERT(!ReadMutationRecord(input, read));
+    }
+    {
+        // Длина записи больше остатка потока
+        string corrupted = buffer;
+        corrupted[3] = '\x7F';
+        istringstream input(corrupted);
+        Mutation read;
+        ASSERT(!ReadMutationRecord(input, read));
+    }
+}
+
+void TestMutationLogReplay()
+{
+    const DurabilityFiles files;
+    for (bool positional_index : { false, true })
+    {
+        files.Remove();
+        mt19937 generator(1);
+        IndexOptions options;
+        options.positional_index = positional_index;
+        SearchServer reference("and"s, options);
+        {
+            SearchServer server("and"s, options);
+            DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+            for (int id = 0; id < 500; ++id)
+            {
+                const string text = GenerateText(generator);
+                const auto status = static_cast<DocumentStatus>(generator() % 4);
+                const int rating = static_cast<int>(generator() % 10);
+                durable.AddDocument(id, text, status, { rating, rating + 1 });
+                reference.AddDocument(id, text, status, { rating, rating + 1 });
+            }
+            for (int id = 0; id < 500; id += 7)
+            {
+                durable.RemoveDocument(id);
+                reference.RemoveDocument(id);
+            }
+            for (int id = 1; id < 500; id += 5)
+            {
+                if (id % 7 != 0)
+                {
+                    durable.SetDocumentAttribute(id, "price"s, id * 0.5);
+                    reference.SetDocumentAttribute(id, "price"s, id * 0.5);
+                }
+            }
+            // Отклонённые изменения не попадают в журнал
+            const uint64_t last_lsn = durable.GetLastLsn();
+            ASSERT_THROWS(durable.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 }), invalid_argument);
+            ASSERT_THROWS(durable.AddDocument(1000, "cat\x01"s, DocumentStatus::ACTUAL, { 1 }), invalid_argument);
+            ASSERT_THROWS(durable.SetDocumentAttribute(0, "price"s, 1.0), out_of_range);
+            durable.RemoveDocument(0);
+            ASSERT_EQUAL(durable.GetLastLsn(), last_lsn);
+            ASSERT(AreSameServers(server, reference));
+            // Объект не сбрасывает буфер явно: записи сохраняет деструктор
+        }
+        SearchServer recovered("and"s, options);
+        DurableSearchServer durable(recovered, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(recovered, reference));
+    }
+}
+
+void TestTornTailRecovery()
+{
+    const DurabilityFiles files;
+    SearchServer reference("and"s);
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        for (int id = 0; id < 20; ++id)
+        {
+            durable.AddDocument(id, "cat dog "s + to_string(id), DocumentStatus::ACTUAL, { id });
+            reference.AddDocument(id, "cat dog "s + to_string(id), DocumentStatus::ACTUAL, { id });
+        }
+    }
+    const auto complete_size = filesystem::file_size(files.log_path);
+
+    // Запись, оборванная на середине: дописанный заголовок без данных
+    {
+        ofstream log(files.log_path, ios::binary | ios::app);
+        log << "\x40\0\0\0garbage"s;
+    }
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(server, reference));
+        // Хвост отрезан, новые записи идут сразу за последней целой
+        ASSERT_EQUAL(filesystem::file_size(files.log_path), complete_size);
+        ASSERT_EQUAL(durable.GetLastLsn(), 20u);
+        durable.AddDocument(100, "red fish"s, DocumentStatus::ACTUAL, { 1 });
+        reference.AddDocument(100, "red fish"s, DocumentStatus::ACTUAL, { 1 });
+        durable.Flush();
+    }
+
+    // Обрезанная последняя запись теряется, предыдущие восстанавливаются
+    filesystem::resize_file(files.log_path, filesystem::file_size(files.log_path) - 3);
+    reference.RemoveDocument(100);
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(server, reference));
+        ASSERT_EQUAL(durable.GetLastLsn(), 20u);
+    }
+}
+
+void TestCheckpointRecovery()
+{
+    const DurabilityFiles files;
+    mt19937 generator(5);
+    SearchServer reference("and"s);
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        for (int id = 0; id < 300; ++id)
+        {
+            const string text = GenerateText(generator);
+            durable.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 7 });
+            reference.AddDocument(id, text, DocumentStatus::ACTUAL, { id % 7 });
+        }
+        durable.SetDocumentAttribute(3, "price"s, 10.0);
+        reference.SetDocumentAttribute(3, "price"s, 10.0);
+        durable.Checkpoint();
+        ASSERT_EQUAL(filesystem::file_size(files.log_path), 0u);
+        const uint64_t checkpoint_lsn = durable.GetLastLsn();
+        for (int id = 300; id < 350; ++id)
+        {
+            durable.AddDocument(id, "big cat"s, DocumentStatus::IRRELEVANT, { 3 });
+            reference.AddDocument(id, "big cat"s, DocumentStatus::IRRELEVANT, { 3 });
+        }
+        durable.RemoveDocument(5);
+        reference.RemoveDocument(5);
+        ASSERT_EQUAL(durable.GetLastLsn(), checkpoint_lsn + 51);
+    }
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(server, reference));
+        // Сбой между записью контрольной точки и очисткой журнала: изменения журнала
+        // с номерами не больше номера контрольной точки не применяются повторно
+        durable.Flush();
+        WriteCheckpoint(server, durable.GetLastLsn(), files.checkpoint_path);
+    }
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(server, reference));
+    }
+
+    // Автоматические контрольные точки
+    {
+        SearchServer server("and"s);
+        DurabilityOptions options;
+        options.checkpoint_interval = 10;
+        options.log.sync_mode = LogSyncMode::ALWAYS;
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path, options);
+        for (int id = 400; id < 425; ++id)
+        {
+            durable.AddDocument(id, "small bird"s, DocumentStatus::ACTUAL, { 1 });
+            reference.AddDocument(id, "small bird"s, DocumentStatus::ACTUAL, { 1 });
+        }
+    }
+    {
+        SearchServer server("and"s);
+        DurableSearchServer durable(server, files.checkpoint_path, files.log_path);
+        ASSERT(AreSameServers(server, reference));
+    }
+
+    // Повреждённая контрольная точка не загружается молча
+    {
+        ofstream checkpoint(files.checkpoint_path, ios::binary | ios::trunc);
+        checkpoint << "SSCKPT01xxxx"s;
+    }
+    SearchServer server("and"s);
+    ASSERT_THROWS(DurableSearchServer(server, files.checkpoint_path, files.log_path), runtime_error);
+}
+} // namespace
+
+void TestDurability(TestRunner& runner)
+{
+    RUN_TEST(runner, TestMutationRecords);
+    RUN_TEST(runner, TestMutationLogReplay);
+    RUN_TEST(runner, TestTornTailRecovery);
+    RUN_TEST(runner, TestCheckpointRecovery);
+}
@@ -0,0 +1,421 @@
+#include "durable_search_server.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "metrics.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+const char CHECKPOINT_MAGIC[8] = {'S', 'S', 'C', 'K', 'P', 'T', '0', '1'};
+// Число изменений, тексты которых разбираются параллельно перед последовательным добавлением в индекс
+const size_t REPLAY_CHUNK_SIZE = 4096;
+// Размер буфера записей контрольной точки, после заполнения которого он записывается в файл
+const size_t CHECKPOINT_WRITE_BUFFER_SIZE = 1 << 20;
+// Смещение числа записей в заголовке контрольной точки (после сигнатуры и номера изменения)
+const long CHECKPOINT_RECORD_COUNT_OFFSET = sizeof(CHECKPOINT_MAGIC) + 8;
+
+void PutU64(std::string& out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFFu));
+    }
+}
+
+bool ReadU64(std::istream& input, uint64_t& value)
+{
+    unsigned char bytes[8];
+    if (!input.read(reinterpret_cast<char*>(bytes), sizeof(bytes)))
+    {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return true;
+}
+
+// Сбрасывает на диск запись каталога, чтобы переименование файла пережило сбой
+void SyncDirectory(const std::filesystem::path& directory)
+{
+#ifndef _WIN32
+    const std::string path = directory.empty() ? "."s : directory.string();
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+    {
+        throw std::runtime_error("Failed to open directory "s + path);
+    }
+    const bool synced = fsync(descriptor) == 0;
+    close(descriptor);
+    if (!synced)
+    {
+        throw std::runtime_error("Failed to sync directory "s + path);
+    }
+#else
+    (void)directory;
+#endif
+}
+
+// Файл контрольной точки, записываемый частями. Незавершённый файл удаляется
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(std::string path)
+        : path_(std::move(path))
+        , file_(std::fopen(path_.c_str(), "wb"))
+    {
+        if (file_ == nullptr)
+        {
+            throw std::runtime_error("Failed to open checkpoint "s + path_);
+        }
+    }
+
+    ~CheckpointWriter()
+    {
+        if (file_ != nullptr)
+        {
+            std::fclose(file_);
+            std::remove(path_.c_str());
+        }
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void Write(const std::string& data)
+    {
+        if (std::fwrite(data.data(), 1, data.size(), file_) != data.size())
+        {
+            throw std::runtime_error("Failed to write checkpoint "s + path_);
+        }
+    }
+
+    // Перезаписывает заголовок: число записей известно только после записи снимка
+    void WriteAt(long offset, const std::string& data)
+    {
+        if (std::fseek(file_, offset, SEEK_SET) != 0)
+        {
+            throw std::runtime_error("Failed to write checkpoint "s + path_);
+        }
+        Write(data);
+    }
+
+    // Сбрасывает файл на диск и закрывает его
+    void Close()
+    {
+        if (std::fflush(file_) != 0)
+        {
+            throw std::runtime_error("Failed to write checkpoint "s + path_);
+        }
+        SyncFile(file_, path_);
+        const bool closed = std::fclose(file_) == 0;
+        file_ = nullptr;
+        if (!closed)
+        {
+            std::remove(path_.c_str());
+            throw std::runtime_error("Failed to write checkpoint "s + path_);
+        }
+    }
+
+private:
+    std::string path_;
+    std::FILE* file_;
+};
+}
+
+
+DurableSearchServer::DurableSearchServer(SearchServer& search_server, std::string checkpoint_path,
+                                         std::string log_path, DurabilityOptions options)
+    : search_server_(search_server)
+    , checkpoint_path_(std::move(checkpoint_path))
+    , log_(log_path, options.log)
+    , options_(options)
+{
+    METRICS_TIMER("durability.recovery");
+
+    if (search_server_.GetDocumentCount() != 0)
+    {
+        throw std::invalid_argument("Search server for recovery must be empty"s);
+    }
+    const uint64_t checkpoint_lsn = LoadCheckpoint(search_server_, checkpoint_path_);
+    const std::vector<Mutation> mutations = MutationLog::Read(log_path, checkpoint_lsn);
+    ReplayMutations(search_server_, mutations);
+    mutations_since_checkpoint_ = mutations.size();
+
+    // Сбой между записью контрольной точки и очисткой журнала: журнал содержит только уже сохранённые изменения
+    if (log_.GetLastLsn() < checkpoint_lsn)
+    {
+        log_.Reset(checkpoint_lsn);
+    }
+}
+
+
+void DurableSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+                                      const std::vector<int>& ratings)
+{
+    // Все проверки AddDocument() выполняются до записи в журнал
+    SearchServer::PreparedDocument prepared = search_server_.PrepareDocument(document_id, document, status, ratings);
+    search_server_.CheckPreparedDocument(prepared);
+
+    Mutation mutation;
+    mutation.type = MutationType::ADD_DOCUMENT;
+    mutation.document_id = document_id;
+    mutation.text = std::string(document);
+    mutation.status = status;
+    mutation.ratings = ratings;
+    Log(std::move(mutation));
+
+    search_server_.AddPreparedDocument(std::move(prepared));
+    CheckpointIfNeeded();
+}
+
+
+void DurableSearchServer::RemoveDocument(int document_id)
+{
+    // Удаление неизвестного документа ничего не меняет, и записывать его не нужно
+    if (!search_server_.HasDocument(document_id))
+    {
+        return;
+    }
+
+    Mutation mutation;
+    mutation.type = MutationType::REMOVE_DOCUMENT;
+    mutation.document_id = document_id;
+    Log(std::move(mutation));
+
+    search_server_.RemoveDocument(document_id);
+    CheckpointIfNeeded();
+}
+
+
+void DurableSearchServer::SetDocumentAttribute(int document_id, std::string_view name, double value)
+{
+    if (!search_server_.HasDocument(document_id))
+    {
+        throw std::out_of_range("Invalid document_id"s);
+    }
+
+    Mutation mutation;
+    mutation.type = MutationType::SET_ATTRIBUTE;
+    mutation.document_id = document_id;
+    mutation.attribute_name = std::string(name);
+    mutation.attribute_value = value;
+    Log(std::move(mutation));
+
+    search_server_.SetDocumentAttribute(document_id, name, value);
+    CheckpointIfNeeded();
+}
+
+
+void DurableSearchServer::Flush()
+{
+    log_.Flush();
+}
+
+
+void DurableSearchServer::Checkpoint()
+{
+    METRICS_TIMER("durability.checkpoint");
+
+    log_.Flush();
+    const uint64_t lsn = log_.GetLastLsn();
+    WriteCheckpoint(search_server_, lsn, checkpoint_path_);
+    log_.Reset(lsn);
+    mutations_since_checkpoint_ = 0;
+}
+
+
+uint64_t DurableSearchServer::GetLastLsn() const
+{
+    return log_.GetLastLsn();
+}
+
+
+const SearchServer& DurableSearchServer::GetServer() const
+{
+    return search_server_;
+}
+
+
+void DurableSearchServer::Log(Mutation&& mutation)
+{
+    log_.Append(std::move(mutation));
+    METRICS_COUNTER_ADD("durability.logged_mutations", 1);
+}
+
+
+void DurableSearchServer::CheckpointIfNeeded()
+{
+    if (options_.checkpoint_interval != 0 && ++mutations_since_checkpoint_ >= options_.checkpoint_interval)
+    {
+        Checkpoint();
+    }
+}
+
+
+void WriteCheckpoint(const SearchServer& search_server, uint64_t lsn, const std::string& path)
+{
+    const std::filesystem::path target(path);
+    const std::string temporary_path = path + ".tmp"s;
+    CheckpointWriter writer(temporary_path);
+
+    // Число записей снимка: по нему при загрузке отличается полный снимок от обрезанного.
+    // Заголовок записывается с нулевым числом записей и исправляется после записи снимка
+    std::string data(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    PutU64(data, lsn);
+    PutU64(data, 0);
+    writer.Write(data);
+
+    // Записи накапливаются в буфере ограниченного размера, снимок целиком в памяти не строится
+    uint64_t record_count = 0;
+    std::string records;
+    for (const int document_id : search_server)
+    {
+        Mutation mutation;
+        mutation.type = MutationType::ADD_DOCUMENT;
+        mutation.document_id = document_id;
+        mutation.text = std::string(search_server.GetDocumentText(document_id));
+        mutation.status = search_server.GetDocumentStatus(document_id);
+        // Рейтинг документа - уже среднее; среднее одного значения совпадает с ним
+        mutation.ratings = { search_server.GetDocumentRating(document_id) };
+        AppendMutationRecord(records, mutation);
+        ++record_count;
+
+        for (const auto& [name, value] : search_server.GetDocumentAttributes(document_id))
+        {
+            Mutation attribute;
+            attribute.type = MutationType::SET_ATTRIBUTE;
+            attribute.document_id = document_id;
+            attribute.attribute_name = std::string(name);
+            attribute.attribute_value = value;
+            AppendMutationRecord(records, attribute);
+            ++record_count;
+        }
+        if (records.size() >= CHECKPOINT_WRITE_BUFFER_SIZE)
+        {
+            writer.Write(records);
+            records.clear();
+        }
+    }
+    writer.Write(records);
+    data.clear();
+    PutU64(data, record_count);
+    writer.WriteAt(CHECKPOINT_RECORD_COUNT_OFFSET, data);
+    writer.Close();
+
+    std::filesystem::rename(temporary_path, target);
+    SyncDirectory(target.parent_path());
+}
+
+
+uint64_t LoadCheckpoint(SearchServer& search_server, const std::string& path)
+{
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+    {
+        return 0;
+    }
+
+    char magic[sizeof(CHECKPOINT_MAGIC)];
+    uint64_t lsn = 0;
+    uint64_t record_count = 0;
+    if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0
+        || !ReadU64(input, lsn) || !ReadU64(input, record_count))
+    {
+        throw std::runtime_error("Invalid checkpoint header "s + path);
+    }
+
+    std::vector<Mutation> mutations;
+    Mutation mutation;
+    while (mutations.size() < record_count && ReadMutationRecord(input, mutation))
+    {
+        mutations.push_back(std::move(mutation));
+        mutation = Mutation{};
+    }
+    if (mutations.size() != record_count)
+    {
+        throw std::runtime_error("Checkpoint is truncated or corrupted "s + path);
+    }
+
+    ReplayMutations(search_server, mutations);
+    return lsn;
+}
+
+
+void ReplayMutations(SearchServer& search_server, const std::vector<Mutation>& mutations)
+{
+    METRICS_COUNTER_ADD("durability.replayed_mutations", mutations.size());
+
+    using PreparedDocument = SearchServer::PreparedDocument;
+
+    std::vector<std::optional<PreparedDocument>> prepared;
+    for (size_t chunk_begin = 0; chunk_begin < mutations.size(); chunk_begin += REPLAY_CHUNK_SIZE)
+    {
+        const size_t chunk_end = std::min(chunk_begin + REPLAY_CHUNK_SIZE, mutations.size());
+        const auto first = mutations.begin() + chunk_begin;
+        const auto last = mutations.begin() + chunk_end;
+
+        // Разбор текстов не зависит от состояния индекса и выполняется параллельно
+        prepared.clear();
+        prepared.resize(chunk_end - chunk_begin);
+        std::transform(std::execution::par, first, last, prepared.begin(),
+                       [&search_server](const Mutation& mutation) -> std::optional<PreparedDocument>
+                       {
+                           if (mutation.type != MutationType::ADD_DOCUMENT)
+                           {
+                               return std::nullopt;
+                           }
+                           try
+                           {
+                               return search_server.PrepareDocument(mutation.document_id, mutation.text,
+                                                                    mutation.status, mutation.ratings);
+                           }
+                           catch (...)
+                           {
+                               // Ошибка будет выброшена повторно при последовательном добавлении
+                               return std::nullopt;
+                           }
+                       });
+
+        for (size_t i = 0; i < prepared.size(); ++i)
+        {
+            const Mutation& mutation = mutations[chunk_begin + i];
+            switch (mutation.type)
+            {
+            case MutationType::ADD_DOCUMENT:
+                if (prepared[i])
+                {
+                    search_server.AddPreparedDocument(std::move(*prepared[i]));
+                }
+                else
+                {
+                    search_server.AddDocument(mutation.document_id, mutation.text, mutation.status, mutation.ratings);
+                }
+                break;
+            case MutationType::REMOVE_DOCUMENT:
+                search_server.RemoveDocument(mutation.document_id);
+                break;
+            case MutationType::SET_ATTRIBUTE:
+                search_server.SetDocumentAttribute(mutation.document_id, mutation.attribute_name,
+                                                   mutation.attribute_value);
+                break;
+            }
+        }
+    }
+}
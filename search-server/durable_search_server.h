@@ -0,0 +1,78 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mutation_log.h"
+#include "search_server.h"
+
+struct DurabilityOptions
+{
+    MutationLogOptions log;
+    // Контрольная точка создаётся автоматически после указанного числа изменений (0 - только вызовом Checkpoint())
+    size_t checkpoint_interval = 0;
+};
+
+// Поисковый сервер с журналом изменений (write-ahead log). Изменение проверяется, записывается в журнал
+// и только затем применяется к серверу: если запись в журнал не удалась, сервер не изменяется.
+// В режиме LogSyncMode::ALWAYS изменение применяется после сброса записи на диск, в режимах с пакетами -
+// после добавления записи в пакет журнала; сохранённым оно становится после записи пакета (Flush()).
+// Контрольная точка - полный снимок документов сервера; после её создания журнал очищается.
+// При создании объекта состояние сервера восстанавливается: загружается контрольная точка,
+// затем применяются изменения журнала, записанные после неё
+class DurableSearchServer
+{
+public:
+    // Сервер должен быть пустым, создан с теми же стоп-словами и IndexOptions, что и при записи журнала,
+    // и должен существовать дольше объекта DurableSearchServer
+    DurableSearchServer(SearchServer&, std::string checkpoint_path, std::string log_path,
+                        DurabilityOptions options = {});
+
+    DurableSearchServer(const DurableSearchServer&) = delete;
+    DurableSearchServer& operator=(const DurableSearchServer&) = delete;
+
+    // Ошибки проверки и записи в журнал выбрасываются до изменения сервера
+    void AddDocument(int, std::string_view, DocumentStatus, const std::vector<int>&);
+    void RemoveDocument(int);
+    void SetDocumentAttribute(int, std::string_view, double);
+
+    // Записывает накопленные изменения журнала в файл
+    void Flush();
+
+    // Сохраняет контрольную точку и очищает журнал
+    void Checkpoint();
+
+    // Номер последнего изменения
+    uint64_t GetLastLsn() const;
+
+    // Сервер доступен только для чтения: изменения в обход журнала не будут восстановлены
+    const SearchServer& GetServer() const;
+
+private:
+    SearchServer& search_server_;
+    std::string checkpoint_path_;
+    MutationLog log_;
+    DurabilityOptions options_;
+    size_t mutations_since_checkpoint_ = 0;
+
+    void Log(Mutation&&);
+    // Создаёт контрольную точку, если с прошлой применено checkpoint_interval изменений
+    void CheckpointIfNeeded();
+};
+
+// Записывает снимок документов сервера (тексты, статусы, рейтинги и атрибуты) с номером изменения lsn.
+// Файл записывается под временным именем частями и переименовывается, поэтому при сбое остаётся прежняя
+// контрольная точка. Ошибки записи и сброса на диск выбрасываются как std::runtime_error
+void WriteCheckpoint(const SearchServer&, uint64_t lsn, const std::string& path);
+
+// Загружает контрольную точку в пустой сервер и возвращает её номер изменения.
+// Отсутствующий файл - пустая контрольная точка с номером 0. Для повреждённого файла выбрасывает std::runtime_error
+uint64_t LoadCheckpoint(SearchServer&, const std::string& path);
+
+// Применяет изменения к серверу в порядке номеров. Тексты добавляемых документов разбираются параллельно
+// (PrepareDocument()), в индекс документы добавляются последовательно
+void ReplayMutations(SearchServer&, const std::vector<Mutation>&);
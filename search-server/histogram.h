@@ -0,0 +1,202 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Логарифмическая сетка корзин гистограммы в стиле HDR Histogram.
+// Значения меньше SUB_BUCKET_COUNT хранятся точно, каждый следующий отрезок [2^k, 2^(k+1))
+// делится на SUB_BUCKET_COUNT равных корзин, поэтому относительная погрешность не превышает
+// 1 / SUB_BUCKET_COUNT. Значения от 2^MAX_VALUE_BITS попадают в последнюю корзину
+struct HistogramBuckets
+{
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{ 1 } << SUB_BUCKET_BITS;
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static size_t GetIndex(uint64_t value)
+    {
+        if (value < SUB_BUCKET_COUNT)
+        {
+            return static_cast<size_t>(value);
+        }
+        if (value >> MAX_VALUE_BITS)
+        {
+            return BUCKET_COUNT - 1;
+        }
+        const int exponent = HighestBit(value);
+        const int shift = exponent - SUB_BUCKET_BITS;
+        return static_cast<size_t>(shift + 1) * SUB_BUCKET_COUNT
+            + static_cast<size_t>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+    }
+
+    // Наибольшее значение, попадающее в корзину
+    static uint64_t GetUpperBound(size_t index)
+    {
+        if (index < SUB_BUCKET_COUNT)
+        {
+            return index;
+        }
+        const int shift = static_cast<int>(index / SUB_BUCKET_COUNT) - 1;
+        const uint64_t sub_bucket = SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT;
+        return ((sub_bucket + 1) << shift) - 1;
+    }
+
+private:
+    static int HighestBit(uint64_t value)
+    {
+#if defined(__GNUC__)
+        return 63 - __builtin_clzll(value);
+#else
+        int bit = 0;
+        while (value >>= 1)
+        {
+            ++bit;
+        }
+        return bit;
+#endif
+    }
+};
+
+
+// Гистограмма значений (например, задержек в наносекундах). Не потокобезопасна
+class Histogram
+{
+public:
+    void Record(uint64_t value, uint64_t count = 1)
+    {
+        counts_[HistogramBuckets::GetIndex(value)] += count;
+        total_count_ += count;
+        sum_ += value * count;
+        max_ = std::max(max_, value);
+    }
+
+    void Merge(const Histogram& other)
+    {
+        for (size_t i = 0; i < HistogramBuckets::BUCKET_COUNT; ++i)
+        {
+            counts_[i] += other.counts_[i];
+        }
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void Clear()
+    {
+        if (total_count_ > 0)
+        {
+            counts_.fill(0);
+        }
+        total_count_ = 0;
+        sum_ = 0;
+        max_ = 0;
+    }
+
+    uint64_t GetCount() const
+    {
+        return total_count_;
+    }
+
+    uint64_t GetSum() const
+    {
+        return sum_;
+    }
+
+    uint64_t GetMax() const
+    {
+        return max_;
+    }
+
+    double GetMean() const
+    {
+        return total_count_ == 0 ? 0.0 : static_cast<double>(sum_) / total_count_;
+    }
+
+    // Значение, не меньше которого percentile процентов записанных значений (0 для пустой гистограммы).
+    // Возвращается верхняя граница корзины, но не больше максимального записанного значения
+    uint64_t GetValueAtPercentile(double percentile) const
+    {
+        if (total_count_ == 0)
+        {
+            return 0;
+        }
+        const double clamped = std::clamp(percentile, 0.0, 100.0);
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(clamped / 100.0 * total_count_ + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < HistogramBuckets::BUCKET_COUNT; ++i)
+        {
+            seen += counts_[i];
+            if (seen >= rank)
+            {
+                return std::min(HistogramBuckets::GetUpperBound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    friend class AtomicHistogram;
+
+    std::array<uint64_t, HistogramBuckets::BUCKET_COUNT> counts_{};
+    uint64_t total_count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t max_ = 0;
+};
+
+
+// Гистограмма с записью из нескольких потоков без блокировок (атомарные счётчики корзин).
+// Снимок Snapshot() во время записи может не учесть часть одновременно записываемых значений
+class AtomicHistogram
+{
+public:
+    AtomicHistogram()
+    {
+        for (auto& count : counts_)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void Record(uint64_t value)
+    {
+        counts_[HistogramBuckets::GetIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Histogram Snapshot() const
+    {
+        Histogram result;
+        for (size_t i = 0; i < HistogramBuckets::BUCKET_COUNT; ++i)
+        {
+            result.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+            result.total_count_ += result.counts_[i];
+        }
+        result.sum_ = sum_.load(std::memory_order_relaxed);
+        result.max_ = max_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    void Reset()
+    {
+        for (auto& count : counts_)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, HistogramBuckets::BUCKET_COUNT> counts_;
+    std::atomic<uint64_t> sum_{ 0 };
+    std::atomic<uint64_t> max_{ 0 };
+};
@@ -0,0 +1,392 @@
+#include "search_server_tests.h"
+
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <map>
+#include <random>
+
+#include "duplicate_detector.h"
+#include "memory_resource.h"
+#include "positional_index.h"
+#include "posting_list.h"
+#include "score_kernels.h"
+#include "term_dictionary.h"
+
+using namespace std;
+
+namespace
+{
+using PostingMap = map<int, double>;
+
+template <typename Postings>
+PostingMap CollectPostings(const Postings& postings)
+{
+    PostingMap result;
+    postings.ForEach([&result](int document_id, double term_freq)
+                     {
+                         result[document_id] = term_freq;
+                     });
+    return result;
+}
+
+PostingMap CollectPartition(const StatusPostings& postings, DocumentStatus status)
+{
+    PostingMap result;
+    postings.ForEachInPartition(status, [&result](int document_id, double term_freq)
+                                {
+                                    result[document_id] = term_freq;
+                                });
+    return result;
+}
+
+void TestTermDictionary()
+{
+    mt19937 generator(1);
+    TermDictionary dictionary;
+    map<string, int> reference;
+    for (int i = 0; i < 20000; ++i)
+    {
+        string term;
+        for (size_t length = 1 + generator() % 6; term.size() < length;)
+        {
+            term += static_cast<char>('a' + generator() % 5);
+        }
+        if (i % 97 == 0)
+        {
+            term = "кот"s + term;
+        }
+        const int id = dictionary.Insert(term);
+        const auto [it, inserted] = reference.emplace(term, id);
+        ASSERT_EQUAL(it->second, id);
+    }
+    ASSERT_EQUAL(dictionary.size(), reference.size());
+    for (const auto& [term, id] : reference)
+    {
+        ASSERT_EQUAL(dictionary.Find(term), id);
+        ASSERT_EQUAL(dictionary.GetTerm(id), string_view(term));
+    }
+    ASSERT_EQUAL(dictionary.Find("zz"sv), -1);
+    ASSERT_EQUAL(dictionary.Find(""sv), -1);
+
+    // Слова с префиксом перебираются в лексикографическом порядке
+    for (const string& prefix : { ""s, "a"s, "abc"s, "кот"s, "\xD0"s, "x"s })
+    {
+        vector<string> found;
+        dictionary.ForEachWithPrefix(prefix, [&found](string_view term, int)
+                                     {
+                                         found.emplace_back(term);
+                                     });
+        vector<string> expected;
+        for (auto it = reference.lower_bound(prefix); it != reference.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            expected.push_back(it->first);
+        }
+        ASSERT_EQUAL(found, expected);
+    }
+
+    const string long_term(70000, 'q');
+    ASSERT_EQUAL(dictionary.GetTerm(dictionary.Insert(long_term)), string_view(long_term));
+}
+
+// Удалённые слова освобождают id, дерево перестраивается, когда удалённых слов становится больше оставшихся
+void TestTermDictionaryErase()
+{
+    mt19937 generator(2);
+    TermDictionary dictionary;
+    map<string, int> reference;
+    size_t max_size = 0;
+    for (int round = 0; round < 20; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            // Первый байт из широкого диапазона: у корня и узлов первого уровня есть таблицы детей
+            string term(1, static_cast<char>(1 + generator() % 255));
+            for (size_t length = generator() % 5; term.size() <= length;)
+            {
+                term += static_cast<char>('a' + generator() % 20);
+            }
+            const int id = dictionary.Insert(term);
+            const auto [it, inserted] = reference.emplace(term, id);
+            ASSERT_EQUAL(it->second, id);
+        }
+        max_size = max(max_size, reference.size());
+        for (auto it = reference.begin(); it != reference.end();)
+        {
+            if (generator() % 3 != 0)
+            {
+                dictionary.Erase(it->second);
+                it = reference.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        ASSERT_EQUAL(dictionary.size(), reference.size());
+    }
+    // id удалённых слов используются повторно: граница id не превышает наибольшего числа слов в словаре
+    ASSERT_EQUAL(dictionary.GetIdBound(), max_size);
+    for (const auto& [term, id] : reference)
+    {
+        ASSERT_EQUAL(dictionary.Find(term), id);
+        ASSERT_EQUAL(dictionary.GetTerm(id), string_view(term));
+    }
+    vector<string> found;
+    dictionary.ForEachWithPrefix(""sv, [&found](string_view term, int)
+                                 {
+                                     found.emplace_back(term);
+                                 });
+    ASSERT_EQUAL(found.size(), reference.size());
+    ASSERT(equal(found.begin(), found.end(), reference.begin(), [](const string& term, const auto& entry)
+                 {
+                     return term == entry.first;
+                 }));
+
+    const int id = reference.begin()->second;
+    dictionary.Erase(id);
+    ASSERT_EQUAL(dictionary.Find(reference.begin()->first), -1);
+    ASSERT_THROWS(dictionary.Erase(id), out_of_range);
+    ASSERT_THROWS(dictionary.Erase(-1), out_of_range);
+    ASSERT_EQUAL(dictionary.Insert("новое"sv), id);
+}
+
+void TestPositionList()
+{
+    PositionList positions;
+    const vector<uint32_t> values = { 0, 5, 300, 70000, 70001 };
+    for (uint32_t position : values)
+    {
+        positions.Add(position);
+    }
+    ASSERT_EQUAL(positions.size(), values.size());
+    ASSERT_EQUAL(positions.Decode(), values);
+
+    PositionList first, second, third;
+    for (uint32_t position : { 1u, 10u, 40u })
+    {
+        first.Add(position);
+    }
+    for (uint32_t position : { 2u, 25u })
+    {
+        second.Add(position);
+    }
+    for (uint32_t position : { 3u, 26u })
+    {
+        third.Add(position);
+    }
+    ASSERT(ContainsPhrase({ &first, &second, &third }));
+    ASSERT(!ContainsPhrase({ &second, &first }));
+    ASSERT(ContainsNear(first, second, 1));
+    ASSERT(ContainsNear(second, first, 1));
+    PositionList far;
+    far.Add(100);
+    ASSERT(!ContainsNear(far, first, 59));
+    ASSERT(ContainsNear(far, first, 60));
+}
+
+// Раздел списка документов переходит в битовую карту на DENSE_MIN_SIZE документах и обратно
+// в массив, когда их становится меньше половины. Содержимое при переходах не меняется
+void TestPostingPartitionTransitions()
+{
+    CountingMemoryResource resource;
+    {
+        mt19937 generator(42);
+        PostingPartition partition(&resource);
+        PostingMap reference;
+        while (reference.size() < PostingPartition::DENSE_MIN_SIZE - 1)
+        {
+            const int id = static_cast<int>(generator() % 200000);
+            const double term_freq = static_cast<float>((generator() % 1000) / 7.0);
+            ASSERT_EQUAL(partition.Add(id, term_freq, &resource), reference.count(id) == 0);
+            reference[id] = term_freq;
+        }
+        ASSERT(!partition.IsDense());
+        ASSERT(CollectPostings(partition) == reference);
+
+        int id = 200000;
+        while (reference.count(id) > 0)
+        {
+            ++id;
+        }
+        partition.Add(id, 1.0, &resource);
+        reference[id] = 1.0;
+        ASSERT(partition.IsDense());
+        ASSERT(CollectPostings(partition) == reference);
+        for (const auto& [document_id, term_freq] : reference)
+        {
+            double found = 0.0;
+            ASSERT(partition.Find(document_id, found) && found == term_freq);
+        }
+
+        // До половины порога представление не меняется
+        while (reference.size() > PostingPartition::DENSE_MIN_SIZE / 2)
+        {
+            const int erased = reference.begin()->first;
+            ASSERT(partition.Erase(erased, &resource));
+            reference.erase(erased);
+        }
+        ASSERT(partition.IsDense());
+        ASSERT(!partition.Erase(-1, &resource));
+        ASSERT(partition.Erase(reference.begin()->first, &resource));
+        reference.erase(reference.begin());
+        ASSERT(!partition.IsDense());
+        ASSERT(CollectPostings(partition) == reference);
+        ASSERT_EQUAL(partition.size(), reference.size());
+    }
+    ASSERT_EQUAL(resource.GetAllocatedBytes(), 0u);
+}
+
+// Список документов слова: встроенное представление для TINY_CAPACITY документов, затем разделы по статусам
+void TestStatusPostingsTransitions()
+{
+    mt19937 generator(7);
+    CountingMemoryResource resource;
+    {
+        StatusPostings postings(&resource);
+        map<DocumentStatus, PostingMap> reference;
+        postings.Add(10, DocumentStatus::ACTUAL, 0.5);
+        postings.Add(3, DocumentStatus::BANNED, 0.25);
+        reference[DocumentStatus::ACTUAL][10] = 0.5;
+        reference[DocumentStatus::BANNED][3] = 0.25;
+        ASSERT_EQUAL(resource.GetAllocatedBytes(), 0u);
+
+        for (int i = 0; i < 30000; ++i)
+        {
+            const int id = static_cast<int>(generator() % 20000);
+            const auto status = static_cast<DocumentStatus>(id % 4 == 0 ? 1 : 0);
+            if (generator() % 4 != 0)
+            {
+                const double term_freq = static_cast<float>(generator() % 50);
+                postings.Add(id, status, term_freq);
+                reference[status][id] = term_freq;
+            }
+            else
+            {
+                postings.Erase(id, status);
+                reference[status].erase(id);
+            }
+        }
+        ASSERT(postings.IsPartitionDense(DocumentStatus::ACTUAL));
+        ASSERT(!postings.IsPartitionDense(DocumentStatus::BANNED));
+        size_t total = 0;
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED,
+                                       DocumentStatus::REMOVED })
+        {
+            ASSERT(CollectPartition(postings, status) == reference[status]);
+            ASSERT_EQUAL(postings.GetPartitionSize(status), reference[status].size());
+            total += reference[status].size();
+        }
+        ASSERT_EQUAL(postings.size(), total);
+
+        // Пересечение с другим списком по разделу статуса
+        StatusPostings other(&resource);
+        for (int id = 0; id < 20000; id += 3)
+        {
+            other.Add(id, DocumentStatus::ACTUAL, 1.0);
+        }
+        vector<int> intersection;
+        IntersectPostings(postings, other, DocumentStatus::ACTUAL, [&intersection](int id, double, double)
+                          {
+                              intersection.push_back(id);
+                          });
+        vector<int> expected;
+        for (const auto& [id, term_freq] : reference[DocumentStatus::ACTUAL])
+        {
+            if (id % 3 == 0)
+            {
+                expected.push_back(id);
+            }
+        }
+        ASSERT_EQUAL(intersection, expected);
+
+        const StatusPostings copy = postings;
+        ASSERT(CollectPostings(copy) == CollectPostings(postings));
+    }
+    ASSERT_EQUAL(resource.GetAllocatedBytes(), 0u);
+}
+
+void TestScoreKernels()
+{
+    mt19937 generator(3);
+    vector<TermFreq> term_freqs(1000);
+    vector<int32_t> word_counts(term_freqs.size());
+    for (size_t i = 0; i < term_freqs.size(); ++i)
+    {
+        term_freqs[i] = static_cast<TermFreq>(1 + generator() % 20);
+        word_counts[i] = static_cast<int32_t>(1 + generator() % 100);
+    }
+    vector<double> scores(term_freqs.size());
+    ComputeTfIdfScores(term_freqs.data(), 999, 1.5, scores.data());
+    Bm25Parameters parameters;
+    parameters.average_word_count = 30.0;
+    vector<double> bm25_scores(term_freqs.size());
+    ComputeBm25Scores(term_freqs.data(), word_counts.data(), term_freqs.size(), 1.5, parameters, bm25_scores.data());
+    for (size_t i = 0; i < 999; ++i)
+    {
+        ASSERT_EQUAL(scores[i], term_freqs[i] * 1.5);
+        ASSERT(abs(bm25_scores[i] - ComputeBm25Score(1.5, term_freqs[i], word_counts[i], parameters)) < 1e-12);
+    }
+    ASSERT_EQUAL(scores[999], 0.0);
+}
+
+void TestDuplicateDetectorScale()
+{
+    // Тысячи точных копий и тысячи почти одинаковых документов: одна огромная корзина в каждой полосе LSH
+    constexpr int COPY_COUNT = 4000;
+    constexpr int NEAR_COUNT = 4000;
+    vector<int> common_words(40);
+    for (int i = 0; i < static_cast<int>(common_words.size()); ++i)
+    {
+        common_words[i] = i;
+    }
+
+    DuplicateDetector detector;
+    for (int document_id = 0; document_id < COPY_COUNT; ++document_id)
+    {
+        detector.AddDocument(document_id, common_words);
+    }
+    for (int document_id = COPY_COUNT; document_id < COPY_COUNT + NEAR_COUNT; ++document_id)
+    {
+        vector<int> word_ids = common_words;
+        word_ids.push_back(1000 + document_id);
+        detector.AddDocument(document_id, word_ids);
+    }
+
+    const auto start = chrono::steady_clock::now();
+    const vector<pair<int, int>> candidates = detector.FindCandidates(execution::par, DuplicateMode::JACCARD, 0.8);
+    const vector<int> duplicates = detector.FindDuplicates(execution::par, DuplicateMode::JACCARD, 0.8);
+    ASSERT(chrono::steady_clock::now() - start < chrono::seconds(5));
+
+    // Копии в LSH не участвуют, а корзина даёт пары только с наименьшим id корзины
+    const size_t representative_count = NEAR_COUNT + 1;
+    ASSERT(candidates.size() <= DuplicateDetector::SIGNATURE_SIZE * representative_count);
+    ASSERT(none_of(candidates.begin(), candidates.end(),
+                   [](const pair<int, int>& candidate)
+                   {
+                       return candidate.first >= candidate.second
+                           || (candidate.first > 0 && candidate.first < COPY_COUNT)
+                           || (candidate.second > 0 && candidate.second < COPY_COUNT);
+                   }));
+
+    vector<int> expected(COPY_COUNT + NEAR_COUNT - 1);
+    for (int i = 0; i < static_cast<int>(expected.size()); ++i)
+    {
+        expected[i] = i + 1;
+    }
+    ASSERT_EQUAL(duplicates, expected);
+    ASSERT_EQUAL(detector.FindDuplicates(execution::seq, DuplicateMode::EXACT, 1.0),
+                 vector<int>(expected.begin(), expected.begin() + COPY_COUNT - 1));
+}
+} // namespace
+
+void TestIndexStructures(TestRunner& runner)
+{
+    RUN_TEST(runner, TestTermDictionary);
+    RUN_TEST(runner, TestTermDictionaryErase);
+    RUN_TEST(runner, TestPositionList);
+    RUN_TEST(runner, TestPostingPartitionTransitions);
+    RUN_TEST(runner, TestStatusPostingsTransitions);
+    RUN_TEST(runner, TestScoreKernels);
+    RUN_TEST(runner, TestDuplicateDetectorScale);
+}
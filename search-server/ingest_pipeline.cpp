@@ -0,0 +1,424 @@
+#include "ingest_pipeline.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "metrics.h"
+#include "read_input_functions.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+// Запись входного потока. error - исключение разбора записи: оно обрабатывается на этапе INDEX
+// в порядке записей, как исключения PrepareDocument() и AddPreparedDocument()
+struct RecordItem
+{
+    DocumentRecord record;
+    std::exception_ptr error;
+};
+
+struct RecordBatch
+{
+    size_t sequence = 0;
+    std::vector<RecordItem> items;
+};
+
+struct PreparedItem
+{
+    std::optional<SearchServer::PreparedDocument> document;
+    std::exception_ptr error;
+};
+
+struct PreparedBatch
+{
+    size_t sequence = 0;
+    std::vector<PreparedItem> items;
+};
+
+int64_t ToNanoseconds(Clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+int64_t ToNanoseconds(Clock::time_point time)
+{
+    return ToNanoseconds(time.time_since_epoch());
+}
+
+bool IsInvalidArgument(const std::exception_ptr& error)
+{
+    try
+    {
+        std::rethrow_exception(error);
+    }
+    catch (const std::invalid_argument&)
+    {
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+}
+
+
+std::ostream& operator<<(std::ostream& out, IngestStage stage)
+{
+    switch (stage)
+    {
+    case IngestStage::READ:
+        return out << "READ"s;
+    case IngestStage::PREPARE:
+        return out << "PREPARE"s;
+    case IngestStage::INDEX:
+        return out << "INDEX"s;
+    }
+    return out;
+}
+
+
+std::ostream& operator<<(std::ostream& out, const IngestStatistics& statistics)
+{
+    const auto to_seconds = [](std::chrono::nanoseconds duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    };
+    out << "added = "s << statistics.added_documents << ", rejected = "s << statistics.rejected_documents
+        << ", elapsed = "s << to_seconds(statistics.elapsed) << " s"s;
+    for (size_t stage = 0; stage < INGEST_STAGE_COUNT; ++stage)
+    {
+        const IngestStageStatistics& stage_statistics = statistics.stages[stage];
+        out << '\n' << static_cast<IngestStage>(stage) << ": documents = "s << stage_statistics.documents
+            << ", bytes = "s << stage_statistics.bytes
+            << ", busy = "s << to_seconds(stage_statistics.busy_time) << " s"s
+            << ", wait = "s << to_seconds(stage_statistics.wait_time) << " s"s
+            << ", throughput = "s << stage_statistics.throughput << " docs/s"s;
+    }
+    return out;
+}
+
+
+IngestPipeline::IngestPipeline(SearchServer& search_server, IngestOptions options)
+    : search_server_(search_server)
+    , options_(options)
+{
+    if (options_.batch_size == 0 || options_.queue_capacity == 0)
+    {
+        throw std::invalid_argument("Ingest batch size and queue capacity must be positive"s);
+    }
+    if (options_.worker_count == 0)
+    {
+        options_.worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+
+IngestStatistics IngestPipeline::Run(int fd)
+{
+    FileDescriptorBuffer buffer(fd);
+    std::istream input(&buffer);
+    return Run(input);
+}
+
+
+IngestStatistics IngestPipeline::Run(std::istream& input)
+{
+    METRICS_TIMER("ingest.pipeline");
+    ResetStatistics();
+
+    BoundedQueue<RecordBatch> records(options_.queue_capacity);
+    BoundedQueue<PreparedBatch> prepared(options_.queue_capacity);
+
+    // Окно пакетов в обработке. Пакет, опередивший медленный, ждёт его в буфере этапа INDEX,
+    // поэтому чтение не уходит вперёд от последнего добавленного пакета больше чем на window пакетов:
+    // иначе один медленный пакет позволил бы накопить в буфере весь входной поток
+    const size_t window = options_.queue_capacity + options_.worker_count;
+
+    // Первое исключение, останавливающее конвейер: очереди закрываются, и все этапы завершаются.
+    // state_mutex защищает error и indexed_sequence (число добавленных в индекс пакетов)
+    std::mutex state_mutex;
+    std::condition_variable window_changed;
+    std::exception_ptr error;
+    size_t indexed_sequence = 0;
+    const auto fail = [&](std::exception_ptr exception)
+    {
+        {
+            std::lock_guard lock(state_mutex);
+            if (!error)
+            {
+                error = std::move(exception);
+            }
+        }
+        window_changed.notify_all();
+        records.Close();
+        prepared.Close();
+    };
+
+    const auto prepare_documents = [&]()
+    {
+        try
+        {
+            RecordBatch batch;
+            Clock::time_point wait_start = Clock::now();
+            while (records.Pop(batch))
+            {
+                const Clock::time_point start = Clock::now();
+                PreparedBatch result;
+                result.sequence = batch.sequence;
+                result.items.resize(batch.items.size());
+                uint64_t bytes = 0;
+                for (size_t i = 0; i < batch.items.size(); ++i)
+                {
+                    RecordItem& item = batch.items[i];
+                    if (item.error)
+                    {
+                        result.items[i].error = std::move(item.error);
+                        continue;
+                    }
+                    try
+                    {
+                        result.items[i].document = search_server_.PrepareDocument(item.record.document_id,
+                                                                                   item.record.text,
+                                                                                   item.record.status,
+                                                                                   item.record.ratings);
+                        bytes += item.record.text.size();
+                    }
+                    catch (...)
+                    {
+                        result.items[i].error = std::current_exception();
+                    }
+                }
+                const Clock::time_point finish = Clock::now();
+                counters_[static_cast<size_t>(IngestStage::PREPARE)].documents += batch.items.size();
+                counters_[static_cast<size_t>(IngestStage::PREPARE)].bytes += bytes;
+                const bool pushed = prepared.Push(std::move(result));
+                const Clock::time_point pushed_at = Clock::now();
+                AddStageTime(IngestStage::PREPARE, finish - start, (start - wait_start) + (pushed_at - finish));
+                if (!pushed)
+                {
+                    break;
+                }
+                wait_start = pushed_at;
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    };
+
+    // Пакеты приходят от потоков разбора в произвольном порядке и добавляются в порядке чтения,
+    // чтобы результат (в том числе при повторяющихся id) совпадал с последовательной загрузкой
+    const auto index_documents = [&]()
+    {
+        try
+        {
+            std::map<size_t, PreparedBatch> pending;
+            size_t next_sequence = 0;
+            PreparedBatch batch;
+            Clock::time_point wait_start = Clock::now();
+            while (prepared.Pop(batch))
+            {
+                const Clock::time_point start = Clock::now();
+                pending.emplace(batch.sequence, std::move(batch));
+                for (auto it = pending.find(next_sequence); it != pending.end(); it = pending.find(++next_sequence))
+                {
+                    uint64_t bytes = 0;
+                    for (PreparedItem& item : it->second.items)
+                    {
+                        if (item.document)
+                        {
+                            const size_t text_size = item.document->text.size();
+                            try
+                            {
+                                search_server_.AddPreparedDocument(std::move(*item.document));
+                                ++added_documents_;
+                                bytes += text_size;
+                                continue;
+                            }
+                            catch (...)
+                            {
+                                item.error = std::current_exception();
+                            }
+                        }
+                        if (!options_.skip_invalid_documents || !IsInvalidArgument(item.error))
+                        {
+                            std::rethrow_exception(item.error);
+                        }
+                        ++rejected_documents_;
+                    }
+                    counters_[static_cast<size_t>(IngestStage::INDEX)].documents += it->second.items.size();
+                    counters_[static_cast<size_t>(IngestStage::INDEX)].bytes += bytes;
+                    pending.erase(it);
+                }
+                {
+                    std::lock_guard lock(state_mutex);
+                    indexed_sequence = next_sequence;
+                }
+                window_changed.notify_all();
+                const Clock::time_point finish = Clock::now();
+                AddStageTime(IngestStage::INDEX, finish - start, start - wait_start);
+                wait_start = finish;
+            }
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    };
+
+    std::vector<std::thread> workers;
+    std::thread indexer;
+    try
+    {
+        indexer = std::thread(index_documents);
+        workers.reserve(options_.worker_count);
+        for (size_t i = 0; i < options_.worker_count; ++i)
+        {
+            workers.emplace_back(prepare_documents);
+        }
+
+        // Этап READ выполняется в вызывающем потоке
+        for (size_t sequence = 0; ; ++sequence)
+        {
+            const Clock::time_point start = Clock::now();
+            RecordBatch batch;
+            batch.sequence = sequence;
+            batch.items.reserve(options_.batch_size);
+            uint64_t bytes = 0;
+            bool end_of_input = false;
+            while (batch.items.size() < options_.batch_size)
+            {
+                RecordItem item;
+                try
+                {
+                    if (!ReadDocumentRecord(input, item.record))
+                    {
+                        end_of_input = true;
+                        break;
+                    }
+                }
+                catch (const std::invalid_argument&)
+                {
+                    item.error = std::current_exception();
+                }
+                bytes += item.record.text.size();
+                batch.items.push_back(std::move(item));
+                // Новых данных в буфере нет: пакет не ждёт заполнения, чтобы медленная лента не задерживала документы
+                if (input.rdbuf()->in_avail() <= 0)
+                {
+                    break;
+                }
+            }
+            const Clock::time_point finish = Clock::now();
+            counters_[static_cast<size_t>(IngestStage::READ)].documents += batch.items.size();
+            counters_[static_cast<size_t>(IngestStage::READ)].bytes += bytes;
+            bool pushed = true;
+            if (!batch.items.empty())
+            {
+                {
+                    // После ошибки очереди закрыты, и Push() вернёт false
+                    std::unique_lock lock(state_mutex);
+                    window_changed.wait(lock, [&]
+                                        {
+                                            return error || sequence < indexed_sequence + window;
+                                        });
+                }
+                pushed = records.Push(std::move(batch));
+            }
+            AddStageTime(IngestStage::READ, finish - start, Clock::now() - finish);
+            if (end_of_input || !pushed)
+            {
+                break;
+            }
+        }
+    }
+    catch (...)
+    {
+        fail(std::current_exception());
+    }
+
+    // Потоки разбора завершаются, разобрав оставшиеся пакеты, затем завершается добавление
+    records.Close();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    prepared.Close();
+    if (indexer.joinable())
+    {
+        indexer.join();
+    }
+    finish_ns_ = ToNanoseconds(Clock::now());
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+    return GetStatistics();
+}
+
+
+IngestStatistics IngestPipeline::GetStatistics() const
+{
+    IngestStatistics result;
+    result.added_documents = added_documents_;
+    result.rejected_documents = rejected_documents_;
+    const int64_t start_ns = start_ns_;
+    const int64_t finish_ns = finish_ns_;
+    if (start_ns != 0)
+    {
+        result.elapsed = std::chrono::nanoseconds((finish_ns != 0 ? finish_ns : ToNanoseconds(Clock::now())) - start_ns);
+    }
+    for (size_t stage = 0; stage < INGEST_STAGE_COUNT; ++stage)
+    {
+        const StageCounters& counters = counters_[stage];
+        IngestStageStatistics& statistics = result.stages[stage];
+        statistics.documents = counters.documents;
+        statistics.bytes = counters.bytes;
+        statistics.busy_time = std::chrono::nanoseconds(counters.busy_ns);
+        statistics.wait_time = std::chrono::nanoseconds(counters.wait_ns);
+        // Время параллельного этапа суммируется по потокам, пропускная способность - всех потоков вместе
+        const size_t thread_count = stage == static_cast<size_t>(IngestStage::PREPARE) ? options_.worker_count : 1;
+        const double busy_seconds = std::chrono::duration<double>(statistics.busy_time).count() / thread_count;
+        statistics.throughput = busy_seconds > 0.0 ? statistics.documents / busy_seconds : 0.0;
+    }
+    return result;
+}
+
+
+void IngestPipeline::ResetStatistics()
+{
+    for (StageCounters& counters : counters_)
+    {
+        counters.documents = 0;
+        counters.bytes = 0;
+        counters.busy_ns = 0;
+        counters.wait_ns = 0;
+    }
+    added_documents_ = 0;
+    rejected_documents_ = 0;
+    finish_ns_ = 0;
+    start_ns_ = ToNanoseconds(Clock::now());
+}
+
+
+void IngestPipeline::AddStageTime(IngestStage stage, Clock::duration busy, Clock::duration wait)
+{
+    StageCounters& counters = counters_[static_cast<size_t>(stage)];
+    counters.busy_ns += ToNanoseconds(busy);
+    counters.wait_ns += ToNanoseconds(wait);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include "search_server.h"
+
+// Этап конвейера загрузки документов
+enum class IngestStage
+{
+    READ,       // Чтение и разбор записей (read_input_functions.h)
+    PREPARE,    // Разбор текстов на слова: SearchServer::PrepareDocument(), выполняется параллельно
+    INDEX,      // Добавление в индекс: SearchServer::AddPreparedDocument()
+};
+
+// Количество значений IngestStage
+const size_t INGEST_STAGE_COUNT = 3;
+
+struct IngestOptions
+{
+    // Число потоков этапа PREPARE (0 - по числу аппаратных потоков)
+    size_t worker_count = 0;
+    // Число записей в пакете, который этапы передают друг другу
+    size_t batch_size = 256;
+    // Ёмкость каждой очереди между этапами в пакетах. Когда очередь заполнена, предыдущий этап ждёт.
+    // Чтение опережает добавление в индекс не больше чем на queue_capacity + worker_count пакетов,
+    // даже если один пакет разбирается намного дольше следующих
+    size_t queue_capacity = 16;
+    // Некорректные записи и документы (std::invalid_argument) пропускаются и учитываются в rejected_documents.
+    // Иначе загрузка останавливается и исключение выбрасывается из Run() после документов, предшествовавших записи
+    bool skip_invalid_documents = false;
+};
+
+// Статистика этапа: busy - время работы потоков этапа, wait - время ожидания очередей
+// (пустой входной или заполненной выходной). Для параллельного этапа время суммируется по потокам
+struct IngestStageStatistics
+{
+    uint64_t documents = 0;
+    uint64_t bytes = 0;     // Объём текстов документов
+    std::chrono::nanoseconds busy_time{ 0 };
+    std::chrono::nanoseconds wait_time{ 0 };
+    // Документов в секунду времени работы этапа (у параллельного этапа - всех потоков вместе)
+    double throughput = 0.0;
+};
+
+struct IngestStatistics
+{
+    uint64_t added_documents = 0;
+    uint64_t rejected_documents = 0;
+    std::chrono::nanoseconds elapsed{ 0 };
+    std::array<IngestStageStatistics, INGEST_STAGE_COUNT> stages{};
+};
+
+std::ostream& operator<<(std::ostream&, IngestStage);
+
+std::ostream& operator<<(std::ostream&, const IngestStatistics&);
+
+// Конвейер потоковой загрузки документов в поисковый сервер: чтение записей, параллельный разбор
+// текстов и добавление в индекс выполняются одновременно и связаны очередями ограниченной ёмкости
+// (bounded_queue.h). Чтение идёт в потоке, вызвавшем Run(), разбор - в worker_count потоках,
+// добавление - в одном потоке (индекс сервера не допускает одновременных изменений), в порядке записей
+// во входном потоке. Run() читает до конца потока, поэтому подходит и для непрерывной ленты документов
+// (канал, сокет): неполный пакет передаётся дальше, как только в буфере потока заканчиваются данные,
+// а GetStatistics() можно вызывать из другого потока во время загрузки.
+// Пока идёт Run(), сервер нельзя использовать из других потоков
+class IngestPipeline
+{
+public:
+    explicit IngestPipeline(SearchServer&, IngestOptions options = {});
+
+    IngestPipeline(const IngestPipeline&) = delete;
+    IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+    // Загружает записи до конца потока. Возвращает статистику этого вызова
+    IngestStatistics Run(std::istream&);
+
+    // Загружает записи из файлового дескриптора до конца данных. Дескриптор не закрывается
+    IngestStatistics Run(int fd);
+
+    // Статистика текущего или последнего вызова Run()
+    IngestStatistics GetStatistics() const;
+
+private:
+    struct StageCounters
+    {
+        std::atomic<uint64_t> documents{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<int64_t> busy_ns{ 0 };
+        std::atomic<int64_t> wait_ns{ 0 };
+    };
+
+    SearchServer& search_server_;
+    IngestOptions options_;
+
+    std::array<StageCounters, INGEST_STAGE_COUNT> counters_;
+    std::atomic<uint64_t> added_documents_{ 0 };
+    std::atomic<uint64_t> rejected_documents_{ 0 };
+    std::atomic<int64_t> start_ns_{ 0 };
+    std::atomic<int64_t> finish_ns_{ 0 };   // 0, пока идёт Run()
+
+    void ResetStatistics();
+    void AddStageTime(IngestStage, std::chrono::steady_clock::duration busy, std::chrono::steady_clock::duration wait);
+};
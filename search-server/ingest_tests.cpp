@@ -0,0 +1,283 @@
+#include "search_server_tests.h"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "bounded_queue.h"
+#include "corpus_loader.h"
+#include "ingest_pipeline.h"
+#include "read_input_functions.h"
+
+using namespace std;
+
+namespace
+{
+// Корпус в формате DocumentRecord и сервер, в который те же документы добавлены напрямую
+struct TestCorpus
+{
+    string records;
+    SearchServer reference{ "w1 w2"s };
+};
+
+void GenerateCorpus(TestCorpus& corpus, int document_count)
+{
+    mt19937 generator(3);
+    ostringstream output;
+    for (int id = 0; id < document_count; ++id)
+    {
+        string text;
+        for (size_t length = 1 + generator() % 30, i = 0; i < length; ++i)
+        {
+            const uint32_t word = min(generator() % 400, generator() % 400);
+            text += (i > 0 ? " "s : ""s) + (word % 13 == 0 ? "W"s : "w"s) + to_string(word);
+        }
+        vector<int> ratings;
+        for (size_t count = generator() % 4, i = 0; i < count; ++i)
+        {
+            ratings.push_back(static_cast<int>(generator() % 20) - 5);
+        }
+        const auto status = static_cast<DocumentStatus>(generator() % 4);
+        WriteDocumentRecord(output, id, status, ratings, text);
+        corpus.reference.AddDocument(id, text, status, ratings);
+    }
+    corpus.records = output.str();
+}
+
+bool AreSameIndexes(const SearchServer& server, const SearchServer& reference)
+{
+    if (!equal(server.begin(), server.end(), reference.begin(), reference.end()))
+    {
+        return false;
+    }
+    mt19937 generator(9);
+    for (int i = 0; i < 50; ++i)
+    {
+        const string query = "w"s + to_string(generator() % 400) + " w"s + to_string(generator() % 50);
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::BANNED })
+        {
+            const vector<Document> found = server.FindTopDocuments(query, status);
+            const vector<Document> expected = reference.FindTopDocuments(query, status);
+            if (GetDocumentIds(found) != GetDocumentIds(expected))
+            {
+                return false;
+            }
+            for (size_t j = 0; j < found.size(); ++j)
+            {
+                if (found[j].relevance != expected[j].relevance || found[j].rating != expected[j].rating)
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Записи с ошибками: неизвестный статус, повторный id, нечисловой рейтинг
+const string INVALID_RECORDS = "1\tACTUAL\t1\tcat\n\n2\tFOO\t1\tdog\r\n3\tACTUAL\t\tbird\r\n"
+                               "1\tACTUAL\t\tdup\n4\tACTUAL\t1 x\tz\n5\tBANNED\t\tfish"s;
+
+void TestDocumentRecords()
+{
+    ostringstream output;
+    WriteDocumentRecord(output, 17, DocumentStatus::IRRELEVANT, { 5, -2, 3 }, "пушистый кот"sv);
+    WriteDocumentRecord(output, 18, DocumentStatus::ACTUAL, {}, "хвост"sv);
+    ASSERT_EQUAL(output.str(), "17\tIRRELEVANT\t5 -2 3\tпушистый кот\n18\tACTUAL\t\tхвост\n"s);
+    ASSERT_THROWS(WriteDocumentRecord(output, 19, DocumentStatus::ACTUAL, {}, "a\tb"sv), invalid_argument);
+
+    istringstream input("17\tIRRELEVANT\t5 -2 3\tпушистый кот\r\n\n18\tACTUAL\t\tхвост\n19\tNONE\t\tx\n"s);
+    DocumentRecord record;
+    ASSERT(ReadDocumentRecord(input, record));
+    ASSERT(record.document_id == 17 && record.status == DocumentStatus::IRRELEVANT);
+    ASSERT_EQUAL(record.ratings, vector<int>({ 5, -2, 3 }));
+    ASSERT_EQUAL(record.text, "пушистый кот"s);
+    ASSERT(ReadDocumentRecord(input, record));
+    ASSERT(record.document_id == 18 && record.ratings.empty() && record.text == "хвост"s);
+    ASSERT_THROWS(ReadDocumentRecord(input, record), invalid_argument);
+    ASSERT(!ReadDocumentRecord(input, record));
+}
+
+void TestBoundedQueue()
+{
+    BoundedQueue<int> queue(2);
+    int sum = 0;
+    thread consumer([&queue, &sum]
+                    {
+                        for (int value = 0; queue.Pop(value);)
+                        {
+                            sum += value;
+                        }
+                    });
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT(queue.Push(i));
+    }
+    queue.Close();
+    consumer.join();
+    ASSERT_EQUAL(sum, 4950);
+    ASSERT(!queue.Push(1));
+}
+
+void TestIngestPipeline()
+{
+    TestCorpus corpus;
+    GenerateCorpus(corpus, 5000);
+    for (size_t worker_count : { 1, 3 })
+    {
+        SearchServer server("w1 w2"s);
+        IngestOptions options;
+        options.worker_count = worker_count;
+        options.batch_size = 100;
+        options.queue_capacity = 2;
+        IngestPipeline pipeline(server, options);
+        istringstream input(corpus.records);
+        const IngestStatistics statistics = pipeline.Run(input);
+        ASSERT_EQUAL(statistics.added_documents, 5000u);
+        ASSERT_EQUAL(statistics.rejected_documents, 0u);
+        ASSERT(AreSameIndexes(server, corpus.reference));
+    }
+
+    {
+        SearchServer server(""s);
+        IngestOptions options;
+        options.skip_invalid_documents = true;
+        options.worker_count = 2;
+        istringstream input(INVALID_RECORDS);
+        const IngestStatistics statistics = IngestPipeline(server, options).Run(input);
+        ASSERT_EQUAL(statistics.added_documents, 3u);
+        ASSERT_EQUAL(statistics.rejected_documents, 3u);
+        ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    }
+    {
+        // Без пропуска ошибок загрузка останавливается на первой некорректной записи
+        SearchServer server(""s);
+        istringstream input(INVALID_RECORDS);
+        IngestPipeline pipeline(server);
+        ASSERT_THROWS(pipeline.Run(input), invalid_argument);
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    }
+}
+
+void TestIngestWindow()
+{
+    // Первый пакет разбирается намного дольше остальных: пока он не добавлен в индекс,
+    // чтение не должно уходить вперёд больше чем на окно пакетов
+    ostringstream output;
+    string huge_text;
+    for (int i = 0; i < 400000; ++i)
+    {
+        huge_text += "w"s + to_string(i % 1000) + " "s;
+    }
+    WriteDocumentRecord(output, 0, DocumentStatus::ACTUAL, {}, huge_text);
+    constexpr int DOCUMENT_COUNT = 20000;
+    for (int id = 1; id < DOCUMENT_COUNT; ++id)
+    {
+        WriteDocumentRecord(output, id, DocumentStatus::ACTUAL, { id % 10 }, "w"s + to_string(id % 50));
+    }
+
+    SearchServer server(""s);
+    IngestOptions options;
+    options.worker_count = 2;
+    options.batch_size = 10;
+    options.queue_capacity = 2;
+    IngestPipeline pipeline(server, options);
+
+    atomic<bool> finished = false;
+    uint64_t max_read_ahead = 0;
+    thread monitor([&]
+                   {
+                       while (!finished)
+                       {
+                           // Счётчик READ читается раньше счётчика INDEX
+                           const IngestStatistics statistics = pipeline.GetStatistics();
+                           if (statistics.stages[static_cast<size_t>(IngestStage::INDEX)].documents == 0)
+                           {
+                               max_read_ahead = max(max_read_ahead,
+                                                    statistics.stages[static_cast<size_t>(IngestStage::READ)].documents);
+                           }
+                           this_thread::yield();
+                       }
+                   });
+    istringstream input(output.str());
+    const IngestStatistics statistics = pipeline.Run(input);
+    finished = true;
+    monitor.join();
+
+    ASSERT_EQUAL(statistics.added_documents, static_cast<uint64_t>(DOCUMENT_COUNT));
+    ASSERT_EQUAL(server.GetDocumentCount(), DOCUMENT_COUNT);
+    // Окно - queue_capacity + worker_count пакетов и ещё один пакет, прочитанный и ждущий места в окне
+    ASSERT(max_read_ahead <= (options.queue_capacity + options.worker_count + 1) * options.batch_size);
+}
+
+void TestCorpusLoader()
+{
+    TestCorpus corpus;
+    GenerateCorpus(corpus, 3000);
+    const string path = GetTestFilePath("corpus.tsv"sv);
+    ofstream(path, ios::binary) << corpus.records;
+    for (bool reference_mapped_text : { true, false })
+    {
+        for (size_t chunk_size : { size_t(1000), size_t(16 << 20) })
+        {
+            SearchServer server("w1 w2"s);
+            CorpusLoadOptions options;
+            options.reference_mapped_text = reference_mapped_text;
+            options.chunk_size = chunk_size;
+            options.parallel_chunks = 3;
+            const CorpusLoadStatistics statistics = LoadCorpusFile(server, path, options);
+            ASSERT_EQUAL(statistics.added_documents, 3000u);
+            ASSERT_EQUAL(statistics.bytes, corpus.records.size());
+            ASSERT(AreSameIndexes(server, corpus.reference));
+            for (int id = 0; id < 3000; id += 7)
+            {
+                ASSERT_EQUAL(server.GetDocumentText(id), corpus.reference.GetDocumentText(id));
+            }
+            // Документы из отображённого файла удаляются и добавляются как обычные
+            for (int id = 0; id < 3000; id += 3)
+            {
+                server.RemoveDocument(id);
+            }
+            server.AddDocument(100000, "w5 w6"s, DocumentStatus::ACTUAL, {});
+            ASSERT_EQUAL(server.GetDocumentText(100000), "w5 w6"sv);
+            ASSERT_EQUAL(server.GetDocumentCount(), 2001);
+        }
+    }
+
+    ofstream(path, ios::binary) << INVALID_RECORDS;
+    {
+        SearchServer server(""s);
+        CorpusLoadOptions options;
+        options.skip_invalid_documents = true;
+        options.chunk_size = 10;
+        const CorpusLoadStatistics statistics = LoadCorpusFile(server, path, options);
+        ASSERT_EQUAL(statistics.added_documents, 3u);
+        ASSERT_EQUAL(statistics.rejected_documents, 3u);
+        ASSERT_EQUAL(server.GetDocumentText(3), "bird"sv);
+        ASSERT_EQUAL(server.GetDocumentText(5), "fish"sv);
+    }
+    {
+        SearchServer server(""s);
+        ASSERT_THROWS(LoadCorpusFile(server, path), invalid_argument);
+        ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    }
+
+    ofstream(path, ios::binary | ios::trunc).flush();
+    SearchServer server(""s);
+    ASSERT_EQUAL(LoadCorpusFile(server, path).added_documents, 0u);
+    filesystem::remove(path);
+    ASSERT_THROWS(LoadCorpusFile(server, path), runtime_error);
+}
+} // namespace
+
+void TestIngest(TestRunner& runner)
+{
+    RUN_TEST(runner, TestDocumentRecords);
+    RUN_TEST(runner, TestBoundedQueue);
+    RUN_TEST(runner, TestIngestPipeline);
+    RUN_TEST(runner, TestIngestWindow);
+    RUN_TEST(runner, TestCorpusLoader);
+}
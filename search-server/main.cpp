@@ -7,6 +7,7 @@
 #include <vector>
 
 #include "process_queries.h"
+#include "search_server_tests.h"
 #include "test_example_functions.h" // for PrintDocument()
 #include "log_duration.h"
 
@@ -136,6 +137,8 @@ void Test(string_view mark, const SearchServer& search_server, const vector<stri
 
 int main()
 {
+    TestSearchServer();
+
     mt19937 generator;
 
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -0,0 +1,34 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Файл, отображённый в память только для чтения (mmap). Данные не копируются в кучу: страницы
+// читаются ОС по обращению и могут вытесняться без записи в файл подкачки.
+// Файл не должен изменяться, пока существует объект. Без mmap (Windows) файл читается в буфер целиком
+class MappedFile
+{
+public:
+    // При ошибке открытия или отображения выбрасывает std::runtime_error
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view GetData() const
+    {
+        return { data_, size_ };
+    }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    std::vector<char> buffer_;
+#endif
+};
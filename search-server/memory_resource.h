@@ -0,0 +1,102 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// Ресурс памяти, подсчитывающий выделения и освобождения и передающий их вышестоящему ресурсу.
+// Позволяет измерить, сколько памяти занимают структуры, размещённые через него (например, индекс сервера
+// при IndexOptions::memory_resource), и сколько обращений к распределителю они делают.
+// Счётчики атомарные, ресурс можно использовать из нескольких потоков, если это допускает вышестоящий ресурс
+class CountingMemoryResource : public std::pmr::memory_resource
+{
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream_(upstream)
+    {
+    }
+
+    // Занято байт в текущий момент
+    size_t GetAllocatedBytes() const
+    {
+        return allocated_bytes_.load(std::memory_order_relaxed);
+    }
+
+    // Наибольшее значение GetAllocatedBytes() за время работы
+    size_t GetPeakBytes() const
+    {
+        return peak_bytes_.load(std::memory_order_relaxed);
+    }
+
+    size_t GetAllocationCount() const
+    {
+        return allocation_count_.load(std::memory_order_relaxed);
+    }
+
+    size_t GetDeallocationCount() const
+    {
+        return deallocation_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> allocated_bytes_ = 0;
+    std::atomic<size_t> peak_bytes_ = 0;
+    std::atomic<size_t> allocation_count_ = 0;
+    std::atomic<size_t> deallocation_count_ = 0;
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        void* result = upstream_->allocate(bytes, alignment);
+        const size_t allocated = allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+        while (allocated > peak && !peak_bytes_.compare_exchange_weak(peak, allocated, std::memory_order_relaxed))
+        {
+        }
+        allocation_count_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+    {
+        upstream_->deallocate(pointer, bytes, alignment);
+        allocated_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        deallocation_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+};
+
+// Арена временных данных одного запроса: std::pmr::monotonic_buffer_resource, первые INLINE_SIZE байт
+// которой лежат в самом объекте (на стеке), а остальное выделяется блоками из кучи. Освобождение памяти
+// внутри арены ничего не делает, вся память возвращается разом при уничтожении арены.
+// При enabled == false выдаёт ресурс по умолчанию (глобальный new/delete)
+class QueryArena
+{
+public:
+    static constexpr size_t INLINE_SIZE = 8 * 1024;
+
+    explicit QueryArena(bool enabled = true)
+        : resource_(buffer_.data(), buffer_.size())
+        , enabled_(enabled)
+    {
+    }
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    std::pmr::memory_resource* GetResource()
+    {
+        return enabled_ ? static_cast<std::pmr::memory_resource*>(&resource_) : std::pmr::get_default_resource();
+    }
+
+private:
+    alignas(std::max_align_t) std::array<std::byte, INLINE_SIZE> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+    bool enabled_;
+};
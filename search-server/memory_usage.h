@@ -0,0 +1,84 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Оценка объёма динамической памяти структур данных с учётом накладных расходов распределителя.
+// Модель соответствует malloc из glibc на 64-битных системах: заголовок блока 8 байт,
+// размер блока выравнивается до 16 байт, минимальный блок - 32 байта.
+// Для структур в пуле памяти (IndexOptions::index_memory) оценка приблизительна: фактический расход
+// измеряется через CountingMemoryResource (memory_resource.h)
+
+// Размер узла std::map / std::set без значения (цвет и три указателя)
+constexpr size_t TREE_NODE_OVERHEAD = 32;
+// Наибольшая длина строки, хранящейся внутри объекта std::string (libstdc++)
+constexpr size_t STRING_INLINE_CAPACITY = 15;
+
+// Сколько памяти фактически занимает блок, запрошенный у распределителя
+constexpr size_t EstimateAllocation(size_t bytes)
+{
+    if (bytes == 0)
+    {
+        return 0;
+    }
+    const size_t chunk = (bytes + 8 + 15) / 16 * 16;
+    return chunk < 32 ? 32 : chunk;
+}
+
+// Память строки длины length вне объекта строки (короткие строки хранятся внутри объекта)
+inline size_t EstimateStringAllocation(size_t length)
+{
+    return length <= STRING_INLINE_CAPACITY ? 0 : EstimateAllocation(length + 1);
+}
+
+// Память строки вне объекта строки
+template <typename Allocator>
+size_t EstimateStringMemory(const std::basic_string<char, std::char_traits<char>, Allocator>& text)
+{
+    return text.capacity() <= STRING_INLINE_CAPACITY ? 0 : EstimateAllocation(text.capacity() + 1);
+}
+
+// Память буфера вектора (вложенная динамическая память элементов не учитывается)
+template <typename Type, typename Allocator>
+size_t EstimateVectorMemory(const std::vector<Type, Allocator>& vector)
+{
+    return EstimateAllocation(vector.capacity() * sizeof(Type));
+}
+
+// Память одного узла дерева std::map / std::set со значением типа Value
+template <typename Value>
+constexpr size_t EstimateTreeNodeMemory()
+{
+    return EstimateAllocation(TREE_NODE_OVERHEAD + sizeof(Value));
+}
+
+// Память узлов дерева std::map / std::set (вложенная динамическая память значений не учитывается)
+template <typename Tree>
+size_t EstimateTreeMemory(const Tree& tree)
+{
+    return tree.size() * EstimateTreeNodeMemory<typename Tree::value_type>();
+}
+
+// Распределение памяти поискового сервера по структурам, в байтах
+struct MemoryUsage
+{
+    size_t inverted_index = 0;      // Списки документов слов
+    size_t forward_index = 0;       // Частоты слов документов
+    size_t documents = 0;           // Тексты документов
+    size_t document_ids = 0;
+    size_t stop_words = 0;
+    size_t dictionary = 0;          // Словарь слов
+    size_t attributes = 0;          // Рейтинги, статусы, длины и дополнительные атрибуты
+    size_t positional_index = 0;
+    size_t duplicate_detector = 0;
+    size_t impacts = 0;             // Предвычисленные вклады слов (BuildImpacts())
+    size_t object = 0;              // Сам объект сервера
+
+    size_t Total() const
+    {
+        return inverted_index + forward_index + documents + document_ids + stop_words + dictionary
+            + attributes + positional_index + duplicate_detector + impacts + object;
+    }
+};
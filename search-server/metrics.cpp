@@ -0,0 +1,117 @@
+#include "metrics.h"
+
+using namespace std::string_literals;
+
+namespace
+{
+const double TIMER_PERCENTILES[] = { 50.0, 90.0, 99.0 };
+}
+
+
+MetricsRegistry& MetricsRegistry::Instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+
+MetricsCounter& MetricsRegistry::GetCounter(std::string_view name)
+{
+    std::lock_guard guard(mutex_);
+    auto it = counters_.find(name);
+    if (it == counters_.end())
+    {
+        it = counters_.emplace(std::string(name), std::make_unique<MetricsCounter>()).first;
+    }
+    return *it->second;
+}
+
+
+MetricsTimer& MetricsRegistry::GetTimer(std::string_view name)
+{
+    std::lock_guard guard(mutex_);
+    auto it = timers_.find(name);
+    if (it == timers_.end())
+    {
+        it = timers_.emplace(std::string(name), std::make_unique<MetricsTimer>()).first;
+    }
+    return *it->second;
+}
+
+
+MetricsSnapshot MetricsRegistry::Snapshot() const
+{
+    std::lock_guard guard(mutex_);
+    MetricsSnapshot result;
+    for (const auto& [name, counter] : counters_)
+    {
+        result.counters.emplace(name, counter->Get());
+    }
+    for (const auto& [name, timer] : timers_)
+    {
+        result.timers.emplace(name, timer->Snapshot());
+    }
+    return result;
+}
+
+
+void MetricsRegistry::Reset()
+{
+    std::lock_guard guard(mutex_);
+    for (auto& [name, counter] : counters_)
+    {
+        counter->Reset();
+    }
+    for (auto& [name, timer] : timers_)
+    {
+        timer->Reset();
+    }
+}
+
+
+void MetricsRegistry::ExportText(std::ostream& out) const
+{
+    const MetricsSnapshot snapshot = Snapshot();
+    for (const auto& [name, value] : snapshot.counters)
+    {
+        out << name << " "s << value << "\n"s;
+    }
+    for (const auto& [name, histogram] : snapshot.timers)
+    {
+        out << name << " count="s << histogram.GetCount()
+            << " mean_ns="s << static_cast<uint64_t>(histogram.GetMean());
+        for (double percentile : TIMER_PERCENTILES)
+        {
+            out << " p"s << percentile << "_ns="s << histogram.GetValueAtPercentile(percentile);
+        }
+        out << " max_ns="s << histogram.GetMax() << "\n"s;
+    }
+}
+
+
+void MetricsRegistry::ExportJson(std::ostream& out) const
+{
+    // Имена метрик - идентификаторы вида "query.parse", экранирование не требуется
+    const MetricsSnapshot snapshot = Snapshot();
+    out << "{\"counters\": {"s;
+    bool first = true;
+    for (const auto& [name, value] : snapshot.counters)
+    {
+        out << (first ? ""s : ", "s) << "\""s << name << "\": "s << value;
+        first = false;
+    }
+    out << "}, \"timers\": {"s;
+    first = true;
+    for (const auto& [name, histogram] : snapshot.timers)
+    {
+        out << (first ? ""s : ", "s) << "\""s << name << "\": {\"count\": "s << histogram.GetCount()
+            << ", \"sum_ns\": "s << histogram.GetSum();
+        for (double percentile : TIMER_PERCENTILES)
+        {
+            out << ", \"p"s << percentile << "_ns\": "s << histogram.GetValueAtPercentile(percentile);
+        }
+        out << ", \"max_ns\": "s << histogram.GetMax() << "}"s;
+        first = false;
+    }
+    out << "}}"s;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "histogram.h"
+#include "log_duration.h"
+
+/**
+ * Метрики поискового сервера: именованные счётчики и таймеры (гистограммы длительностей в наносекундах).
+ * Запись идёт без блокировок, поиск метрики по имени выполняется один раз на место вызова макроса.
+ *
+ * Пример использования:
+ *
+ *  void ParseQuery() {
+ *      METRICS_TIMER("query.parse"); // Длительность до конца блока попадёт в таймер query.parse
+ *      METRICS_COUNTER_ADD("query.count", 1);
+ *      ...
+ *  }
+ *
+ *  MetricsRegistry::Instance().ExportJson(std::cout);
+ *
+ * При определённом SEARCH_SERVER_DISABLE_METRICS макросы ничего не делают.
+ */
+#ifndef SEARCH_SERVER_DISABLE_METRICS
+#define METRICS_TIMER(name)                                                                         \
+    static MetricsTimer& PROFILE_CONCAT(metricsTimer, __LINE__) = MetricsRegistry::Instance().GetTimer(name); \
+    ScopedMetricsTimer PROFILE_CONCAT(metricsTimerGuard, __LINE__)(PROFILE_CONCAT(metricsTimer, __LINE__))
+
+#define METRICS_COUNTER_ADD(name, value)                                                            \
+    do                                                                                              \
+    {                                                                                               \
+        static MetricsCounter& metrics_counter = MetricsRegistry::Instance().GetCounter(name);      \
+        metrics_counter.Add(value);                                                                 \
+    } while (false)
+#else
+#define METRICS_TIMER(name) ((void)0)
+#define METRICS_COUNTER_ADD(name, value) ((void)0)
+#endif
+
+class MetricsCounter
+{
+public:
+    void Add(uint64_t value)
+    {
+        value_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t Get() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        value_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> value_{ 0 };
+};
+
+class MetricsTimer
+{
+public:
+    void Record(LogDuration::Clock::duration duration)
+    {
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        histogram_.Record(nanoseconds > 0 ? static_cast<uint64_t>(nanoseconds) : 0);
+    }
+
+    Histogram Snapshot() const
+    {
+        return histogram_.Snapshot();
+    }
+
+    void Reset()
+    {
+        histogram_.Reset();
+    }
+
+private:
+    AtomicHistogram histogram_;
+};
+
+// Замеряет время до конца блока, как LogDuration, но записывает его в таймер вместо вывода в поток
+class ScopedMetricsTimer
+{
+public:
+    explicit ScopedMetricsTimer(MetricsTimer& timer)
+        : timer_(timer)
+    {}
+
+    ScopedMetricsTimer(const ScopedMetricsTimer&) = delete;
+    ScopedMetricsTimer& operator=(const ScopedMetricsTimer&) = delete;
+
+    ~ScopedMetricsTimer()
+    {
+        timer_.Record(LogDuration::Clock::now() - start_time_);
+    }
+
+private:
+    MetricsTimer& timer_;
+    const LogDuration::Clock::time_point start_time_ = LogDuration::Clock::now();
+};
+
+// Значения всех метрик на момент вызова MetricsRegistry::Snapshot()
+struct MetricsSnapshot
+{
+    std::map<std::string, uint64_t> counters;
+    std::map<std::string, Histogram> timers;  // Длительности в наносекундах
+};
+
+// Реестр метрик процесса. Метрики создаются при первом обращении и живут до конца программы,
+// поэтому ссылки на них можно хранить
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& Instance();
+
+    MetricsCounter& GetCounter(std::string_view);
+
+    MetricsTimer& GetTimer(std::string_view);
+
+    MetricsSnapshot Snapshot() const;
+
+    // Обнуляет значения всех метрик (сами метрики остаются в реестре)
+    void Reset();
+
+    // Вывод в текстовом виде: строка на метрику
+    void ExportText(std::ostream&) const;
+
+    // Вывод в виде JSON-объекта {"counters": {...}, "timers": {...}}
+    void ExportJson(std::ostream&) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<MetricsCounter>, std::less<>> counters_;
+    std::map<std::string, std::unique_ptr<MetricsTimer>, std::less<>> timers_;
+};
@@ -0,0 +1,488 @@
+#include "mutation_log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std::string_literals;
+
+namespace
+{
+const size_t RECORD_HEADER_SIZE = 8;
+// Данные записи читаются частями такого размера, см. ReadMutationRecord()
+const size_t RECORD_READ_CHUNK_SIZE = 1 << 16;
+
+// Таблица CRC-32 (полином 0xEDB88320, как в zlib)
+constexpr std::array<uint32_t, 256> MakeCrcTable()
+{
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            value = (value & 1u) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+constexpr std::array<uint32_t, 256> CRC_TABLE = MakeCrcTable();
+
+uint32_t ComputeCrc32(const char* data, size_t size)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = CRC_TABLE[(crc ^ static_cast<uint8_t>(data[i])) & 0xFFu] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void PutU32(std::string& out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFFu));
+    }
+}
+
+void PutU64(std::string& out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFFu));
+    }
+}
+
+void PutDouble(std::string& out, double value)
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    PutU64(out, bits);
+}
+
+void PutString(std::string& out, const std::string& value)
+{
+    PutU32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+uint32_t GetU32(const char* data)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        value |= static_cast<uint32_t>(static_cast<uint8_t>(data[i])) << (8 * i);
+    }
+    return value;
+}
+
+// Последовательное чтение данных записи с проверкой границ
+class PayloadReader
+{
+public:
+    explicit PayloadReader(const std::string& data)
+        : data_(data)
+    {
+    }
+
+    bool ReadU8(uint8_t& value)
+    {
+        if (!Has(1))
+        {
+            return false;
+        }
+        value = static_cast<uint8_t>(data_[position_++]);
+        return true;
+    }
+
+    bool ReadU32(uint32_t& value)
+    {
+        if (!Has(4))
+        {
+            return false;
+        }
+        value = GetU32(data_.data() + position_);
+        position_ += 4;
+        return true;
+    }
+
+    bool ReadU64(uint64_t& value)
+    {
+        uint32_t low = 0;
+        uint32_t high = 0;
+        if (!ReadU32(low) || !ReadU32(high))
+        {
+            return false;
+        }
+        value = (static_cast<uint64_t>(high) << 32) | low;
+        return true;
+    }
+
+    bool ReadI32(int& value)
+    {
+        uint32_t bits = 0;
+        if (!ReadU32(bits))
+        {
+            return false;
+        }
+        value = static_cast<int32_t>(bits);
+        return true;
+    }
+
+    bool ReadDouble(double& value)
+    {
+        uint64_t bits = 0;
+        if (!ReadU64(bits))
+        {
+            return false;
+        }
+        std::memcpy(&value, &bits, sizeof(value));
+        return true;
+    }
+
+    bool ReadString(std::string& value)
+    {
+        uint32_t size = 0;
+        if (!ReadU32(size) || !Has(size))
+        {
+            return false;
+        }
+        value.assign(data_, position_, size);
+        position_ += size;
+        return true;
+    }
+
+    bool AtEnd() const
+    {
+        return position_ == data_.size();
+    }
+
+private:
+    const std::string& data_;
+    size_t position_ = 0;
+
+    bool Has(size_t size) const
+    {
+        return data_.size() - position_ >= size;
+    }
+};
+
+bool ParseMutation(const std::string& payload, Mutation& mutation)
+{
+    PayloadReader reader(payload);
+    uint8_t type = 0;
+    if (!reader.ReadU64(mutation.lsn) || !reader.ReadU8(type) || !reader.ReadI32(mutation.document_id))
+    {
+        return false;
+    }
+    mutation.type = static_cast<MutationType>(type);
+    switch (mutation.type)
+    {
+    case MutationType::ADD_DOCUMENT:
+    {
+        uint8_t status = 0;
+        uint32_t rating_count = 0;
+        if (!reader.ReadU8(status) || status >= DOCUMENT_STATUS_COUNT || !reader.ReadU32(rating_count))
+        {
+            return false;
+        }
+        mutation.status = static_cast<DocumentStatus>(status);
+        mutation.ratings.clear();
+        for (uint32_t i = 0; i < rating_count; ++i)
+        {
+            int rating = 0;
+            if (!reader.ReadI32(rating))
+            {
+                return false;
+            }
+            mutation.ratings.push_back(rating);
+        }
+        if (!reader.ReadString(mutation.text))
+        {
+            return false;
+        }
+        break;
+    }
+    case MutationType::REMOVE_DOCUMENT:
+        break;
+    case MutationType::SET_ATTRIBUTE:
+        if (!reader.ReadString(mutation.attribute_name) || !reader.ReadDouble(mutation.attribute_value))
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    return reader.AtEnd();
+}
+}
+
+
+void AppendMutationRecord(std::string& buffer, const Mutation& mutation)
+{
+    std::string payload;
+    PutU64(payload, mutation.lsn);
+    payload.push_back(static_cast<char>(mutation.type));
+    PutU32(payload, static_cast<uint32_t>(mutation.document_id));
+    switch (mutation.type)
+    {
+    case MutationType::ADD_DOCUMENT:
+        payload.push_back(static_cast<char>(mutation.status));
+        PutU32(payload, static_cast<uint32_t>(mutation.ratings.size()));
+        for (int rating : mutation.ratings)
+        {
+            PutU32(payload, static_cast<uint32_t>(rating));
+        }
+        PutString(payload, mutation.text);
+        break;
+    case MutationType::REMOVE_DOCUMENT:
+        break;
+    case MutationType::SET_ATTRIBUTE:
+        PutString(payload, mutation.attribute_name);
+        PutDouble(payload, mutation.attribute_value);
+        break;
+    }
+
+    PutU32(buffer, static_cast<uint32_t>(payload.size()));
+    PutU32(buffer, ComputeCrc32(payload.data(), payload.size()));
+    buffer += payload;
+}
+
+
+bool ReadMutationRecord(std::istream& input, Mutation& mutation)
+{
+    char header[RECORD_HEADER_SIZE];
+    if (!input.read(header, RECORD_HEADER_SIZE))
+    {
+        return false;
+    }
+    const uint32_t size = GetU32(header);
+    const uint32_t crc = GetU32(header + 4);
+
+    // Длина из повреждённого заголовка может быть любой. Буфер растёт частями по мере чтения,
+    // поэтому запись не может быть длиннее остатка потока и память не выделяется под отсутствующие данные
+    std::string payload;
+    while (payload.size() < size)
+    {
+        const size_t offset = payload.size();
+        const size_t chunk_size = std::min<size_t>(size - offset, RECORD_READ_CHUNK_SIZE);
+        payload.resize(offset + chunk_size);
+        if (!input.read(payload.data() + offset, static_cast<std::streamsize>(chunk_size)))
+        {
+            return false;
+        }
+    }
+    if (ComputeCrc32(payload.data(), payload.size()) != crc)
+    {
+        return false;
+    }
+    return ParseMutation(payload, mutation);
+}
+
+
+void SyncFile(std::FILE* file, const std::string& path)
+{
+#ifdef _WIN32
+    const bool synced = _commit(_fileno(file)) == 0;
+#else
+    const bool synced = fsync(fileno(file)) == 0;
+#endif
+    if (!synced)
+    {
+        throw std::runtime_error("Failed to sync file "s + path);
+    }
+}
+
+
+MutationLog::MutationLog(std::string path, MutationLogOptions options)
+    : path_(std::move(path))
+    , options_(options)
+{
+    if (options_.batch_size == 0)
+    {
+        throw std::invalid_argument("Mutation log batch size must be positive"s);
+    }
+
+    // Находим конец последней целой записи и номер последнего изменения
+    uint64_t valid_size = 0;
+    {
+        std::ifstream input(path_, std::ios::binary);
+        Mutation mutation;
+        while (input && ReadMutationRecord(input, mutation))
+        {
+            last_lsn_ = mutation.lsn;
+            valid_size = static_cast<uint64_t>(input.tellg());
+        }
+    }
+    durable_lsn_ = last_lsn_;
+
+    // Недописанная при сбое запись отрезается, чтобы новые записи шли сразу за последней целой
+    std::error_code error;
+    if (std::filesystem::exists(path_, error) && std::filesystem::file_size(path_, error) > valid_size)
+    {
+        std::filesystem::resize_file(path_, valid_size);
+    }
+    file_size_ = valid_size;
+    Open("ab");
+}
+
+
+MutationLog::~MutationLog()
+{
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+    }
+    if (file_ != nullptr)
+    {
+        std::fclose(file_);
+    }
+}
+
+
+uint64_t MutationLog::Append(Mutation mutation)
+{
+    const size_t previous_buffer_size = buffer_.size();
+    mutation.lsn = ++last_lsn_;
+    AppendMutationRecord(buffer_, mutation);
+    ++buffered_records_;
+    if (options_.sync_mode == LogSyncMode::ALWAYS || buffered_records_ >= options_.batch_size)
+    {
+        try
+        {
+            Flush();
+        }
+        catch (...)
+        {
+            // Изменение не сохранено: убираем его из пакета, предыдущие записи пакета остаются
+            // и будут записаны следующим Flush()
+            buffer_.resize(previous_buffer_size);
+            --buffered_records_;
+            --last_lsn_;
+            throw;
+        }
+    }
+    return mutation.lsn;
+}
+
+
+void MutationLog::Flush()
+{
+    if (buffer_.empty())
+    {
+        return;
+    }
+    // После неудачной записи в конце файла может остаться часть пакета. Она отрезается,
+    // и пакет записывается заново целиком
+    if (needs_truncation_)
+    {
+        Truncate();
+    }
+    // fsync, завершившийся ошибкой, не гарантирует сохранности уже переданных ОС данных,
+    // поэтому ошибка сброса на диск обрабатывается как ошибка записи
+    needs_truncation_ = true;
+    if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size() || std::fflush(file_) != 0)
+    {
+        throw std::runtime_error("Failed to write mutation log "s + path_);
+    }
+    if (options_.sync_mode != LogSyncMode::NONE)
+    {
+        SyncFile(file_, path_);
+    }
+    needs_truncation_ = false;
+    file_size_ += buffer_.size();
+    buffer_.clear();
+    buffered_records_ = 0;
+    durable_lsn_ = last_lsn_;
+}
+
+
+uint64_t MutationLog::GetLastLsn() const
+{
+    return last_lsn_;
+}
+
+
+uint64_t MutationLog::GetDurableLsn() const
+{
+    return durable_lsn_;
+}
+
+
+void MutationLog::Reset(uint64_t last_lsn)
+{
+    buffer_.clear();
+    buffered_records_ = 0;
+    if (file_ != nullptr)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    Open("wb");
+    SyncFile(file_, path_);
+    file_size_ = 0;
+    needs_truncation_ = false;
+    last_lsn_ = last_lsn;
+    durable_lsn_ = last_lsn;
+}
+
+
+std::vector<Mutation> MutationLog::Read(const std::string& path, uint64_t after_lsn)
+{
+    std::vector<Mutation> result;
+    std::ifstream input(path, std::ios::binary);
+    Mutation mutation;
+    while (input && ReadMutationRecord(input, mutation))
+    {
+        if (mutation.lsn > after_lsn)
+        {
+            result.push_back(std::move(mutation));
+            mutation = Mutation{};
+        }
+    }
+    return result;
+}
+
+
+void MutationLog::Open(const char* mode)
+{
+    file_ = std::fopen(path_.c_str(), mode);
+    if (file_ == nullptr)
+    {
+        throw std::runtime_error("Failed to open mutation log "s + path_);
+    }
+}
+
+
+void MutationLog::Truncate()
+{
+    if (file_ != nullptr)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    std::error_code error;
+    std::filesystem::resize_file(path_, file_size_, error);
+    if (error)
+    {
+        throw std::runtime_error("Failed to truncate mutation log "s + path_ + ": "s + error.message());
+    }
+    Open("ab");
+    needs_truncation_ = false;
+}
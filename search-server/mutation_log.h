@@ -0,0 +1,117 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "document.h"
+
+// Изменение индекса поискового сервера
+enum class MutationType : uint8_t
+{
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    SET_ATTRIBUTE = 3,
+};
+
+struct Mutation
+{
+    // Порядковый номер изменения (log sequence number), начиная с 1
+    uint64_t lsn = 0;
+    MutationType type = MutationType::ADD_DOCUMENT;
+    int document_id = 0;
+
+    // ADD_DOCUMENT
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+
+    // SET_ATTRIBUTE
+    std::string attribute_name;
+    double attribute_value = 0.0;
+};
+
+// Дописывает запись в буфер. Формат записи: длина данных (4 байта), CRC-32 данных (4 байта), данные.
+// Числа записываются в порядке little-endian независимо от платформы
+void AppendMutationRecord(std::string& buffer, const Mutation&);
+
+// Читает очередную запись. Возвращает false в конце потока, а также для недописанной
+// или повреждённой записи (длина больше остатка потока, несовпадение контрольной суммы)
+bool ReadMutationRecord(std::istream&, Mutation&);
+
+// Когда журнал сбрасывает данные на диск (fsync)
+enum class LogSyncMode
+{
+    NONE,       // Данные передаются ОС, на диск их сбрасывает ОС (быстро, возможна потеря последних записей при сбое ОС)
+    BATCH,      // fsync после записи каждого пакета
+    ALWAYS,     // Каждая запись - отдельный пакет со своим fsync
+};
+
+struct MutationLogOptions
+{
+    // Число записей, накапливаемых в памяти до записи пакета в файл
+    size_t batch_size = 64;
+    LogSyncMode sync_mode = LogSyncMode::BATCH;
+};
+
+// Журнал изменений (write-ahead log): файл, в который только дописываются записи Mutation.
+// Записи накапливаются пакетами и записываются в файл одним вызовом. Запись считается сохранённой
+// после Flush() (или автоматической записи заполненного пакета).
+// При открытии существующего журнала недописанный при сбое хвост отрезается
+class MutationLog
+{
+public:
+    explicit MutationLog(std::string path, MutationLogOptions options = {});
+
+    // Записывает накопленный пакет. Ошибки записи при уничтожении игнорируются - вызывайте Flush() явно
+    ~MutationLog();
+
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    // Назначает изменению следующий номер и добавляет его в пакет. Возвращает номер.
+    // Если заполненный пакет не удалось записать, изменение не добавляется, а исключение Flush() передаётся дальше
+    uint64_t Append(Mutation);
+
+    // Записывает накопленный пакет в файл (и сбрасывает на диск согласно sync_mode).
+    // При ошибке записи или сброса на диск выбрасывает std::runtime_error, пакет остаётся в памяти,
+    // а недописанные данные отрезаются перед следующей попыткой
+    void Flush();
+
+    // Номер последнего добавленного изменения (0 - изменений не было)
+    uint64_t GetLastLsn() const;
+
+    // Номер последнего изменения, записанного в файл
+    uint64_t GetDurableLsn() const;
+
+    // Удаляет все записи журнала (они уже сохранены контрольной точкой).
+    // Следующее изменение получит номер last_lsn + 1
+    void Reset(uint64_t last_lsn);
+
+    // Читает изменения журнала с номерами больше after_lsn до первой повреждённой записи.
+    // Отсутствующий файл - пустой журнал
+    static std::vector<Mutation> Read(const std::string& path, uint64_t after_lsn = 0);
+
+private:
+    std::string path_;
+    MutationLogOptions options_;
+    std::FILE* file_ = nullptr;
+    std::string buffer_;
+    size_t buffered_records_ = 0;
+    uint64_t last_lsn_ = 0;
+    uint64_t durable_lsn_ = 0;
+    // Размер файла без пакета, запись которого не удалась
+    uint64_t file_size_ = 0;
+    bool needs_truncation_ = false;
+
+    void Open(const char* mode);
+    // Отрезает файл до file_size_ и открывает его заново
+    void Truncate();
+};
+
+// Сбрасывает данные файла на диск. При ошибке выбрасывает std::runtime_error
+void SyncFile(std::FILE*, const std::string& path);
@@ -0,0 +1,140 @@
+#include "positional_index.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+void PositionList::Add(uint32_t position)
+{
+    // Первая позиция кодируется как есть, остальные - разностью с предыдущей
+    uint32_t delta = (count_ == 0) ? position : position - last_;
+    while (delta >= 0x80)
+    {
+        data_.push_back(static_cast<uint8_t>(delta | 0x80));
+        delta >>= 7;
+    }
+    data_.push_back(static_cast<uint8_t>(delta));
+
+    last_ = position;
+    ++count_;
+}
+
+
+std::vector<uint32_t> PositionList::Decode() const
+{
+    std::vector<uint32_t> result;
+    DecodeTo(result);
+    return result;
+}
+
+
+void PositionList::DecodeTo(std::vector<uint32_t>& result) const
+{
+    result.clear();
+    result.reserve(count_);
+
+    uint32_t position = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (uint8_t byte : data_)
+    {
+        delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80)
+        {
+            shift += 7;
+            continue;
+        }
+        position += delta;
+        result.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+}
+
+
+size_t PositionList::size() const
+{
+    return count_;
+}
+
+
+size_t PositionList::EncodedSize() const
+{
+    return data_.size();
+}
+
+
+size_t PositionList::GetMemoryUsage() const
+{
+    return EstimateVectorMemory(data_);
+}
+
+
+bool ContainsPhrase(const std::vector<const PositionList*>& lists)
+{
+    if (lists.empty())
+    {
+        return false;
+    }
+
+    // Кандидаты - позиции начала фразы. Каждый следующий список сужает множество кандидатов:
+    // остаются только p, для которых (p + i) есть в списке i-го слова
+    std::vector<uint32_t> candidates = lists[0]->Decode();
+    std::vector<uint32_t> positions;
+    for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i)
+    {
+        lists[i]->DecodeTo(positions);
+
+        auto out = candidates.begin();
+        auto it = positions.begin();
+        for (auto candidate = candidates.begin(); candidate != candidates.end(); ++candidate)
+        {
+            const uint32_t expected = *candidate + static_cast<uint32_t>(i);
+            while (it != positions.end() && *it < expected)
+            {
+                ++it;
+            }
+            if (it == positions.end())
+            {
+                break;
+            }
+            if (*it == expected)
+            {
+                *out++ = *candidate;
+            }
+        }
+        candidates.erase(out, candidates.end());
+    }
+
+    return !candidates.empty();
+}
+
+
+bool ContainsNear(const PositionList& lhs, const PositionList& rhs, int distance)
+{
+    const std::vector<uint32_t> lhs_positions = lhs.Decode();
+    const std::vector<uint32_t> rhs_positions = rhs.Decode();
+
+    // Слияние двух отсортированных списков: достаточно сравнивать соседние элементы
+    auto lhs_it = lhs_positions.begin();
+    auto rhs_it = rhs_positions.begin();
+    while (lhs_it != lhs_positions.end() && rhs_it != rhs_positions.end())
+    {
+        const int64_t diff = static_cast<int64_t>(*lhs_it) - static_cast<int64_t>(*rhs_it);
+        if (std::abs(diff) <= distance)
+        {
+            return true;
+        }
+        if (diff < 0)
+        {
+            ++lhs_it;
+        }
+        else
+        {
+            ++rhs_it;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+// Сжатый список позиций слова в документе.
+// Позиции хранятся как разности соседних значений в кодировке varint (7 бит данных на байт),
+// поэтому типичный список из небольших приращений занимает 1 байт на позицию.
+// Данные выделяются из ресурса памяти распределителя (std::pmr), в контейнерах std::pmr - из ресурса контейнера
+class PositionList
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<uint8_t>;
+
+    PositionList() = default;
+
+    explicit PositionList(const allocator_type& allocator)
+        : data_(allocator)
+    {
+    }
+
+    PositionList(const PositionList& other, const allocator_type& allocator)
+        : data_(other.data_, allocator)
+        , last_(other.last_)
+        , count_(other.count_)
+    {
+    }
+
+    PositionList(PositionList&& other, const allocator_type& allocator)
+        : data_(std::move(other.data_), allocator)
+        , last_(other.last_)
+        , count_(other.count_)
+    {
+    }
+
+    PositionList(const PositionList&) = default;
+    PositionList(PositionList&&) noexcept = default;
+    PositionList& operator=(const PositionList&) = default;
+    PositionList& operator=(PositionList&&) = default;
+
+    // Добавляет позицию в конец списка. Позиции должны поступать по неубыванию
+    void Add(uint32_t position);
+
+    // Распаковывает список в вектор абсолютных позиций (отсортирован по возрастанию)
+    std::vector<uint32_t> Decode() const;
+
+    // Распаковывает список в переданный буфер (без выделения памяти при достаточной ёмкости)
+    void DecodeTo(std::vector<uint32_t>&) const;
+
+    size_t size() const;
+
+    // Объём занимаемой закодированными данными памяти в байтах
+    size_t EncodedSize() const;
+
+    // Объём динамической памяти списка с учётом резерва и накладных расходов распределителя
+    size_t GetMemoryUsage() const;
+
+private:
+    std::pmr::vector<uint8_t> data_;
+    uint32_t last_ = 0;
+    uint32_t count_ = 0;
+};
+
+// Проверяет, что слова списков идут в документе подряд (фраза):
+// найдётся позиция p, для которой слово i стоит на позиции p + i
+bool ContainsPhrase(const std::vector<const PositionList*>&);
+
+// Проверяет, что два слова встречаются в документе на расстоянии не более distance (в любом порядке)
+bool ContainsNear(const PositionList&, const PositionList&, int distance);
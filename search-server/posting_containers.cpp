@@ -0,0 +1,377 @@
+#include "posting_containers.h"
+
+#include <iterator>
+
+
+bool ArrayPostings::Add(int document_id, double term_freq)
+{
+    // Документы обычно добавляются по возрастанию id: сначала проверяется конец массива
+    if (ids_.empty() || ids_.back() < document_id)
+    {
+        ids_.push_back(document_id);
+        term_freqs_.push_back(term_freq);
+        return true;
+    }
+
+    const auto it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+    const auto position = it - ids_.begin();
+    if (*it == document_id)
+    {
+        term_freqs_[position] = term_freq;
+        return false;
+    }
+    ids_.insert(it, document_id);
+    term_freqs_.insert(term_freqs_.begin() + position, term_freq);
+    return true;
+}
+
+
+bool ArrayPostings::Erase(int document_id)
+{
+    const auto it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+    if (it == ids_.end() || *it != document_id)
+    {
+        return false;
+    }
+    term_freqs_.erase(term_freqs_.begin() + (it - ids_.begin()));
+    ids_.erase(it);
+    return true;
+}
+
+
+bool ArrayPostings::Find(int document_id, double& term_freq) const
+{
+    const auto it = std::lower_bound(ids_.begin(), ids_.end(), document_id);
+    if (it == ids_.end() || *it != document_id)
+    {
+        return false;
+    }
+    term_freq = term_freqs_[it - ids_.begin()];
+    return true;
+}
+
+
+void BitmapPostings::Cursor::EnterChunk()
+{
+    rank_ = 0;
+    if (!Valid())
+    {
+        return;
+    }
+    const Chunk& chunk = postings_->chunks_[chunk_];
+    if (!chunk.IsBitmap())
+    {
+        low_ = chunk.values.front();
+        return;
+    }
+    word_ = chunk.bits.front();
+    ScanBitmap(0);
+}
+
+
+void BitmapPostings::Cursor::ScanBitmap(size_t word_index)
+{
+    const Chunk& chunk = postings_->chunks_[chunk_];
+    while (word_ == 0)
+    {
+        // Блоки не бывают пустыми, поэтому непройденный документ всегда найдётся
+        word_ = chunk.bits[++word_index];
+    }
+    low_ = static_cast<uint32_t>(word_index * 64 + CountTrailingZeros(word_));
+}
+
+
+void BitmapPostings::Cursor::Next()
+{
+    const Chunk& chunk = postings_->chunks_[chunk_];
+    if (++rank_ == chunk.size())
+    {
+        ++chunk_;
+        EnterChunk();
+        return;
+    }
+    if (!chunk.IsBitmap())
+    {
+        low_ = chunk.values[rank_];
+        return;
+    }
+    word_ &= word_ - 1;
+    ScanBitmap(low_ / 64);
+}
+
+
+void BitmapPostings::Cursor::SeekTo(int document_id)
+{
+    if (!Valid() || DocumentId() >= document_id)
+    {
+        return;
+    }
+
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    const uint32_t low = static_cast<uint32_t>(document_id) & 0xFFFFu;
+    if (postings_->chunks_[chunk_].key < key)
+    {
+        const auto& chunks = postings_->chunks_;
+        chunk_ = static_cast<size_t>(
+            std::lower_bound(chunks.begin() + chunk_, chunks.end(), key,
+                             [](const Chunk& chunk, uint32_t chunk_key)
+                             {
+                                 return chunk.key < chunk_key;
+                             })
+            - chunks.begin());
+        EnterChunk();
+        if (!Valid() || postings_->chunks_[chunk_].key > key)
+        {
+            return;
+        }
+    }
+
+    const Chunk& chunk = postings_->chunks_[chunk_];
+    if (!chunk.IsBitmap())
+    {
+        rank_ = static_cast<size_t>(std::lower_bound(chunk.values.begin() + rank_, chunk.values.end(), low)
+                                    - chunk.values.begin());
+        if (rank_ == chunk.size())
+        {
+            ++chunk_;
+            EnterChunk();
+            return;
+        }
+        low_ = chunk.values[rank_];
+        return;
+    }
+
+    if (low_ >= low)
+    {
+        return;
+    }
+    // Ранг растёт на число пропущенных документов: остаток текущего слова и целые слова до слова цели
+    size_t word_index = low_ / 64;
+    const size_t target_word = low / 64;
+    while (word_index < target_word)
+    {
+        rank_ += CountBits(word_);
+        word_ = chunk.bits[++word_index];
+    }
+    const uint64_t skipped = word_ & ((uint64_t{ 1 } << (low % 64)) - 1);
+    rank_ += CountBits(skipped);
+    word_ &= ~skipped;
+    if (rank_ == chunk.size())
+    {
+        ++chunk_;
+        EnterChunk();
+        return;
+    }
+    ScanBitmap(word_index);
+}
+
+
+bool BitmapPostings::Add(int document_id, double term_freq)
+{
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    const uint32_t low = static_cast<uint32_t>(document_id) & 0xFFFFu;
+    const size_t chunk_index = FindChunk(key);
+    if (chunk_index == chunks_.size() || chunks_[chunk_index].key != key)
+    {
+        Chunk chunk(chunks_.get_allocator());
+        chunk.key = key;
+        chunk.values.push_back(static_cast<uint16_t>(low));
+        chunk.term_freqs.push_back(term_freq);
+        chunks_.insert(chunks_.begin() + chunk_index, std::move(chunk));
+        ++size_;
+        return true;
+    }
+
+    Chunk& chunk = chunks_[chunk_index];
+    size_t rank = 0;
+    if (FindInChunk(chunk, low, rank))
+    {
+        chunk.term_freqs[rank] = term_freq;
+        return false;
+    }
+    if (chunk.IsBitmap())
+    {
+        chunk.bits[low / 64] |= uint64_t{ 1 } << (low % 64);
+    }
+    else
+    {
+        chunk.values.insert(chunk.values.begin() + rank, static_cast<uint16_t>(low));
+    }
+    chunk.term_freqs.insert(chunk.term_freqs.begin() + rank, term_freq);
+    if (!chunk.IsBitmap() && chunk.size() > ARRAY_CHUNK_LIMIT)
+    {
+        ConvertToBitmap(chunk);
+    }
+    ++size_;
+    return true;
+}
+
+
+bool BitmapPostings::Erase(int document_id)
+{
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    const uint32_t low = static_cast<uint32_t>(document_id) & 0xFFFFu;
+    const size_t chunk_index = FindChunk(key);
+    if (chunk_index == chunks_.size() || chunks_[chunk_index].key != key)
+    {
+        return false;
+    }
+
+    Chunk& chunk = chunks_[chunk_index];
+    size_t rank = 0;
+    if (!FindInChunk(chunk, low, rank))
+    {
+        return false;
+    }
+    if (chunk.IsBitmap())
+    {
+        chunk.bits[low / 64] &= ~(uint64_t{ 1 } << (low % 64));
+    }
+    else
+    {
+        chunk.values.erase(chunk.values.begin() + rank);
+    }
+    chunk.term_freqs.erase(chunk.term_freqs.begin() + rank);
+    --size_;
+
+    if (chunk.term_freqs.empty())
+    {
+        chunks_.erase(chunks_.begin() + chunk_index);
+    }
+    else if (chunk.IsBitmap() && chunk.size() < ARRAY_CHUNK_LIMIT / 2)
+    {
+        ConvertToArray(chunk);
+    }
+    return true;
+}
+
+
+bool BitmapPostings::Find(int document_id, double& term_freq) const
+{
+    const uint32_t key = static_cast<uint32_t>(document_id) >> 16;
+    const size_t chunk_index = FindChunk(key);
+    if (chunk_index == chunks_.size() || chunks_[chunk_index].key != key)
+    {
+        return false;
+    }
+    size_t rank = 0;
+    if (!FindInChunk(chunks_[chunk_index], static_cast<uint32_t>(document_id) & 0xFFFFu, rank))
+    {
+        return false;
+    }
+    term_freq = chunks_[chunk_index].term_freqs[rank];
+    return true;
+}
+
+
+size_t BitmapPostings::GetMemoryUsage() const
+{
+    size_t result = EstimateVectorMemory(chunks_);
+    for (const Chunk& chunk : chunks_)
+    {
+        result += EstimateVectorMemory(chunk.values) + EstimateVectorMemory(chunk.bits)
+            + EstimateVectorMemory(chunk.term_freqs);
+    }
+    return result;
+}
+
+
+size_t BitmapPostings::FindChunk(uint32_t key) const
+{
+    return static_cast<size_t>(std::lower_bound(chunks_.begin(), chunks_.end(), key,
+                                                [](const Chunk& chunk, uint32_t chunk_key)
+                                                {
+                                                    return chunk.key < chunk_key;
+                                                })
+                               - chunks_.begin());
+}
+
+
+bool BitmapPostings::FindInChunk(const Chunk& chunk, uint32_t low, size_t& rank)
+{
+    if (!chunk.IsBitmap())
+    {
+        const auto it = std::lower_bound(chunk.values.begin(), chunk.values.end(), low);
+        rank = static_cast<size_t>(it - chunk.values.begin());
+        return it != chunk.values.end() && *it == low;
+    }
+
+    // Ранг - число установленных битов до искомого. Считается от ближайшего края блока
+    const size_t word_index = low / 64;
+    const uint64_t word = chunk.bits[word_index];
+    const uint64_t mask = uint64_t{ 1 } << (low % 64);
+    rank = CountBits(word & (mask - 1));
+    if (word_index < BITMAP_WORDS / 2)
+    {
+        for (size_t i = 0; i < word_index; ++i)
+        {
+            rank += CountBits(chunk.bits[i]);
+        }
+    }
+    else
+    {
+        size_t after = CountBits(word & ~(mask - 1));
+        for (size_t i = word_index + 1; i < BITMAP_WORDS; ++i)
+        {
+            after += CountBits(chunk.bits[i]);
+        }
+        rank = chunk.size() - after;
+    }
+    return (word & mask) != 0;
+}
+
+
+void BitmapPostings::ConvertToBitmap(Chunk& chunk)
+{
+    chunk.bits.assign(BITMAP_WORDS, 0);
+    for (const uint16_t low : chunk.values)
+    {
+        chunk.bits[low / 64] |= uint64_t{ 1 } << (low % 64);
+    }
+    std::pmr::vector<uint16_t>(chunk.values.get_allocator()).swap(chunk.values);
+}
+
+
+void BitmapPostings::ConvertToArray(Chunk& chunk)
+{
+    chunk.values.reserve(chunk.size());
+    for (size_t word_index = 0; word_index < BITMAP_WORDS; ++word_index)
+    {
+        for (uint64_t word = chunk.bits[word_index]; word != 0; word &= word - 1)
+        {
+            chunk.values.push_back(static_cast<uint16_t>(word_index * 64 + CountTrailingZeros(word)));
+        }
+    }
+    std::pmr::vector<uint64_t>(chunk.bits.get_allocator()).swap(chunk.bits);
+}
+
+
+bool PostingPartition::Add(int document_id, double term_freq, const allocator_type& allocator)
+{
+    const bool inserted = std::visit([document_id, term_freq](auto& postings)
+                                     {
+                                         return postings.Add(document_id, term_freq);
+                                     },
+                                     postings_);
+    max_term_freq_ = std::max(max_term_freq_, static_cast<TermFreq>(term_freq));
+    if (inserted && !IsDense() && size() >= DENSE_MIN_SIZE)
+    {
+        Convert<BitmapPostings, ArrayPostings>(allocator);
+    }
+    return inserted;
+}
+
+
+bool PostingPartition::Erase(int document_id, const allocator_type& allocator)
+{
+    const bool erased = std::visit([document_id](auto& postings)
+                                   {
+                                       return postings.Erase(document_id);
+                                   },
+                                   postings_);
+    if (erased && IsDense() && size() < DENSE_MIN_SIZE / 2)
+    {
+        Convert<ArrayPostings, BitmapPostings>(allocator);
+    }
+    return erased;
+}
@@ -0,0 +1,1034 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "document.h"
+#include "memory_usage.h"
+
+// Контейнеры списков документов слова с частотами. Список выбирается по плотности слова:
+// редкое слово - отсортированные массивы id и частот (ArrayPostings), частое - сжатая битовая карта
+// в стиле Roaring с массивом частот в порядке возрастания id (BitmapPostings). Списки из одного-двух
+// документов хранятся прямо в StatusPostings (posting_list.h) и здесь представлены TinyPostingsView.
+// Все контейнеры перебираются курсорами с общим интерфейсом:
+//     Valid(), DocumentId(), Value(), Next(), SeekTo(id) - переход к первому документу с id >= заданного.
+// Value() - значение элемента списка: частота слова (или, например, предвычисленный вклад слова).
+// Ядра пересечения и объединения (IntersectPartitions(), UnitePartitions()) специализированы для пар
+// контейнеров, для остальных пар используется обход курсорами.
+// Частоты хранятся в типе TermFreq (document.h). Для вычисления вкладов векторизуемыми ядрами (score_kernels.h)
+// разделы перебираются также блоками (ForEachBlock()): не больше POSTING_BLOCK_SIZE id и частот подряд
+
+// Наибольшее число документов в блоке, который передаёт ForEachBlock()
+const size_t POSTING_BLOCK_SIZE = 128;
+
+// Номер первого id не меньше document_id в отсортированном массиве ids, начиная с позиции position.
+// Галопирующий поиск: шаг удваивается, затем двоичный поиск в найденном интервале, поэтому переход
+// на расстояние d стоит O(log d) сравнений
+inline size_t GallopTo(const int* ids, size_t size, size_t position, int document_id)
+{
+    size_t step = 1;
+    size_t low = position;
+    size_t high = position;
+    while (high < size && ids[high] < document_id)
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    high = std::min(high, size);
+    return static_cast<size_t>(std::lower_bound(ids + low, ids + high, document_id) - ids);
+}
+
+// Отсортированный массив id документов без значений (например, документы-кандидаты запроса).
+// Значение всех документов - 0
+class SortedIdsView
+{
+public:
+    class Cursor
+    {
+    public:
+        Cursor(const int* ids, size_t size)
+            : ids_(ids)
+            , size_(size)
+        {
+        }
+
+        bool Valid() const
+        {
+            return position_ < size_;
+        }
+
+        int DocumentId() const
+        {
+            return ids_[position_];
+        }
+
+        double Value() const
+        {
+            return 0.0;
+        }
+
+        void Next()
+        {
+            ++position_;
+        }
+
+        void SeekTo(int document_id)
+        {
+            position_ = GallopTo(ids_, size_, position_, document_id);
+        }
+
+    private:
+        const int* ids_;
+        size_t size_;
+        size_t position_ = 0;
+    };
+
+    template <typename Allocator>
+    explicit SortedIdsView(const std::vector<int, Allocator>& ids)
+        : ids_(ids.data())
+        , size_(ids.size())
+    {
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    Cursor GetCursor() const
+    {
+        return Cursor(ids_, size_);
+    }
+
+private:
+    const int* ids_;
+    size_t size_;
+};
+
+// Отсортированные по id массивы документов и частот
+class ArrayPostings
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const ArrayPostings& postings)
+            : postings_(&postings)
+        {
+        }
+
+        bool Valid() const
+        {
+            return position_ < postings_->ids_.size();
+        }
+
+        int DocumentId() const
+        {
+            return postings_->ids_[position_];
+        }
+
+        double Value() const
+        {
+            return postings_->term_freqs_[position_];
+        }
+
+        void Next()
+        {
+            ++position_;
+        }
+
+        void SeekTo(int document_id)
+        {
+            position_ = GallopTo(postings_->ids_.data(), postings_->ids_.size(), position_, document_id);
+        }
+
+    private:
+        const ArrayPostings* postings_;
+        size_t position_ = 0;
+    };
+
+    ArrayPostings() = default;
+
+    explicit ArrayPostings(const allocator_type& allocator)
+        : ids_(allocator)
+        , term_freqs_(allocator)
+    {
+    }
+
+    ArrayPostings(const ArrayPostings& other, const allocator_type& allocator)
+        : ids_(other.ids_, allocator)
+        , term_freqs_(other.term_freqs_, allocator)
+    {
+    }
+
+    ArrayPostings(ArrayPostings&& other, const allocator_type& allocator)
+        : ids_(std::move(other.ids_), allocator)
+        , term_freqs_(std::move(other.term_freqs_), allocator)
+    {
+    }
+
+    ArrayPostings(const ArrayPostings&) = default;
+    ArrayPostings(ArrayPostings&&) noexcept = default;
+    ArrayPostings& operator=(const ArrayPostings&) = default;
+    ArrayPostings& operator=(ArrayPostings&&) = default;
+
+    size_t size() const
+    {
+        return ids_.size();
+    }
+
+    // Добавляет документ или заменяет частоту. Возвращает true, если документ новый
+    bool Add(int document_id, double term_freq);
+
+    // Возвращает true, если документ был в списке
+    bool Erase(int document_id);
+
+    // Записывает частоту документа в term_freq. Возвращает false, если документа нет
+    bool Find(int document_id, double& term_freq) const;
+
+    Cursor GetCursor() const
+    {
+        return Cursor(*this);
+    }
+
+    // Вызывает function(id документа, частота) по возрастанию id
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (size_t i = 0; i < ids_.size(); ++i)
+        {
+            function(ids_[i], term_freqs_[i]);
+        }
+    }
+
+    const std::pmr::vector<int>& GetIds() const
+    {
+        return ids_;
+    }
+
+    const std::pmr::vector<TermFreq>& GetTermFreqs() const
+    {
+        return term_freqs_;
+    }
+
+    // Вызывает function(const int* ids, const TermFreq* term_freqs, size_t count) для блоков документов
+    // по возрастанию id. Блоки - участки массивов списка, без копирования
+    template <typename Function>
+    void ForEachBlock(Function function) const
+    {
+        for (size_t begin = 0; begin < ids_.size(); begin += POSTING_BLOCK_SIZE)
+        {
+            function(ids_.data() + begin, term_freqs_.data() + begin, std::min(POSTING_BLOCK_SIZE, ids_.size() - begin));
+        }
+    }
+
+    size_t GetMemoryUsage() const
+    {
+        return EstimateVectorMemory(ids_) + EstimateVectorMemory(term_freqs_);
+    }
+
+private:
+    std::pmr::vector<int> ids_;
+    std::pmr::vector<TermFreq> term_freqs_;
+};
+
+// Сжатая битовая карта документов в стиле Roaring. Id разбиваются на блоки по старшим 16 битам;
+// младшие 16 бит блока хранятся отсортированным массивом (не больше ARRAY_CHUNK_LIMIT значений)
+// или битовой картой из 65536 бит. Частоты блока хранятся отдельным массивом в порядке возрастания id:
+// частота документа находится по его номеру среди документов блока (ранг)
+class BitmapPostings
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    static constexpr size_t ARRAY_CHUNK_LIMIT = 4096;
+    static constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+    struct Chunk
+    {
+        using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+        uint32_t key = 0;                       // Старшие 16 бит id документов блока
+        std::pmr::vector<uint16_t> values;      // Младшие 16 бит по возрастанию (форма массива)
+        std::pmr::vector<uint64_t> bits;        // BITMAP_WORDS слов (форма битовой карты), иначе пусто
+        std::pmr::vector<TermFreq> term_freqs;  // Частоты по возрастанию id
+
+        explicit Chunk(const allocator_type& allocator = {})
+            : values(allocator)
+            , bits(allocator)
+            , term_freqs(allocator)
+        {
+        }
+
+        Chunk(const Chunk& other, const allocator_type& allocator)
+            : key(other.key)
+            , values(other.values, allocator)
+            , bits(other.bits, allocator)
+            , term_freqs(other.term_freqs, allocator)
+        {
+        }
+
+        Chunk(Chunk&& other, const allocator_type& allocator)
+            : key(other.key)
+            , values(std::move(other.values), allocator)
+            , bits(std::move(other.bits), allocator)
+            , term_freqs(std::move(other.term_freqs), allocator)
+        {
+        }
+
+        Chunk(const Chunk&) = default;
+        Chunk(Chunk&&) noexcept = default;
+        Chunk& operator=(const Chunk&) = default;
+        Chunk& operator=(Chunk&&) = default;
+
+        bool IsBitmap() const
+        {
+            return !bits.empty();
+        }
+
+        size_t size() const
+        {
+            return term_freqs.size();
+        }
+    };
+
+    class Cursor
+    {
+    public:
+        explicit Cursor(const BitmapPostings& postings)
+            : postings_(&postings)
+        {
+            EnterChunk();
+        }
+
+        bool Valid() const
+        {
+            return chunk_ < postings_->chunks_.size();
+        }
+
+        int DocumentId() const
+        {
+            return static_cast<int>((postings_->chunks_[chunk_].key << 16) | low_);
+        }
+
+        double Value() const
+        {
+            return postings_->chunks_[chunk_].term_freqs[rank_];
+        }
+
+        void Next();
+
+        void SeekTo(int document_id);
+
+    private:
+        const BitmapPostings* postings_;
+        size_t chunk_ = 0;
+        size_t rank_ = 0;       // Номер текущего документа в блоке
+        uint32_t low_ = 0;      // Младшие 16 бит текущего id
+        uint64_t word_ = 0;     // Ещё не пройденные биты текущего слова битовой карты
+
+        // Встаёт на первый документ блока chunk_ (блоки не бывают пустыми)
+        void EnterChunk();
+        // Встаёт на первый документ текущего блока битовой карты, начиная со слова word_index
+        // (word_ содержит оставшиеся биты этого слова)
+        void ScanBitmap(size_t word_index);
+    };
+
+    BitmapPostings() = default;
+
+    explicit BitmapPostings(const allocator_type& allocator)
+        : chunks_(allocator)
+    {
+    }
+
+    BitmapPostings(const BitmapPostings& other, const allocator_type& allocator)
+        : chunks_(other.chunks_, allocator)
+        , size_(other.size_)
+    {
+    }
+
+    BitmapPostings(BitmapPostings&& other, const allocator_type& allocator)
+        : chunks_(std::move(other.chunks_), allocator)
+        , size_(other.size_)
+    {
+    }
+
+    BitmapPostings(const BitmapPostings&) = default;
+    BitmapPostings(BitmapPostings&&) noexcept = default;
+    BitmapPostings& operator=(const BitmapPostings&) = default;
+    BitmapPostings& operator=(BitmapPostings&&) = default;
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    bool Add(int document_id, double term_freq);
+
+    bool Erase(int document_id);
+
+    bool Find(int document_id, double& term_freq) const;
+
+    Cursor GetCursor() const
+    {
+        return Cursor(*this);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (const Chunk& chunk : chunks_)
+        {
+            ForEachInChunk(chunk, function);
+        }
+    }
+
+    // Вызывает function(const int* ids, const TermFreq* term_freqs, size_t count) для блоков документов
+    // по возрастанию id. Id блока восстанавливаются в буфер на стеке, частоты передаются участком массива блока
+    template <typename Function>
+    void ForEachBlock(Function function) const
+    {
+        int ids[POSTING_BLOCK_SIZE];
+        for (const Chunk& chunk : chunks_)
+        {
+            size_t begin = 0;
+            size_t count = 0;
+            ForEachInChunk(chunk, [&](int document_id, double)
+                           {
+                               ids[count++] = document_id;
+                               if (count == POSTING_BLOCK_SIZE)
+                               {
+                                   function(static_cast<const int*>(ids), chunk.term_freqs.data() + begin, count);
+                                   begin += count;
+                                   count = 0;
+                               }
+                           });
+            if (count != 0)
+            {
+                function(static_cast<const int*>(ids), chunk.term_freqs.data() + begin, count);
+            }
+        }
+    }
+
+    const std::pmr::vector<Chunk>& GetChunks() const
+    {
+        return chunks_;
+    }
+
+    size_t GetMemoryUsage() const;
+
+    // Вызывает function(id документа, частота) для документов блока по возрастанию id
+    template <typename Function>
+    static void ForEachInChunk(const Chunk& chunk, Function function)
+    {
+        const uint32_t base = chunk.key << 16;
+        if (!chunk.IsBitmap())
+        {
+            for (size_t i = 0; i < chunk.values.size(); ++i)
+            {
+                function(static_cast<int>(base | chunk.values[i]), chunk.term_freqs[i]);
+            }
+            return;
+        }
+        size_t rank = 0;
+        for (size_t word_index = 0; word_index < BITMAP_WORDS; ++word_index)
+        {
+            for (uint64_t word = chunk.bits[word_index]; word != 0; word &= word - 1)
+            {
+                const uint32_t low = static_cast<uint32_t>(word_index * 64 + CountTrailingZeros(word));
+                function(static_cast<int>(base | low), chunk.term_freqs[rank++]);
+            }
+        }
+    }
+
+    static int CountTrailingZeros(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(word);
+#else
+        int result = 0;
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            ++result;
+        }
+        return result;
+#endif
+    }
+
+    static int CountBits(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(word);
+#else
+        int result = 0;
+        for (; word != 0; word &= word - 1)
+        {
+            ++result;
+        }
+        return result;
+#endif
+    }
+
+private:
+    std::pmr::vector<Chunk> chunks_;   // По возрастанию key, пустых блоков нет
+    size_t size_ = 0;
+
+    // Номер первого блока с ключом не меньше key
+    size_t FindChunk(uint32_t key) const;
+
+    // Ищет младшие 16 бит id в блоке: true, если найдено; rank - номер документа (или место вставки)
+    static bool FindInChunk(const Chunk&, uint32_t low, size_t& rank);
+
+    static void ConvertToBitmap(Chunk&);
+    static void ConvertToArray(Chunk&);
+};
+
+// Список документов раздела из не более чем нескольких документов, хранящихся прямо в StatusPostings
+struct TinyPosting
+{
+    int document_id = 0;
+    uint32_t status = 0;
+    TermFreq term_freq = 0.0f;
+};
+
+// Документы одного раздела крошечного списка (упорядочены по id)
+class TinyPostingsView
+{
+public:
+    class Cursor
+    {
+    public:
+        Cursor(const TinyPosting* begin, const TinyPosting* end)
+            : position_(begin)
+            , end_(end)
+        {
+        }
+
+        bool Valid() const
+        {
+            return position_ != end_;
+        }
+
+        int DocumentId() const
+        {
+            return position_->document_id;
+        }
+
+        double Value() const
+        {
+            return position_->term_freq;
+        }
+
+        void Next()
+        {
+            ++position_;
+        }
+
+        void SeekTo(int document_id)
+        {
+            while (position_ != end_ && position_->document_id < document_id)
+            {
+                ++position_;
+            }
+        }
+
+    private:
+        const TinyPosting* position_;
+        const TinyPosting* end_;
+    };
+
+    TinyPostingsView(const TinyPosting* begin, const TinyPosting* end)
+        : begin_(begin)
+        , end_(end)
+    {
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>(end_ - begin_);
+    }
+
+    bool Find(int document_id, double& term_freq) const
+    {
+        for (const TinyPosting* it = begin_; it != end_; ++it)
+        {
+            if (it->document_id == document_id)
+            {
+                term_freq = it->term_freq;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Cursor GetCursor() const
+    {
+        return Cursor(begin_, end_);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (const TinyPosting* it = begin_; it != end_; ++it)
+        {
+            function(it->document_id, it->term_freq);
+        }
+    }
+
+    template <typename Function>
+    void ForEachBlock(Function function) const
+    {
+        int ids[POSTING_BLOCK_SIZE];
+        TermFreq term_freqs[POSTING_BLOCK_SIZE];
+        size_t count = 0;
+        for (const TinyPosting* it = begin_; it != end_; ++it)
+        {
+            ids[count] = it->document_id;
+            term_freqs[count++] = it->term_freq;
+            if (count == POSTING_BLOCK_SIZE || it + 1 == end_)
+            {
+                function(static_cast<const int*>(ids), static_cast<const TermFreq*>(term_freqs), count);
+                count = 0;
+            }
+        }
+    }
+
+private:
+    const TinyPosting* begin_;
+    const TinyPosting* end_;
+};
+
+// Раздел списка документов: массив для редкого слова, битовая карта для частого.
+// Переходит в битовую карту, когда документов становится DENSE_MIN_SIZE, и обратно,
+// когда их меньше половины этого числа (чтобы не переключаться при каждом изменении на границе)
+class PostingPartition
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    static constexpr size_t DENSE_MIN_SIZE = 4096;
+
+    PostingPartition()
+        : PostingPartition(allocator_type{})
+    {
+    }
+
+    explicit PostingPartition(const allocator_type& allocator)
+        : postings_(std::in_place_type<ArrayPostings>, allocator)
+    {
+    }
+
+    PostingPartition(const PostingPartition& other, const allocator_type& allocator)
+        : postings_(std::visit([&allocator](const auto& postings) -> Postings
+                               {
+                                   using Type = std::decay_t<decltype(postings)>;
+                                   return Postings(std::in_place_type<Type>, postings, allocator);
+                               },
+                               other.postings_))
+        , max_term_freq_(other.max_term_freq_)
+    {
+    }
+
+    PostingPartition(PostingPartition&& other, const allocator_type& allocator)
+        : postings_(std::visit([&allocator](auto& postings) -> Postings
+                               {
+                                   using Type = std::decay_t<decltype(postings)>;
+                                   return Postings(std::in_place_type<Type>, std::move(postings), allocator);
+                               },
+                               other.postings_))
+        , max_term_freq_(other.max_term_freq_)
+    {
+    }
+
+    PostingPartition(const PostingPartition&) = default;
+    PostingPartition(PostingPartition&&) noexcept = default;
+    PostingPartition& operator=(const PostingPartition&) = default;
+    PostingPartition& operator=(PostingPartition&&) = default;
+
+    size_t size() const
+    {
+        return std::visit([](const auto& postings)
+                          {
+                              return postings.size();
+                          },
+                          postings_);
+    }
+
+    bool IsDense() const
+    {
+        return std::holds_alternative<BitmapPostings>(postings_);
+    }
+
+    // Верхняя граница частоты слова в документах раздела. Удаление документов её не уменьшает
+    TermFreq GetMaxTermFreq() const
+    {
+        return max_term_freq_;
+    }
+
+    bool Add(int document_id, double term_freq, const allocator_type& allocator);
+
+    bool Erase(int document_id, const allocator_type& allocator);
+
+    bool Find(int document_id, double& term_freq) const
+    {
+        return std::visit([document_id, &term_freq](const auto& postings)
+                          {
+                              return postings.Find(document_id, term_freq);
+                          },
+                          postings_);
+    }
+
+    // Вызывает function(контейнер) для текущего представления раздела
+    template <typename Function>
+    decltype(auto) Visit(Function function) const
+    {
+        return std::visit(function, postings_);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        std::visit([&function](const auto& postings)
+                   {
+                       postings.ForEach(function);
+                   },
+                   postings_);
+    }
+
+    template <typename Function>
+    void ForEachBlock(Function function) const
+    {
+        std::visit([&function](const auto& postings)
+                   {
+                       postings.ForEachBlock(function);
+                   },
+                   postings_);
+    }
+
+    size_t GetMemoryUsage() const
+    {
+        return std::visit([](const auto& postings)
+                          {
+                              return postings.GetMemoryUsage();
+                          },
+                          postings_);
+    }
+
+private:
+    using Postings = std::variant<ArrayPostings, BitmapPostings>;
+
+    Postings postings_;
+    TermFreq max_term_freq_ = 0.0f;
+
+    // Переносит документы текущего представления в представление Target
+    template <typename Target, typename Source>
+    void Convert(const allocator_type& allocator)
+    {
+        Target target(allocator);
+        std::get<Source>(postings_).ForEach([&target](int document_id, double term_freq)
+                                            {
+                                                target.Add(document_id, term_freq);
+                                            });
+        postings_.template emplace<Target>(std::move(target), allocator);
+    }
+};
+
+
+// Ядра пересечения: вызывают function(id документа, частота в lhs, частота в rhs)
+// для документов, входящих в оба списка, по возрастанию id
+
+// Поочерёдный переход курсоров к большему из текущих id (leapfrog)
+template <typename LhsCursor, typename RhsCursor, typename Function>
+void IntersectCursors(LhsCursor lhs_cursor, RhsCursor rhs_cursor, Function function)
+{
+    while (lhs_cursor.Valid() && rhs_cursor.Valid())
+    {
+        const int lhs_id = lhs_cursor.DocumentId();
+        const int rhs_id = rhs_cursor.DocumentId();
+        if (lhs_id == rhs_id)
+        {
+            function(lhs_id, lhs_cursor.Value(), rhs_cursor.Value());
+            lhs_cursor.Next();
+            rhs_cursor.Next();
+        }
+        else if (lhs_id < rhs_id)
+        {
+            lhs_cursor.SeekTo(rhs_id);
+        }
+        else
+        {
+            rhs_cursor.SeekTo(lhs_id);
+        }
+    }
+}
+
+// Общий случай
+template <typename Lhs, typename Rhs, typename Function>
+void IntersectPartitions(const Lhs& lhs, const Rhs& rhs, Function function)
+{
+    IntersectCursors(lhs.GetCursor(), rhs.GetCursor(), function);
+}
+
+// Массив и массив: слияние при близких размерах, галопирующий поиск по большему массиву при сильно различных
+template <typename Function>
+void IntersectPartitions(const ArrayPostings& lhs, const ArrayPostings& rhs, Function function)
+{
+    static constexpr size_t GALLOP_RATIO = 32;
+
+    const std::pmr::vector<int>& lhs_ids = lhs.GetIds();
+    const std::pmr::vector<int>& rhs_ids = rhs.GetIds();
+    if (lhs_ids.size() * GALLOP_RATIO < rhs_ids.size() || rhs_ids.size() * GALLOP_RATIO < lhs_ids.size())
+    {
+        IntersectCursors(lhs.GetCursor(), rhs.GetCursor(), function);
+        return;
+    }
+
+    const std::pmr::vector<TermFreq>& lhs_freqs = lhs.GetTermFreqs();
+    const std::pmr::vector<TermFreq>& rhs_freqs = rhs.GetTermFreqs();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs_ids.size() && j < rhs_ids.size())
+    {
+        if (lhs_ids[i] == rhs_ids[j])
+        {
+            function(lhs_ids[i], lhs_freqs[i], rhs_freqs[j]);
+            ++i;
+            ++j;
+        }
+        else if (lhs_ids[i] < rhs_ids[j])
+        {
+            ++i;
+        }
+        else
+        {
+            ++j;
+        }
+    }
+}
+
+// Битовая карта и битовая карта: блоки сопоставляются по ключу, в блоках-картах пересечение - AND слов,
+// ранги (номера частот) обоих документов считаются подсчётом битов
+template <typename Function>
+void IntersectPartitions(const BitmapPostings& lhs, const BitmapPostings& rhs, Function function)
+{
+    using Chunk = BitmapPostings::Chunk;
+
+    const std::pmr::vector<Chunk>& lhs_chunks = lhs.GetChunks();
+    const std::pmr::vector<Chunk>& rhs_chunks = rhs.GetChunks();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs_chunks.size() && j < rhs_chunks.size())
+    {
+        const Chunk& lhs_chunk = lhs_chunks[i];
+        const Chunk& rhs_chunk = rhs_chunks[j];
+        if (lhs_chunk.key < rhs_chunk.key)
+        {
+            ++i;
+            continue;
+        }
+        if (rhs_chunk.key < lhs_chunk.key)
+        {
+            ++j;
+            continue;
+        }
+
+        if (lhs_chunk.IsBitmap() && rhs_chunk.IsBitmap())
+        {
+            const uint32_t base = lhs_chunk.key << 16;
+            size_t lhs_rank = 0;
+            size_t rhs_rank = 0;
+            for (size_t word_index = 0; word_index < BitmapPostings::BITMAP_WORDS; ++word_index)
+            {
+                const uint64_t lhs_word = lhs_chunk.bits[word_index];
+                const uint64_t rhs_word = rhs_chunk.bits[word_index];
+                for (uint64_t common = lhs_word & rhs_word; common != 0; common &= common - 1)
+                {
+                    const int bit = BitmapPostings::CountTrailingZeros(common);
+                    const uint64_t below = (uint64_t{ 1 } << bit) - 1;
+                    function(static_cast<int>(base | static_cast<uint32_t>(word_index * 64 + bit)),
+                             lhs_chunk.term_freqs[lhs_rank + BitmapPostings::CountBits(lhs_word & below)],
+                             rhs_chunk.term_freqs[rhs_rank + BitmapPostings::CountBits(rhs_word & below)]);
+                }
+                lhs_rank += BitmapPostings::CountBits(lhs_word);
+                rhs_rank += BitmapPostings::CountBits(rhs_word);
+            }
+        }
+        else
+        {
+            // Хотя бы один блок - массив: перебираем меньший блок и ищем его документы в другом
+            const bool lhs_smaller = lhs_chunk.size() <= rhs_chunk.size();
+            const Chunk& small = lhs_smaller ? lhs_chunk : rhs_chunk;
+            const BitmapPostings& large = lhs_smaller ? rhs : lhs;
+            BitmapPostings::ForEachInChunk(small, [&](int document_id, double small_freq)
+                                           {
+                                               double large_freq = 0.0;
+                                               if (large.Find(document_id, large_freq))
+                                               {
+                                                   lhs_smaller ? function(document_id, small_freq, large_freq)
+                                                               : function(document_id, large_freq, small_freq);
+                                               }
+                                           });
+        }
+        ++i;
+        ++j;
+    }
+}
+
+
+// Ядра объединения: вызывают function(id документа, частота в lhs, частота в rhs) для документов
+// хотя бы одного из списков по возрастанию id; для отсутствующего в списке документа частота равна 0
+
+// Общий случай: слияние курсоров
+template <typename Lhs, typename Rhs, typename Function>
+void UnitePartitions(const Lhs& lhs, const Rhs& rhs, Function function)
+{
+    auto lhs_cursor = lhs.GetCursor();
+    auto rhs_cursor = rhs.GetCursor();
+    while (lhs_cursor.Valid() || rhs_cursor.Valid())
+    {
+        if (!rhs_cursor.Valid() || (lhs_cursor.Valid() && lhs_cursor.DocumentId() < rhs_cursor.DocumentId()))
+        {
+            function(lhs_cursor.DocumentId(), lhs_cursor.Value(), 0.0);
+            lhs_cursor.Next();
+        }
+        else if (!lhs_cursor.Valid() || rhs_cursor.DocumentId() < lhs_cursor.DocumentId())
+        {
+            function(rhs_cursor.DocumentId(), 0.0, rhs_cursor.Value());
+            rhs_cursor.Next();
+        }
+        else
+        {
+            function(lhs_cursor.DocumentId(), lhs_cursor.Value(), rhs_cursor.Value());
+            lhs_cursor.Next();
+            rhs_cursor.Next();
+        }
+    }
+}
+
+// Массив и массив: слияние по индексам без курсоров
+template <typename Function>
+void UnitePartitions(const ArrayPostings& lhs, const ArrayPostings& rhs, Function function)
+{
+    const std::pmr::vector<int>& lhs_ids = lhs.GetIds();
+    const std::pmr::vector<int>& rhs_ids = rhs.GetIds();
+    const std::pmr::vector<TermFreq>& lhs_freqs = lhs.GetTermFreqs();
+    const std::pmr::vector<TermFreq>& rhs_freqs = rhs.GetTermFreqs();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs_ids.size() || j < rhs_ids.size())
+    {
+        if (j == rhs_ids.size() || (i < lhs_ids.size() && lhs_ids[i] < rhs_ids[j]))
+        {
+            function(lhs_ids[i], lhs_freqs[i], 0.0);
+            ++i;
+        }
+        else if (i == lhs_ids.size() || rhs_ids[j] < lhs_ids[i])
+        {
+            function(rhs_ids[j], 0.0, rhs_freqs[j]);
+            ++j;
+        }
+        else
+        {
+            function(lhs_ids[i], lhs_freqs[i], rhs_freqs[j]);
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// Битовая карта и битовая карта: в блоках-картах объединение - OR слов, частоты находятся по рангам
+template <typename Function>
+void UnitePartitions(const BitmapPostings& lhs, const BitmapPostings& rhs, Function function)
+{
+    using Chunk = BitmapPostings::Chunk;
+
+    const std::pmr::vector<Chunk>& lhs_chunks = lhs.GetChunks();
+    const std::pmr::vector<Chunk>& rhs_chunks = rhs.GetChunks();
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs_chunks.size() || j < rhs_chunks.size())
+    {
+        if (j == rhs_chunks.size() || (i < lhs_chunks.size() && lhs_chunks[i].key < rhs_chunks[j].key))
+        {
+            BitmapPostings::ForEachInChunk(lhs_chunks[i++], [&function](int document_id, double term_freq)
+                                           {
+                                               function(document_id, term_freq, 0.0);
+                                           });
+            continue;
+        }
+        if (i == lhs_chunks.size() || rhs_chunks[j].key < lhs_chunks[i].key)
+        {
+            BitmapPostings::ForEachInChunk(rhs_chunks[j++], [&function](int document_id, double term_freq)
+                                           {
+                                               function(document_id, 0.0, term_freq);
+                                           });
+            continue;
+        }
+
+        const Chunk& lhs_chunk = lhs_chunks[i++];
+        const Chunk& rhs_chunk = rhs_chunks[j++];
+        if (lhs_chunk.IsBitmap() && rhs_chunk.IsBitmap())
+        {
+            const uint32_t base = lhs_chunk.key << 16;
+            size_t lhs_rank = 0;
+            size_t rhs_rank = 0;
+            for (size_t word_index = 0; word_index < BitmapPostings::BITMAP_WORDS; ++word_index)
+            {
+                const uint64_t lhs_word = lhs_chunk.bits[word_index];
+                const uint64_t rhs_word = rhs_chunk.bits[word_index];
+                for (uint64_t any = lhs_word | rhs_word; any != 0; any &= any - 1)
+                {
+                    const uint64_t bit = any & (~any + 1);
+                    const int document_id = static_cast<int>(
+                        base | static_cast<uint32_t>(word_index * 64 + BitmapPostings::CountTrailingZeros(bit)));
+                    const double lhs_freq = (lhs_word & bit) ? lhs_chunk.term_freqs[lhs_rank++] : 0.0;
+                    const double rhs_freq = (rhs_word & bit) ? rhs_chunk.term_freqs[rhs_rank++] : 0.0;
+                    function(document_id, lhs_freq, rhs_freq);
+                }
+            }
+        }
+        else
+        {
+            // Хотя бы один блок - массив: слияние перебором блоков по возрастанию id
+            std::vector<std::pair<int, double>> rhs_documents;
+            rhs_documents.reserve(rhs_chunk.size());
+            BitmapPostings::ForEachInChunk(rhs_chunk, [&rhs_documents](int document_id, double term_freq)
+                                           {
+                                               rhs_documents.emplace_back(document_id, term_freq);
+                                           });
+            size_t position = 0;
+            BitmapPostings::ForEachInChunk(lhs_chunk, [&](int document_id, double term_freq)
+                                           {
+                                               for (; position < rhs_documents.size()
+                                                      && rhs_documents[position].first < document_id; ++position)
+                                               {
+                                                   function(rhs_documents[position].first, 0.0,
+                                                            rhs_documents[position].second);
+                                               }
+                                               if (position < rhs_documents.size()
+                                                   && rhs_documents[position].first == document_id)
+                                               {
+                                                   function(document_id, term_freq, rhs_documents[position++].second);
+                                               }
+                                               else
+                                               {
+                                                   function(document_id, term_freq, 0.0);
+                                               }
+                                           });
+            for (; position < rhs_documents.size(); ++position)
+            {
+                function(rhs_documents[position].first, 0.0, rhs_documents[position].second);
+            }
+        }
+    }
+}
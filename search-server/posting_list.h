@@ -0,0 +1,649 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "document.h"
+#include "memory_usage.h"
+#include "posting_containers.h"
+
+// Список документов, содержащих слово, с частотами слова в них.
+// Список разбит на разделы по статусам документов: документ лежит в разделе своего статуса,
+// поэтому запрос по одному статусу перебирает только свой раздел и не проверяет статус каждого документа.
+// Представление выбирается по плотности слова: до TINY_CAPACITY документов хранятся прямо в объекте
+// без выделения памяти (большинство слов корпуса встречается в одном-двух документах), иначе - в блоке разделов,
+// каждый из которых - массив или битовая карта (PostingPartition, posting_containers.h).
+// Память выделяется из ресурса распределителя (std::pmr): в std::pmr::vector<StatusPostings>
+// ресурс вектора передаётся спискам автоматически
+class StatusPostings
+{
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    static constexpr size_t TINY_CAPACITY = 2;
+    // Средний объём памяти на документ списка в разделах (массивы id и частот с запасом роста).
+    // Используется для оценки памяти документа до его добавления
+    static constexpr size_t ESTIMATED_POSTING_MEMORY = 11;
+
+    StatusPostings()
+        : StatusPostings(allocator_type{})
+    {
+    }
+
+    explicit StatusPostings(const allocator_type& allocator)
+        : allocator_(allocator)
+    {
+    }
+
+    StatusPostings(const StatusPostings& other, const allocator_type& allocator)
+        : tiny_(other.tiny_)
+        , size_(other.size_)
+        , allocator_(allocator)
+    {
+        if (other.partitions_ != nullptr)
+        {
+            partitions_ = CreatePartitions(*other.partitions_);
+        }
+    }
+
+    StatusPostings(StatusPostings&& other, const allocator_type& allocator)
+        : allocator_(allocator)
+    {
+        if (allocator_ == other.allocator_)
+        {
+            Swap(other);
+        }
+        else
+        {
+            StatusPostings copy(other, allocator);
+            Swap(copy);
+        }
+    }
+
+    StatusPostings(const StatusPostings& other)
+        : StatusPostings(other, allocator_type{})
+    {
+    }
+
+    StatusPostings(StatusPostings&& other) noexcept
+        : allocator_(other.allocator_)
+    {
+        Swap(other);
+    }
+
+    StatusPostings& operator=(const StatusPostings& other)
+    {
+        if (this != &other)
+        {
+            StatusPostings copy(other, allocator_);
+            Swap(copy);
+        }
+        return *this;
+    }
+
+    StatusPostings& operator=(StatusPostings&& other)
+    {
+        if (this != &other)
+        {
+            StatusPostings moved(std::move(other), allocator_);
+            Swap(moved);
+        }
+        return *this;
+    }
+
+    ~StatusPostings()
+    {
+        DestroyPartitions();
+    }
+
+    // Добавляет документ (или заменяет частоту слова в нём)
+    void Add(int document_id, DocumentStatus status, double term_freq);
+
+    void Erase(int document_id, DocumentStatus status);
+
+    // Количество документов со словом по всем статусам
+    size_t size() const
+    {
+        return size_;
+    }
+
+    // Объём динамической памяти списка в байтах
+    size_t GetMemoryUsage() const
+    {
+        if (partitions_ == nullptr)
+        {
+            return 0;
+        }
+        size_t result = EstimateAllocation(sizeof(Partitions));
+        for (const PostingPartition& partition : *partitions_)
+        {
+            result += partition.GetMemoryUsage();
+        }
+        return result;
+    }
+
+    // Курсор по разделу статуса с представлением, выбранным при создании (см. GetCursor())
+    class Cursor
+    {
+    public:
+        template <typename PartitionCursor>
+        explicit Cursor(const PartitionCursor& cursor)
+            : cursor_(cursor)
+        {
+        }
+
+        bool Valid() const
+        {
+            return std::visit([](const auto& cursor) { return cursor.Valid(); }, cursor_);
+        }
+
+        int DocumentId() const
+        {
+            return std::visit([](const auto& cursor) { return cursor.DocumentId(); }, cursor_);
+        }
+
+        double Value() const
+        {
+            return std::visit([](const auto& cursor) { return static_cast<double>(cursor.Value()); }, cursor_);
+        }
+
+        void Next()
+        {
+            std::visit([](auto& cursor) { cursor.Next(); }, cursor_);
+        }
+
+        // Переходит к первому документу с id не меньше заданного
+        void SeekTo(int document_id)
+        {
+            std::visit([document_id](auto& cursor) { cursor.SeekTo(document_id); }, cursor_);
+        }
+
+    private:
+        std::variant<TinyPostingsView::Cursor, ArrayPostings::Cursor, BitmapPostings::Cursor> cursor_;
+    };
+
+    // Количество документов в разделе статуса
+    size_t GetPartitionSize(DocumentStatus status) const
+    {
+        if (partitions_ == nullptr)
+        {
+            const auto [begin, end] = GetTinyRange(status);
+            return static_cast<size_t>(end - begin);
+        }
+        return (*partitions_)[static_cast<size_t>(status)].size();
+    }
+
+    // Хранится ли раздел статуса битовой картой
+    bool IsPartitionDense(DocumentStatus status) const
+    {
+        return partitions_ != nullptr && (*partitions_)[static_cast<size_t>(status)].IsDense();
+    }
+
+    // Верхняя граница частоты слова в документах раздела статуса (для оценки вклада слова в релевантность)
+    double GetMaxTermFreq(DocumentStatus status) const
+    {
+        if (partitions_ == nullptr)
+        {
+            const auto [begin, end] = GetTinyRange(status);
+            double result = 0.0;
+            for (const TinyPosting* it = begin; it != end; ++it)
+            {
+                result = std::max(result, static_cast<double>(it->term_freq));
+            }
+            return result;
+        }
+        return (*partitions_)[static_cast<size_t>(status)].GetMaxTermFreq();
+    }
+
+    // Курсор по разделу статуса. Действителен, пока список не изменён
+    Cursor GetCursor(DocumentStatus status) const
+    {
+        Cursor result(TinyPostingsView::Cursor(nullptr, nullptr));
+        VisitPartition(status, [&result](const auto& partition)
+                       {
+                           result = Cursor(partition.GetCursor());
+                       });
+        return result;
+    }
+
+    // Вызывает function(контейнер) для раздела документов с заданным статусом: TinyPostingsView,
+    // ArrayPostings или BitmapPostings. Все контейнеры упорядочены по id документа
+    template <typename Function>
+    void VisitPartition(DocumentStatus status, Function function) const
+    {
+        if (partitions_ == nullptr)
+        {
+            const auto [begin, end] = GetTinyRange(status);
+            function(TinyPostingsView(begin, end));
+            return;
+        }
+        (*partitions_)[static_cast<size_t>(status)].Visit(function);
+    }
+
+    // Вызывает function(id документа, частота) для документов раздела с заданным статусом по возрастанию id.
+    // Цикл перебора выбирается по представлению раздела один раз на раздел
+    template <typename Function>
+    void ForEachInPartition(DocumentStatus status, Function function) const
+    {
+        VisitPartition(status, [&function](const auto& partition)
+                       {
+                           partition.ForEach(function);
+                       });
+    }
+
+    // Вызывает function(const int* ids, const TermFreq* term_freqs, size_t count) для блоков документов раздела
+    // с заданным статусом (не больше POSTING_BLOCK_SIZE документов, по возрастанию id)
+    template <typename Function>
+    void ForEachBlockInPartition(DocumentStatus status, Function function) const
+    {
+        VisitPartition(status, [&function](const auto& partition)
+                       {
+                           partition.ForEachBlock(function);
+                       });
+    }
+
+    // Вызывает function(id документа, частота) для документов всех разделов
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            ForEachInPartition(static_cast<DocumentStatus>(status), function);
+        }
+    }
+
+private:
+    using Partitions = std::array<PostingPartition, DOCUMENT_STATUS_COUNT>;
+
+    // Документы крошечного списка упорядочены по статусу, затем по id
+    std::array<TinyPosting, TINY_CAPACITY> tiny_{};
+    Partitions* partitions_ = nullptr;
+    size_t size_ = 0;
+    allocator_type allocator_;
+
+    void Swap(StatusPostings& other) noexcept
+    {
+        std::swap(tiny_, other.tiny_);
+        std::swap(partitions_, other.partitions_);
+        std::swap(size_, other.size_);
+    }
+
+    std::pair<const TinyPosting*, const TinyPosting*> GetTinyRange(DocumentStatus status) const
+    {
+        const TinyPosting* begin = tiny_.data();
+        const TinyPosting* end = tiny_.data() + size_;
+        const uint32_t status_index = static_cast<uint32_t>(status);
+        while (begin != end && begin->status < status_index)
+        {
+            ++begin;
+        }
+        const TinyPosting* last = begin;
+        while (last != end && last->status == status_index)
+        {
+            ++last;
+        }
+        return { begin, last };
+    }
+
+    template <typename... Source>
+    Partitions* CreatePartitions(const Source&... source)
+    {
+        std::pmr::polymorphic_allocator<Partitions> allocator(allocator_);
+        Partitions* partitions = allocator.allocate(1);
+        try
+        {
+            new (partitions) Partitions(MakePartitions(std::make_index_sequence<DOCUMENT_STATUS_COUNT>{}, source...));
+        }
+        catch (...)
+        {
+            allocator.deallocate(partitions, 1);
+            throw;
+        }
+        return partitions;
+    }
+
+    void DestroyPartitions()
+    {
+        if (partitions_ != nullptr)
+        {
+            std::pmr::polymorphic_allocator<Partitions> allocator(allocator_);
+            partitions_->~Partitions();
+            allocator.deallocate(partitions_, 1);
+            partitions_ = nullptr;
+        }
+    }
+
+    template <size_t... Statuses>
+    Partitions MakePartitions(std::index_sequence<Statuses...>) const
+    {
+        return { ((void)Statuses, PostingPartition(allocator_))... };
+    }
+
+    template <size_t... Statuses>
+    Partitions MakePartitions(std::index_sequence<Statuses...>, const Partitions& other) const
+    {
+        return { PostingPartition(other[Statuses], allocator_)... };
+    }
+};
+
+inline void StatusPostings::Add(int document_id, DocumentStatus status, double term_freq)
+{
+    const uint32_t status_index = static_cast<uint32_t>(status);
+    if (partitions_ != nullptr)
+    {
+        if ((*partitions_)[status_index].Add(document_id, term_freq, allocator_))
+        {
+            ++size_;
+        }
+        return;
+    }
+
+    // Место документа в крошечном списке (по статусу, затем по id)
+    size_t position = 0;
+    while (position < size_ && (tiny_[position].status < status_index
+                                || (tiny_[position].status == status_index && tiny_[position].document_id < document_id)))
+    {
+        ++position;
+    }
+    if (position < size_ && tiny_[position].status == status_index && tiny_[position].document_id == document_id)
+    {
+        tiny_[position].term_freq = term_freq;
+        return;
+    }
+
+    if (size_ < TINY_CAPACITY)
+    {
+        std::move_backward(tiny_.begin() + position, tiny_.begin() + size_, tiny_.begin() + size_ + 1);
+        tiny_[position] = { document_id, status_index, static_cast<TermFreq>(term_freq) };
+        ++size_;
+        return;
+    }
+
+    // Крошечный список заполнен: документы переносятся в разделы
+    partitions_ = CreatePartitions();
+    for (size_t i = 0; i < size_; ++i)
+    {
+        (*partitions_)[tiny_[i].status].Add(tiny_[i].document_id, tiny_[i].term_freq, allocator_);
+    }
+    (*partitions_)[status_index].Add(document_id, term_freq, allocator_);
+    ++size_;
+}
+
+inline void StatusPostings::Erase(int document_id, DocumentStatus status)
+{
+    const uint32_t status_index = static_cast<uint32_t>(status);
+    if (partitions_ == nullptr)
+    {
+        for (size_t position = 0; position < size_; ++position)
+        {
+            if (tiny_[position].status == status_index && tiny_[position].document_id == document_id)
+            {
+                std::move(tiny_.begin() + position + 1, tiny_.begin() + size_, tiny_.begin() + position);
+                --size_;
+                return;
+            }
+        }
+        return;
+    }
+
+    if (!(*partitions_)[status_index].Erase(document_id, allocator_))
+    {
+        return;
+    }
+    --size_;
+
+    // Список стал крошечным с запасом (чтобы не переключаться при каждом изменении на границе):
+    // блок разделов освобождается
+    if (size_ <= TINY_CAPACITY / 2)
+    {
+        size_t position = 0;
+        for (uint32_t partition = 0; partition < DOCUMENT_STATUS_COUNT; ++partition)
+        {
+            (*partitions_)[partition].ForEach([this, &position, partition](int id, TermFreq term_freq)
+                                              {
+                                                  tiny_[position++] = { id, partition, term_freq };
+                                              });
+        }
+        DestroyPartitions();
+    }
+}
+
+// Вызывает function(id документа, частота в lhs, частота в rhs) для документов раздела с заданным статусом,
+// входящих в оба списка, по возрастанию id. Ядро пересечения выбирается по представлениям разделов
+template <typename Function>
+void IntersectPostings(const StatusPostings& lhs, const StatusPostings& rhs, DocumentStatus status, Function function)
+{
+    lhs.VisitPartition(status, [&rhs, status, &function](const auto& lhs_partition)
+                       {
+                           rhs.VisitPartition(status, [&lhs_partition, &function](const auto& rhs_partition)
+                                              {
+                                                  IntersectPartitions(lhs_partition, rhs_partition, function);
+                                              });
+                       });
+}
+
+// Вызывает function(id документа, частота в lhs, частота в rhs) для документов раздела с заданным статусом,
+// входящих хотя бы в один список, по возрастанию id (частота в списке без документа равна 0)
+template <typename Function>
+void UnitePostings(const StatusPostings& lhs, const StatusPostings& rhs, DocumentStatus status, Function function)
+{
+    lhs.VisitPartition(status, [&rhs, status, &function](const auto& lhs_partition)
+                       {
+                           rhs.VisitPartition(status, [&lhs_partition, &function](const auto& rhs_partition)
+                                              {
+                                                  UnitePartitions(lhs_partition, rhs_partition, function);
+                                              });
+                       });
+}
+
+// Элемент списка вкладов: документ и квантованный вклад слова в его релевантность
+struct ImpactPosting
+{
+    int document_id = 0;
+    uint16_t impact = 0;
+};
+
+// Раздел списка вкладов (упорядочен по id документа) с курсором, как у контейнеров posting_containers.h.
+// Значение элемента - вклад
+class ImpactPartitionView
+{
+public:
+    class Cursor
+    {
+    public:
+        Cursor(const ImpactPosting* begin, const ImpactPosting* end)
+            : position_(begin)
+            , end_(end)
+        {
+        }
+
+        bool Valid() const
+        {
+            return position_ != end_;
+        }
+
+        int DocumentId() const
+        {
+            return position_->document_id;
+        }
+
+        uint16_t Value() const
+        {
+            return position_->impact;
+        }
+
+        void Next()
+        {
+            ++position_;
+        }
+
+        void SeekTo(int document_id)
+        {
+            position_ = std::lower_bound(position_, end_, document_id,
+                                         [](const ImpactPosting& posting, int id)
+                                         {
+                                             return posting.document_id < id;
+                                         });
+        }
+
+    private:
+        const ImpactPosting* position_;
+        const ImpactPosting* end_;
+    };
+
+    explicit ImpactPartitionView(const std::vector<ImpactPosting>& partition)
+        : partition_(partition)
+    {
+    }
+
+    size_t size() const
+    {
+        return partition_.size();
+    }
+
+    Cursor GetCursor() const
+    {
+        return Cursor(partition_.data(), partition_.data() + partition_.size());
+    }
+
+private:
+    const std::vector<ImpactPosting>& partition_;
+};
+
+// Предвычисленные вклады слова в релевантность документов (см. SearchServer::BuildImpacts()).
+// Разбиты по статусам документов так же, как StatusPostings; внутри раздела упорядочены по id документа
+class ImpactPostings
+{
+public:
+    using Cursor = ImpactPartitionView::Cursor;
+
+    // Документы раздела должны добавляться по возрастанию id
+    void Add(int document_id, DocumentStatus status, uint16_t impact)
+    {
+        partitions_[static_cast<size_t>(status)].push_back({ document_id, impact });
+        max_impacts_[static_cast<size_t>(status)] = std::max(max_impacts_[static_cast<size_t>(status)], impact);
+        ++size_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+    const std::vector<ImpactPosting>& GetPartition(DocumentStatus status) const
+    {
+        return partitions_[static_cast<size_t>(status)];
+    }
+
+    size_t GetPartitionSize(DocumentStatus status) const
+    {
+        return partitions_[static_cast<size_t>(status)].size();
+    }
+
+    // Наибольший вклад в разделе статуса
+    uint16_t GetMaxImpact(DocumentStatus status) const
+    {
+        return max_impacts_[static_cast<size_t>(status)];
+    }
+
+    Cursor GetCursor(DocumentStatus status) const
+    {
+        return ImpactPartitionView(partitions_[static_cast<size_t>(status)]).GetCursor();
+    }
+
+    size_t GetMemoryUsage() const
+    {
+        size_t result = 0;
+        for (const auto& partition : partitions_)
+        {
+            result += EstimateVectorMemory(partition);
+        }
+        return result;
+    }
+
+    // Вызывает function(ImpactPartitionView) для раздела с заданным статусом (см. StatusPostings::VisitPartition())
+    template <typename Function>
+    void VisitPartition(DocumentStatus status, Function function) const
+    {
+        function(ImpactPartitionView(partitions_[static_cast<size_t>(status)]));
+    }
+
+    // Вызывает function(id документа, вклад) для документов раздела с заданным статусом по возрастанию id
+    template <typename Function>
+    void ForEachInPartition(DocumentStatus status, Function function) const
+    {
+        for (const auto [document_id, impact] : partitions_[static_cast<size_t>(status)])
+        {
+            function(document_id, impact);
+        }
+    }
+
+    // Вызывает function(id документа, вклад) для документов всех разделов
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (const auto& partition : partitions_)
+        {
+            for (const auto [document_id, impact] : partition)
+            {
+                function(document_id, impact);
+            }
+        }
+    }
+
+private:
+    std::array<std::vector<ImpactPosting>, DOCUMENT_STATUS_COUNT> partitions_;
+    std::array<uint16_t, DOCUMENT_STATUS_COUNT> max_impacts_{};
+    size_t size_ = 0;
+};
+
+// Вклады слова, упорядоченные внутри раздела статуса по убыванию вклада (при равенстве - по id документа).
+// Раздел обрабатывается сегментами по SEGMENT_SIZE вкладов: сначала сегменты с наибольшими вкладами,
+// что позволяет прервать обработку в любой момент с наилучшим на этот момент результатом
+class ImpactOrderedPostings
+{
+public:
+    static constexpr size_t SEGMENT_SIZE = 128;
+
+    ImpactOrderedPostings() = default;
+
+    explicit ImpactOrderedPostings(const ImpactPostings& postings)
+    {
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            auto& partition = partitions_[status];
+            partition = postings.GetPartition(static_cast<DocumentStatus>(status));
+            // Исходный раздел упорядочен по id, поэтому устойчивая сортировка сохраняет порядок id при равных вкладах
+            std::stable_sort(partition.begin(), partition.end(),
+                             [](const ImpactPosting& lhs, const ImpactPosting& rhs)
+                             {
+                                 return lhs.impact > rhs.impact;
+                             });
+        }
+    }
+
+    const std::vector<ImpactPosting>& GetPartition(DocumentStatus status) const
+    {
+        return partitions_[static_cast<size_t>(status)];
+    }
+
+    size_t GetMemoryUsage() const
+    {
+        size_t result = 0;
+        for (const auto& partition : partitions_)
+        {
+            result += EstimateVectorMemory(partition);
+        }
+        return result;
+    }
+
+private:
+    std::array<std::vector<ImpactPosting>, DOCUMENT_STATUS_COUNT> partitions_;
+};
@@ -31,6 +31,35 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
     return results;
 }
 
+std::vector<SearchResult> ProcessQueries(const SearchServer& search_server, const std::vector<std::string>& queries,
+                                         const QueryControl& control, std::chrono::steady_clock::duration query_timeout)
+{
+    std::vector<SearchResult> results(queries.size());
+
+    std::transform(std::execution::par,
+                   queries.begin(), queries.end(),
+                   results.begin(),
+                   [&search_server, &control, query_timeout](const std::string& query)
+                   {
+                       // После отмены или истечения срока пакета оставшиеся запросы не выполняются
+                       const QueryStatus status = control.GetStatus();
+                       if (status != QueryStatus::OK)
+                       {
+                           return SearchResult{ {}, status };
+                       }
+
+                       QueryControl query_control = control;
+                       if (query_timeout != std::chrono::steady_clock::duration::max())
+                       {
+                           query_control.deadline = std::min(control.deadline,
+                                                             QueryControl::Clock::now() + query_timeout);
+                       }
+                       return search_server.FindTopDocuments(query, query_control);
+                   });
+
+    return results;
+}
+
 // Время работы вашей функции должно быть по крайней мере вдвое меньше, чем у тривиального решения DefaultProcess
 std::vector<std::vector<Document>> DefaultProcess(const SearchServer& search_server, const std::vector<std::string>& queries)
 {
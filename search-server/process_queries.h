@@ -1,9 +1,11 @@
 #pragma once
 
 #include "document.h"
+#include "query_control.h"
 #include "search_server.h"
 
 #include <vector>
+#include <chrono>
 #include <execution>
 #include <string>
 #include <algorithm>
@@ -16,6 +18,15 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer&,
     const std::vector<std::string>&);
 
+// Версия ProcessQueries() с ограничениями: control.deadline - крайний срок всего пакета,
+// control.token отменяет ещё не завершённые запросы пакета, query_timeout ограничивает каждый запрос.
+// Прерванные и не начатые запросы возвращают состояние TIMED_OUT или CANCELLED
+std::vector<SearchResult> ProcessQueries(
+    const SearchServer&,
+    const std::vector<std::string>&,
+    const QueryControl&,
+    std::chrono::steady_clock::duration query_timeout = std::chrono::steady_clock::duration::max());
+
 std::vector<std::vector<Document>> DefaultProcess(
     const SearchServer&,
     const std::vector<std::string>&);
@@ -0,0 +1,137 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "document.h"
+
+// Состояние выполнения запроса
+enum class QueryStatus
+{
+    OK,
+    TIMED_OUT,      // Истёк крайний срок запроса
+    CANCELLED,      // Запрос отменён через CancellationToken
+};
+
+// Флаг отмены, общий для запроса (или пакета запросов) и управляющего ими кода.
+// Cancel() можно вызывать из любого потока
+class CancellationToken
+{
+public:
+    void Cancel()
+    {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const
+    {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> cancelled_ = false;
+};
+
+// Ограничения выполнения запроса: крайний срок и (необязательный) флаг отмены.
+// Поисковый сервер проверяет их между словами запроса и через каждые CHECK_INTERVAL
+// элементов списков документов. По умолчанию ограничений нет
+struct QueryControl
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t CHECK_INTERVAL = 1024;
+
+    Clock::time_point deadline = Clock::time_point::max();
+    // Флаг отмены принадлежит вызывающему коду и должен существовать до конца запроса
+    const CancellationToken* token = nullptr;
+
+    // Ограничение "не дольше timeout с текущего момента"
+    static QueryControl WithTimeout(Clock::duration timeout, const CancellationToken* token = nullptr)
+    {
+        QueryControl control;
+        control.deadline = Clock::now() + timeout;
+        control.token = token;
+        return control;
+    }
+
+    QueryStatus GetStatus() const
+    {
+        if (token != nullptr && token->IsCancelled())
+        {
+            return QueryStatus::CANCELLED;
+        }
+        if (deadline != Clock::time_point::max() && Clock::now() >= deadline)
+        {
+            return QueryStatus::TIMED_OUT;
+        }
+        return QueryStatus::OK;
+    }
+};
+
+// Исключение, которым прерывается обход индекса при срабатывании QueryControl.
+// Версии FindTopDocuments() с QueryControl перехватывают его и возвращают состояние в SearchResult
+class QueryInterruptedError : public std::runtime_error
+{
+public:
+    explicit QueryInterruptedError(QueryStatus status)
+        : std::runtime_error(status == QueryStatus::CANCELLED ? "Query cancelled" : "Query timed out")
+        , status_(status)
+    {
+    }
+
+    QueryStatus GetStatus() const
+    {
+        return status_;
+    }
+
+private:
+    QueryStatus status_;
+};
+
+// Результат запроса с ограничениями: при status != OK документы не возвращаются
+struct SearchResult
+{
+    std::vector<Document> documents;
+    QueryStatus status = QueryStatus::OK;
+};
+
+// Счётчик обработанных элементов списков: раз в CHECK_INTERVAL элементов проверяет ограничения
+// и прерывает запрос исключением QueryInterruptedError. Без ограничений (nullptr) ничего не проверяет
+class QueryControlChecker
+{
+public:
+    explicit QueryControlChecker(const QueryControl* control)
+        : control_(control)
+    {
+    }
+
+    void Tick()
+    {
+        if (control_ != nullptr && ++count_ == QueryControl::CHECK_INTERVAL)
+        {
+            count_ = 0;
+            Check();
+        }
+    }
+
+    void Check() const
+    {
+        if (control_ == nullptr)
+        {
+            return;
+        }
+        const QueryStatus status = control_->GetStatus();
+        if (status != QueryStatus::OK)
+        {
+            throw QueryInterruptedError(status);
+        }
+    }
+
+private:
+    const QueryControl* control_;
+    size_t count_ = 0;
+};
@@ -0,0 +1,55 @@
+#include "query_plan.h"
+
+#include <cmath>
+
+// Для использования оператора ""s
+using namespace std::string_literals;
+
+
+std::ostream& operator<<(std::ostream& out, QueryStrategy strategy)
+{
+    switch (strategy)
+    {
+    case QueryStrategy::TERM_AT_A_TIME:
+        return out << "TERM_AT_A_TIME"s;
+    case QueryStrategy::MINUS_FIRST:
+        return out << "MINUS_FIRST"s;
+    case QueryStrategy::REQUIRED_INTERSECTION:
+        return out << "REQUIRED_INTERSECTION"s;
+    case QueryStrategy::DOCUMENT_AT_A_TIME:
+        return out << "DOCUMENT_AT_A_TIME"s;
+    case QueryStrategy::BITMAP:
+        return out << "BITMAP"s;
+    }
+    return out;
+}
+
+
+std::ostream& operator<<(std::ostream& out, const QueryPlan& plan)
+{
+    out << "strategy = "s << plan.strategy << '\n';
+    for (const QueryPlanTerm& term : plan.terms)
+    {
+        out << "  "s << (term.role == QueryTermRole::MINUS ? "-"s : term.role == QueryTermRole::REQUIRED ? "+"s : ""s)
+            << term.word << ": df = "s << term.document_freq << (term.is_dense ? ", bitmap"s : ", array"s);
+        if (term.role != QueryTermRole::MINUS)
+        {
+            out << ", max_score = "s << term.max_score;
+        }
+        out << '\n';
+    }
+    out << "costs:"s;
+    for (size_t strategy = 0; strategy < QUERY_STRATEGY_COUNT; ++strategy)
+    {
+        out << ' ' << static_cast<QueryStrategy>(strategy) << " = "s;
+        if (std::isinf(plan.costs[strategy]))
+        {
+            out << "n/a"s;
+        }
+        else
+        {
+            out << plan.costs[strategy];
+        }
+    }
+    return out;
+}
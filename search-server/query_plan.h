@@ -0,0 +1,59 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Способ вычисления запроса, который выбирает планировщик поискового сервера
+enum class QueryStrategy
+{
+    TERM_AT_A_TIME,         // Списки плюс-слов по очереди складываются в накопитель, затем удаляются документы минус-слов
+    MINUS_FIRST,            // Документы минус-слов сначала отмечаются в битовой карте, списки плюс-слов их пропускают
+    REQUIRED_INTERSECTION,  // Пересечение списков обязательных слов от самого редкого, оценка только кандидатов
+    DOCUMENT_AT_A_TIME,     // Курсоры по спискам плюс-слов; документы, которые не попадут в лучшие
+                            // по верхней оценке релевантности, не дооцениваются (MaxScore)
+    BITMAP,                 // Вклады складываются в массив по id документа, найденные документы отмечаются
+                            // в битовой карте; минус-слова снимают отметки, битовые карты плотных списков -
+                            // целыми 64-битными словами
+};
+
+// Количество значений QueryStrategy
+const size_t QUERY_STRATEGY_COUNT = 5;
+
+// Роль слова в запросе
+enum class QueryTermRole
+{
+    PLUS,
+    REQUIRED,
+    MINUS,
+};
+
+// Статистика слова запроса, по которой выбирается стратегия
+struct QueryPlanTerm
+{
+    std::string word;
+    QueryTermRole role = QueryTermRole::PLUS;
+    // Число документов со словом в разделах статусов, которые может пропустить предикат запроса
+    size_t document_freq = 0;
+    // Хотя бы один из этих разделов хранится битовой картой
+    bool is_dense = false;
+    // Верхняя граница вклада слова в релевантность документа (для минус-слов 0)
+    double max_score = 0.0;
+};
+
+// План запроса (SearchServer::ExplainQuery()): выбранная стратегия, слова в порядке обработки
+// (плюс- и обязательные слова по возрастанию числа документов, затем минус-слова) и оценки стоимости
+// стратегий в условных операциях над элементами списков. Неприменимые стратегии имеют бесконечную стоимость
+struct QueryPlan
+{
+    QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+    std::vector<QueryPlanTerm> terms;
+    std::array<double, QUERY_STRATEGY_COUNT> costs{};
+};
+
+std::ostream& operator<<(std::ostream&, QueryStrategy);
+
+std::ostream& operator<<(std::ostream&, const QueryPlan&);
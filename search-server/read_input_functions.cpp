@@ -1,7 +1,17 @@
 #include "read_input_functions.h"
 
 // Локальные #include для корректной работы определений функций
+#include <array>
+#include <cerrno>
+#include <charconv>
 #include <iostream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 // Упрощаем обращения к потокам ввода-вывода
 using namespace std;
@@ -22,3 +32,159 @@ int ReadLineWithNumber()
     ReadLine();
     return result;
 }
+
+
+namespace
+{
+const std::array<std::string_view, DOCUMENT_STATUS_COUNT> STATUS_NAMES = {
+    "ACTUAL"sv, "IRRELEVANT"sv, "BANNED"sv, "REMOVED"sv,
+};
+
+// Отделяет от line поле до табуляции. Возвращает false, если табуляции нет
+bool TakeField(std::string_view& line, std::string_view& field)
+{
+    const size_t tab = line.find('\t');
+    if (tab == std::string_view::npos)
+    {
+        return false;
+    }
+    field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return true;
+}
+
+bool ParseInt(std::string_view text, int& value)
+{
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size() && !text.empty();
+}
+}
+
+
+void ParseDocumentRecord(std::string_view line, int& document_id, DocumentStatus& status,
+                         std::vector<int>& ratings, std::string_view& text)
+{
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    std::string_view id_field;
+    std::string_view status_field;
+    std::string_view ratings_field;
+    if (!TakeField(line, id_field) || !TakeField(line, status_field) || !TakeField(line, ratings_field))
+    {
+        throw std::invalid_argument("Document record must have 4 tab-separated fields"s);
+    }
+    if (!ParseInt(id_field, document_id))
+    {
+        throw std::invalid_argument("Invalid document id in record: "s + std::string(id_field));
+    }
+
+    size_t status_index = 0;
+    while (status_index < STATUS_NAMES.size() && STATUS_NAMES[status_index] != status_field)
+    {
+        ++status_index;
+    }
+    if (status_index == STATUS_NAMES.size())
+    {
+        throw std::invalid_argument("Invalid document status in record: "s + std::string(status_field));
+    }
+    status = static_cast<DocumentStatus>(status_index);
+
+    ratings.clear();
+    while (!ratings_field.empty())
+    {
+        const size_t space = ratings_field.find(' ');
+        const std::string_view rating = ratings_field.substr(0, space);
+        int value = 0;
+        if (!rating.empty())
+        {
+            if (!ParseInt(rating, value))
+            {
+                throw std::invalid_argument("Invalid rating in record: "s + std::string(rating));
+            }
+            ratings.push_back(value);
+        }
+        ratings_field.remove_prefix(space == std::string_view::npos ? ratings_field.size() : space + 1);
+    }
+    text = line;
+}
+
+
+void WriteDocumentRecord(std::ostream& output, int document_id, DocumentStatus status, const std::vector<int>& ratings,
+                         std::string_view text)
+{
+    if (text.find_first_of("\t\n"sv) != std::string_view::npos)
+    {
+        throw std::invalid_argument("Document record text must not contain tabs or line breaks"s);
+    }
+    output << document_id << '\t' << STATUS_NAMES[static_cast<size_t>(status)] << '\t';
+    for (size_t i = 0; i < ratings.size(); ++i)
+    {
+        if (i != 0)
+        {
+            output << ' ';
+        }
+        output << ratings[i];
+    }
+    output << '\t' << text << '\n';
+}
+
+
+bool ReadDocumentRecord(std::istream& input, DocumentRecord& record)
+{
+    // Строка читается прямо в record.text, затем поля перед текстом удаляются из её начала
+    do
+    {
+        if (!std::getline(input, record.text))
+        {
+            return false;
+        }
+    } while (record.text.empty() || record.text == "\r"sv);
+
+    std::string_view text;
+    ParseDocumentRecord(record.text, record.document_id, record.status, record.ratings, text);
+    const size_t text_offset = static_cast<size_t>(text.data() - record.text.data());
+    record.text.resize(text_offset + text.size());
+    record.text.erase(0, text_offset);
+    return true;
+}
+
+
+FileDescriptorBuffer::FileDescriptorBuffer(int fd, size_t buffer_size)
+    : fd_(fd)
+    , buffer_(buffer_size)
+{
+    if (buffer_.empty())
+    {
+        throw std::invalid_argument("Buffer size must be positive"s);
+    }
+    setg(buffer_.data(), buffer_.data(), buffer_.data());
+}
+
+
+FileDescriptorBuffer::int_type FileDescriptorBuffer::underflow()
+{
+    if (gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+    while (true)
+    {
+#ifdef _WIN32
+        const int count = _read(fd_, buffer_.data(), static_cast<unsigned>(buffer_.size()));
+#else
+        const ssize_t count = read(fd_, buffer_.data(), buffer_.size());
+#endif
+        if (count > 0)
+        {
+            setg(buffer_.data(), buffer_.data(), buffer_.data() + count);
+            return traits_type::to_int_type(*gptr());
+        }
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return traits_type::eof();
+    }
+}
@@ -1,7 +1,58 @@
 #pragma once
 
 // #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <streambuf>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
 
 std::string ReadLine();
 int ReadLineWithNumber();
+
+// Запись документа во входном потоке - одна строка из четырёх полей, разделённых табуляцией:
+//     id <TAB> статус <TAB> рейтинги через пробел <TAB> текст
+// Статус - имя значения DocumentStatus (ACTUAL, IRRELEVANT, BANNED, REMOVED), список рейтингов может быть пустым.
+// Пример: "17\tACTUAL\t5 -2 3\tпушистый кот пушистый хвост"
+struct DocumentRecord
+{
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// Разбирает строку записи (без перевода строки; завершающий '\r' отбрасывается). Текст - часть строки line.
+// Для некорректной записи выбрасывает std::invalid_argument
+void ParseDocumentRecord(std::string_view line, int& document_id, DocumentStatus& status,
+                         std::vector<int>& ratings, std::string_view& text);
+
+// Записывает запись в поток в формате DocumentRecord. Текст с табуляцией или переводом строки
+// не помещается в запись: выбрасывается std::invalid_argument
+void WriteDocumentRecord(std::ostream&, int document_id, DocumentStatus, const std::vector<int>& ratings,
+                         std::string_view text);
+
+// Читает очередную запись, пропуская пустые строки. Возвращает false в конце потока.
+// Для некорректной записи выбрасывает std::invalid_argument; поток при этом стоит на следующей строке
+bool ReadDocumentRecord(std::istream&, DocumentRecord&);
+
+// Буфер потока, читающий из файлового дескриптора (канала, сокета, файла) крупными блоками:
+//     FileDescriptorBuffer buffer(fd);
+//     std::istream input(&buffer);
+// Дескриптор не закрывается. Ошибка чтения воспринимается как конец потока
+class FileDescriptorBuffer : public std::streambuf
+{
+public:
+    explicit FileDescriptorBuffer(int fd, size_t buffer_size = 1 << 16);
+
+protected:
+    int_type underflow() override;
+
+private:
+    int fd_;
+    std::vector<char> buffer_;
+};
@@ -0,0 +1,7 @@
+#include "remove_duplicates.h"
+
+
+void RemoveDuplicates(SearchServer& search_server, DuplicateMode mode, double threshold)
+{
+    RemoveDuplicates(std::execution::seq, search_server, mode, threshold);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <iostream>
+
+#include "search_server.h"
+#include "duplicate_detector.h"
+
+// Функция удаляет из поискового сервера документы-дубликаты, оставляя в каждой группе документ с наименьшим id.
+// О каждом удалённом документе выводится сообщение в std::cout
+void RemoveDuplicates(SearchServer&, DuplicateMode mode = DuplicateMode::EXACT, double threshold = 1.0);
+
+// Версия RemoveDuplicates() с поддержкой параллельного поиска дубликатов
+template <class ExecutionPolicy>
+void RemoveDuplicates(ExecutionPolicy&& policy, SearchServer& search_server,
+                      DuplicateMode mode = DuplicateMode::EXACT, double threshold = 1.0)
+{
+    using namespace std::string_literals;
+
+    for (int document_id : search_server.FindDuplicates(policy, mode, threshold))
+    {
+        std::cout << "Found duplicate document id "s << document_id << std::endl;
+        search_server.RemoveDocument(document_id);
+    }
+}
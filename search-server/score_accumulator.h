@@ -0,0 +1,269 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Накопитель релевантности "id документа - сумма вкладов слов запроса" для однопоточного поиска.
+// Открытая адресация с линейным пробированием; Clear() сбрасывает только занятые ячейки
+// и сохраняет выделенную память, поэтому повторное использование не обращается к аллокатору.
+// Обход идёт в порядке первого обращения к документам.
+// Score - тип суммы: double для вещественных оценок, целый тип для квантованных вкладов.
+// Память выделяется из переданного ресурса (например, арены запроса)
+template <typename Score>
+class BasicScoreAccumulator
+{
+public:
+    explicit BasicScoreAccumulator(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : table_(resource)
+        , entries_(resource)
+    {
+    }
+
+    struct Entry
+    {
+        int document_id;
+        Score score;
+        bool erased;
+        uint32_t slot;
+    };
+
+    // Возвращает ссылку на сумму для документа (0 для нового или удалённого документа)
+    Score& operator[](int document_id)
+    {
+        if ((entries_.size() + 1) * 2 > table_.size())
+        {
+            Grow();
+        }
+
+        uint32_t slot = FindSlot(document_id);
+        if (table_[slot] == EMPTY)
+        {
+            table_[slot] = static_cast<int32_t>(entries_.size());
+            entries_.push_back({ document_id, Score{}, false, slot });
+            return entries_.back().score;
+        }
+
+        Entry& entry = entries_[table_[slot]];
+        if (entry.erased)
+        {
+            entry.erased = false;
+            entry.score = Score{};
+        }
+        return entry.score;
+    }
+
+    // Исключает документ из результата (ячейка остаётся занятой до Clear())
+    void Erase(int document_id)
+    {
+        if (table_.empty())
+        {
+            return;
+        }
+        const uint32_t slot = FindSlot(document_id);
+        if (table_[slot] != EMPTY)
+        {
+            entries_[table_[slot]].erased = true;
+        }
+    }
+
+    bool Contains(int document_id) const
+    {
+        if (table_.empty())
+        {
+            return false;
+        }
+        const uint32_t slot = FindSlot(document_id);
+        return table_[slot] != EMPTY && !entries_[table_[slot]].erased;
+    }
+
+    void Clear()
+    {
+        for (const Entry& entry : entries_)
+        {
+            table_[entry.slot] = EMPTY;
+        }
+        entries_.clear();
+    }
+
+    // Вызывает function(id документа, сумма) для всех неудалённых документов
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (const Entry& entry : entries_)
+        {
+            if (!entry.erased)
+            {
+                function(entry.document_id, entry.score);
+            }
+        }
+    }
+
+    // Вызывает predicate(id документа) и удаляет документы, для которых он вернул false
+    template <typename Predicate>
+    void EraseIfNot(Predicate predicate)
+    {
+        for (Entry& entry : entries_)
+        {
+            if (!entry.erased && !predicate(entry.document_id))
+            {
+                entry.erased = true;
+            }
+        }
+    }
+
+private:
+    static constexpr int32_t EMPTY = -1;
+    static constexpr size_t MIN_TABLE_SIZE = 64;
+
+    std::pmr::vector<int32_t> table_;    // Индексы в entries_ или EMPTY, размер - степень двойки
+    std::pmr::vector<Entry> entries_;
+
+    uint32_t FindSlot(int document_id) const
+    {
+        const uint32_t mask = static_cast<uint32_t>(table_.size() - 1);
+        // Мультипликативное хеширование: последовательные id не попадают в соседние ячейки
+        uint32_t slot = (static_cast<uint32_t>(document_id) * 2654435761u) & mask;
+        while (table_[slot] != EMPTY && entries_[table_[slot]].document_id != document_id)
+        {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void Grow()
+    {
+        table_.assign(table_.empty() ? MIN_TABLE_SIZE : table_.size() * 2, EMPTY);
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            const uint32_t slot = FindSlot(entries_[i].document_id);
+            table_[slot] = static_cast<int32_t>(i);
+            entries_[i].slot = slot;
+        }
+    }
+};
+
+using ScoreAccumulator = BasicScoreAccumulator<double>;
+using ImpactAccumulator = BasicScoreAccumulator<uint64_t>;
+
+// Плотный накопитель для стратегии BITMAP: суммы в массиве по id документа и битовая карта
+// документов, получивших хотя бы один вклад. Сумма документа обнуляется при первой отметке, поэтому
+// массив сумм не очищается между запросами; Reset() очищает только битовую карту (id / 64 слов).
+// Обход идёт по возрастанию id. Интерфейс совпадает с BasicScoreAccumulator
+template <typename Score>
+class DenseScoreAccumulator
+{
+public:
+    explicit DenseScoreAccumulator(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : scores_(resource)
+        , matched_(resource)
+    {
+    }
+
+    // Готовит накопитель к документам с id из [0, document_bound)
+    void Reset(size_t document_bound)
+    {
+        if (scores_.size() < document_bound)
+        {
+            scores_.resize(document_bound);
+        }
+        matched_.assign((document_bound + 63) / 64, 0);
+    }
+
+    Score& operator[](int document_id)
+    {
+        uint64_t& word = matched_[document_id / 64];
+        const uint64_t bit = uint64_t{ 1 } << (document_id % 64);
+        if ((word & bit) == 0)
+        {
+            word |= bit;
+            scores_[document_id] = Score{};
+        }
+        return scores_[document_id];
+    }
+
+    void Erase(int document_id)
+    {
+        if (static_cast<size_t>(document_id / 64) < matched_.size())
+        {
+            matched_[document_id / 64] &= ~(uint64_t{ 1 } << (document_id % 64));
+        }
+    }
+
+    // Исключает документы, отмеченные в bits: count слов, первое соответствует id first_word * 64
+    void EraseWords(size_t first_word, const uint64_t* bits, size_t count)
+    {
+        if (first_word >= matched_.size())
+        {
+            return;
+        }
+        count = std::min(count, matched_.size() - first_word);
+        for (size_t i = 0; i < count; ++i)
+        {
+            matched_[first_word + i] &= ~bits[i];
+        }
+    }
+
+    bool Contains(int document_id) const
+    {
+        return static_cast<size_t>(document_id / 64) < matched_.size()
+            && ((matched_[document_id / 64] >> (document_id % 64)) & 1) != 0;
+    }
+
+    void Clear()
+    {
+        std::fill(matched_.begin(), matched_.end(), 0);
+    }
+
+    template <typename Function>
+    void ForEach(Function function) const
+    {
+        for (size_t word_index = 0; word_index < matched_.size(); ++word_index)
+        {
+            for (uint64_t word = matched_[word_index]; word != 0; word &= word - 1)
+            {
+                const int document_id = static_cast<int>(word_index * 64 + CountTrailingZeros(word));
+                function(document_id, scores_[document_id]);
+            }
+        }
+    }
+
+    template <typename Predicate>
+    void EraseIfNot(Predicate predicate)
+    {
+        for (size_t word_index = 0; word_index < matched_.size(); ++word_index)
+        {
+            for (uint64_t word = matched_[word_index]; word != 0; word &= word - 1)
+            {
+                const int bit = CountTrailingZeros(word);
+                if (!predicate(static_cast<int>(word_index * 64 + bit)))
+                {
+                    matched_[word_index] &= ~(uint64_t{ 1 } << bit);
+                }
+            }
+        }
+    }
+
+private:
+    std::pmr::vector<Score> scores_;
+    std::pmr::vector<uint64_t> matched_;
+
+    static int CountTrailingZeros(uint64_t word)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(word);
+#else
+        int result = 0;
+        while ((word & 1) == 0)
+        {
+            word >>= 1;
+            ++result;
+        }
+        return result;
+#endif
+    }
+};
+
+using DenseRelevanceAccumulator = DenseScoreAccumulator<double>;
+using DenseImpactAccumulator = DenseScoreAccumulator<uint64_t>;
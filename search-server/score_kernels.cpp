@@ -0,0 +1,39 @@
+#include "score_kernels.h"
+
+
+void ComputeTfIdfScores(const TermFreq* term_freqs, size_t count, double idf, double* scores)
+{
+    size_t i = 0;
+    for (; i + SCORE_KERNEL_LANES <= count; i += SCORE_KERNEL_LANES)
+    {
+        scores[i] = static_cast<double>(term_freqs[i]) * idf;
+        scores[i + 1] = static_cast<double>(term_freqs[i + 1]) * idf;
+        scores[i + 2] = static_cast<double>(term_freqs[i + 2]) * idf;
+        scores[i + 3] = static_cast<double>(term_freqs[i + 3]) * idf;
+    }
+    for (; i < count; ++i)
+    {
+        scores[i] = static_cast<double>(term_freqs[i]) * idf;
+    }
+}
+
+
+void ComputeBm25Scores(const TermFreq* term_freqs, const int32_t* word_counts, size_t count, double idf,
+                       const Bm25Parameters& parameters, double* scores)
+{
+    // Параметры копируются в локальную переменную: запись в scores не может их изменить,
+    // и компилятору не нужно перечитывать их на каждой итерации
+    const Bm25Parameters local = parameters;
+    size_t i = 0;
+    for (; i + SCORE_KERNEL_LANES <= count; i += SCORE_KERNEL_LANES)
+    {
+        scores[i] = ComputeBm25Score(idf, term_freqs[i], word_counts[i], local);
+        scores[i + 1] = ComputeBm25Score(idf, term_freqs[i + 1], word_counts[i + 1], local);
+        scores[i + 2] = ComputeBm25Score(idf, term_freqs[i + 2], word_counts[i + 2], local);
+        scores[i + 3] = ComputeBm25Score(idf, term_freqs[i + 3], word_counts[i + 3], local);
+    }
+    for (; i < count; ++i)
+    {
+        scores[i] = ComputeBm25Score(idf, term_freqs[i], word_counts[i], local);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <cstddef>
+#include <cstdint>
+
+#include "document.h"
+
+// Ядра вычисления вкладов слова в релевантность для блока документов списка (ForEachBlock(), posting_containers.h).
+// Частоты блока лежат подряд, поэтому вклады считаются циклами без ветвлений и вызовов: тело цикла
+// обрабатывает по SCORE_KERNEL_LANES документов, и компилятор собирает их в векторные инструкции
+// уже при -O2. Результаты побитово совпадают с вычислением для одного документа
+
+// Число документов, обрабатываемых одной итерацией ядра
+const size_t SCORE_KERNEL_LANES = 4;
+
+struct Bm25Parameters
+{
+    double k1 = 1.2;
+    double b = 0.75;
+    double average_word_count = 0.0;
+};
+
+// Вклад слова по BM25: term_freq - доля слова среди слов документа, word_count - длина документа
+inline double ComputeBm25Score(double idf, double term_freq, double word_count, const Bm25Parameters& parameters)
+{
+    const double count = term_freq * word_count;
+    const double k1 = parameters.k1;
+    const double b = parameters.b;
+    return idf * count * (k1 + 1.0) / (count + k1 * (1.0 - b + b * word_count / parameters.average_word_count));
+}
+
+// scores[i] = term_freqs[i] * idf
+void ComputeTfIdfScores(const TermFreq* term_freqs, size_t count, double idf, double* scores);
+
+// scores[i] = ComputeBm25Score(idf, term_freqs[i], word_counts[i], parameters)
+void ComputeBm25Scores(const TermFreq* term_freqs, const int32_t* word_counts, size_t count, double idf,
+                       const Bm25Parameters& parameters, double* scores);
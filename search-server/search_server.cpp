@@ -1,6 +1,8 @@
 #include <cmath>
 #include <numeric>
+#include <limits>
 #include <algorithm>
+#include <charconv>
 
 #include "string_processing.h"
 #include "search_server.h"
@@ -8,47 +10,171 @@
 //#include "log_duration.h"
 
 
-SearchServer::SearchServer(const std::string& stop_words_text)  // Invoke delegating constructor
-    : SearchServer(SplitIntoWordsView(stop_words_text))             // from string container
+SearchServer::SearchServer(const std::string& stop_words_text, const IndexOptions& options)  // Invoke delegating constructor
+    : SearchServer(SplitIntoWordsView(stop_words_text), options)                            // from string container
 {}
 
 
-SearchServer::SearchServer(const std::string_view stop_words_view)  // Invoke delegating constructor
-    : SearchServer(SplitIntoWordsView(stop_words_view))           // from string container
+SearchServer::SearchServer(const std::string_view stop_words_view, const IndexOptions& options)  // Invoke delegating constructor
+    : SearchServer(SplitIntoWordsView(stop_words_view), options)                              // from string container
 {}
 
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
                                const std::vector<int>& ratings)
+{
+    AddPreparedDocument(PrepareDocument(document_id, document, status, ratings));
+}
+
+
+SearchServer::PreparedDocument SearchServer::PrepareDocument(int document_id, std::string_view document,
+                                                             DocumentStatus status,
+                                                             const std::vector<int>& ratings,
+                                                             std::shared_ptr<const void> text_owner) const
 {
     using namespace std::string_literals;
 
-    if ((document_id < 0) || (documents_.count(document_id) > 0))
+    if (document_id < 0)
     {
         throw std::invalid_argument("Invalid document_id"s);
     }
 
-    const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, std::string(document) });
-    const auto words = SplitIntoWordsNoStop(it->second.doc_text);
+    METRICS_TIMER("ingest.prepare_document");
+
+    PreparedDocument prepared(document_id, status, ComputeAverageRating(ratings), index_resource_);
+    if (text_owner)
+    {
+        prepared.external_text = document;
+        prepared.text_owner = std::move(text_owner);
+    }
+    else
+    {
+        prepared.text.assign(document);
+    }
+
+    // Слова индексируются в нижнем регистре. Приведение не меняет длину текста, поэтому копия
+    // создаётся только для текста с заглавными буквами
+    if (HasUpperCase(prepared.GetText()))
+    {
+        prepared.folded_text.assign(prepared.GetText());
+        FoldCase(prepared.folded_text.data(), prepared.folded_text.size());
+    }
+    const std::string_view term_text = prepared.GetTermText();
+    const auto words = SplitIntoWordsNoStop(term_text);
+    prepared.word_count = words.size();
+
+    // Группируем одинаковые слова: сортируем номера слов по самим словам
+    std::vector<uint32_t> order(words.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(),
+              [&words](uint32_t lhs, uint32_t rhs)
+              {
+                  return words[lhs] < words[rhs];
+              });
+
+    if (options_.positional_index)
+    {
+        prepared.sequence.resize(words.size());
+    }
+    for (uint32_t index : order)
+    {
+        const std::string_view word = words[index];
+        if (prepared.terms.empty() || prepared.GetTerm(prepared.terms.back()) != word)
+        {
+            prepared.terms.push_back({ static_cast<uint32_t>(word.data() - term_text.data()),
+                                       static_cast<uint32_t>(word.size()), 0 });
+        }
+        ++prepared.terms.back().count;
+        if (options_.positional_index)
+        {
+            prepared.sequence[index] = static_cast<uint32_t>(prepared.terms.size() - 1);
+        }
+    }
+    return prepared;
+}
+
+
+void SearchServer::AddPreparedDocument(PreparedDocument&& prepared)
+{
+    // Документ, не прошедший проверку (в том числе не помещающийся в бюджет памяти), не оставляет следов в индексе
+    CheckPreparedDocument(prepared);
+    const int document_id = prepared.document_id;
+
+    METRICS_TIMER("ingest.add_document");
+    METRICS_COUNTER_ADD("ingest.documents", 1);
+
+    // Учитывается фактический прирост памяти затронутых структур: рост массивов по ёмкости и новые страницы
+    // столбцов не совпадают с оценкой, по которой документ проверялся на бюджет
+    size_t previous_memory = GetSharedMemory();
+    const auto [it, inserted] = documents_.emplace(document_id, std::move(prepared.text));
+    if (prepared.text_owner)
+    {
+        it->second.external_text = prepared.external_text;
+        if (std::find(text_owners_.begin(), text_owners_.end(), prepared.text_owner) == text_owners_.end())
+        {
+            text_owners_.push_back(std::move(prepared.text_owner));
+        }
+    }
+    // Слова ссылаются на сохранённую копию текста (внешний текст) или на текст в нижнем регистре
+    const std::string_view term_text = prepared.folded_text.empty() ? it->second.GetText()
+                                                                    : std::string_view(prepared.folded_text);
+    attributes_.Add(document_id, prepared.rating, prepared.status, static_cast<int>(prepared.word_count));
+    total_word_count_ += prepared.word_count;
+
+    std::vector<int> term_ids;
+    term_ids.reserve(prepared.terms.size());
+    for (const PreparedDocument::Term& term : prepared.terms)
+    {
+        term_ids.push_back(dictionary_.Insert(term_text.substr(term.offset, term.length)));
+    }
+    word_to_document_freqs_.resize(dictionary_.GetIdBound());
+
+    // Прямой индекс документа: плоский массив (id слова, частота), отсортированный по id слова
+    const double inv_word_count = 1.0 / prepared.word_count;
+    auto& document_words = document_to_words_[document_id];
+    document_words.reserve(prepared.terms.size());
+    for (size_t i = 0; i < prepared.terms.size(); ++i)
+    {
+        document_words.push_back({ term_ids[i], static_cast<TermFreq>(prepared.terms[i].count * inv_word_count) });
+    }
+    std::sort(document_words.begin(), document_words.end(),
+              [](const WordFrequency& lhs, const WordFrequency& rhs)
+              {
+                  return lhs.word_id < rhs.word_id;
+              });
+
+    previous_memory += GetPostingsMemory(document_words);
+    std::vector<int> unique_word_ids;
+    unique_word_ids.reserve(document_words.size());
+    for (const auto [word_id, term_freq] : document_words)
+    {
+        word_to_document_freqs_[word_id].Add(document_id, prepared.status, term_freq);
+        unique_word_ids.push_back(word_id);
+    }
 
-    const double inv_word_count = 1.0 / words.size();
-    for (std::string_view word : words)
+    // Множество слов документа для подсистемы поиска дубликатов
+    duplicate_detector_.AddDocument(document_id, unique_word_ids);
+
+    if (options_.positional_index)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        // Заполняем дополнительный словарь для подсистемы поиска дубликатов (кэш подсистемы)
-        document_to_words_[document_id][word] = word_to_document_freqs_[word][document_id];
+        word_to_document_positions_.resize(dictionary_.GetIdBound());
+        // Позиция слова - его номер среди слов документа без учёта стоп-слов
+        for (size_t position = 0; position < prepared.sequence.size(); ++position)
+        {
+            word_to_document_positions_[term_ids[prepared.sequence[position]]][document_id]
+                .Add(static_cast<uint32_t>(position));
+        }
     }
     document_ids_.push_back(document_id);
+    estimated_memory_ += GetDocumentMemory(document_id) + GetPostingsMemory(document_words) + GetSharedMemory()
+        - previous_memory;
+    ++index_version_;
 }
 
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const
 {
-    return FindTopDocuments(std::execution::seq,
-                            raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                            {
-                                return document_status == status;
-                            });
+    return FindTopDocuments(std::execution::seq, raw_query, DocumentStatusFilter{ status });
 }
 
 
@@ -58,6 +184,71 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
 }
 
 
+void SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query, DocumentStatus status,
+                                    std::vector<Document>& result) const
+{
+    FindTopDocuments(context, raw_query, DocumentStatusFilter{ status }, result);
+}
+
+
+void SearchServer::FindTopDocuments(QueryContext& context, std::string_view raw_query,
+                                    std::vector<Document>& result) const
+{
+    FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL, result);
+}
+
+
+SearchResult SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+                                            const QueryControl& control) const
+{
+    return FindTopDocuments(raw_query, DocumentStatusFilter{ status }, control);
+}
+
+
+SearchResult SearchServer::FindTopDocuments(std::string_view raw_query, const QueryControl& control) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL, control);
+}
+
+
+ResultPage SearchServer::FindTopDocumentsAfter(std::string_view raw_query, DocumentStatus status,
+                                               const SearchCursor& after, size_t page_size) const
+{
+    return FindTopDocumentsAfter(raw_query, DocumentStatusFilter{ status }, after, page_size);
+}
+
+
+ResultPage SearchServer::FindTopDocumentsAfter(std::string_view raw_query, const SearchCursor& after, size_t page_size) const
+{
+    return FindTopDocumentsAfter(raw_query, DocumentStatus::ACTUAL, after, page_size);
+}
+
+
+AnytimeResult SearchServer::FindTopDocumentsAnytime(std::string_view raw_query, DocumentStatus status,
+                                                    const SearchBudget& budget) const
+{
+    return FindTopDocumentsAnytime(raw_query, DocumentStatusFilter{ status }, budget);
+}
+
+
+AnytimeResult SearchServer::FindTopDocumentsAnytime(std::string_view raw_query, const SearchBudget& budget) const
+{
+    return FindTopDocumentsAnytime(raw_query, DocumentStatus::ACTUAL, budget);
+}
+
+
+QueryPlan SearchServer::ExplainQuery(std::string_view raw_query, DocumentStatus status) const
+{
+    return ExplainQuery(raw_query, DocumentStatusFilter{ status });
+}
+
+
+QueryPlan SearchServer::ExplainQuery(std::string_view raw_query) const
+{
+    return ExplainQuery(raw_query, DocumentStatus::ACTUAL);
+}
+
+
 int SearchServer::GetDocumentCount() const
 {
     return documents_.size();
@@ -70,13 +261,13 @@ int SearchServer::GetDocumentId(int index) const
 }
 
 
-std::vector<int>::const_iterator SearchServer::begin()
+std::pmr::vector<int>::const_iterator SearchServer::begin() const
 {
     return document_ids_.cbegin();
 }
 
 
-std::vector<int>::const_iterator SearchServer::end()
+std::pmr::vector<int>::const_iterator SearchServer::end() const
 {
     return document_ids_.cend();
 }
@@ -94,99 +285,418 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
     // MatchDocument() без политики - вызываем последовательную версию
     const auto query = ParseQuery(std::execution::seq, raw_query);
 
+    return MatchParsedQuery(query, ResolveQueryWords(query), document_id);
+}
+
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument([[maybe_unused]] std::execution::sequenced_policy policy,
+                                                                                      std::string_view raw_query,
+                                                                                      int document_id)
+{
+    // Тело метода дублирует код метода без политик выполнения
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument([[maybe_unused]] std::execution::parallel_policy policy,
+                                                                                      std::string_view raw_query,
+                                                                                      int document_id)
+{
+    // Матчинг одного документа - слияние двух коротких отсортированных списков,
+    // распараллеливать здесь нечего. Параллельная версия для многих документов - MatchDocuments()
+    return SearchServer::MatchDocument(raw_query, document_id);
+}
+
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchParsedQuery(const Query& query,
+                                                                                         const QueryWordIds& word_ids,
+                                                                                         int document_id) const
+{
+    // id слов запроса и прямой индекс документа отсортированы, поэтому проверки - слияние двух списков
+    const auto& document_words = document_to_words_.at(document_id);
+    const DocumentStatus status = attributes_.GetStatus(document_id);
+
     // Сначала проверим минус-слова.
-    for (std::string_view word : query.minus_words)
+    bool has_minus_word = false;
+    ForEachCommonWord(word_ids.minus, document_words,
+                      [&has_minus_word](int)
+                      {
+                          has_minus_word = true;
+                      });
+    if (has_minus_word)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        // Минус-слово из запроса есть в документе. Выходим с пустым результатом.
+        return { std::vector<std::string_view>{}, status };
+    }
+
+    // Документ должен содержать все обязательные слова. Неизвестное серверу обязательное слово
+    // не содержит ни один документ: оно не попадает в word_ids.required, и счётчики не совпадут
+    size_t required_count = 0;
+    ForEachCommonWord(word_ids.required, document_words,
+                      [&required_count](int)
+                      {
+                          ++required_count;
+                      });
+    if (required_count != query.required_words.size())
+    {
+        return { std::vector<std::string_view>{}, status };
+    }
+
+    // Документ, не содержащий фразу или пару слов NEAR из запроса, не подходит под запрос
+    for (const auto& clause : query.positional_clauses)
+    {
+        if (!MatchesPositionalClause(clause, document_id))
         {
-            // Минус-слово из запроса есть в документе. Выходим с пустым результатом.
-            return { {}, documents_.at(document_id).status };
+            return { std::vector<std::string_view>{}, status };
         }
     }
 
+    // Слова словаря сервера переживают строку запроса
     std::vector<std::string_view> matched_words;
+    ForEachCommonWord(word_ids.plus, document_words,
+                      [this, &matched_words](int word_id)
+                      {
+                          matched_words.push_back(dictionary_.GetTerm(word_id));
+                      });
+    std::sort(matched_words.begin(), matched_words.end());
+
+    return { matched_words, status };
+}
 
-    for (std::string_view word : query.plus_words)
+
+SearchServer::QueryWordIds SearchServer::ResolveQueryWords(const Query& query) const
+{
+    QueryWordIds result;
+    const auto resolve = [this](const std::pmr::vector<std::string_view>& words, std::vector<int>& word_ids)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        word_ids.reserve(words.size());
+        for (std::string_view word : words)
         {
-            continue;
+            const int word_id = dictionary_.Find(word);
+            if (word_id != TermDictionary::NOT_FOUND)
+            {
+                word_ids.push_back(word_id);
+            }
         }
-        if (word_to_document_freqs_.at(word).count(document_id))
+        std::sort(word_ids.begin(), word_ids.end());
+        word_ids.erase(std::unique(word_ids.begin(), word_ids.end()), word_ids.end());
+    };
+    resolve(query.plus_words, result.plus);
+    resolve(query.minus_words, result.minus);
+    resolve(query.required_words, result.required);
+
+    return result;
+}
+
+
+bool SearchServer::ResolveRequiredPostings(const Query& query, RequiredMatchBuffers& buffers) const
+{
+    buffers.postings.clear();
+    for (std::string_view word : query.required_words)
+    {
+        const int word_id = dictionary_.Find(word);
+        if (word_id == TermDictionary::NOT_FOUND)
         {
-            matched_words.push_back(word);
+            return false;
         }
+        buffers.postings.push_back(&word_to_document_freqs_[word_id]);
     }
-
-    return { std::vector<std::string_view>(matched_words.begin(), matched_words.end()), documents_.at(document_id).status };
+    // Пересечение начинается с самого редкого слова: кандидатов не больше, чем документов в его списке
+    std::sort(buffers.postings.begin(), buffers.postings.end(),
+              [](const StatusPostings* lhs, const StatusPostings* rhs)
+              {
+                  return lhs->size() < rhs->size();
+              });
+    return true;
 }
 
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument([[maybe_unused]] std::execution::sequenced_policy policy,
-                                                                                      std::string_view raw_query,
-                                                                                      int document_id)
+namespace
 {
-    // Тело метода дублирует код метода без политик выполнения
-    return SearchServer::MatchDocument(raw_query, document_id);
+// Стоимость операций над элементами списков в оценках планировщика (единица - добавление документа
+// в хеш-накопитель с последующим отбором лучших). Стоимости сверены со временем запросов разных видов
+// с принудительной стратегией (QueryContext::SetStrategy()) на корпусах benchmark/ из 10000 и 100000
+// документов: выбранная стратегия была самой быстрой или медленнее самой быстрой не больше чем на 10%
+const double ACCUMULATE_COST = 1.0;
+const double ERASE_COST = 1.0;
+// Вызов произвольного предиката и ожидаемая доля документов, которые он пропускает
+const double PREDICATE_COST = 0.2;
+const double PREDICATE_SELECTIVITY = 0.5;
+// Установка или проверка бита битовой карты исключений
+const double BITMAP_COST = 0.1;
+// Очистка 64-битного слова битовой карты исключений
+const double BITMAP_CLEAR_COST = 0.02;
+// Шаг курсора по списку
+const double CURSOR_COST = 0.2;
+// Поиск документа в списке курсором (галопирующий поиск или проверка битовой карты)
+const double SEEK_COST = 0.5;
+// Вычисление вклада слова в документ по курсору
+const double SCORE_COST = 0.2;
+// Добавление вклада в массив по id документа с отметкой в битовой карте (BITMAP)
+const double DENSE_ACCUMULATE_COST = 0.7;
+// Наибольшее отношение диапазона id к числу документов, при котором строится массив сумм по id (BITMAP)
+const size_t DENSE_ID_RANGE_RATIO = 4;
+// Ожидаемый порог вхождения в лучшие документы - доля наибольшей границы вклада слова
+// среди слов, у которых документов не меньше, чем нужно лучших
+const double THRESHOLD_RATIO = 0.75;
 }
 
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy policy,
-                                                                                      std::string_view raw_query,
-                                                                                      int document_id)
+void SearchServer::PlanQuery(const Query& query, const PredicateScope& scope, size_t result_count,
+                             ExecutionPlan& plan) const
 {
-    using namespace std::string_literals;
-    if (!documents_.count(document_id))
+    plan.plus_terms.clear();
+    plan.minus_terms.clear();
+    plan.costs.fill(std::numeric_limits<double>::infinity());
+
+    const double average_word_count = GetAverageWordCount();
+    const double score_step = HasCurrentImpacts() ? impact_step_ : 1.0;
+    const auto make_term = [&](std::string_view word, int word_id, QueryTermRole role)
     {
-        throw std::out_of_range("Invalid document_id"s);
+        PlannedTerm term{ word_id, word, role };
+        const StatusPostings& postings = word_to_document_freqs_[word_id];
+        const double inverse_document_freq = role == QueryTermRole::MINUS
+            ? 0.0
+            : ComputeWordInverseDocumentFreq(word_id);
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            const size_t partition_size = postings.GetPartitionSize(static_cast<DocumentStatus>(status));
+            if (!scope.statuses[status] || partition_size == 0)
+            {
+                continue;
+            }
+            term.document_freq += partition_size;
+            term.is_dense = term.is_dense || postings.IsPartitionDense(static_cast<DocumentStatus>(status));
+            if (role != QueryTermRole::MINUS)
+            {
+                term.max_score = std::max(term.max_score,
+                                          GetTermScoreBound(word_id, static_cast<DocumentStatus>(status),
+                                                            inverse_document_freq, average_word_count) * score_step);
+            }
+        }
+        return term;
+    };
+
+    // Слова запроса со статистикой списков. Неизвестное обязательное слово означает пустой результат
+    bool has_unknown_required = false;
+    for (std::string_view word : query.plus_words)
+    {
+        const bool is_required = std::binary_search(query.required_words.begin(), query.required_words.end(), word);
+        const int word_id = dictionary_.Find(word);
+        if (word_id == TermDictionary::NOT_FOUND)
+        {
+            has_unknown_required = has_unknown_required || is_required;
+            continue;
+        }
+        plan.plus_terms.push_back(make_term(word, word_id, is_required ? QueryTermRole::REQUIRED : QueryTermRole::PLUS));
+    }
+    std::stable_sort(plan.plus_terms.begin(), plan.plus_terms.end(),
+                     [](const PlannedTerm& lhs, const PlannedTerm& rhs)
+                     {
+                         return lhs.document_freq < rhs.document_freq;
+                     });
+    for (std::string_view word : query.minus_words)
+    {
+        const int word_id = dictionary_.Find(word);
+        if (word_id != TermDictionary::NOT_FOUND)
+        {
+            plan.minus_terms.push_back(make_term(word, word_id, QueryTermRole::MINUS));
+        }
+    }
+
+    const double document_count = std::max(GetDocumentCount(), 1);
+    const double predicate_cost = scope.is_arbitrary ? PREDICATE_COST : 0.0;
+    // Доля элементов списков, которые дойдут до накопителя после предиката
+    const double accumulate_fraction = scope.is_arbitrary ? PREDICATE_SELECTIVITY : 1.0;
+    double plus_postings = 0.0;
+    double required_postings = 0.0;
+    for (const PlannedTerm& term : plan.plus_terms)
+    {
+        plus_postings += term.document_freq;
+        if (term.role == QueryTermRole::REQUIRED)
+        {
+            required_postings += term.document_freq;
+        }
+    }
+    double minus_postings = 0.0;
+    // Доля документов без минус-слов (слова считаются независимыми)
+    double kept_fraction = 1.0;
+    for (const PlannedTerm& term : plan.minus_terms)
+    {
+        minus_postings += term.document_freq;
+        kept_fraction *= std::max(0.0, 1.0 - term.document_freq / document_count);
     }
+    auto& costs = plan.costs;
 
-    // Получаем векторы плюс- и минус-слов параллельным алгоритмом
-    const auto query = ParseQuery(policy, raw_query);
+    // TERM_AT_A_TIME: каждый элемент списков плюс-слов - в накопитель, затем удаление документов минус-слов.
+    // Обязательные слова проверяются пересечением их списков по всем найденным документам
+    costs[static_cast<size_t>(QueryStrategy::TERM_AT_A_TIME)] = plus_postings * (predicate_cost + accumulate_fraction * ACCUMULATE_COST)
+        + minus_postings * ERASE_COST + required_postings * CURSOR_COST;
 
-    // Проверяем, есть ли среди минус-слов хотя бы 1, входящее в текущий документ
-    if (std::any_of(std::execution::par, query.minus_words.cbegin(), query.minus_words.cend(),
-                    [this, document_id](std::string_view word)
-                    {
-                        const auto it = word_to_document_freqs_.find(word);
-                        // Если минус слово есть среди слов сервера И в заданном документе это слово встечается (== 1)  => true
-                        return ((it != word_to_document_freqs_.end()) && (it->second.count(document_id)));
-                    })
-        )
+    // MINUS_FIRST: документы минус-слов отмечаются в битовой карте по id, и списки плюс-слов пропускают их
+    // до предиката и накопителя. Карта не строится, если id документов слишком разрежены
+    const size_t bitmap_words = (GetDocumentIdBound() + 63) / 64;
+    if (!plan.minus_terms.empty() && query.required_words.empty() && bitmap_words <= documents_.size())
     {
-        // В запросе есть хотя бы 1 минус-слово, встречающееся в текущем документе.
-        // Возвращаем пустой ответ
-        return { {}, documents_.at(document_id).status };
+        costs[static_cast<size_t>(QueryStrategy::MINUS_FIRST)] = bitmap_words * BITMAP_CLEAR_COST
+            + minus_postings * BITMAP_COST
+            + plus_postings * (BITMAP_COST + kept_fraction * (predicate_cost + accumulate_fraction * ACCUMULATE_COST));
     }
 
-                    ///////////////////////////////////////////////
-                    // Если мы здесь, то минус-слов в документе нет
+    // REQUIRED_INTERSECTION: кандидаты - пересечение списков обязательных слов от самого редкого,
+    // списки плюс-слов проходятся только по кандидатам (слиянием или галопирующим поиском)
+    if (!query.required_words.empty())
+    {
+        double cost = 0.0;
+        if (!has_unknown_required)
+        {
+            double candidates = -1.0;
+            for (const PlannedTerm& term : plan.plus_terms)
+            {
+                if (term.role != QueryTermRole::REQUIRED)
+                {
+                    continue;
+                }
+                if (candidates < 0.0)
+                {
+                    candidates = term.document_freq;
+                    cost += candidates * CURSOR_COST;
+                }
+                else
+                {
+                    cost += std::min(candidates * SEEK_COST, (candidates + term.document_freq) * CURSOR_COST);
+                    candidates *= term.document_freq / document_count;
+                }
+            }
+            cost += candidates * predicate_cost;
+            for (const PlannedTerm& term : plan.plus_terms)
+            {
+                cost += std::min(candidates * SEEK_COST, (candidates + term.document_freq) * CURSOR_COST)
+                    + candidates * accumulate_fraction * ACCUMULATE_COST;
+            }
+            cost += minus_postings * ERASE_COST;
+        }
+        costs[static_cast<size_t>(QueryStrategy::REQUIRED_INTERSECTION)] = cost;
+    }
 
-                    // Пустой вектор совпавших слов
-                    std::vector<std::string_view> matched_words{};
-                    // Резервируем память (не более чем количество плюс-слов в запросе)
-                    matched_words.reserve(query.plus_words.size());
+    // DOCUMENT_AT_A_TIME: при ожидаемом пороге вхождения в лучшие слова с наименьшими границами вкладов
+    // (в сумме меньше порога) не перебираются, а только проверяются для документов остальных слов.
+    // Документы не попадают в хеш-накопитель, поэтому стратегия выгодна и для одного слова
+    if (result_count > 0 && query.required_words.empty() && !plan.plus_terms.empty())
+    {
+        double threshold = 0.0;
+        for (const PlannedTerm& term : plan.plus_terms)
+        {
+            if (term.document_freq >= result_count)
+            {
+                threshold = std::max(threshold, term.max_score);
+            }
+        }
+        threshold *= THRESHOLD_RATIO;
+
+        auto& score_order = plan.score_order;
+        score_order.resize(plan.plus_terms.size());
+        std::iota(score_order.begin(), score_order.end(), 0);
+        std::sort(score_order.begin(), score_order.end(),
+                  [&plan](size_t lhs, size_t rhs)
+                  {
+                      return plan.plus_terms[lhs].max_score < plan.plus_terms[rhs].max_score;
+                  });
+        size_t non_essential_count = 0;
+        double non_essential_bound = 0.0;
+        while (non_essential_count < score_order.size()
+               && non_essential_bound + plan.plus_terms[score_order[non_essential_count]].max_score < threshold)
+        {
+            non_essential_bound += plan.plus_terms[score_order[non_essential_count]].max_score;
+            ++non_essential_count;
+        }
+        double essential_postings = 0.0;
+        for (size_t i = non_essential_count; i < score_order.size(); ++i)
+        {
+            essential_postings += plan.plus_terms[score_order[i]].document_freq;
+        }
+        const double essential_count = static_cast<double>(score_order.size() - non_essential_count);
+        // Документы, отвергнутые произвольным предикатом, не повышают порог, и отсечение слабее
+        costs[static_cast<size_t>(QueryStrategy::DOCUMENT_AT_A_TIME)] = essential_postings
+            * (SCORE_COST + essential_count * CURSOR_COST + non_essential_count * SEEK_COST)
+            / accumulate_fraction;
+    }
+
+    // BITMAP: вклады складываются в массив по id без хеширования, отметки найденных документов очищаются
+    // и перебираются 64-битными словами. Минус-слова снимают отметки, у плотных списков - словами битовой карты.
+    // Массив сумм занимает место под каждый id, поэтому стратегия применима только при плотных id
+    if (query.required_words.empty() && !plan.plus_terms.empty()
+        && GetDocumentIdBound() <= DENSE_ID_RANGE_RATIO * documents_.size())
+    {
+        double minus_cost = 0.0;
+        for (const PlannedTerm& term : plan.minus_terms)
+        {
+            minus_cost += term.is_dense ? bitmap_words * BITMAP_CLEAR_COST : term.document_freq * BITMAP_COST;
+        }
+        costs[static_cast<size_t>(QueryStrategy::BITMAP)] = 2 * bitmap_words * BITMAP_CLEAR_COST + minus_cost
+            + plus_postings * (predicate_cost + accumulate_fraction * DENSE_ACCUMULATE_COST);
+    }
+
+    plan.strategy = QueryStrategy::TERM_AT_A_TIME;
+    for (size_t strategy = 0; strategy < QUERY_STRATEGY_COUNT; ++strategy)
+    {
+        if (costs[strategy] < costs[static_cast<size_t>(plan.strategy)])
+        {
+            plan.strategy = static_cast<QueryStrategy>(strategy);
+        }
+    }
+}
+
+
+double SearchServer::GetTermScoreBound(int word_id, DocumentStatus status, double inverse_document_freq,
+                                       double average_word_count) const
+{
+    if (HasCurrentImpacts())
+    {
+        return word_impacts_[word_id].GetMaxImpact(status);
+    }
+    const double max_term_freq = word_to_document_freqs_[word_id].GetMaxTermFreq(status);
+    if (options_.ranking == RankingModel::TF_IDF)
+    {
+        return max_term_freq * inverse_document_freq;
+    }
+    // Вклад BM25 через долю слова tf и длину документа len: idf * (k1 + 1) * tf / (tf + k1 * (1 - b) / len + k1 * b / avg).
+    // Он растёт с tf и не превосходит значения при len -> бесконечность
+    const double saturation = options_.bm25_k1 * options_.bm25_b / average_word_count;
+    const double saturated_freq = max_term_freq + saturation > 0.0 ? max_term_freq / (max_term_freq + saturation) : 1.0;
+    return inverse_document_freq * (options_.bm25_k1 + 1.0) * saturated_freq;
+}
+
+
+QueryPlan SearchServer::MakeQueryPlan(const ExecutionPlan& plan) const
+{
+    QueryPlan result;
+    result.strategy = plan.strategy;
+    result.costs = plan.costs;
+    for (const auto* terms : { &plan.plus_terms, &plan.minus_terms })
+    {
+        for (const PlannedTerm& term : *terms)
+        {
+            result.terms.push_back({ std::string(term.word), term.role, term.document_freq, term.is_dense,
+                                     term.max_score });
+        }
+    }
+    return result;
+}
 
-                    // Матчинг плюс-слов, версия 2 для последовательной реализации (другой словарь)
-                    const auto& this_doc_words = document_to_words_.at(document_id);
-                    for (std::string_view word : query.plus_words)
-                    {
-                        if (this_doc_words.count(word))
-                        {
-                            matched_words.push_back(word);
-                        }
-                    }
 
-                    // Удаляем дубликаты из результатов матчинга (версия для последовательной реализации)
-                    std::sort(std::execution::par, matched_words.begin(), matched_words.end());
-                    auto last = std::unique(std::execution::par, matched_words.begin(), matched_words.end());
-                    last = matched_words.erase(last, matched_words.end());
+void SearchServer::CheckPreparedDocument(const PreparedDocument& prepared) const
+{
+    using namespace std::string_literals;
 
-                    return { matched_words, documents_.at(document_id).status };
+    if ((prepared.document_id < 0) || (documents_.count(prepared.document_id) > 0))
+    {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    if (options_.memory_budget != 0)
+    {
+        CheckMemoryBudget(prepared);
+    }
 }
 
 
@@ -199,66 +709,442 @@ void SearchServer::RemoveDocument(int document_id)
         return;
     }
 
+    METRICS_TIMER("index.remove_document");
+
     // Считаем что данные в контейнерах корректны и если id присутствует в documents_,
     // то такой документ есть и в остальных контейнерах. Удаляем отовсюду.
+    // Статус нужен, чтобы найти раздел списков документов слов
+    const DocumentStatus status = attributes_.GetStatus(document_id);
+    const auto& document_words = document_to_words_.at(document_id);
+    // Ёмкость массивов после удаления не возвращается, поэтому вычитается только фактически освобождённая память
+    const size_t previous_memory = GetDocumentMemory(document_id) + GetPostingsMemory(document_words) + GetSharedMemory();
+    total_word_count_ -= attributes_.GetWordCount(document_id);
     documents_.erase(document_id);
     // erase-remove для вектора
     auto new_end_it = std::remove(document_ids_.begin(), document_ids_.end(), document_id);
     document_ids_.erase(new_end_it, document_ids_.end());
 
-    for (auto& [word, submap] : word_to_document_freqs_)
+    // Перебираем только слова удаляемого документа
+    for (const auto [word_id, _] : document_words)
     {
-        if (submap.count(document_id) > 0)
+        word_to_document_freqs_[word_id].Erase(document_id, status);
+        if (options_.positional_index)
         {
-            // Текущее word присутствует в указанном документе document_id. Удаляем.
-            submap.erase(document_id);
-            // Если для слова word больше нет ссылок, удаляем и само слово
-            // СЛЕДУЮЩИЙ КОД вызывает провал проверки задания тренажером, отключено
-//            if (submap.size() == 0)
-//            {
-//                word_to_document_freqs_.erase(word);
-//            }
+            word_to_document_positions_[word_id].erase(document_id);
         }
     }
+    EraseUnusedTerms(document_words);
+    const size_t postings_memory = GetPostingsMemory(document_words);
 
     document_to_words_.erase(document_id);
+    duplicate_detector_.RemoveDocument(document_id);
+    attributes_.Remove(document_id);
+    estimated_memory_ -= previous_memory - postings_memory - GetSharedMemory();
+    ++index_version_;
+}
+
+
+bool SearchServer::HasDocument(int document_id) const
+{
+    return documents_.count(document_id) > 0;
+}
+
+
+std::string_view SearchServer::GetDocumentText(int document_id) const
+{
+    return documents_.at(document_id).GetText();
+}
+
+
+DocumentStatus SearchServer::GetDocumentStatus(int document_id) const
+{
+    CheckDocumentExists(document_id);
+    return attributes_.GetStatus(document_id);
+}
+
+
+int SearchServer::GetDocumentRating(int document_id) const
+{
+    CheckDocumentExists(document_id);
+    return attributes_.GetRating(document_id);
 }
 
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
+std::vector<std::pair<std::string_view, double>> SearchServer::GetDocumentAttributes(int document_id) const
 {
-    // Статические переменные инициализируются при первом обращении, а потом просто используются
-    static std::map<std::string_view, double> word_freqs_;
-    word_freqs_.clear();
+    CheckDocumentExists(document_id);
+    std::vector<std::pair<std::string_view, double>> result;
+    attributes_.ForEachAttribute(document_id,
+                                 [&result](std::string_view name, double value)
+                                 {
+                                     if (value != 0.0)
+                                     {
+                                         result.emplace_back(name, value);
+                                     }
+                                 });
+    return result;
+}
 
-    if (documents_.count(document_id) > 0)
+
+void SearchServer::CheckDocumentExists(int document_id) const
+{
+    using namespace std::string_literals;
+    if (documents_.count(document_id) == 0)
     {
-        word_freqs_ = document_to_words_.at(document_id);
+        throw std::out_of_range("Invalid document_id"s);
     }
+}
 
-    return word_freqs_;
+
+size_t SearchServer::GetDocumentIdBound() const
+{
+    return documents_.empty() ? 0 : static_cast<size_t>(documents_.rbegin()->first) + 1;
+}
+
+
+void SearchServer::SetDocumentAttribute(int document_id, std::string_view name, double value)
+{
+    using namespace std::string_literals;
+    if (documents_.count(document_id) == 0)
+    {
+        throw std::out_of_range("Invalid document_id"s);
+    }
+    const size_t previous_memory = attributes_.GetMemoryUsage();
+    attributes_.SetAttribute(document_id, name, value);
+    estimated_memory_ += attributes_.GetMemoryUsage() - previous_memory;
 }
 
+
+WordFrequenciesView SearchServer::GetWordFrequencies(int document_id) const
+{
+    // Представление ссылается на прямой индекс без копирования. Для неизвестного документа - пустое
+    const auto it = document_to_words_.find(document_id);
+    if (it == document_to_words_.end())
+    {
+        return WordFrequenciesView({}, {}, &dictionary_, index_version_);
+    }
+
+    const auto& document_words = it->second;
+    return WordFrequenciesView(document_words.data(), document_words.data() + document_words.size(),
+                               &dictionary_, index_version_);
+}
+
+
+uint64_t SearchServer::GetIndexVersion() const
+{
+    return index_version_;
+}
+
+
+void SearchServer::BuildImpacts()
+{
+    estimated_memory_ -= GetImpactsMemory();
+    word_impacts_.assign(word_to_document_freqs_.size(), ImpactPostings{});
+    const double average_word_count = GetAverageWordCount();
+
+    // Первый проход: наибольший вклад задаёт шаг квантования
+    double max_score = 0.0;
+    for (size_t word_id = 0; word_id < word_to_document_freqs_.size(); ++word_id)
+    {
+        const StatusPostings& postings = word_to_document_freqs_[word_id];
+        if (postings.size() == 0)
+        {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(static_cast<int>(word_id));
+        postings.ForEach([&](int document_id, double term_freq)
+                         {
+                             max_score = std::max(max_score,
+                                                  ComputeTermScore(inverse_document_freq, document_id,
+                                                                   term_freq, average_word_count));
+                         });
+    }
+    impact_step_ = max_score > 0.0 ? max_score / std::numeric_limits<uint16_t>::max() : 1.0;
+
+    // Второй проход: квантованные вклады. Отрицательные вклады (слово во всех документах) обнуляются
+    for (size_t word_id = 0; word_id < word_to_document_freqs_.size(); ++word_id)
+    {
+        const StatusPostings& postings = word_to_document_freqs_[word_id];
+        if (postings.size() == 0)
+        {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(static_cast<int>(word_id));
+        ImpactPostings& impacts = word_impacts_[word_id];
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            postings.ForEachInPartition(static_cast<DocumentStatus>(status),
+                                        [&](int document_id, double term_freq)
+                                        {
+                                            const double score = ComputeTermScore(inverse_document_freq, document_id,
+                                                                                  term_freq, average_word_count);
+                                            impacts.Add(document_id, static_cast<DocumentStatus>(status),
+                                                        static_cast<uint16_t>(
+                                                            std::lround(std::max(score, 0.0) / impact_step_)));
+                                        });
+        }
+    }
+
+    word_impact_order_.clear();
+    if (options_.impact_ordered_postings)
+    {
+        word_impact_order_.reserve(word_impacts_.size());
+        for (const ImpactPostings& impacts : word_impacts_)
+        {
+            word_impact_order_.emplace_back(impacts);
+        }
+    }
+    impacts_version_ = index_version_;
+    estimated_memory_ += GetImpactsMemory();
+}
+
+
+bool SearchServer::HasCurrentImpacts() const
+{
+    return impacts_version_ == index_version_;
+}
+
+
+bool SearchServer::HasCurrentImpactOrder() const
+{
+    return options_.impact_ordered_postings && HasCurrentImpacts();
+}
+
+
+MemoryUsage SearchServer::GetMemoryUsage() const
+{
+    MemoryUsage usage;
+
+    usage.inverted_index = EstimateVectorMemory(word_to_document_freqs_);
+    for (const StatusPostings& postings : word_to_document_freqs_)
+    {
+        usage.inverted_index += postings.GetMemoryUsage();
+    }
+
+    usage.forward_index = EstimateTreeMemory(document_to_words_);
+    for (const auto& [document_id, document_words] : document_to_words_)
+    {
+        usage.forward_index += EstimateVectorMemory(document_words);
+    }
+
+    usage.documents = EstimateTreeMemory(documents_);
+    for (const auto& [document_id, document_data] : documents_)
+    {
+        usage.documents += EstimateStringMemory(document_data.doc_text);
+    }
+
+    usage.document_ids = EstimateVectorMemory(document_ids_);
+
+    usage.stop_words = EstimateTreeMemory(stop_words_);
+    for (const std::string& stop_word : stop_words_)
+    {
+        usage.stop_words += EstimateStringMemory(stop_word);
+    }
+
+    usage.dictionary = dictionary_.GetMemoryUsage();
+    usage.attributes = attributes_.GetMemoryUsage();
+
+    usage.positional_index = EstimateVectorMemory(word_to_document_positions_);
+    for (const auto& document_positions : word_to_document_positions_)
+    {
+        usage.positional_index += EstimateTreeMemory(document_positions);
+        for (const auto& [document_id, positions] : document_positions)
+        {
+            usage.positional_index += positions.GetMemoryUsage();
+        }
+    }
+
+    usage.duplicate_detector = duplicate_detector_.GetMemoryUsage();
+
+    usage.impacts = GetImpactsMemory();
+    usage.object = sizeof(SearchServer);
+    return usage;
+}
+
+
+size_t SearchServer::GetEstimatedMemory() const
+{
+    return estimated_memory_;
+}
+
+
+std::pmr::memory_resource* SearchServer::GetIndexMemoryResource() const
+{
+    return index_resource_;
+}
+
+
+std::unique_ptr<std::pmr::synchronized_pool_resource> SearchServer::MakeIndexPool(const IndexOptions& options)
+{
+    if (options.index_memory != IndexMemoryMode::POOL)
+    {
+        return nullptr;
+    }
+    // В пуле размещаются только мелкие блоки (узлы деревьев, короткие списки), крупные массивы выделяются
+    // напрямую из memory_resource. Ограничение размера порции пула не даёт одному размеру блока
+    // захватывать всё более крупные порции, которые затем не используются для других размеров
+    std::pmr::pool_options pool_options;
+    pool_options.largest_required_pool_block = 1024;
+    pool_options.max_blocks_per_chunk = 256;
+    return std::make_unique<std::pmr::synchronized_pool_resource>(
+        pool_options, options.memory_resource != nullptr ? options.memory_resource : std::pmr::get_default_resource());
+}
+
+
+size_t SearchServer::EstimateDocumentMemory(size_t text_length, size_t word_count, size_t unique_word_count) const
+{
+    size_t result = EstimateTreeNodeMemory<std::pair<const int, DocumentData>>() + EstimateStringAllocation(text_length)
+        + sizeof(int)   // document_ids_
+        + EstimateTreeNodeMemory<std::pair<const int, std::pmr::vector<WordFrequency>>>()
+        + EstimateAllocation(unique_word_count * sizeof(WordFrequency))
+        + unique_word_count * StatusPostings::ESTIMATED_POSTING_MEMORY
+        + DuplicateDetector::EstimateDocumentMemory(unique_word_count);
+    if (options_.positional_index && unique_word_count > 0)
+    {
+        // Позиции слова кодируются примерно байтом на вхождение
+        const size_t positions_per_word = (word_count + unique_word_count - 1) / unique_word_count;
+        result += unique_word_count * (EstimateTreeNodeMemory<std::pair<const int, PositionList>>()
+                                       + EstimateAllocation(positions_per_word));
+    }
+    return result;
+}
+
+
+size_t SearchServer::GetTermStorageMemory() const
+{
+    return dictionary_.GetMemoryUsage() + EstimateVectorMemory(word_to_document_freqs_)
+        + EstimateVectorMemory(word_to_document_positions_);
+}
+
+
+void SearchServer::EraseUnusedTerms(const std::pmr::vector<WordFrequency>& document_words)
+{
+    for (const auto [word_id, _] : document_words)
+    {
+        if (word_to_document_freqs_[word_id].size() == 0)
+        {
+            dictionary_.Erase(word_id);
+        }
+    }
+}
+
+
+size_t SearchServer::GetSharedMemory() const
+{
+    return GetTermStorageMemory() + attributes_.GetMemoryUsage() + EstimateVectorMemory(document_ids_);
+}
+
+
+size_t SearchServer::GetDocumentMemory(int document_id) const
+{
+    const auto& document_words = document_to_words_.at(document_id);
+    size_t result = EstimateTreeNodeMemory<std::pair<const int, DocumentData>>()
+        + EstimateStringMemory(documents_.at(document_id).doc_text)
+        + EstimateTreeNodeMemory<std::pair<const int, std::pmr::vector<WordFrequency>>>()
+        + EstimateVectorMemory(document_words) + duplicate_detector_.GetDocumentMemory(document_id);
+    if (options_.positional_index)
+    {
+        for (const auto [word_id, _] : document_words)
+        {
+            result += EstimateTreeNodeMemory<std::pair<const int, PositionList>>()
+                + word_to_document_positions_[word_id].at(document_id).GetMemoryUsage();
+        }
+    }
+    return result;
+}
+
+
+size_t SearchServer::GetPostingsMemory(const std::pmr::vector<WordFrequency>& document_words) const
+{
+    size_t result = 0;
+    for (const auto [word_id, _] : document_words)
+    {
+        result += word_to_document_freqs_[word_id].GetMemoryUsage();
+    }
+    return result;
+}
+
+
+size_t SearchServer::GetImpactsMemory() const
+{
+    size_t result = EstimateVectorMemory(word_impacts_) + EstimateVectorMemory(word_impact_order_);
+    for (const ImpactPostings& impacts : word_impacts_)
+    {
+        result += impacts.GetMemoryUsage();
+    }
+    for (const ImpactOrderedPostings& impacts : word_impact_order_)
+    {
+        result += impacts.GetMemoryUsage();
+    }
+    return result;
+}
+
+
+size_t SearchServer::EstimateTermMemory(size_t length) const
+{
+    return TermDictionary::EstimateTermMemory(length) + sizeof(StatusPostings)
+        + (options_.positional_index ? sizeof(std::pmr::map<int, PositionList>) : 0);
+}
+
+
+void SearchServer::CheckMemoryBudget(const PreparedDocument& prepared) const
+{
+    using namespace std::string_literals;
+
+    size_t required = EstimateDocumentMemory(prepared.text.size(), prepared.word_count, prepared.terms.size())
+        + attributes_.EstimateAddMemory(prepared.document_id);
+    for (const PreparedDocument::Term& term : prepared.terms)
+    {
+        if (dictionary_.Find(prepared.GetTerm(term)) == TermDictionary::NOT_FOUND)
+        {
+            required += EstimateTermMemory(term.length);
+        }
+    }
+    if (estimated_memory_ + required > options_.memory_budget)
+    {
+        METRICS_COUNTER_ADD("ingest.memory_budget_rejections", 1);
+        throw std::length_error("Memory budget exceeded"s);
+    }
+}
+
+std::vector<int> SearchServer::FindDuplicates(DuplicateMode mode, double threshold) const
+{
+    return duplicate_detector_.FindDuplicates(std::execution::seq, mode, threshold);
+}
+
+
 SearchServer::Query::Query(size_t size_plus, size_t size_minus) : plus_words(size_plus), minus_words(size_minus)
 {}
 
 SearchServer::Query::Query(size_t size) : plus_words(size), minus_words(size)
 {}
 
+SearchServer::Query::Query(std::pmr::memory_resource* resource)
+    : plus_words(resource), minus_words(resource), required_words(resource)
+{}
+
+void SearchServer::Query::Clear()
+{
+    plus_words.clear();
+    minus_words.clear();
+    required_words.clear();
+    positional_clauses.clear();
+}
+
 void SearchServer::Query::SortUniq(bool sort_plus)
 {
     if (sort_plus)
     {
         // Сортировка словаря плюс-слов
-        std::sort(std::execution::par, plus_words.begin(), plus_words.end());
-        auto last = std::unique(std::execution::par, plus_words.begin(), plus_words.end());
+        std::sort(plus_words.begin(), plus_words.end());
+        auto last = std::unique(plus_words.begin(), plus_words.end());
         last = plus_words.erase(last, plus_words.end());
     }
     else
     {
         // Сортировка словаря минус-слов
-        std::sort(std::execution::par, minus_words.begin(), minus_words.end());
-        auto last = std::unique(std::execution::par, minus_words.begin(), minus_words.end());
+        std::sort(minus_words.begin(), minus_words.end());
+        auto last = std::unique(minus_words.begin(), minus_words.end());
         last = minus_words.erase(last, minus_words.end());
     }
 }
@@ -268,6 +1154,9 @@ void SearchServer::Query::SortUniq()
     SortUniq(true);
     SortUniq(false);
 
+    std::sort(required_words.begin(), required_words.end());
+    required_words.erase(std::unique(required_words.begin(), required_words.end()), required_words.end());
+
     // Сортировка словаря плюс-слов
 //    std::sort(std::execution::par, plus_words.begin(), plus_words.end());
 //    auto last = std::unique(std::execution::par, plus_words.begin(), plus_words.end());
@@ -280,6 +1169,19 @@ void SearchServer::Query::SortUniq()
 }
 
 
+std::set<std::string, std::less<>> SearchServer::FoldStopWords(std::set<std::string, std::less<>> stop_words)
+{
+    std::set<std::string, std::less<>> result;
+    for (auto it = stop_words.begin(); it != stop_words.end();)
+    {
+        auto node = stop_words.extract(it++);
+        FoldCase(node.value().data(), node.value().size());
+        result.insert(std::move(node));
+    }
+    return result;
+}
+
+
 bool SearchServer::IsStopWord(std::string_view word) const
 {
     //return stop_words_.count(word.data()) > 0;
@@ -289,11 +1191,8 @@ bool SearchServer::IsStopWord(std::string_view word) const
 
 bool SearchServer::IsValidWord(std::string_view word)
 {
-    // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](char c)
-                        {
-                            return c >= '\0' && c < ' ';
-                        });
+    // A valid word must be valid UTF-8 and must not contain special characters
+    return IsValidText(word);
 }
 
 
@@ -301,12 +1200,15 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_vie
 {
     using namespace std::string_literals;
 
+    // Текст проверяется целиком: некорректная последовательность UTF-8 не может включать пробел,
+    // поэтому текст корректен, только если корректны все слова. Слово с ошибкой ищется для сообщения
+    const bool is_valid_text = IsValidWord(text);
     std::vector<std::string_view> words;
     for (std::string_view word : SplitIntoWordsView(text))
     {
-        if (!IsValidWord(word))
+        if (!is_valid_text && !IsValidWord(word))
         {
-            throw std::invalid_argument("Word "s + word.data() + " is invalid"s);
+            throw std::invalid_argument("Word "s + std::string(word) + " is invalid"s);
         }
         if (!IsStopWord(word))
         {
@@ -319,6 +1221,11 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_vie
 
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings)
 {
+    // Документ без оценок (например, запись с пустым списком рейтингов) имеет рейтинг 0
+    if (ratings.empty())
+    {
+        return 0;
+    }
     int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
 
     return rating_sum / static_cast<int>(ratings.size());
@@ -335,22 +1242,370 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
     }
     std::string_view word = text;
     bool is_minus = false;
+    bool is_required = false;
     if (word[0] == '-')
     {
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word))
+    else if (word[0] == '+')
+    {
+        is_required = true;
+        word = word.substr(1);
+    }
+    bool is_prefix = false;
+    if (!word.empty() && word.back() == '*')
+    {
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
+    if (word.empty() || word[0] == '-' || word[0] == '+' || !IsValidWord(word))
+    {
+        throw std::invalid_argument("Query word "s + std::string(text) + " is invalid"s);
+    }
+    if (is_required && is_prefix)
+    {
+        throw std::invalid_argument("Required prefix words are not supported: "s + std::string(text));
+    }
+
+    if (is_prefix)
+    {
+        // Префикс приводится к нижнему регистру при раскрытии (см. ParseQueryWords())
+        return { word, is_minus, false, is_prefix, is_required };
+    }
+
+    return WithFoldedCase(word,
+                          [&](std::string_view folded) -> QueryWord
+                          {
+                              if (folded.data() == word.data())
+                              {
+                                  return { word, is_minus, IsStopWord(word), is_prefix, is_required };
+                              }
+                              // Слово с заглавными буквами заменяется словом словаря, которое живёт дольше запроса.
+                              // Слова нет в словаре - остаётся исходное: в словаре только слова в нижнем регистре,
+                              // поэтому исходное слово тоже ничего не найдёт
+                              const int word_id = dictionary_.Find(folded);
+                              return { word_id == TermDictionary::NOT_FOUND ? word : dictionary_.GetTerm(word_id),
+                                       is_minus, IsStopWord(folded), is_prefix, is_required };
+                          });
+}
+
+
+void SearchServer::ParseQuery(std::string_view text, QueryContext& context) const
+{
+    METRICS_TIMER("query.parse");
+    // Буферы контекста очищаются, но сохраняют выделенную память
+    SplitIntoWordsView(text, context.query_words_);
+    context.query_.Clear();
+    ParseQueryWords(text, context.query_words_, context.query_);
+    context.query_.SortUniq();
+}
+
+
+bool SearchServer::IsMoreRelevant(const Document& lhs, const Document& rhs)
+{
+    // Сравнение релевантностей с допуском (|a - b| < EPSILON) не транзитивно: a ~ b и b ~ c не дают a ~ c,
+    // и сортировка и курсор страниц расходятся. Ключ - номер интервала длины EPSILON
+    const double lhs_key = std::round(lhs.relevance / EPSILON);
+    const double rhs_key = std::round(rhs.relevance / EPSILON);
+    if (lhs_key != rhs_key)
+    {
+        return lhs_key > rhs_key;
+    }
+    if (lhs.rating != rhs.rating)
+    {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+
+void SearchServer::ParseQueryWords(std::string_view text, const std::pmr::vector<std::string_view>& query_words,
+                                   Query& result) const
+{
+    using namespace std::string_literals;
+
+    // Резервируем память только для плюс-слов
+    result.plus_words.reserve(query_words.size());
+
+    // Слова текущей фразы в кавычках
+    bool in_phrase = false;
+    std::vector<std::string_view> phrase_words;
+    // Последнее плюс-слово вне фразы - левый операнд оператора NEAR/k
+    std::string_view near_operand;
+
+    for (size_t i = 0; i < query_words.size(); ++i)
+    {
+        std::string_view word = query_words[i];
+
+        // Без позиционного индекса кавычки и NEAR/k - часть обычных слов, как до появления фраз
+        if (!options_.positional_index)
+        {
+            AddQueryWord(ParseQueryWord(word), result);
+            continue;
+        }
+
+        if (word.size() > 1 && word[0] == '-' && word[1] == '"')
+        {
+            throw std::invalid_argument("Minus phrases are not supported: "s + std::string(word));
+        }
+        // Фраза и так обязательна: документ без неё не попадает в результат
+        if (word.size() > 1 && word[0] == '+' && word[1] == '"')
+        {
+            throw std::invalid_argument("Phrases are always required, '+' is not allowed before phrase: "s
+                                        + std::string(word));
+        }
+
+        // Фраза в кавычках: "слово1 слово2 ..."
+        if (!in_phrase && !word.empty() && word.front() == '"')
+        {
+            in_phrase = true;
+            word.remove_prefix(1);
+        }
+        if (in_phrase)
+        {
+            const bool phrase_end = !word.empty() && word.back() == '"';
+            if (phrase_end)
+            {
+                word.remove_suffix(1);
+            }
+            if (!word.empty())
+            {
+                const auto query_word = ParseQueryWord(word);
+                if (query_word.is_minus || query_word.is_prefix || query_word.is_required)
+                {
+                    throw std::invalid_argument("Minus, required and prefix words are not allowed inside phrase: "s
+                                                + std::string(word));
+                }
+                // Стоп-слова не индексируются и не занимают позиций, поэтому и из фразы выбрасываются
+                if (!query_word.is_stop)
+                {
+                    phrase_words.push_back(query_word.data);
+                    result.plus_words.push_back(query_word.data);
+                }
+            }
+            if (phrase_end)
+            {
+                // Фраза из одного слова - тоже обязательное условие, а не обычное плюс-слово
+                if (!phrase_words.empty())
+                {
+                    result.positional_clauses.push_back({ phrase_words, 0 });
+                }
+                phrase_words.clear();
+                in_phrase = false;
+            }
+            near_operand = {};
+            continue;
+        }
+
+        // Оператор близости: слово1 NEAR/k слово2
+        if (word.size() > 5 && word.substr(0, 5) == "NEAR/"
+            && std::all_of(word.begin() + 5, word.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        {
+            if (near_operand.empty() || i + 1 == query_words.size())
+            {
+                throw std::invalid_argument("NEAR operator requires two plus words: "s + std::string(text));
+            }
+            const auto right_word = ParseQueryWord(query_words[++i]);
+            if (right_word.is_minus || right_word.is_stop || right_word.is_prefix)
+            {
+                throw std::invalid_argument("NEAR operator requires two plus words: "s + std::string(text));
+            }
+            // Расстояние больше числа слов любого документа ничего не ограничивает, но должно помещаться в int
+            int distance = 0;
+            const std::string_view digits = word.substr(5);
+            const auto [digits_end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), distance);
+            if (error != std::errc() || digits_end != digits.data() + digits.size() || distance < 1)
+            {
+                throw std::invalid_argument("NEAR distance must be a positive integer: "s + std::string(word));
+            }
+            result.positional_clauses.push_back({ { near_operand, right_word.data }, distance });
+            result.plus_words.push_back(right_word.data);
+            if (right_word.is_required)
+            {
+                result.required_words.push_back(right_word.data);
+            }
+            near_operand = right_word.data;
+            continue;
+        }
+
+        const auto query_word = ParseQueryWord(word);
+        AddQueryWord(query_word, result);
+        near_operand = !query_word.is_prefix && !query_word.is_stop && !query_word.is_minus ? query_word.data
+                                                                                          : std::string_view{};
+    }
+
+    if (in_phrase)
+    {
+        throw std::invalid_argument("Unterminated phrase in query: "s + std::string(text));
+    }
+}
+
+
+void SearchServer::AddQueryWord(const QueryWord& query_word, Query& result) const
+{
+    if (query_word.is_prefix)
+    {
+        // Префиксное слово раскрывается во все слова словаря с этим префиксом
+        auto& target = query_word.is_minus ? result.minus_words : result.plus_words;
+        WithFoldedCase(query_word.data,
+                       [this, &target](std::string_view prefix)
+                       {
+                           dictionary_.ForEachWithPrefix(prefix,
+                                                         [&target](std::string_view term, int)
+                                                         {
+                                                             target.push_back(term);
+                                                         });
+                       });
+    }
+    else if (!query_word.is_stop)
+    {
+        if (query_word.is_minus)
+        {
+            result.minus_words.push_back(query_word.data);
+        }
+        else
+        {
+            result.plus_words.push_back(query_word.data);
+            if (query_word.is_required)
+            {
+                result.required_words.push_back(query_word.data);
+            }
+        }
+    }
+}
+
+
+bool SearchServer::MatchesPositionalClause(const PositionalClause& clause, int document_id) const
+{
+    std::vector<const PositionList*> lists;
+    lists.reserve(clause.words.size());
+    for (std::string_view word : clause.words)
     {
-        throw std::invalid_argument("Query word "s + text.data() + " is invalid"s);
+        const int word_id = dictionary_.Find(word);
+        if (word_id == TermDictionary::NOT_FOUND)
+        {
+            return false;
+        }
+        const auto& document_positions = word_to_document_positions_[word_id];
+        const auto document_it = document_positions.find(document_id);
+        if (document_it == document_positions.end())
+        {
+            return false;
+        }
+        lists.push_back(&document_it->second);
     }
 
-    return { word, is_minus, IsStopWord(word) };
+    return clause.distance == 0
+        ? ContainsPhrase(lists)
+        : ContainsNear(*lists[0], *lists[1], clause.distance);
+}
+
+
+std::vector<int> SearchServer::FindPositionalMatches(const Query& query) const
+{
+    std::vector<int> result;
+    bool first_clause = true;
+
+    for (const auto& clause : query.positional_clauses)
+    {
+        // Кандидаты - документы, содержащие два самых редких слова условия: пересечение их списков документов
+        // (ядро пересечения выбирается по представлениям списков). Позиции проверяются только у кандидатов
+        std::array<const StatusPostings*, 2> rarest = { nullptr, nullptr };
+        for (std::string_view word : clause.words)
+        {
+            const int word_id = dictionary_.Find(word);
+            if (word_id == TermDictionary::NOT_FOUND)
+            {
+                return {};
+            }
+            const StatusPostings* postings = &word_to_document_freqs_[word_id];
+            if (rarest[0] == nullptr || postings->size() < rarest[0]->size())
+            {
+                rarest[1] = rarest[0];
+                rarest[0] = postings;
+            }
+            else if (rarest[1] == nullptr || postings->size() < rarest[1]->size())
+            {
+                rarest[1] = postings;
+            }
+        }
+
+        std::vector<int> candidates;
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            if (rarest[1] == nullptr)
+            {
+                rarest[0]->ForEachInPartition(static_cast<DocumentStatus>(status),
+                                              [&candidates](int document_id, double)
+                                              {
+                                                  candidates.push_back(document_id);
+                                              });
+                continue;
+            }
+            IntersectPostings(*rarest[0], *rarest[1], static_cast<DocumentStatus>(status),
+                              [&candidates](int document_id, double, double)
+                              {
+                                  candidates.push_back(document_id);
+                              });
+        }
+        std::sort(candidates.begin(), candidates.end());
+
+        std::vector<int> clause_matches;
+        for (const int document_id : candidates)
+        {
+            if ((first_clause || std::binary_search(result.begin(), result.end(), document_id))
+                && MatchesPositionalClause(clause, document_id))
+            {
+                clause_matches.push_back(document_id);
+            }
+        }
+        result = std::move(clause_matches);
+        first_clause = false;
+
+        if (result.empty())
+        {
+            break;
+        }
+    }
+
+    return result;
 }
 
 
 // Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const
+double SearchServer::ComputeWordInverseDocumentFreq(int word_id) const
+{
+    const double document_count = GetDocumentCount();
+    const double document_freq = word_to_document_freqs_.at(word_id).size();
+    if (options_.ranking == RankingModel::BM25)
+    {
+        // Вариант IDF из Lucene: всегда положителен, в отличие от исходного log((N - df + 0.5) / (df + 0.5))
+        return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+    }
+    return std::log(document_count / document_freq);
+}
+
+
+double SearchServer::ComputeTermScore(double idf, int document_id, double term_freq, double average_word_count) const
+{
+    if (options_.ranking == RankingModel::TF_IDF)
+    {
+        return term_freq * idf;
+    }
+    // В индексе хранится доля слова среди слов документа, BM25 нужно число вхождений
+    const Bm25Parameters parameters{ options_.bm25_k1, options_.bm25_b, average_word_count };
+    return ComputeBm25Score(idf, term_freq, attributes_.GetWordCount(document_id), parameters);
+}
+
+
+double SearchServer::GetAverageWordCount() const
+{
+    return documents_.empty() ? 0.0 : static_cast<double>(total_word_count_) / documents_.size();
+}
+
+
+Bm25Parameters SearchServer::GetBm25Parameters() const
 {
-    return std::log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    return { options_.bm25_k1, options_.bm25_b, GetAverageWordCount() };
 }
@@ -14,14 +14,33 @@
 #include <mutex>
 #include <type_traits>
 #include <future>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 
 #include <ostream>      // для тестов
 #include <iostream>     // для тестов
 #include <ios>          // для тестов
 
+#include "attribute_store.h"
 #include "document.h"
 #include "string_processing.h"
 #include "concurrent_map.h"
+#include "duplicate_detector.h"
+#include "memory_resource.h"
+#include "memory_usage.h"
+#include "metrics.h"
+#include "positional_index.h"
+#include "posting_list.h"
+#include "query_control.h"
+#include "query_plan.h"
+#include "score_accumulator.h"
+#include "score_kernels.h"
+#include "term_dictionary.h"
+#include "word_frequencies.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
@@ -31,22 +50,151 @@ const double EPSILON = 1e-6;
 // Число корзин для разбиения многопоточных словарей
 const size_t BUCKETS_NUM = 8;
 
+// Модель ранжирования документов
+enum class RankingModel
+{
+    TF_IDF,     // tf * log(N / df), tf - доля слова среди слов документа
+    BM25,       // Okapi BM25 с нормализацией по длине документа (параметры k1 и b)
+};
+
+// Распределение памяти структур индекса (см. IndexOptions::index_memory)
+enum class IndexMemoryMode
+{
+    DEFAULT,    // Напрямую из IndexOptions::memory_resource
+    POOL,       // Из собственного пула сервера (std::pmr::synchronized_pool_resource) поверх memory_resource
+};
+
+// Параметры построения индекса поискового сервера
+struct IndexOptions
+{
+    // Хранить позиции слов в документах (нужно для поиска фраз в кавычках и оператора NEAR/k)
+    bool positional_index = false;
+
+    RankingModel ranking = RankingModel::TF_IDF;
+    // Параметры BM25: насыщение частоты слова (k1 >= 0) и степень нормализации по длине (0 <= b <= 1)
+    double bm25_k1 = 1.2;
+    double bm25_b = 0.75;
+
+    // Строить в BuildImpacts() копию вкладов, упорядоченную по убыванию вклада (для FindTopDocumentsAnytime())
+    bool impact_ordered_postings = false;
+
+    // Ограничение оценки занимаемой памяти в байтах (см. SearchServer::GetEstimatedMemory()), 0 - без ограничения
+    size_t memory_budget = 0;
+
+    // Откуда выделяется память документов, списков документов слов, прямого и позиционного индексов.
+    // В пуле мелкие узлы и списки одного размера берутся из общих блоков и не перемежаются с остальными
+    // выделениями процесса. Освобождённая память пула не возвращается системе и используется повторно
+    // только для блоков того же размера
+    IndexMemoryMode index_memory = IndexMemoryMode::DEFAULT;
+    // Источник памяти индекса (nullptr - std::pmr::get_default_resource()). Должен быть потокобезопасным
+    // (документы разбираются и удаляются параллельно) и существовать дольше сервера
+    std::pmr::memory_resource* memory_resource = nullptr;
+    // Размещать временные данные запросов без QueryContext в арене на стеке (QueryArena)
+    bool query_arena = true;
+};
+
+// Предикат "документ имеет заданный статус".
+// FindTopDocuments() распознаёт его на этапе компиляции и перебирает только раздел индекса
+// с нужным статусом, не вызывая предикат для каждого документа
+struct DocumentStatusFilter
+{
+    DocumentStatus status = DocumentStatus::ACTUAL;
+
+    bool operator()(int, DocumentStatus document_status, int) const
+    {
+        return document_status == status;
+    }
+};
+
+// Позиция в выдаче для постраничного поиска: релевантность, рейтинг и id последнего документа
+// предыдущей страницы. Курсор по умолчанию указывает на начало выдачи
+struct SearchCursor
+{
+    double relevance = 0.0;
+    int rating = 0;
+    int document_id = -1;
+
+    bool IsStart() const
+    {
+        return document_id < 0;
+    }
+};
+
+// Страница выдачи
+struct ResultPage
+{
+    std::vector<Document> documents;
+    // Есть ли документы после этой страницы
+    bool has_more = false;
+    // Курсор для запроса следующей страницы (последний документ этой страницы)
+    SearchCursor next_cursor;
+};
+
+// Ограничение на обработку списков документов в FindTopDocumentsAnytime().
+// По умолчанию ограничений нет
+struct SearchBudget
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Момент, после которого обработка прекращается (проверяется между сегментами списков)
+    Clock::time_point deadline = Clock::time_point::max();
+    // Наибольшее число обрабатываемых элементов списков документов плюс-слов
+    size_t max_postings = std::numeric_limits<size_t>::max();
+
+    // Бюджет "не дольше timeout с текущего момента"
+    static SearchBudget WithTimeout(Clock::duration timeout)
+    {
+        SearchBudget budget;
+        budget.deadline = Clock::now() + timeout;
+        return budget;
+    }
+};
+
+// Результат поиска с ограниченным бюджетом
+struct AnytimeResult
+{
+    std::vector<Document> documents;
+    // true, если обработаны все списки документов и результат совпадает с FindTopDocuments()
+    bool exact = true;
+    size_t processed_postings = 0;
+};
+
 class SearchServer
 {
 public:
+    // Переиспользуемый контекст запроса (определён ниже)
+    class QueryContext;
+
     // Шаблонный конструктор на основе контейнера со стоп-словами
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
+    explicit SearchServer(const StringContainer& stop_words, const IndexOptions& options = {});
 
     // Конструктор на основе строки со стоп-словами (вызывает шаблонный конструктор)
-    explicit SearchServer(const std::string&);
+    explicit SearchServer(const std::string&, const IndexOptions& options = {});
 
     // Конструктор на основе string_view со стоп-словами (вызывает шаблонный конструктор)
-    explicit SearchServer(const std::string_view);
+    explicit SearchServer(const std::string_view, const IndexOptions& options = {});
+
+    // Документ, разобранный на слова и готовый к добавлению в индекс (определён ниже)
+    struct PreparedDocument;
 
-    // Метод добавляет новый документ в базу данных поискового сервера
+    // Метод добавляет новый документ в базу данных поискового сервера.
+    // Если документ не помещается в IndexOptions::memory_budget, выбрасывает std::length_error
+    // и не изменяет индекс: документ можно добавить позже, освободив память удалением других документов
     void AddDocument(int, std::string_view, DocumentStatus, const std::vector<int>&);
 
+    // AddDocument() в два этапа. PrepareDocument() разбирает и проверяет текст, не обращаясь
+    // к изменяемому состоянию сервера, поэтому документы можно готовить параллельно, в том числе
+    // одновременно с AddPreparedDocument(). AddPreparedDocument() добавляет документ в индекс.
+    // С text_owner текст не копируется: документ ссылается на переданный текст, а сервер хранит
+    // text_owner (например, отображённый в память файл корпуса) до своего уничтожения
+    PreparedDocument PrepareDocument(int, std::string_view, DocumentStatus, const std::vector<int>&,
+                                     std::shared_ptr<const void> text_owner = nullptr) const;
+    void AddPreparedDocument(PreparedDocument&&);
+    // Выбрасывает те же исключения, что и AddPreparedDocument() для этого документа (повторный id,
+    // превышение бюджета памяти), не изменяя индекс
+    void CheckPreparedDocument(const PreparedDocument&) const;
+
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(std::string_view,
                                            DocumentPredicate) const;
@@ -63,14 +211,74 @@ public:
     template <class ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&&, std::string_view) const;
 
+    // Версии FindTopDocuments() с переиспользуемым контекстом и буфером результата (однопоточные).
+    // После первых запросов контекст и буфер достигают нужной ёмкости, и дальше запросы
+    // без фраз и NEAR не выделяют динамическую память
+    template <typename DocumentPredicate>
+    void FindTopDocuments(QueryContext&, std::string_view, DocumentPredicate, std::vector<Document>&) const;
+    void FindTopDocuments(QueryContext&, std::string_view, DocumentStatus, std::vector<Document>&) const;
+    void FindTopDocuments(QueryContext&, std::string_view, std::vector<Document>&) const;
+
+    // Версии FindTopDocuments() с крайним сроком и/или флагом отмены (однопоточные). Ограничения проверяются
+    // между словами запроса и через каждые QueryControl::CHECK_INTERVAL элементов списков документов.
+    // Прерванный запрос возвращает пустой список документов и состояние TIMED_OUT или CANCELLED
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocuments(QueryContext&, std::string_view, DocumentPredicate, const QueryControl&) const;
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocuments(std::string_view, DocumentPredicate, const QueryControl&) const;
+    SearchResult FindTopDocuments(std::string_view, DocumentStatus, const QueryControl&) const;
+    SearchResult FindTopDocuments(std::string_view, const QueryControl&) const;
+
+    // Постраничный поиск: возвращает до page_size документов, следующих в порядке выдачи за курсором.
+    // Порядок выдачи строгий и полный (IsMoreRelevant()), поэтому страницы не пересекаются и не теряют
+    // документы. Документы до курсора отбрасываются сразу после оценки, отбирается только нужная страница,
+    // без сортировки всех найденных документов. Для page_size == 0 выбрасывает std::invalid_argument
+    template <typename DocumentPredicate>
+    ResultPage FindTopDocumentsAfter(QueryContext&, std::string_view, DocumentPredicate,
+                                     const SearchCursor&, size_t page_size) const;
+    template <typename DocumentPredicate>
+    ResultPage FindTopDocumentsAfter(std::string_view, DocumentPredicate, const SearchCursor&, size_t page_size) const;
+    ResultPage FindTopDocumentsAfter(std::string_view, DocumentStatus, const SearchCursor&, size_t page_size) const;
+    ResultPage FindTopDocumentsAfter(std::string_view, const SearchCursor&, size_t page_size) const;
+
+    // Поиск с ограниченным бюджетом по упорядоченным по вкладу спискам (IndexOptions::impact_ordered_postings
+    // и актуальный BuildImpacts()). Сегменты списков всех плюс-слов обрабатываются по убыванию вклада,
+    // пока не исчерпан бюджет; возвращаются лучшие документы по накопленным к этому моменту вкладам.
+    // Минус-слова, фразы и фильтры применяются полностью. Без актуальных упорядоченных списков
+    // выполняется обычный поиск без учёта бюджета (результат точный)
+    template <typename DocumentPredicate>
+    AnytimeResult FindTopDocumentsAnytime(QueryContext&, std::string_view, DocumentPredicate, const SearchBudget&) const;
+    template <typename DocumentPredicate>
+    AnytimeResult FindTopDocumentsAnytime(std::string_view, DocumentPredicate, const SearchBudget&) const;
+    AnytimeResult FindTopDocumentsAnytime(std::string_view, DocumentStatus, const SearchBudget&) const;
+    AnytimeResult FindTopDocumentsAnytime(std::string_view, const SearchBudget&) const;
+
+    // План выполнения запроса последовательными версиями FindTopDocuments(): стратегия, выбранная по числу
+    // документов слов запроса и верхним границам их вкладов в релевантность, и оценки стоимости всех стратегий.
+    // Параллельные версии FindTopDocuments() план не используют
+    template <typename DocumentPredicate>
+    QueryPlan ExplainQuery(std::string_view, DocumentPredicate) const;
+    QueryPlan ExplainQuery(std::string_view, DocumentStatus) const;
+    QueryPlan ExplainQuery(std::string_view) const;
+
     int GetDocumentCount() const;
 
     int GetDocumentId(int) const;
 
-    std::vector<int>::const_iterator begin();
+    std::pmr::vector<int>::const_iterator begin() const;
 
-    std::vector<int>::const_iterator end();
+    std::pmr::vector<int>::const_iterator end() const;
 
+    bool HasDocument(int) const;
+
+    // Текст, статус и рейтинг документа. Для неизвестного id выбрасывают std::out_of_range
+    std::string_view GetDocumentText(int) const;
+    DocumentStatus GetDocumentStatus(int) const;
+    int GetDocumentRating(int) const;
+    // Дополнительные числовые атрибуты документа с ненулевыми значениями
+    std::vector<std::pair<std::string_view, double>> GetDocumentAttributes(int) const;
+
+    // Найденные слова ссылаются на словарь сервера и действительны до удаления документов из индекса
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view, int) const;
 
     // Версия MatchDocument() для политики последовательного выполнения
@@ -79,6 +287,13 @@ public:
     // Версия MatchDocument() для политики параллельного выполнения
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, std::string_view, int);
 
+    // Матчинг запроса с набором документов: запрос разбирается один раз, документы обрабатываются
+    // независимо (параллельно для parallel_policy). Результаты идут в порядке переданных id
+    template <class ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(ExecutionPolicy&&,
+                                                                                          std::string_view,
+                                                                                          const std::vector<int>&) const;
+
     // Метод удаляет документ под указанным id изо всех контейнеров
     void RemoveDocument(int);
 
@@ -86,15 +301,84 @@ public:
     template <class ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&&, int);
 
-    // Метод возвращает словарь частоты слов для документа с указанным id
-    const std::map<std::string_view, double>& GetWordFrequencies(int) const;
+    // Метод задаёт значение дополнительного числового атрибута документа (см. DocumentFilter::attribute_ranges).
+    // Для неизвестного id выбрасывает std::out_of_range
+    void SetDocumentAttribute(int, std::string_view, double);
+
+    // Метод возвращает частоты слов документа с указанным id (пустое представление для неизвестного id).
+    // Представление не копирует данные и действительно, пока не изменилась версия индекса
+    WordFrequenciesView GetWordFrequencies(int) const;
+
+    // Версия индекса: увеличивается при каждом добавлении и удалении документа
+    uint64_t GetIndexVersion() const;
+
+    // Предвычисляет вклады слов в релевантность документов по текущей модели ранжирования и квантует
+    // их до 16 бит: поиск складывает целые вклады вместо вычисления оценки для каждого документа.
+    // Релевантность приближённая (погрешность вклада - половина шага квантования). Вклады зависят от
+    // числа документов, поэтому любое изменение индекса отключает их до следующего вызова BuildImpacts()
+    void BuildImpacts();
+
+    // Используются ли при поиске предвычисленные вклады (построены и индекс с тех пор не менялся)
+    bool HasCurrentImpacts() const;
+
+    // Доступен ли поиск с ограниченным бюджетом по упорядоченным по вкладу спискам
+    bool HasCurrentImpactOrder() const;
+
+    // Распределение занимаемой памяти по структурам сервера с учётом накладных расходов распределителя.
+    // Обходит весь индекс, время работы пропорционально его размеру
+    MemoryUsage GetMemoryUsage() const;
+
+    // Занимаемая память, поддерживаемая при изменениях индекса без его обхода: изменения затронутых структур
+    // учитываются по фактической ёмкости, поэтому значение совпадает с GetMemoryUsage().Total().
+    // С ней сравнивается IndexOptions::memory_budget
+    size_t GetEstimatedMemory() const;
+
+    // Ресурс памяти структур индекса (пул сервера при IndexMemoryMode::POOL)
+    std::pmr::memory_resource* GetIndexMemoryResource() const;
+
+    // Метод возвращает отсортированные id документов-дубликатов.
+    // Из каждой группы дубликатов остаётся документ с наименьшим id
+    std::vector<int> FindDuplicates(DuplicateMode mode = DuplicateMode::EXACT, double threshold = 1.0) const;
+
+    // Версия FindDuplicates() с поддержкой параллельного выполнения
+    template <class ExecutionPolicy>
+    std::vector<int> FindDuplicates(ExecutionPolicy&&, DuplicateMode mode = DuplicateMode::EXACT, double threshold = 1.0) const;
 
 private:
     struct DocumentData
     {
-        int rating;
-        DocumentStatus status;
-        std::string doc_text;   // Исходные строки документа. На их основе конструируются string_view
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        std::pmr::string doc_text;   // Исходные строки документа. На их основе конструируются string_view
+        // Текст документа вне сервера (PrepareDocument() с text_owner), doc_text при этом пуст
+        std::string_view external_text;
+
+        explicit DocumentData(const allocator_type& allocator = {})
+            : doc_text(allocator)
+        {
+        }
+
+        DocumentData(std::pmr::string&& text, const allocator_type& allocator)
+            : doc_text(std::move(text), allocator)
+        {
+        }
+
+        DocumentData(const DocumentData& other, const allocator_type& allocator)
+            : doc_text(other.doc_text, allocator)
+            , external_text(other.external_text)
+        {
+        }
+
+        DocumentData(DocumentData&& other, const allocator_type& allocator)
+            : doc_text(std::move(other.doc_text), allocator)
+            , external_text(other.external_text)
+        {
+        }
+
+        std::string_view GetText() const
+        {
+            return doc_text.empty() ? external_text : std::string_view(doc_text);
+        }
     };
 
     struct QueryWord
@@ -102,20 +386,39 @@ private:
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        bool is_prefix;     // Слово вида "кот*" - все слова сервера с префиксом "кот"
+        bool is_required;   // Слово вида "+кот" - документ обязан его содержать
+    };
+
+    // Условие на взаимное расположение слов запроса: фраза в кавычках или оператор NEAR/k
+    struct PositionalClause
+    {
+        std::vector<std::string_view> words;
+        // 0 - слова должны идти подряд (фраза), иначе - максимальное расстояние между двумя словами
+        int distance = 0;
     };
 
     // Структура запроса для обычных и последовательных алгоритмов
     struct Query
     {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        // Обязательные слова (+слово): входят и в plus_words, но документ должен содержать каждое из них
+        std::pmr::vector<std::string_view> required_words;
+        std::vector<PositionalClause> positional_clauses;
 
         Query() = default;
 
+        // Списки слов выделяются из resource
+        explicit Query(std::pmr::memory_resource*);
+
         explicit Query(size_t, size_t);
 
         explicit Query(size_t);
 
+        // Очищает запрос, сохраняя выделенную память
+        void Clear();
+
         // Выполняет сортировку и оставление уникальных значений в векторе (эмуляция set).
         // true для сортировки плюс-слов, false для сортировки минус-слов
         void SortUniq(bool);
@@ -125,16 +428,57 @@ private:
     };
 
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::vector<int> document_ids_;
+    const IndexOptions options_;
+    // Пул памяти индекса (только при IndexMemoryMode::POOL) и ресурс, из которого выделяется память индекса.
+    // Объявлены до контейнеров индекса, чтобы пул уничтожался после них
+    std::unique_ptr<std::pmr::synchronized_pool_resource> index_pool_;
+    std::pmr::memory_resource* index_resource_;
+    // Словарь слов сервера: слово <-> id, поиск по префиксу
+    TermDictionary dictionary_;
+    // Инвертированный индекс: для id слова - документы с частотой слова, разбитые по статусам документов
+    std::pmr::vector<StatusPostings> word_to_document_freqs_;
+    std::pmr::map<int, DocumentData> documents_;
+    // Владельцы внешних текстов документов (см. PrepareDocument()). Хранятся до уничтожения сервера
+    std::vector<std::shared_ptr<const void>> text_owners_;
+    // Рейтинг, статус и дополнительные атрибуты документов по столбцам
+    DocumentAttributeStore attributes_;
+    std::pmr::vector<int> document_ids_;
 
     //NEW
     // Словарь "номер документа - словарь частоты его слов"
-    std::map<int, std::map<std::string_view, double>> document_to_words_;
+    // Массив отсортирован по id слова
+    std::pmr::map<int, std::pmr::vector<WordFrequency>> document_to_words_;
+
+    uint64_t index_version_ = 0;
+
+    // Сигнатуры документов для поиска дубликатов
+    DuplicateDetector duplicate_detector_;
+
+    // Позиционный индекс "id слова - документ - сжатый список позиций" (заполняется только при options_.positional_index)
+    std::pmr::vector<std::pmr::map<int, PositionList>> word_to_document_positions_;
+
+    // Суммарное число слов документов (для средней длины документа в BM25)
+    uint64_t total_word_count_ = 0;
+
+    // См. GetEstimatedMemory()
+    size_t estimated_memory_ = 0;
+
+    // Квантованные вклады слов (см. BuildImpacts()): релевантность = сумма вкладов * impact_step_
+    std::vector<ImpactPostings> word_impacts_;
+    // Те же вклады в порядке убывания (строятся при options_.impact_ordered_postings)
+    std::vector<ImpactOrderedPostings> word_impact_order_;
+    double impact_step_ = 1.0;
+    // Версия индекса, для которой построены вклады
+    uint64_t impacts_version_ = UINT64_MAX;
+
+    static std::unique_ptr<std::pmr::synchronized_pool_resource> MakeIndexPool(const IndexOptions&);
+
+    // Слова индекса и стоп-слова хранятся в нижнем регистре (см. FoldCase())
+    static std::set<std::string, std::less<>> FoldStopWords(std::set<std::string, std::less<>>);
 
     bool IsStopWord(std::string_view) const;
 
+    // Слово (или текст) - корректный UTF-8 без управляющих символов
     static bool IsValidWord(std::string_view);
 
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view) const;
@@ -143,25 +487,444 @@ private:
 
     QueryWord ParseQueryWord(std::string_view) const;
 
+    // Разбирает слова запроса на плюс-, минус-слова и позиционные условия (без сортировки).
+    // Фразы в кавычках и NEAR/k распознаются только при позиционном индексе.
+    // Текст запроса нужен для сообщений об ошибках
+    void ParseQueryWords(std::string_view, const std::pmr::vector<std::string_view>&, Query&) const;
+
+    // Добавляет в запрос слово вне фраз (префиксное слово - все слова словаря с префиксом)
+    void AddQueryWord(const QueryWord&, Query&) const;
+
     template <class ExecutionPolicy>
     Query ParseQuery(ExecutionPolicy&&, std::string_view) const;
 
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+    // Разбирает запрос в буферы контекста (слова сортируются, повторы удаляются)
+    void ParseQuery(std::string_view, QueryContext&) const;
+
+    // Порядок выдачи: по убыванию релевантности, при равной релевантности - по убыванию рейтинга,
+    // при равном рейтинге - по возрастанию id. Релевантности равны, если округляются до одного
+    // кратного EPSILON, поэтому порядок строгий и полный: курсор страниц однозначно делит выдачу
+    static bool IsMoreRelevant(const Document&, const Document&);
+
+    // Слова запроса, переведённые в id словаря сервера (отсортированы, без повторов и неизвестных слов)
+    struct QueryWordIds
+    {
+        std::vector<int> plus;
+        std::vector<int> minus;
+        std::vector<int> required;
+    };
 
-    // Специализированный шаблон для последовательного выполнения
+    QueryWordIds ResolveQueryWords(const Query&) const;
+
+    // Матчинг разобранного запроса с одним документом
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchParsedQuery(const Query&, const QueryWordIds&, int) const;
+
+    // Вызывает function(id слова) для слов, общих у отсортированного списка id и прямого индекса документа
+    template <typename Function>
+    static void ForEachCommonWord(const std::vector<int>&,
+                                  const std::pmr::vector<WordFrequency>&,
+                                  Function);
+
+    // Проверяет позиционное условие для одного документа
+    bool MatchesPositionalClause(const PositionalClause&, int) const;
+
+    // Возвращает отсортированные id документов, удовлетворяющих всем позиционным условиям запроса
+    std::vector<int> FindPositionalMatches(const Query&) const;
+
+    // Оценка памяти нового документа во всех структурах сервера (кроме словаря и страниц атрибутов)
+    size_t EstimateDocumentMemory(size_t text_length, size_t word_count, size_t unique_word_count) const;
+    // Оценка памяти нового слова в словаре и индексах слов
+    size_t EstimateTermMemory(size_t length) const;
+    // Память словаря и массивов индексов, адресуемых id слова (вычисляется за O(1))
+    size_t GetTermStorageMemory() const;
+    // Удаляет из словаря слова документа, не оставшиеся ни в одном документе. Их id и места в индексах слов
+    // достаются следующим новым словам, поэтому при смене документов словарь и индексы слов не растут
+    void EraseUnusedTerms(const std::pmr::vector<WordFrequency>&);
+    // Память структур, общих для всех документов и не зависящих от их слов: словарь, атрибуты, document_ids_
+    size_t GetSharedMemory() const;
+    // Память, принадлежащая только документу: текст, прямой индекс, сигнатура, позиции слов
+    size_t GetDocumentMemory(int) const;
+    // Память списков документов слов документа
+    size_t GetPostingsMemory(const std::pmr::vector<WordFrequency>&) const;
+    // Память предвычисленных вкладов (BuildImpacts())
+    size_t GetImpactsMemory() const;
+    // Выбрасывает std::length_error, если документ не помещается в бюджет памяти
+    void CheckMemoryBudget(const PreparedDocument&) const;
+
+    // Выбрасывает std::out_of_range для неизвестного id документа
+    void CheckDocumentExists(int) const;
+    // Наибольший id документа + 1 (0 без документов): размер массивов и битовых карт, адресуемых id
+    size_t GetDocumentIdBound() const;
+
+    // IDF слова по модели ранжирования
+    double ComputeWordInverseDocumentFreq(int word_id) const;
+
+    // Вклад слова в релевантность документа (idf - результат ComputeWordInverseDocumentFreq())
+    double ComputeTermScore(double idf, int document_id, double term_freq, double average_word_count) const;
+
+    double GetAverageWordCount() const;
+
+    Bm25Parameters GetBm25Parameters() const;
+
+    // Вызывает function(id документа, вклад слова в релевантность) для документов слова,
+    // удовлетворяющих предикату. Для DocumentStatusFilter и DocumentFilter разделы перебираются блоками,
+    // вклады блока вычисляются ядрами score_kernels.h
+    template <typename DocumentPredicate, typename Function>
+    void ForEachScoredPosting(int word_id, const DocumentPredicate&, Function) const;
+
+    // Вызывает function(id документа, частота) для документов слова, удовлетворяющих предикату.
+    // Для DocumentStatusFilter перебирается только раздел с нужным статусом, без вызовов предиката,
+    // для DocumentFilter - разделы допустимых статусов (остальные условия проверяет ApplyDocumentFilter())
+    // Postings - StatusPostings или ImpactPostings
+    template <typename Postings, typename DocumentPredicate, typename Function>
+    void ForEachMatchingPosting(const Postings&, const DocumentPredicate&, Function) const;
+
+    // Вызывает function(id документа, частота) для документов слова, которые могут пройти предикат,
+    // не вызывая его: для фильтров по статусу - только разделы допустимых статусов, иначе все документы.
+    // Нужна для минус-слов: документы других статусов заведомо не попали в результат
+    template <typename Postings, typename DocumentPredicate, typename Function>
+    static void ForEachPostingInScope(const Postings&, const DocumentPredicate&, Function);
+
+    // Может ли документ с таким статусом удовлетворять предикату (произвольный предикат - любой статус)
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, 
-                                           const Query&,
-                                           DocumentPredicate) const;
+    static bool IsStatusInScope(const DocumentPredicate&, DocumentStatus);
+
+    // Оставляет в documents только документы, проходящие фильтр (порядок сохраняется).
+    // ids и keep - рабочие буферы
+    template <typename Allocator>
+    void ApplyDocumentFilter(const DocumentFilter&, std::vector<Document, Allocator>& documents,
+                             std::pmr::vector<int>& ids, std::pmr::vector<uint8_t>& keep) const;
+
+    // Рабочие буферы конъюнктивного поиска по обязательным словам запроса
+    struct RequiredMatchBuffers
+    {
+        // Списки документов обязательных слов по возрастанию размера
+        std::pmr::vector<const StatusPostings*> postings;
+        std::pmr::vector<int> candidates;
+        std::pmr::vector<int> next_candidates;
+        std::pmr::vector<int> matches;
+
+        RequiredMatchBuffers() = default;
+
+        explicit RequiredMatchBuffers(std::pmr::memory_resource* resource)
+            : postings(resource)
+            , candidates(resource)
+            , next_candidates(resource)
+            , matches(resource)
+        {
+        }
+    };
+
+    // Слово запроса в плане выполнения
+    struct PlannedTerm
+    {
+        int word_id = 0;
+        std::string_view word;
+        QueryTermRole role = QueryTermRole::PLUS;
+        // Число документов в разделах статусов, которые может пропустить предикат
+        size_t document_freq = 0;
+        bool is_dense = false;
+        // Верхняя граница вклада в релевантность документа (по тем же разделам)
+        double max_score = 0.0;
+    };
+
+    // План выполнения запроса (см. PlanQuery())
+    struct ExecutionPlan
+    {
+        QueryStrategy strategy = QueryStrategy::TERM_AT_A_TIME;
+        // Известные серверу плюс-слова (включая обязательные) по возрастанию числа документов
+        std::pmr::vector<PlannedTerm> plus_terms;
+        // Известные серверу минус-слова
+        std::pmr::vector<PlannedTerm> minus_terms;
+        // Рабочий буфер: номера плюс-слов по возрастанию max_score
+        std::pmr::vector<size_t> score_order;
+        std::array<double, QUERY_STRATEGY_COUNT> costs{};
+
+        ExecutionPlan() = default;
+
+        explicit ExecutionPlan(std::pmr::memory_resource* resource)
+            : plus_terms(resource)
+            , minus_terms(resource)
+            , score_order(resource)
+        {
+        }
+    };
+
+    // Сведения о предикате запроса, нужные планировщику
+    struct PredicateScope
+    {
+        // Статусы документов, которые может пропустить предикат
+        std::array<bool, DOCUMENT_STATUS_COUNT> statuses{};
+        // Предикат произвольный: вызывается для документов, а не сводится к выбору разделов и фильтру
+        bool is_arbitrary = false;
+    };
+
+    template <typename DocumentPredicate>
+    static PredicateScope GetPredicateScope(const DocumentPredicate&);
+
+    // Заполняет план: слова запроса со статистикой их списков, оценки стоимости стратегий и самую дешёвую.
+    // result_count - сколько лучших документов нужно вызывающему (0 - все найденные документы)
+    void PlanQuery(const Query&, const PredicateScope&, size_t result_count, ExecutionPlan&) const;
+
+    // Верхняя граница вклада слова в релевантность документов раздела статуса в единицах накопителя
+    // (для предвычисленных вкладов - в целых вкладах). idf - результат ComputeWordInverseDocumentFreq()
+    double GetTermScoreBound(int word_id, DocumentStatus, double idf, double average_word_count) const;
+
+    QueryPlan MakeQueryPlan(const ExecutionPlan&) const;
+
+    // Курсор по разделу списка плюс-слова для стратегии DOCUMENT_AT_A_TIME
+    template <typename Cursor>
+    struct TermCursor
+    {
+        Cursor cursor;
+        // Номер слова в ExecutionPlan::plus_terms
+        size_t term_index = 0;
+        double inverse_document_freq = 0.0;
+        // Верхняя граница вклада слова в документы раздела (в единицах накопителя)
+        double bound = 0.0;
+    };
+
+    // Рабочие буферы стратегии DOCUMENT_AT_A_TIME
+    struct DocumentAtATimeBuffers
+    {
+        std::pmr::vector<TermCursor<StatusPostings::Cursor>> cursors;
+        std::pmr::vector<TermCursor<ImpactPostings::Cursor>> impact_cursors;
+        std::pmr::vector<StatusPostings::Cursor> minus_cursors;
+        // Суммы границ вкладов курсоров от первого до данного включительно (курсоры упорядочены по границе)
+        std::pmr::vector<double> bound_sums;
+        // Вклады слов в текущий документ по номерам слов плана
+        std::pmr::vector<double> term_scores;
+        // Куча (наименьшая сверху) наибольших релевантностей принятых документов
+        std::pmr::vector<double> top_scores;
+
+        DocumentAtATimeBuffers() = default;
+
+        explicit DocumentAtATimeBuffers(std::pmr::memory_resource* resource)
+            : cursors(resource)
+            , impact_cursors(resource)
+            , minus_cursors(resource)
+            , bound_sums(resource)
+            , term_scores(resource)
+            , top_scores(resource)
+        {
+        }
+    };
+
+    // Последовательная версия: запрос берётся из контекста, найденные документы
+    // складываются в буфер контекста. result_count - сколько лучших документов будет отобрано
+    // из найденных (0 - нужны все найденные документы)
+    template <typename DocumentPredicate>
+    void FindAllDocuments(QueryContext&, DocumentPredicate, size_t result_count) const;
     // Специализированный шаблон для параллельного выполнения
     template <typename DocumentPredicate>
     std::vector<Document> FindAllDocuments(std::execution::parallel_policy, 
                                            const Query&,
                                            DocumentPredicate) const;
-    // Версия шаблона для вызова без указания политики выполнения (вызывает seq-версию)
+
+    // Общая часть поиска для точных оценок (ScoreAccumulator / double) и предвычисленных
+    // вкладов (ImpactAccumulator / uint64_t): релевантность = накопленная сумма * score_step.
+    // Выполняет запрос по стратегии плана
+    template <typename DocumentPredicate, typename Accumulator>
+    void CollectMatchedDocuments(const Query&, const ExecutionPlan&, const DocumentPredicate&, Accumulator&,
+                                 double score_step, size_t result_count, QueryControlChecker&, QueryContext&) const;
+    // Складывает в накопитель вклады плюс-слов плана по одному слову (TERM_AT_A_TIME). Документы, отмеченные
+    // в битовой карте excluded (если она задана), пропускаются до вызова предиката
+    template <typename DocumentPredicate, typename Accumulator>
+    void AccumulatePlusTerms(const ExecutionPlan&, const DocumentPredicate&, Accumulator&, QueryControlChecker&,
+                             const std::pmr::vector<uint64_t>* excluded) const;
+    // Снимает в плотном накопителе (BITMAP) отметки документов с минус-словами плана. Блоки списков,
+    // хранящиеся битовыми картами, вычитаются из отметок целыми 64-битными словами
+    template <typename DocumentPredicate, typename Score>
+    void ExcludeDenseMinusWords(const ExecutionPlan&, const DocumentPredicate&, DenseScoreAccumulator<Score>&,
+                                QueryControlChecker&) const;
+    // Добавляет в matched_documents документы накопителя, идущие в порядке выдачи после page_after
+    template <typename Accumulator>
+    void AppendMatchedDocuments(const Accumulator&, double score_step, const std::optional<Document>& page_after,
+                                std::pmr::vector<Document>& matched_documents) const;
+    // Отмечает в битовой карте документы с минус-словами плана (MINUS_FIRST)
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query&,
-                                           DocumentPredicate) const;
+    void MarkExcludedDocuments(const ExecutionPlan&, const DocumentPredicate&, std::pmr::vector<uint64_t>& excluded,
+                               QueryControlChecker&) const;
+    // Отбирает документы по спискам плюс-слов курсорами, документ за документом (DOCUMENT_AT_A_TIME, MaxScore).
+    // Курсоры упорядочены по верхней границе вклада; слова, суммарная граница которых меньше порога вхождения
+    // в result_count лучших, только уточняют оценку документов, найденных по остальным словам, и оценка
+    // прекращается, как только документ заведомо не проходит порог. В matched_documents попадают все
+    // документы после page_after (если он задан), которые могут войти в result_count лучших, и, возможно,
+    // часть остальных
+    template <typename Score, typename DocumentPredicate>
+    void CollectTopDocuments(const Query&, const ExecutionPlan&, const DocumentPredicate&, double score_step,
+                             size_t result_count, const std::optional<Document>& page_after, QueryControlChecker&,
+                             DocumentAtATimeBuffers&, std::pmr::vector<Document>& matched_documents) const;
+    // Удаляет из накопителя документы с минус-словами и не удовлетворяющие фразам и условиям NEAR
+    template <typename DocumentPredicate, typename Accumulator>
+    void ExcludeDocuments(const Query&, const DocumentPredicate&, Accumulator&, QueryControlChecker&) const;
+    template <typename DocumentPredicate, typename Accumulator>
+    void ExcludeMinusWords(const Query&, const DocumentPredicate&, Accumulator&, QueryControlChecker&) const;
+    template <typename Accumulator>
+    void KeepPositionalMatches(const Query&, Accumulator&, QueryControlChecker&) const;
+    template <typename Score, typename DocumentPredicate>
+    std::vector<Document> CollectMatchedDocuments(std::execution::parallel_policy, const Query&,
+                                                  const DocumentPredicate&, double score_step) const;
+
+    // Заполняет buffers.postings списками обязательных слов запроса. false - какое-то обязательное слово
+    // неизвестно серверу, и запросу не соответствует ни один документ
+    bool ResolveRequiredPostings(const Query&, RequiredMatchBuffers&) const;
+
+    // Собирает в buffers.candidates документы раздела status, содержащие все обязательные слова
+    // и удовлетворяющие предикату. Списки пересекаются начиная с самого редкого слова: каждый следующий
+    // список не перебирается целиком, а проходится галопирующим поиском от кандидатов
+    template <typename DocumentPredicate>
+    void CollectRequiredCandidates(const DocumentPredicate&, DocumentStatus, RequiredMatchBuffers&) const;
+
+    // Вызывает function(id документа, вклад слова в релевантность) для документов-кандидатов раздела status,
+    // содержащих слово. Score - double (точные оценки) или uint64_t (предвычисленные вклады)
+    template <typename Score, typename Function>
+    void ForEachCandidatePosting(int word_id, DocumentStatus, const std::pmr::vector<int>& candidates,
+                                 Function) const;
+
+    // Накапливает релевантность документов, содержащих все обязательные слова: плюс-слова плана оцениваются
+    // только для кандидатов, полученных пересечением списков обязательных слов
+    template <typename DocumentPredicate, typename Accumulator>
+    void CollectRequiredMatches(const Query&, const ExecutionPlan&, const DocumentPredicate&, RequiredMatchBuffers&,
+                                Accumulator&, QueryControlChecker&) const;
+
+    // Удаляет из накопителя документы, не содержащие всех обязательных слов запроса
+    template <typename DocumentPredicate, typename Accumulator>
+    void KeepRequiredMatches(const Query&, const DocumentPredicate&, RequiredMatchBuffers&, Accumulator&) const;
+};
+
+
+struct SearchServer::PreparedDocument
+{
+    // Различное слово документа: положение в GetTermText() и число вхождений
+    struct Term
+    {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        uint32_t count = 0;
+    };
+
+    // Текст выделяется из ресурса памяти индекса resource
+    PreparedDocument(int document_id, DocumentStatus status, int rating, std::pmr::memory_resource* resource)
+        : document_id(document_id)
+        , text(resource)
+        , status(status)
+        , rating(rating)
+    {
+    }
+
+    int document_id = 0;
+    // Выделяется из ресурса памяти индекса и переходит в индекс без копирования.
+    // Пуст, если документ ссылается на внешний текст
+    std::pmr::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int rating = 0;
+    // Число слов без стоп-слов
+    size_t word_count = 0;
+    // Различные слова (в нижнем регистре) в лексикографическом порядке
+    std::vector<Term> terms;
+    // Номера слов в terms в порядке следования в тексте (только при позиционном индексе)
+    std::vector<uint32_t> sequence;
+    // Текст в нижнем регистре, если в тексте есть заглавные буквы. Длина совпадает с текстом,
+    // положения слов отсчитываются в нём
+    std::string folded_text;
+    // Внешний текст и его владелец (PrepareDocument() с text_owner)
+    std::string_view external_text;
+    std::shared_ptr<const void> text_owner;
+
+    // Исходный текст документа
+    std::string_view GetText() const
+    {
+        return text_owner ? external_text : std::string_view(text);
+    }
+
+    // Текст, в котором лежат слова terms
+    std::string_view GetTermText() const
+    {
+        return folded_text.empty() ? GetText() : std::string_view(folded_text);
+    }
+
+    std::string_view GetTerm(const Term& term) const
+    {
+        return GetTermText().substr(term.offset, term.length);
+    }
+};
+
+
+// Контекст запроса: буферы разбора, накопитель релевантности и список найденных документов.
+// Создаётся один раз (например, на поток) и передаётся в FindTopDocuments() для каждого запроса.
+// Один контекст нельзя использовать из нескольких потоков одновременно
+class SearchServer::QueryContext
+{
+public:
+    QueryContext() = default;
+
+    // Буферы контекста выделяются из resource (например, пула потока или арены QueryArena).
+    // Ресурс должен существовать дольше контекста
+    explicit QueryContext(std::pmr::memory_resource* resource)
+        : query_words_(resource)
+        , query_(resource)
+        , document_to_relevance_(resource)
+        , document_to_impact_(resource)
+        , matched_documents_(resource)
+        , filter_ids_(resource)
+        , filter_keep_(resource)
+        , impact_cursors_(resource)
+        , required_buffers_(resource)
+        , plan_(resource)
+        , excluded_documents_(resource)
+        , document_at_a_time_buffers_(resource)
+        , dense_relevance_(resource)
+        , dense_impact_(resource)
+    {
+    }
+
+    // Выполнять запросы стратегией strategy вместо выбранной планировщиком (для проверки стратегий и замеров).
+    // Неприменимая к запросу стратегия заменяется выбором планировщика, std::nullopt - только планировщик
+    void SetStrategy(std::optional<QueryStrategy> strategy)
+    {
+        strategy_ = strategy;
+    }
+
+private:
+    friend class SearchServer;
+
+    std::pmr::vector<std::string_view> query_words_;
+    Query query_;
+    ScoreAccumulator document_to_relevance_;
+    ImpactAccumulator document_to_impact_;
+    std::pmr::vector<Document> matched_documents_;
+    // Буферы проверки DocumentFilter
+    std::pmr::vector<int> filter_ids_;
+    std::pmr::vector<uint8_t> filter_keep_;
+
+    // Позиция в упорядоченном по вкладу разделе списка для FindTopDocumentsAnytime()
+    struct ImpactCursor
+    {
+        const std::vector<ImpactPosting>* postings = nullptr;
+        size_t position = 0;
+        DocumentStatus status = DocumentStatus::ACTUAL;
+    };
+    std::pmr::vector<ImpactCursor> impact_cursors_;
+
+    RequiredMatchBuffers required_buffers_;
+
+    // План текущего запроса и буферы его стратегий
+    ExecutionPlan plan_;
+    // Битовая карта документов с минус-словами (MINUS_FIRST)
+    std::pmr::vector<uint64_t> excluded_documents_;
+    DocumentAtATimeBuffers document_at_a_time_buffers_;
+    // Плотные накопители стратегии BITMAP
+    DenseRelevanceAccumulator dense_relevance_;
+    DenseImpactAccumulator dense_impact_;
+    // Стратегия, заданная SetStrategy()
+    std::optional<QueryStrategy> strategy_;
+
+    // Ограничения выполняемого запроса (задаются версиями FindTopDocuments() с QueryControl)
+    const QueryControl* control_ = nullptr;
+    // Последний документ предыдущей страницы (FindTopDocumentsAfter()): документы не дальше него
+    // в порядке выдачи отбрасываются сразу после оценки и не попадают в matched_documents_
+    std::optional<Document> page_after_;
 };
 
 
@@ -212,8 +975,18 @@ void ForEach(ForwardRange& range, Function function)
 
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+SearchServer::SearchServer(const StringContainer& stop_words, const IndexOptions& options)
+    : stop_words_(FoldStopWords(MakeUniqueNonEmptyStrings(stop_words)))  // Extract non-empty stop words
+    , options_(options)
+    , index_pool_(MakeIndexPool(options))
+    , index_resource_(index_pool_ ? index_pool_.get()
+                      : options.memory_resource ? options.memory_resource : std::pmr::get_default_resource())
+    , word_to_document_freqs_(index_resource_)
+    , documents_(index_resource_)
+    , document_ids_(index_resource_)
+    , document_to_words_(index_resource_)
+    , duplicate_detector_(index_resource_)
+    , word_to_document_positions_(index_resource_)
 {
     using namespace std::string_literals;
 
@@ -221,6 +994,12 @@ SearchServer::SearchServer(const StringContainer& stop_words)
     {
         throw std::invalid_argument("Some of stop words are invalid"s);
     }
+    if (!(options_.bm25_k1 >= 0.0) || !(options_.bm25_b >= 0.0 && options_.bm25_b <= 1.0))
+    {
+        throw std::invalid_argument("Invalid BM25 parameters"s);
+    }
+
+    estimated_memory_ = GetMemoryUsage().Total();
 
 }
 
@@ -238,127 +1017,1126 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy,
                                                      std::string_view raw_query,
                                                      DocumentPredicate document_predicate) const
 {
-    const auto query = ParseQuery(policy, raw_query);
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>)
+    {
+        // Последовательная версия работает через одноразовый контекст запроса,
+        // буферы которого размещаются в арене и освобождаются разом после запроса
+        QueryArena arena(options_.query_arena);
+        QueryContext context(arena.GetResource());
+        std::vector<Document> result;
+        FindTopDocuments(context, raw_query, document_predicate, result);
+        return result;
+    }
+    else
+    {
+        const auto query = ParseQuery(policy, raw_query);
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
 
-    std::sort(policy, matched_documents.begin(), matched_documents.end(),
-              [](const Document& lhs, const Document& rhs)
-              {
-                  return lhs.relevance > rhs.relevance
-                      || (std::abs(lhs.relevance - rhs.relevance) < EPSILON && lhs.rating > rhs.rating);
-              });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
-    {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        METRICS_TIMER("query.top_k");
+        std::sort(policy, matched_documents.begin(), matched_documents.end(), IsMoreRelevant);
+        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+        {
+            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        }
+
+        return matched_documents;
     }
+}
 
-    return matched_documents;
+
+template <typename DocumentPredicate>
+void SearchServer::FindTopDocuments(QueryContext& context,
+                                    std::string_view raw_query,
+                                    DocumentPredicate document_predicate,
+                                    std::vector<Document>& result) const
+{
+    ParseQuery(raw_query, context);
+
+    FindAllDocuments(context, document_predicate, MAX_RESULT_DOCUMENT_COUNT);
+
+    METRICS_TIMER("query.top_k");
+    // Полная сортировка не нужна: упорядочиваем только первые MAX_RESULT_DOCUMENT_COUNT документов
+    auto& matched_documents = context.matched_documents_;
+    const size_t result_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(),
+                      IsMoreRelevant);
+
+    result.assign(matched_documents.begin(), matched_documents.begin() + result_count);
 }
 
 
-template <class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(QueryContext& context,
+                                            std::string_view raw_query,
+                                            DocumentPredicate document_predicate,
+                                            const QueryControl& control) const
 {
-    return FindTopDocuments(policy,
-                            raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                            {
-                                return document_status == status;
-                            });
+    SearchResult result;
+    context.control_ = &control;
+    try
+    {
+        QueryControlChecker(&control).Check();
+        FindTopDocuments(context, raw_query, document_predicate, result.documents);
+    }
+    catch (const QueryInterruptedError& error)
+    {
+        result.documents.clear();
+        result.status = error.GetStatus();
+        if (result.status == QueryStatus::CANCELLED)
+        {
+            METRICS_COUNTER_ADD("query.cancelled", 1);
+        }
+        else
+        {
+            METRICS_COUNTER_ADD("query.timed_out", 1);
+        }
+    }
+    catch (...)
+    {
+        context.control_ = nullptr;
+        throw;
+    }
+    context.control_ = nullptr;
+    return result;
 }
 
 
-template <class ExecutionPolicy>
-std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocuments(std::string_view raw_query,
+                                            DocumentPredicate document_predicate,
+                                            const QueryControl& control) const
 {
-    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+    QueryArena arena(options_.query_arena);
+    QueryContext context(arena.GetResource());
+    return FindTopDocuments(context, raw_query, document_predicate, control);
 }
 
 
-template <typename ExecutionPolicy>
-SearchServer::Query SearchServer::ParseQuery(ExecutionPolicy&& policy, std::string_view text) const
+template <typename DocumentPredicate>
+ResultPage SearchServer::FindTopDocumentsAfter(QueryContext& context,
+                                               std::string_view raw_query,
+                                               DocumentPredicate document_predicate,
+                                               const SearchCursor& after,
+                                               size_t page_size) const
 {
-    // Разбиваем запрос на слова
-    const std::vector<std::string_view> query_words = SplitIntoWordsView(text);
-    // Резервируем память только для плюс-слов
-    SearchServer::Query result;
-    result.plus_words.reserve(query_words.size());
+    using namespace std::string_literals;
 
-    for (std::string_view word : query_words)
+    if (page_size == 0)
     {
-        const auto query_word = ParseQueryWord(word);
-        if (!query_word.is_stop)
-        {
-            if (query_word.is_minus)
-            {
-                result.minus_words.push_back(query_word.data);
-            }
-            else
-            {
-                result.plus_words.push_back(query_word.data);
-            }
-        }
+        throw std::invalid_argument("Page size must be positive"s);
     }
 
-    if constexpr (!std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>)
+    ParseQuery(raw_query, context);
+
+    // Документы до курсора отбрасываются при оценке. Нужны page_size лучших после курсора и ещё один -
+    // признак следующей страницы, поэтому планировщик может выбрать отбор лучших документ за документом
+    if (!after.IsStart())
     {
-        result.SortUniq();
+        context.page_after_ = Document{ after.document_id, after.relevance, after.rating };
+    }
+    try
+    {
+        FindAllDocuments(context, document_predicate, std::min(page_size, documents_.size()) + 1);
+    }
+    catch (...)
+    {
+        context.page_after_.reset();
+        throw;
+    }
+    context.page_after_.reset();
+
+    METRICS_TIMER("query.top_k");
+    // Частичная сортировка на куче: O(N log page_size) вместо сортировки всех документов после курсора
+    auto& matched_documents = context.matched_documents_;
+    const size_t result_count = std::min(matched_documents.size(), page_size);
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(),
+                      IsMoreRelevant);
+
+    ResultPage page;
+    page.documents.assign(matched_documents.begin(), matched_documents.begin() + result_count);
+    page.has_more = matched_documents.size() > result_count;
+    if (result_count > 0)
+    {
+        const Document& last = page.documents.back();
+        page.next_cursor = { last.relevance, last.rating, last.id };
+    }
+    else
+    {
+        page.next_cursor = after;
     }
+    return page;
+}
 
-    return result;
+
+template <typename DocumentPredicate>
+ResultPage SearchServer::FindTopDocumentsAfter(std::string_view raw_query,
+                                               DocumentPredicate document_predicate,
+                                               const SearchCursor& after,
+                                               size_t page_size) const
+{
+    QueryArena arena(options_.query_arena);
+    QueryContext context(arena.GetResource());
+    return FindTopDocumentsAfter(context, raw_query, document_predicate, after, page_size);
 }
 
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy policy, 
-                                                     const SearchServer::Query& query,
-                                                     DocumentPredicate document_predicate) const
+AnytimeResult SearchServer::FindTopDocumentsAnytime(QueryContext& context,
+                                                    std::string_view raw_query,
+                                                    DocumentPredicate document_predicate,
+                                                    const SearchBudget& budget) const
 {
-    // Вектор результатов
-    std::vector<Document> matched_documents;
+    AnytimeResult result;
+    if (!HasCurrentImpactOrder())
+    {
+        FindTopDocuments(context, raw_query, document_predicate, result.documents);
+        return result;
+    }
 
-    // Стандартный однопоточный словарь
-    std::map<int, double> document_to_relevance;
+    ParseQuery(raw_query, context);
+    const Query& query = context.query_;
 
-    // Обрабатываем плюс-слова
+    METRICS_TIMER("query.anytime");
+    // По курсору на каждый раздел списка плюс-слова, который может содержать подходящие документы
+    auto& cursors = context.impact_cursors_;
+    cursors.clear();
     for (std::string_view word : query.plus_words)
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        const int word_id = dictionary_.Find(word);
+        if (word_id == TermDictionary::NOT_FOUND)
         {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
         {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating))
+            const auto& partition = word_impact_order_[word_id].GetPartition(static_cast<DocumentStatus>(status));
+            if (!partition.empty() && IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status)))
             {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                cursors.push_back({ &partition, 0, static_cast<DocumentStatus>(status) });
             }
         }
     }
 
-    // Обрабатываем минус-слова, удаляем из найденных документы с минус-словами
-    for (std::string_view word : query.minus_words)
+    // Куча курсоров по наибольшему вкладу в их следующем сегменте
+    const auto segment_less = [](const QueryContext::ImpactCursor& lhs, const QueryContext::ImpactCursor& rhs)
+    {
+        return (*lhs.postings)[lhs.position].impact < (*rhs.postings)[rhs.position].impact;
+    };
+    std::make_heap(cursors.begin(), cursors.end(), segment_less);
+
+    auto& document_to_impact = context.document_to_impact_;
+    document_to_impact.Clear();
+    const bool has_deadline = budget.deadline != SearchBudget::Clock::time_point::max();
+    while (!cursors.empty())
     {
-        if (word_to_document_freqs_.count(word) == 0)
+        if (result.processed_postings >= budget.max_postings
+            || (has_deadline && SearchBudget::Clock::now() >= budget.deadline))
         {
-            continue;
+            break;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+
+        std::pop_heap(cursors.begin(), cursors.end(), segment_less);
+        auto& cursor = cursors.back();
+        const std::vector<ImpactPosting>& postings = *cursor.postings;
+        const size_t segment_end = std::min({ postings.size(),
+                                              cursor.position + ImpactOrderedPostings::SEGMENT_SIZE,
+                                              cursor.position + (budget.max_postings - result.processed_postings) });
+        for (size_t i = cursor.position; i < segment_end; ++i)
         {
-            document_to_relevance.erase(document_id);
+            const auto [document_id, impact] = postings[i];
+            if constexpr (!std::is_same_v<DocumentPredicate, DocumentStatusFilter>
+                          && !std::is_same_v<DocumentPredicate, DocumentFilter>)
+            {
+                if (!document_predicate(document_id, cursor.status, attributes_.GetRating(document_id)))
+                {
+                    continue;
+                }
+            }
+            document_to_impact[document_id] += impact;
         }
-    }
-
-    // Заполняем вектор с найденными документами
-    for (const auto [document_id, relevance] : document_to_relevance)
-    {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
-    }
+        result.processed_postings += segment_end - cursor.position;
+        cursor.position = segment_end;
 
-    return matched_documents;
+        if (cursor.position == postings.size())
+        {
+            cursors.pop_back();
+        }
+        else
+        {
+            std::push_heap(cursors.begin(), cursors.end(), segment_less);
+        }
+    }
+    result.exact = cursors.empty();
+    if (!result.exact)
+    {
+        METRICS_COUNTER_ADD("query.anytime_truncated", 1);
+    }
+
+    if (!query.required_words.empty())
+    {
+        KeepRequiredMatches(query, document_predicate, context.required_buffers_, document_to_impact);
+    }
+    QueryControlChecker no_control(nullptr);
+    ExcludeDocuments(query, document_predicate, document_to_impact, no_control);
+
+    auto& matched_documents = context.matched_documents_;
+    matched_documents.clear();
+    document_to_impact.ForEach([this, &matched_documents](int document_id, uint64_t impact)
+                               {
+                                   matched_documents.push_back(
+                                       { document_id, impact * impact_step_, attributes_.GetRating(document_id) });
+                               });
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        ApplyDocumentFilter(document_predicate, matched_documents, context.filter_ids_, context.filter_keep_);
+    }
+
+    const size_t result_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(),
+                      IsMoreRelevant);
+    result.documents.assign(matched_documents.begin(), matched_documents.begin() + result_count);
+    return result;
+}
+
+
+template <typename DocumentPredicate>
+AnytimeResult SearchServer::FindTopDocumentsAnytime(std::string_view raw_query,
+                                                    DocumentPredicate document_predicate,
+                                                    const SearchBudget& budget) const
+{
+    QueryArena arena(options_.query_arena);
+    QueryContext context(arena.GetResource());
+    return FindTopDocumentsAnytime(context, raw_query, document_predicate, budget);
+}
+
+
+template <typename DocumentPredicate>
+QueryPlan SearchServer::ExplainQuery(std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    QueryArena arena(options_.query_arena);
+    QueryContext context(arena.GetResource());
+    ParseQuery(raw_query, context);
+    PlanQuery(context.query_, GetPredicateScope(document_predicate), MAX_RESULT_DOCUMENT_COUNT, context.plan_);
+    return MakeQueryPlan(context.plan_);
+}
+
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatusFilter{ status });
+}
+
+
+template <class ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const
+{
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+
+template <class ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(ExecutionPolicy&& policy,
+                                                                                                    std::string_view raw_query,
+                                                                                                    const std::vector<int>& document_ids) const
+{
+    using namespace std::string_literals;
+
+    if (!std::all_of(document_ids.begin(), document_ids.end(),
+                     [this](int document_id)
+                     {
+                         return documents_.count(document_id) > 0;
+                     }))
+    {
+        throw std::out_of_range("Invalid document_id"s);
+    }
+
+    // Разбор запроса и перевод слов в id выполняются один раз на весь набор документов
+    const auto query = ParseQuery(std::execution::seq, raw_query);
+    const auto word_ids = ResolveQueryWords(query);
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> results(document_ids.size());
+    std::transform(policy,
+                   document_ids.begin(), document_ids.end(),
+                   results.begin(),
+                   [this, &query, &word_ids](int document_id)
+                   {
+                       return MatchParsedQuery(query, word_ids, document_id);
+                   });
+
+    return results;
+}
+
+
+template <typename Function>
+void SearchServer::ForEachCommonWord(const std::vector<int>& word_ids,
+                                     const std::pmr::vector<WordFrequency>& document_words,
+                                     Function function)
+{
+    auto word_it = word_ids.begin();
+    auto document_it = document_words.begin();
+    while (word_it != word_ids.end() && document_it != document_words.end())
+    {
+        if (*word_it < document_it->word_id)
+        {
+            ++word_it;
+        }
+        else if (document_it->word_id < *word_it)
+        {
+            ++document_it;
+        }
+        else
+        {
+            function(*word_it);
+            ++word_it;
+            ++document_it;
+        }
+    }
+}
+
+
+template <class ExecutionPolicy>
+std::vector<int> SearchServer::FindDuplicates(ExecutionPolicy&& policy, DuplicateMode mode, double threshold) const
+{
+    return duplicate_detector_.FindDuplicates(policy, mode, threshold);
+}
+
+
+template <typename ExecutionPolicy>
+SearchServer::Query SearchServer::ParseQuery(ExecutionPolicy&&, std::string_view text) const
+{
+    METRICS_TIMER("query.parse");
+    SearchServer::Query result;
+    std::pmr::vector<std::string_view> words;
+    SplitIntoWordsView(text, words);
+    ParseQueryWords(text, words, result);
+
+    if constexpr (!std::is_same_v<ExecutionPolicy, std::execution::parallel_policy>)
+    {
+        result.SortUniq();
+    }
+
+    return result;
+}
+
+
+template <typename Postings, typename DocumentPredicate, typename Function>
+void SearchServer::ForEachMatchingPosting(const Postings& postings,
+                                          const DocumentPredicate& document_predicate,
+                                          Function function) const
+{
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>)
+    {
+        postings.ForEachInPartition(document_predicate.status, function);
+    }
+    else if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        ForEachPostingInScope(postings, document_predicate, function);
+    }
+    else
+    {
+        METRICS_COUNTER_ADD("query.predicate_calls", postings.size());
+        postings.ForEach([this, &document_predicate, &function](int document_id, auto value)
+                         {
+                             if (document_predicate(document_id,
+                                                    attributes_.GetStatus(document_id),
+                                                    attributes_.GetRating(document_id)))
+                             {
+                                 function(document_id, value);
+                             }
+                         });
+    }
+}
+
+
+template <typename Postings, typename DocumentPredicate, typename Function>
+void SearchServer::ForEachPostingInScope(const Postings& postings,
+                                         const DocumentPredicate& document_predicate,
+                                         Function function)
+{
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>)
+    {
+        postings.ForEachInPartition(document_predicate.status, function);
+    }
+    else if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            if (document_predicate.HasStatus(static_cast<DocumentStatus>(status)))
+            {
+                postings.ForEachInPartition(static_cast<DocumentStatus>(status), function);
+            }
+        }
+    }
+    else
+    {
+        postings.ForEach(function);
+    }
+}
+
+
+template <typename DocumentPredicate>
+bool SearchServer::IsStatusInScope(const DocumentPredicate& document_predicate, DocumentStatus status)
+{
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>)
+    {
+        return document_predicate.status == status;
+    }
+    else if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        return document_predicate.HasStatus(status);
+    }
+    else
+    {
+        return true;
+    }
+}
+
+
+template <typename DocumentPredicate>
+SearchServer::PredicateScope SearchServer::GetPredicateScope(const DocumentPredicate& document_predicate)
+{
+    PredicateScope scope;
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+    {
+        scope.statuses[status] = IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status));
+    }
+    scope.is_arbitrary = !std::is_same_v<DocumentPredicate, DocumentStatusFilter>
+        && !std::is_same_v<DocumentPredicate, DocumentFilter>;
+    return scope;
+}
+
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(QueryContext& context,
+                                    DocumentPredicate document_predicate,
+                                    size_t result_count) const
+{
+    // Накопители контекста: память сохраняется между запросами
+    auto& matched_documents = context.matched_documents_;
+    matched_documents.clear();
+    QueryControlChecker checker(context.control_);
+    PlanQuery(context.query_, GetPredicateScope(document_predicate), result_count, context.plan_);
+    if (context.strategy_ && !std::isinf(context.plan_.costs[static_cast<size_t>(*context.strategy_)]))
+    {
+        context.plan_.strategy = *context.strategy_;
+    }
+    if (HasCurrentImpacts())
+    {
+        CollectMatchedDocuments(context.query_, context.plan_, document_predicate, context.document_to_impact_,
+                                impact_step_, result_count, checker, context);
+    }
+    else
+    {
+        CollectMatchedDocuments(context.query_, context.plan_, document_predicate, context.document_to_relevance_,
+                                1.0, result_count, checker, context);
+    }
+
+    // Условия декларативного фильтра проверяются блоками по всем найденным документам сразу
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        ApplyDocumentFilter(document_predicate, matched_documents, context.filter_ids_, context.filter_keep_);
+    }
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::CollectMatchedDocuments(const Query& query,
+                                           const ExecutionPlan& plan,
+                                           const DocumentPredicate& document_predicate,
+                                           Accumulator& document_to_score,
+                                           double score_step,
+                                           size_t result_count,
+                                           QueryControlChecker& checker,
+                                           QueryContext& context) const
+{
+    using Score = std::conditional_t<std::is_same_v<Accumulator, ImpactAccumulator>, uint64_t, double>;
+
+    auto& matched_documents = context.matched_documents_;
+    document_to_score.Clear();
+
+    // Обрабатываем плюс- и минус-слова по стратегии плана
+    switch (plan.strategy)
+    {
+    case QueryStrategy::DOCUMENT_AT_A_TIME:
+    {
+        METRICS_COUNTER_ADD("query.plan.document_at_a_time", 1);
+        METRICS_TIMER("query.postings");
+        // Документы отбираются сразу в matched_documents, накопитель не нужен
+        CollectTopDocuments<Score>(query, plan, document_predicate, score_step, result_count, context.page_after_,
+                                   checker, context.document_at_a_time_buffers_, matched_documents);
+        return;
+    }
+    case QueryStrategy::BITMAP:
+    {
+        METRICS_COUNTER_ADD("query.plan.bitmap", 1);
+        auto& dense_to_score = [&context]() -> auto&
+        {
+            if constexpr (std::is_same_v<Score, uint64_t>)
+            {
+                return context.dense_impact_;
+            }
+            else
+            {
+                return context.dense_relevance_;
+            }
+        }();
+        dense_to_score.Reset(GetDocumentIdBound());
+        {
+            METRICS_TIMER("query.postings");
+            AccumulatePlusTerms(plan, document_predicate, dense_to_score, checker, nullptr);
+        }
+        ExcludeDenseMinusWords(plan, document_predicate, dense_to_score, checker);
+        KeepPositionalMatches(query, dense_to_score, checker);
+        AppendMatchedDocuments(dense_to_score, score_step, context.page_after_, matched_documents);
+        return;
+    }
+    case QueryStrategy::REQUIRED_INTERSECTION:
+    {
+        METRICS_COUNTER_ADD("query.plan.required_intersection", 1);
+        {
+            METRICS_TIMER("query.postings");
+            CollectRequiredMatches(query, plan, document_predicate, context.required_buffers_, document_to_score,
+                                   checker);
+        }
+        ExcludeDocuments(query, document_predicate, document_to_score, checker);
+        break;
+    }
+    case QueryStrategy::MINUS_FIRST:
+    {
+        METRICS_COUNTER_ADD("query.plan.minus_first", 1);
+        {
+            METRICS_TIMER("query.minus_words");
+            MarkExcludedDocuments(plan, document_predicate, context.excluded_documents_, checker);
+        }
+        {
+            METRICS_TIMER("query.postings");
+            AccumulatePlusTerms(plan, document_predicate, document_to_score, checker, &context.excluded_documents_);
+        }
+        KeepPositionalMatches(query, document_to_score, checker);
+        break;
+    }
+    case QueryStrategy::TERM_AT_A_TIME:
+    {
+        METRICS_COUNTER_ADD("query.plan.term_at_a_time", 1);
+        {
+            METRICS_TIMER("query.postings");
+            AccumulatePlusTerms(plan, document_predicate, document_to_score, checker, nullptr);
+        }
+        if (!query.required_words.empty())
+        {
+            KeepRequiredMatches(query, document_predicate, context.required_buffers_, document_to_score);
+        }
+        ExcludeDocuments(query, document_predicate, document_to_score, checker);
+        break;
+    }
+    }
+
+    // Заполняем вектор с найденными документами
+    AppendMatchedDocuments(document_to_score, score_step, context.page_after_, matched_documents);
+}
+
+
+template <typename Accumulator>
+void SearchServer::AppendMatchedDocuments(const Accumulator& document_to_score,
+                                          double score_step,
+                                          const std::optional<Document>& page_after,
+                                          std::pmr::vector<Document>& matched_documents) const
+{
+    document_to_score.ForEach([this, &matched_documents, &page_after, score_step](int document_id, auto score)
+                              {
+                                  const Document document{ document_id, score * score_step,
+                                                           attributes_.GetRating(document_id) };
+                                  if (!page_after || IsMoreRelevant(*page_after, document))
+                                  {
+                                      matched_documents.push_back(document);
+                                  }
+                              });
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::AccumulatePlusTerms(const ExecutionPlan& plan,
+                                       const DocumentPredicate& document_predicate,
+                                       Accumulator& document_to_score,
+                                       QueryControlChecker& checker,
+                                       const std::pmr::vector<uint64_t>* excluded) const
+{
+    const auto is_excluded = [excluded](int document_id)
+    {
+        return excluded != nullptr && (((*excluded)[document_id / 64] >> (document_id % 64)) & 1) != 0;
+    };
+    const auto accumulate = [&](const auto& predicate, bool check_exclusion)
+    {
+        for (const PlannedTerm& term : plan.plus_terms)
+        {
+            checker.Check();
+            if constexpr (std::is_same_v<Accumulator, ImpactAccumulator>
+                          || std::is_same_v<Accumulator, DenseImpactAccumulator>)
+            {
+                ForEachMatchingPosting(word_impacts_[term.word_id], predicate,
+                                       [&](int document_id, uint16_t impact)
+                                       {
+                                           checker.Tick();
+                                           if (!check_exclusion || !is_excluded(document_id))
+                                           {
+                                               document_to_score[document_id] += impact;
+                                           }
+                                       });
+            }
+            else
+            {
+                ForEachScoredPosting(term.word_id, predicate,
+                                     [&](int document_id, double score)
+                                     {
+                                         checker.Tick();
+                                         if (!check_exclusion || !is_excluded(document_id))
+                                         {
+                                             document_to_score[document_id] += score;
+                                         }
+                                     });
+            }
+        }
+    };
+
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>
+                  || std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        accumulate(document_predicate, excluded != nullptr);
+    }
+    else
+    {
+        if (excluded != nullptr)
+        {
+            // Произвольный предикат не вызывается для исключённых документов
+            const auto predicate_with_exclusion = [&document_predicate, &is_excluded](int document_id,
+                                                                                     DocumentStatus status,
+                                                                                     int rating)
+            {
+                return !is_excluded(document_id) && document_predicate(document_id, status, rating);
+            };
+            accumulate(predicate_with_exclusion, false);
+        }
+        else
+        {
+            accumulate(document_predicate, false);
+        }
+    }
+}
+
+
+template <typename DocumentPredicate, typename Score>
+void SearchServer::ExcludeDenseMinusWords(const ExecutionPlan& plan,
+                                          const DocumentPredicate& document_predicate,
+                                          DenseScoreAccumulator<Score>& document_to_score,
+                                          QueryControlChecker& checker) const
+{
+    METRICS_TIMER("query.minus_words");
+    const PredicateScope scope = GetPredicateScope(document_predicate);
+    const auto erase = [&document_to_score, &checker](int document_id, auto)
+    {
+        checker.Tick();
+        document_to_score.Erase(document_id);
+    };
+    for (const PlannedTerm& term : plan.minus_terms)
+    {
+        checker.Check();
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            if (!scope.statuses[status])
+            {
+                continue;
+            }
+            word_to_document_freqs_[term.word_id].VisitPartition(
+                static_cast<DocumentStatus>(status),
+                [&document_to_score, &checker, &erase](const auto& partition)
+                {
+                    if constexpr (std::is_same_v<std::decay_t<decltype(partition)>, BitmapPostings>)
+                    {
+                        for (const BitmapPostings::Chunk& chunk : partition.GetChunks())
+                        {
+                            if (chunk.IsBitmap())
+                            {
+                                checker.Tick();
+                                document_to_score.EraseWords(static_cast<size_t>(chunk.key) * BitmapPostings::BITMAP_WORDS,
+                                                             chunk.bits.data(), chunk.bits.size());
+                            }
+                            else
+                            {
+                                BitmapPostings::ForEachInChunk(chunk, erase);
+                            }
+                        }
+                    }
+                    else
+                    {
+                        partition.ForEach(erase);
+                    }
+                });
+        }
+    }
+}
+
+
+template <typename DocumentPredicate>
+void SearchServer::MarkExcludedDocuments(const ExecutionPlan& plan,
+                                         const DocumentPredicate& document_predicate,
+                                         std::pmr::vector<uint64_t>& excluded,
+                                         QueryControlChecker& checker) const
+{
+    excluded.assign((GetDocumentIdBound() + 63) / 64, 0);
+    for (const PlannedTerm& term : plan.minus_terms)
+    {
+        checker.Check();
+        ForEachPostingInScope(word_to_document_freqs_[term.word_id], document_predicate,
+                              [&excluded, &checker](int document_id, double)
+                              {
+                                  checker.Tick();
+                                  excluded[document_id / 64] |= uint64_t{ 1 } << (document_id % 64);
+                              });
+    }
+}
+
+
+template <typename Score, typename DocumentPredicate>
+void SearchServer::CollectTopDocuments(const Query& query,
+                                       const ExecutionPlan& plan,
+                                       const DocumentPredicate& document_predicate,
+                                       double score_step,
+                                       size_t result_count,
+                                       const std::optional<Document>& page_after,
+                                       QueryControlChecker& checker,
+                                       DocumentAtATimeBuffers& buffers,
+                                       std::pmr::vector<Document>& matched_documents) const
+{
+    auto& cursors = [&buffers]() -> auto&
+    {
+        if constexpr (std::is_same_v<Score, uint64_t>)
+        {
+            return buffers.impact_cursors;
+        }
+        else
+        {
+            return buffers.cursors;
+        }
+    }();
+    auto& minus_cursors = buffers.minus_cursors;
+    auto& bound_sums = buffers.bound_sums;
+    auto& term_scores = buffers.term_scores;
+    auto& top_scores = buffers.top_scores;
+    term_scores.assign(plan.plus_terms.size(), 0.0);
+    top_scores.clear();
+
+    const std::vector<int> positional_matches = query.positional_clauses.empty()
+        ? std::vector<int>{}
+        : FindPositionalMatches(query);
+    const double average_word_count = GetAverageWordCount();
+    // Документ с оценкой ниже порога на margin заведомо уступает result_count лучшим
+    // (релевантности отличаются больше чем на EPSILON)
+    const double margin = EPSILON / score_step;
+    double threshold = -std::numeric_limits<double>::infinity();
+    // Не дающие вхождения в лучшие документы удаляются из matched_documents, когда их накопится много
+    const size_t compaction_size = 4 * result_count + 64;
+
+    for (size_t status_index = 0; status_index < DOCUMENT_STATUS_COUNT; ++status_index)
+    {
+        const DocumentStatus status = static_cast<DocumentStatus>(status_index);
+        if (!IsStatusInScope(document_predicate, status))
+        {
+            continue;
+        }
+        checker.Check();
+
+        cursors.clear();
+        for (size_t term_index = 0; term_index < plan.plus_terms.size(); ++term_index)
+        {
+            const int word_id = plan.plus_terms[term_index].word_id;
+            if constexpr (std::is_same_v<Score, uint64_t>)
+            {
+                const ImpactPostings& postings = word_impacts_[word_id];
+                if (postings.GetPartitionSize(status) > 0)
+                {
+                    cursors.push_back({ postings.GetCursor(status), term_index, 0.0,
+                                        static_cast<double>(postings.GetMaxImpact(status)) });
+                }
+            }
+            else
+            {
+                const StatusPostings& postings = word_to_document_freqs_[word_id];
+                if (postings.GetPartitionSize(status) > 0)
+                {
+                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_id);
+                    cursors.push_back({ postings.GetCursor(status), term_index, inverse_document_freq,
+                                        GetTermScoreBound(word_id, status, inverse_document_freq,
+                                                          average_word_count) });
+                }
+            }
+        }
+        if (cursors.empty())
+        {
+            continue;
+        }
+        std::sort(cursors.begin(), cursors.end(),
+                  [](const auto& lhs, const auto& rhs)
+                  {
+                      return lhs.bound < rhs.bound;
+                  });
+        bound_sums.clear();
+        double bound_sum = 0.0;
+        for (const auto& term_cursor : cursors)
+        {
+            bound_sum += term_cursor.bound;
+            bound_sums.push_back(bound_sum);
+        }
+
+        minus_cursors.clear();
+        for (const PlannedTerm& term : plan.minus_terms)
+        {
+            const StatusPostings& postings = word_to_document_freqs_[term.word_id];
+            if (postings.GetPartitionSize(status) > 0)
+            {
+                minus_cursors.push_back(postings.GetCursor(status));
+            }
+        }
+
+        const auto term_score = [this, average_word_count](const auto& term_cursor, int document_id)
+        {
+            if constexpr (std::is_same_v<Score, uint64_t>)
+            {
+                return static_cast<double>(term_cursor.cursor.Value());
+            }
+            else
+            {
+                return ComputeTermScore(term_cursor.inverse_document_freq, document_id,
+                                        term_cursor.cursor.Value(), average_word_count);
+            }
+        };
+
+        // Курсоры с first_essential и дальше - основные: документ, которого нет ни в одном из них,
+        // не наберёт порог даже с наибольшими вкладами остальных слов
+        size_t first_essential = 0;
+        while (first_essential < cursors.size() && bound_sums[first_essential] < threshold - margin)
+        {
+            ++first_essential;
+        }
+        while (first_essential < cursors.size())
+        {
+            int document_id = std::numeric_limits<int>::max();
+            for (size_t i = first_essential; i < cursors.size(); ++i)
+            {
+                if (cursors[i].cursor.Valid())
+                {
+                    document_id = std::min(document_id, cursors[i].cursor.DocumentId());
+                }
+            }
+            if (document_id == std::numeric_limits<int>::max())
+            {
+                break;
+            }
+            checker.Tick();
+
+            std::fill(term_scores.begin(), term_scores.end(), 0.0);
+            double score = 0.0;
+            for (size_t i = first_essential; i < cursors.size(); ++i)
+            {
+                auto& term_cursor = cursors[i];
+                if (term_cursor.cursor.Valid() && term_cursor.cursor.DocumentId() == document_id)
+                {
+                    const double term_score_value = term_score(term_cursor, document_id);
+                    term_scores[term_cursor.term_index] = term_score_value;
+                    score += term_score_value;
+                    term_cursor.cursor.Next();
+                }
+            }
+            // Остальные слова проверяются от наибольшей границы, пока документ может набрать порог
+            bool is_pruned = false;
+            for (size_t i = first_essential; i-- > 0;)
+            {
+                if (score + bound_sums[i] < threshold - margin)
+                {
+                    is_pruned = true;
+                    break;
+                }
+                auto& term_cursor = cursors[i];
+                term_cursor.cursor.SeekTo(document_id);
+                if (term_cursor.cursor.Valid() && term_cursor.cursor.DocumentId() == document_id)
+                {
+                    const double term_score_value = term_score(term_cursor, document_id);
+                    term_scores[term_cursor.term_index] = term_score_value;
+                    score += term_score_value;
+                }
+            }
+            if (is_pruned)
+            {
+                continue;
+            }
+
+            // Итоговая оценка складывается в порядке слов плана, как в накопителе TERM_AT_A_TIME
+            score = 0.0;
+            for (const double term_score_value : term_scores)
+            {
+                score += term_score_value;
+            }
+            if (score < threshold - margin)
+            {
+                continue;
+            }
+
+            if (std::any_of(minus_cursors.begin(), minus_cursors.end(),
+                            [document_id](StatusPostings::Cursor& cursor)
+                            {
+                                cursor.SeekTo(document_id);
+                                return cursor.Valid() && cursor.DocumentId() == document_id;
+                            }))
+            {
+                continue;
+            }
+            if (!query.positional_clauses.empty()
+                && !std::binary_search(positional_matches.begin(), positional_matches.end(), document_id))
+            {
+                continue;
+            }
+            const int rating = attributes_.GetRating(document_id);
+            if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+            {
+                uint8_t keep = 0;
+                attributes_.Filter(document_predicate, &document_id, 1, &keep);
+                if (keep == 0)
+                {
+                    continue;
+                }
+            }
+            else if constexpr (!std::is_same_v<DocumentPredicate, DocumentStatusFilter>)
+            {
+                if (!document_predicate(document_id, status, rating))
+                {
+                    continue;
+                }
+            }
+
+            const Document document{ document_id, score * score_step, rating };
+            if (page_after && !IsMoreRelevant(*page_after, document))
+            {
+                continue;
+            }
+            matched_documents.push_back(document);
+            if (top_scores.size() < result_count)
+            {
+                top_scores.push_back(score);
+                std::push_heap(top_scores.begin(), top_scores.end(), std::greater<>());
+            }
+            else if (score > top_scores.front())
+            {
+                std::pop_heap(top_scores.begin(), top_scores.end(), std::greater<>());
+                top_scores.back() = score;
+                std::push_heap(top_scores.begin(), top_scores.end(), std::greater<>());
+            }
+            if (top_scores.size() < result_count || top_scores.front() <= threshold)
+            {
+                continue;
+            }
+
+            threshold = top_scores.front();
+            while (first_essential < cursors.size() && bound_sums[first_essential] < threshold - margin)
+            {
+                ++first_essential;
+            }
+            if (matched_documents.size() > compaction_size)
+            {
+                const double min_relevance = (threshold - margin) * score_step;
+                matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(),
+                                                       [min_relevance](const Document& document)
+                                                       {
+                                                           return document.relevance < min_relevance;
+                                                       }),
+                                        matched_documents.end());
+            }
+        }
+    }
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::ExcludeDocuments(const Query& query,
+                                    const DocumentPredicate& document_predicate,
+                                    Accumulator& document_to_score,
+                                    QueryControlChecker& checker) const
+{
+    ExcludeMinusWords(query, document_predicate, document_to_score, checker);
+    KeepPositionalMatches(query, document_to_score, checker);
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::ExcludeMinusWords(const Query& query,
+                                     const DocumentPredicate& document_predicate,
+                                     Accumulator& document_to_score,
+                                     QueryControlChecker& checker) const
+{
+    // Обрабатываем минус-слова, удаляем из найденных документы с минус-словами
+    METRICS_TIMER("query.minus_words");
+    for (std::string_view word : query.minus_words)
+    {
+        checker.Check();
+        const int word_id = dictionary_.Find(word);
+        if (word_id == TermDictionary::NOT_FOUND)
+        {
+            continue;
+        }
+        ForEachPostingInScope(word_to_document_freqs_[word_id], document_predicate,
+                              [&document_to_score, &checker](int document_id, double)
+                              {
+                                  checker.Tick();
+                                  document_to_score.Erase(document_id);
+                              });
+    }
+}
+
+
+template <typename Accumulator>
+void SearchServer::KeepPositionalMatches(const Query& query,
+                                         Accumulator& document_to_score,
+                                         QueryControlChecker& checker) const
+{
+    // Оставляем только документы, удовлетворяющие фразам и условиям NEAR
+    if (query.positional_clauses.empty())
+    {
+        return;
+    }
+    checker.Check();
+    METRICS_TIMER("query.positional");
+    const std::vector<int> positional_matches = FindPositionalMatches(query);
+    document_to_score.EraseIfNot([&positional_matches](int document_id)
+                                 {
+                                     return std::binary_search(positional_matches.begin(),
+                                                               positional_matches.end(),
+                                                               document_id);
+                                 });
+}
+
+
+template <typename Allocator>
+void SearchServer::ApplyDocumentFilter(const DocumentFilter& filter,
+                                       std::vector<Document, Allocator>& documents,
+                                       std::pmr::vector<int>& ids,
+                                       std::pmr::vector<uint8_t>& keep) const
+{
+    METRICS_TIMER("query.filter");
+    ids.resize(documents.size());
+    keep.resize(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        ids[i] = documents[i].id;
+    }
+    attributes_.Filter(filter, ids.data(), ids.size(), keep.data());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        documents[kept] = documents[i];
+        kept += keep[i];
+    }
+    documents.resize(kept);
 }
 
 
@@ -366,56 +2144,143 @@ template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy policy, 
                                                      const SearchServer::Query& query,
                                                      DocumentPredicate document_predicate) const
+{
+    std::vector<Document> matched_documents = HasCurrentImpacts()
+        ? CollectMatchedDocuments<uint64_t>(policy, query, document_predicate, impact_step_)
+        : CollectMatchedDocuments<double>(policy, query, document_predicate, 1.0);
+
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        std::pmr::vector<int> filter_ids;
+        std::pmr::vector<uint8_t> filter_keep;
+        ApplyDocumentFilter(document_predicate, matched_documents, filter_ids, filter_keep);
+    }
+
+    return matched_documents;
+}
+
+
+template <typename Score, typename DocumentPredicate>
+std::vector<Document> SearchServer::CollectMatchedDocuments(std::execution::parallel_policy policy,
+                                                            const Query& query,
+                                                            const DocumentPredicate& document_predicate,
+                                                            double score_step) const
 {
     // Вектор результатов
     std::vector<Document> matched_documents;
 
     // Словарь с поддержкой параллельных алгоритмов
-    ConcurrentMap<int, double> document_to_relevance(BUCKETS_NUM);
+    ConcurrentMap<int, Score> document_to_score(BUCKETS_NUM);
 
     // Обработка плюс-слов
-    // Кастомный алгоритм с улучшенной параллелизацией
-    ForEach(policy,
-            query.plus_words,
-            [this, &document_to_relevance, &document_predicate](std::string_view word)
+    // Запрос с обязательными словами: плюс-слова параллельно оцениваются только для кандидатов
+    if (!query.required_words.empty())
+    {
+        METRICS_TIMER("query.postings");
+        RequiredMatchBuffers required_buffers;
+        if (ResolveRequiredPostings(query, required_buffers))
+        {
+            for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
             {
-                // Если плюс-слово есть в словаре частот слов
-                if (!word_to_document_freqs_.count(word) == 0)
+                if (!IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status)))
                 {
-                    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                    for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word))
-                    {
-                        const auto& document_data = documents_.at(document_id);
-                        if (document_predicate(document_id, document_data.status, document_data.rating))
+                    continue;
+                }
+                CollectRequiredCandidates(document_predicate, static_cast<DocumentStatus>(status), required_buffers);
+                if (required_buffers.candidates.empty())
+                {
+                    continue;
+                }
+                ForEach(policy,
+                        query.plus_words,
+                        [this, &document_to_score, &required_buffers, status](std::string_view word)
                         {
-                            document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                            const int word_id = dictionary_.Find(word);
+                            if (word_id == TermDictionary::NOT_FOUND)
+                            {
+                                return;
+                            }
+                            ForEachCandidatePosting<Score>(word_id, static_cast<DocumentStatus>(status),
+                                                           required_buffers.candidates,
+                                                           [&document_to_score](int document_id, Score score)
+                                                           {
+                                                               document_to_score[document_id] += score;
+                                                           });
                         }
+                );
+            }
+        }
+    }
+    // Кастомный алгоритм с улучшенной параллелизацией
+    else
+    {
+        METRICS_TIMER("query.postings");
+        ForEach(policy,
+                query.plus_words,
+                [this, &document_to_score, &document_predicate](std::string_view word)
+                {
+                    // Если плюс-слово есть в словаре сервера
+                    const int word_id = dictionary_.Find(word);
+                    if (word_id == TermDictionary::NOT_FOUND)
+                    {
+                        return;
+                    }
+                    if constexpr (std::is_same_v<Score, uint64_t>)
+                    {
+                        ForEachMatchingPosting(word_impacts_[word_id], document_predicate,
+                                               [&document_to_score](int document_id, uint16_t impact)
+                                               {
+                                                   document_to_score[document_id] += impact;
+                                               });
+                    }
+                    else
+                    {
+                        ForEachScoredPosting(word_id, document_predicate,
+                                             [&document_to_score](int document_id, double score)
+                                             {
+                                                 document_to_score[document_id] += score;
+                                             });
                     }
                 }
-            }
-    );
+        );
+    }
 
-    // Обработка минус-слов. Модификация словаря document_to_relevance, полученного по плюс-словам
+    // Обработка минус-слов. Модификация словаря document_to_score, полученного по плюс-словам
     // Кастомный алгоритм с улучшенной параллелизацией
-    ForEach(policy,
-            query.minus_words,
-            [this, &document_to_relevance](std::string_view word)
-            {
-                if (!word_to_document_freqs_.count(word) == 0)
+    {
+        METRICS_TIMER("query.minus_words");
+        ForEach(policy,
+                query.minus_words,
+                [this, &document_to_score, &document_predicate](std::string_view word)
                 {
-                    for (const auto [document_id, _] : word_to_document_freqs_.at(word))
+                    const int word_id = dictionary_.Find(word);
+                    if (word_id != TermDictionary::NOT_FOUND)
                     {
-                        // Erase у ConcurrentMap потокобезопасный
-                        document_to_relevance.Erase(document_id);
+                        ForEachPostingInScope(word_to_document_freqs_[word_id], document_predicate,
+                                              [&document_to_score](int document_id, double)
+                                              {
+                                                  // Erase у ConcurrentMap потокобезопасный
+                                                  document_to_score.Erase(document_id);
+                                              });
                     }
                 }
-            }
-    );
+        );
+    }
+
+    // Фразы и условия NEAR проверяются по позиционному индексу
+    const std::vector<int> positional_matches = query.positional_clauses.empty()
+        ? std::vector<int>{}
+        : FindPositionalMatches(query);
 
-    for (const auto& [document_id, relevance] : document_to_relevance.BuildOrdinaryMap())
+    for (const auto& [document_id, score] : document_to_score.BuildOrdinaryMap())
     {
+        if (!query.positional_clauses.empty()
+            && !std::binary_search(positional_matches.begin(), positional_matches.end(), document_id))
+        {
+            continue;
+        }
         matched_documents.emplace_back(
-            Document ( document_id, relevance, documents_.at(document_id).rating )
+            Document ( document_id, score * score_step, attributes_.GetRating(document_id) )
         );
     }
 
@@ -424,42 +2289,244 @@ std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_po
 
 
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const SearchServer::Query& query,
-                                                     DocumentPredicate document_predicate) const
+void SearchServer::CollectRequiredCandidates(const DocumentPredicate& document_predicate,
+                                             DocumentStatus status,
+                                             RequiredMatchBuffers& buffers) const
 {
-    return SearchServer::FindAllDocuments(std::execution::seq, query, document_predicate);
+    auto& candidates = buffers.candidates;
+    auto& next_candidates = buffers.next_candidates;
+    candidates.clear();
+    buffers.postings.front()->ForEachInPartition(status,
+                                                 [&candidates](int document_id, double)
+                                                 {
+                                                     candidates.push_back(document_id);
+                                                 });
+    for (size_t i = 1; i < buffers.postings.size() && !candidates.empty(); ++i)
+    {
+        next_candidates.clear();
+        const SortedIdsView candidate_view(candidates);
+        buffers.postings[i]->VisitPartition(status,
+                                            [&candidate_view, &next_candidates](const auto& partition)
+                                            {
+                                                IntersectPartitions(candidate_view, partition,
+                                                                    [&next_candidates](int document_id, double, double)
+                                                                    {
+                                                                        next_candidates.push_back(document_id);
+                                                                    });
+                                            });
+        candidates.swap(next_candidates);
+    }
+
+    if constexpr (!std::is_same_v<DocumentPredicate, DocumentStatusFilter>
+                  && !std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        METRICS_COUNTER_ADD("query.predicate_calls", candidates.size());
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                        [this, &document_predicate, status](int document_id)
+                                        {
+                                            return !document_predicate(document_id, status,
+                                                                       attributes_.GetRating(document_id));
+                                        }),
+                         candidates.end());
+    }
+    METRICS_COUNTER_ADD("query.required_candidates", candidates.size());
+}
+
+
+template <typename Score, typename Function>
+void SearchServer::ForEachCandidatePosting(int word_id,
+                                           DocumentStatus status,
+                                           const std::pmr::vector<int>& candidates,
+                                           Function function) const
+{
+    const SortedIdsView candidate_view(candidates);
+    if constexpr (std::is_same_v<Score, uint64_t>)
+    {
+        word_impacts_[word_id].VisitPartition(status,
+                                              [&candidate_view, &function](const auto& partition)
+                                              {
+                                                  IntersectPartitions(candidate_view, partition,
+                                                                      [&function](int document_id, double, uint16_t impact)
+                                                                      {
+                                                                          function(document_id, impact);
+                                                                      });
+                                              });
+    }
+    else
+    {
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_id);
+        const double average_word_count = GetAverageWordCount();
+        word_to_document_freqs_[word_id].VisitPartition(
+            status,
+            [this, &candidate_view, &function, inverse_document_freq, average_word_count](const auto& partition)
+            {
+                IntersectPartitions(candidate_view, partition,
+                                    [&](int document_id, double, double term_freq)
+                                    {
+                                        function(document_id, ComputeTermScore(inverse_document_freq, document_id,
+                                                                               term_freq, average_word_count));
+                                    });
+            });
+    }
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::CollectRequiredMatches(const Query& query,
+                                          const ExecutionPlan& plan,
+                                          const DocumentPredicate& document_predicate,
+                                          RequiredMatchBuffers& buffers,
+                                          Accumulator& document_to_score,
+                                          QueryControlChecker& checker) const
+{
+    using Score = std::conditional_t<std::is_same_v<Accumulator, ImpactAccumulator>, uint64_t, double>;
+
+    if (!ResolveRequiredPostings(query, buffers))
+    {
+        return;
+    }
+    for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+    {
+        if (!IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status)))
+        {
+            continue;
+        }
+        checker.Check();
+        CollectRequiredCandidates(document_predicate, static_cast<DocumentStatus>(status), buffers);
+        if (buffers.candidates.empty())
+        {
+            continue;
+        }
+        for (const PlannedTerm& term : plan.plus_terms)
+        {
+            checker.Check();
+            ForEachCandidatePosting<Score>(term.word_id, static_cast<DocumentStatus>(status), buffers.candidates,
+                                           [&document_to_score, &checker](int document_id, Score score)
+                                           {
+                                               checker.Tick();
+                                               document_to_score[document_id] += score;
+                                           });
+        }
+    }
+}
+
+
+template <typename DocumentPredicate, typename Accumulator>
+void SearchServer::KeepRequiredMatches(const Query& query,
+                                       const DocumentPredicate& document_predicate,
+                                       RequiredMatchBuffers& buffers,
+                                       Accumulator& document_to_score) const
+{
+    auto& matches = buffers.matches;
+    matches.clear();
+    if (ResolveRequiredPostings(query, buffers))
+    {
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            if (IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status)))
+            {
+                CollectRequiredCandidates(document_predicate, static_cast<DocumentStatus>(status), buffers);
+                matches.insert(matches.end(), buffers.candidates.begin(), buffers.candidates.end());
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+    }
+    document_to_score.EraseIfNot([&matches](int document_id)
+                                 {
+                                     return std::binary_search(matches.begin(), matches.end(), document_id);
+                                 });
+}
+
+
+template <typename DocumentPredicate, typename Function>
+void SearchServer::ForEachScoredPosting(int word_id,
+                                        const DocumentPredicate& document_predicate,
+                                        Function function) const
+{
+    const double inverse_document_freq = ComputeWordInverseDocumentFreq(word_id);
+    if constexpr (std::is_same_v<DocumentPredicate, DocumentStatusFilter>
+                  || std::is_same_v<DocumentPredicate, DocumentFilter>)
+    {
+        const Bm25Parameters bm25 = GetBm25Parameters();
+        int32_t word_counts[POSTING_BLOCK_SIZE];
+        double scores[POSTING_BLOCK_SIZE];
+        const auto score_block = [&](const int* ids, const TermFreq* term_freqs, size_t count)
+        {
+            if (options_.ranking == RankingModel::TF_IDF)
+            {
+                ComputeTfIdfScores(term_freqs, count, inverse_document_freq, scores);
+            }
+            else
+            {
+                attributes_.GatherWordCounts(ids, count, word_counts);
+                ComputeBm25Scores(term_freqs, word_counts, count, inverse_document_freq, bm25, scores);
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                function(ids[i], scores[i]);
+            }
+        };
+        for (size_t status = 0; status < DOCUMENT_STATUS_COUNT; ++status)
+        {
+            if (IsStatusInScope(document_predicate, static_cast<DocumentStatus>(status)))
+            {
+                word_to_document_freqs_[word_id].ForEachBlockInPartition(static_cast<DocumentStatus>(status), score_block);
+            }
+        }
+        return;
+    }
+    if (options_.ranking == RankingModel::TF_IDF)
+    {
+        ForEachMatchingPosting(word_to_document_freqs_[word_id], document_predicate,
+                               [&function, inverse_document_freq](int document_id, double term_freq)
+                               {
+                                   function(document_id, term_freq * inverse_document_freq);
+                               });
+        return;
+    }
+    const double average_word_count = GetAverageWordCount();
+    ForEachMatchingPosting(word_to_document_freqs_[word_id], document_predicate,
+                           [this, &function, inverse_document_freq, average_word_count](int document_id, double term_freq)
+                           {
+                               function(document_id,
+                                        ComputeTermScore(inverse_document_freq, document_id, term_freq, average_word_count));
+                           });
 }
 
 
 template <class ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id)
 {
-    // Берем только ссылки на слова удаляемого документа
-    const auto& word_freqs = document_to_words_.at(document_id);  // map<string, double>
-
-    // Создаём вектор указателей на слова необходимого размера
-    std::vector<const std::string*> words(word_freqs.size());
-    std::transform(
-        policy,
-        word_freqs.begin(), word_freqs.end(),
-        words.begin(),
-        [](const auto& word)
-        {
-            // word - map<string, double>
-            // Кладем указатель на слово
-            return &word.first;
-        });
-
-    std::mutex mutex_;
-    // Удаляем слова, перебирая указатели на них
-    std::for_each(policy, words.begin(), words.end(),
-                  [this, document_id](const std::string* word)
+    if (documents_.count(document_id) == 0)
+    {
+        return;
+    }
+
+    METRICS_TIMER("index.remove_document");
+
+    // Прямой индекс документа уже содержит id его слов. Слова документа различны, поэтому
+    // удаление из индекса разных слов затрагивает разные словари и не требует блокировок
+    const DocumentStatus status = attributes_.GetStatus(document_id);
+    const auto& word_freqs = document_to_words_.at(document_id);
+    const size_t previous_memory = GetDocumentMemory(document_id) + GetPostingsMemory(word_freqs) + GetSharedMemory();
+    total_word_count_ -= attributes_.GetWordCount(document_id);
+    std::for_each(policy, word_freqs.begin(), word_freqs.end(),
+                  [this, document_id, status](const WordFrequency& word)
                   {
-                      const std::lock_guard<std::mutex> lock(mutex_);
-                      word_to_document_freqs_.at(*word).erase(document_id);
+                      word_to_document_freqs_[word.word_id].Erase(document_id, status);
+                      if (options_.positional_index)
+                      {
+                          word_to_document_positions_[word.word_id].erase(document_id);
+                      }
                   });
+    EraseUnusedTerms(word_freqs);
+    const size_t postings_memory = GetPostingsMemory(word_freqs);
 
     documents_.erase(document_id);
+    document_ids_.erase(std::remove(document_ids_.begin(), document_ids_.end(), document_id), document_ids_.end());
     document_to_words_.erase(document_id);
-
+    duplicate_detector_.RemoveDocument(document_id);
+    attributes_.Remove(document_id);
+    estimated_memory_ -= previous_memory - postings_memory - GetSharedMemory();
+    ++index_version_;
 }
@@ -0,0 +1,875 @@
+#include "search_server_tests.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#include "concurrent_request_queue.h"
+#include "search_server.h"
+#include "string_processing.h"
+
+using namespace std;
+
+vector<int> GetDocumentIds(const vector<Document>& documents)
+{
+    vector<int> ids;
+    ids.reserve(documents.size());
+    for (const Document& document : documents)
+    {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+string GetTestFilePath(string_view name)
+{
+    return (filesystem::temp_directory_path() / ("search_server_test_"s + string(name))).string();
+}
+
+namespace
+{
+// Отсортированные id документов результата (для запросов, где порядок не проверяется)
+vector<int> GetSortedIds(const vector<Document>& documents)
+{
+    vector<int> ids = GetDocumentIds(documents);
+    sort(ids.begin(), ids.end());
+    return ids;
+}
+
+// Совпадение результатов с точностью EPSILON по релевантности
+bool AreSameResults(const vector<Document>& lhs, const vector<Document>& rhs)
+{
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i)
+    {
+        if (lhs[i].id != rhs[i].id || lhs[i].rating != rhs[i].rating
+            || abs(lhs[i].relevance - rhs[i].relevance) > EPSILON)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Корпус из count документов со словами w0..w<vocabulary_size - 1>, частоты слов убывают по закону Ципфа
+void AddRandomDocuments(SearchServer& server, mt19937& generator, int count, int vocabulary_size)
+{
+    for (int id = 0; id < count; ++id)
+    {
+        const int length = 5 + static_cast<int>(generator() % 25);
+        string text;
+        for (int i = 0; i < length; ++i)
+        {
+            const double rank = exp((generator() % 1000) / 1000.0 * log(static_cast<double>(vocabulary_size)));
+            text += (i > 0 ? " w"s : "w"s) + to_string(min(vocabulary_size - 1, static_cast<int>(rank) - 1));
+        }
+        server.AddDocument(id, text, static_cast<DocumentStatus>(generator() % 4 == 0 ? 1 : 0),
+                           { static_cast<int>(generator() % 10) });
+    }
+}
+
+void TestExcludeStopWordsFromAddedDocumentContent()
+{
+    SearchServer server("in the"s);
+    server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    ASSERT(server.FindTopDocuments("in"s).empty());
+    const vector<Document> found = server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(found.size(), 1u);
+    ASSERT_EQUAL(found[0].id, 42);
+    ASSERT_EQUAL(found[0].rating, 2);
+}
+
+void TestMinusWords()
+{
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "curly cat curly tail"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "nasty dog with big eyes"s, DocumentStatus::ACTUAL, { 3 });
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat dog -curly"s)), vector<int>({ 1, 3 }));
+    ASSERT(server.FindTopDocuments("cat -cat"s).empty());
+    ASSERT_THROWS(server.FindTopDocuments("cat --curly"s), invalid_argument);
+    ASSERT_THROWS(server.FindTopDocuments("cat -"s), invalid_argument);
+}
+
+void TestTfIdfRelevance()
+{
+    SearchServer server("и в на"s);
+    server.AddDocument(0, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(1, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    const vector<Document> found = server.FindTopDocuments("пушистый ухоженный кот"s);
+    // tf считается без стоп-слов: у документа 0 четыре слова
+    ASSERT_EQUAL(GetDocumentIds(found), vector<int>({ 1, 2, 0 }));
+    ASSERT(abs(found[0].relevance - (0.5 * log(3.0) + 0.25 * log(1.5))) < 1e-6);
+    ASSERT(abs(found[1].relevance - 0.25 * log(3.0)) < 1e-6);
+    ASSERT(abs(found[2].relevance - 0.25 * log(1.5)) < 1e-6);
+    ASSERT_EQUAL(found[0].rating, 5);
+    ASSERT_EQUAL(found[1].rating, -1);
+    ASSERT_EQUAL(found[2].rating, 2);
+}
+
+void TestBm25Relevance()
+{
+    IndexOptions options;
+    options.ranking = RankingModel::BM25;
+    SearchServer server(""s, options);
+    const vector<string> texts = { "cat dog"s, "cat cat cat bird fish"s, "bird"s, "dog dog fish fish fish fish"s };
+    for (size_t id = 0; id < texts.size(); ++id)
+    {
+        server.AddDocument(static_cast<int>(id), texts[id], DocumentStatus::ACTUAL, { 1 });
+    }
+    const double average_length = (2 + 5 + 1 + 6) / 4.0;
+    const auto bm25 = [&](double term_freq, double df, double length)
+    {
+        const double idf = log(1 + (4 - df + 0.5) / (df + 0.5));
+        return idf * term_freq * 2.2 / (term_freq + 1.2 * (0.25 + 0.75 * length / average_length));
+    };
+    // Частоты слов хранятся с одинарной точностью
+    const vector<Document> found = server.FindTopDocuments("cat fish"s);
+    ASSERT_EQUAL(GetDocumentIds(found), vector<int>({ 1, 3, 0 }));
+    ASSERT(abs(found[0].relevance - (bm25(3, 2, 5) + bm25(1, 2, 5))) < EPSILON);
+    ASSERT(abs(found[1].relevance - bm25(4, 2, 6)) < EPSILON);
+    ASSERT(abs(found[2].relevance - bm25(1, 2, 2)) < EPSILON);
+
+    IndexOptions invalid;
+    invalid.bm25_b = 2;
+    ASSERT_THROWS(SearchServer(""s, invalid), invalid_argument);
+}
+
+void TestPhraseQueries()
+{
+    IndexOptions options;
+    options.positional_index = true;
+    SearchServer server("and with"s, options);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "yellow white cat curly tail"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "cat is white hat"s, DocumentStatus::ACTUAL, { 3 });
+
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white cat\""s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"yellow white cat\""s)), vector<int>({ 2 }));
+    ASSERT(server.FindTopDocuments("\"cat white\""s).empty());
+    // Фраза - условие на документ, а не одно из слов запроса
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white hat\" tail"s)), vector<int>({ 3 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white cat\" tail"s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments(execution::par, "\"white cat\""s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white cat\" -curly"s)), vector<int>({ 1 }));
+    // Фраза из одного слова так же обязательна, как фраза из нескольких слов
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"tail\" cat"s)), vector<int>({ 2 }));
+    ASSERT(server.FindTopDocuments("\"dog\" cat"s).empty());
+
+    {
+        const auto [words, status] = server.MatchDocument("\"white cat\" tail"s, 2);
+        ASSERT_EQUAL(words.size(), 3u);
+        ASSERT(status == DocumentStatus::ACTUAL);
+    }
+    {
+        const auto [words, status] = server.MatchDocument("\"white cat\""s, 3);
+        ASSERT(words.empty());
+    }
+
+    server.RemoveDocument(1);
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white cat\""s)), vector<int>({ 2 }));
+
+    ASSERT_THROWS(server.FindTopDocuments("\"white cat"s), invalid_argument);
+    ASSERT_THROWS(server.FindTopDocuments("+\"white cat\""s), invalid_argument);
+    // Сообщение об ошибке содержит только некорректное слово, а не остаток запроса
+    string message;
+    try
+    {
+        server.FindTopDocuments("ca\x01t dog"s);
+    }
+    catch (const invalid_argument& error)
+    {
+        message = error.what();
+    }
+    ASSERT_EQUAL(message, "Query word ca\x01t is invalid"s);
+}
+
+void TestNearQueries()
+{
+    IndexOptions options;
+    options.positional_index = true;
+    SearchServer server("and with"s, options);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "yellow white cat curly tail"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "cat is white hat"s, DocumentStatus::ACTUAL, { 3 });
+
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("white NEAR/1 cat"s)), vector<int>({ 1, 2 }));
+    // NEAR/k не зависит от порядка слов
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat NEAR/1 white"s)), vector<int>({ 1, 2 }));
+    ASSERT(server.FindTopDocuments("tail NEAR/1 cat"s).empty());
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("tail NEAR/2 cat"s)), vector<int>({ 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments(execution::par, "tail NEAR/2 cat"s)), vector<int>({ 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat NEAR/2147483647 hat"s)), vector<int>({ 1, 3 }));
+
+    ASSERT_THROWS(server.FindTopDocuments("white NEAR/0 cat"s), invalid_argument);
+    // Оператор - только NEAR/ с цифрами, остальное - обычное слово
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("white NEAR/3x"s)), vector<int>({ 1, 2, 3 }));
+    ASSERT_THROWS(server.FindTopDocuments("white NEAR/99999999999999999999 cat"s), invalid_argument);
+}
+
+void TestQuotesAreWordsWithoutPositionalIndex()
+{
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "\"white NEAR/3"s, DocumentStatus::ACTUAL, { 2 });
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("\"white cat\""s)), vector<int>({ 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat NEAR/3"s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat -\"white"s)), vector<int>({ 1 }));
+}
+
+void TestPrefixQueries()
+{
+    IndexOptions options;
+    options.positional_index = true;
+    SearchServer server("and with"s, options);
+    server.AddDocument(1, "white cat and yellow hat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "yellow white cat curly tail"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "catalog is hat"s, DocumentStatus::ACTUAL, { 3 });
+
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat*"s)), vector<int>({ 1, 2, 3 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("catal*"s)), vector<int>({ 3 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments(execution::par, "cat* -curl*"s)), vector<int>({ 1, 3 }));
+    ASSERT(server.FindTopDocuments("dog*"s).empty());
+    {
+        const auto [words, status] = server.MatchDocument("ca* tail"s, 2);
+        ASSERT_EQUAL(words, vector<string_view>({ "cat"sv, "tail"sv }));
+    }
+    ASSERT_THROWS(server.FindTopDocuments("+cat*"s), invalid_argument);
+
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("cat*"s)), vector<int>({ 1, 2 }));
+}
+
+void TestCaseFolding()
+{
+    const auto fold = [](string text)
+    {
+        FoldCase(text.data(), text.size());
+        return text;
+    };
+    ASSERT_EQUAL(fold("Hello WORLD, Привет МИР Ёж"s), "hello world, привет мир ёж"s);
+    ASSERT_EQUAL(fold("ΑΒΓ ΆΈΌΏ Σ"s), "αβγ άέόώ σ"s);
+    ASSERT_EQUAL(fold("ÀÉÎÕÜ×ß"s), "àéîõü×ß"s);
+    ASSERT(!HasUpperCase("привет hello ×ß"s));
+    ASSERT(HasUpperCase("приВет"s));
+    ASSERT(IsValidText("привет мир"s));
+    ASSERT(!IsValidText("\xD0"s));
+    ASSERT(!IsValidText("\xC0\x80"s));
+    ASSERT(!IsValidText("abc\x01"s));
+
+    SearchServer server("И в На"s);
+    server.AddDocument(1, "Белый Кот и модный ошейник"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "ухоженный ПЁС выразительные глаза"s, DocumentStatus::ACTUAL, { 3 });
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("КОТ"s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("Кот -ОШЕЙНИК"s)), vector<int>({ 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("пёс"s)), vector<int>({ 3 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("ПУШ*"s)), vector<int>({ 2 }));
+    // Исходный текст документа сохраняется без свёртки регистра
+    ASSERT_EQUAL(server.GetDocumentText(1), "Белый Кот и модный ошейник"sv);
+    {
+        const auto [words, status] = server.MatchDocument("И"s, 1);
+        ASSERT(words.empty());
+    }
+    ASSERT_THROWS(server.AddDocument(4, "плохой \xD0 текст"s, DocumentStatus::ACTUAL, { 1 }), invalid_argument);
+    ASSERT_THROWS(server.FindTopDocuments("\xff"s), invalid_argument);
+}
+
+void TestRequiredWords()
+{
+    SearchServer server("и"s);
+    server.AddDocument(1, "белый кот и модный ошейник"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "пушистый кот пушистый хвост"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "ухоженный пёс выразительные глаза"s, DocumentStatus::ACTUAL, { 3 });
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("+кот пёс"s)), vector<int>({ 1, 2 }));
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("+кот +хвост"s)), vector<int>({ 2 }));
+    ASSERT(server.FindTopDocuments("+кот +неизвестное"s).empty());
+    ASSERT(server.FindTopDocuments("+кот -кот"s).empty());
+    // Обязательное стоп-слово не ограничивает выдачу
+    ASSERT_EQUAL(GetSortedIds(server.FindTopDocuments("+и кот"s)), vector<int>({ 1, 2 }));
+    {
+        const auto [words, status] = server.MatchDocument("+хвост кот"s, 1);
+        ASSERT(words.empty());
+    }
+    for (const string& query : { "+"s, "+-кот"s, "-+кот"s, "++кот"s })
+    {
+        ASSERT_THROWS(server.FindTopDocuments(query), invalid_argument);
+    }
+}
+
+void TestMatchDocuments()
+{
+    SearchServer server("and with"s);
+    int id = 0;
+    for (const string& text : { "funny pet and nasty rat"s, "funny pet with curly hair"s,
+                                "funny pet and not very nasty rat"s, "pet with rat and rat and rat"s })
+    {
+        server.AddDocument(++id, text, DocumentStatus::ACTUAL, { 1, 2 });
+    }
+    const string query = "curly and funny -not"s;
+    const auto batch = server.MatchDocuments(execution::par, query, { 4, 3, 2, 1 });
+    ASSERT_EQUAL(batch.size(), 4u);
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        const auto [words, status] = server.MatchDocument(query, 4 - static_cast<int>(i));
+        ASSERT_EQUAL(get<0>(batch[i]), words);
+    }
+    ASSERT_EQUAL(get<0>(batch[1]).size(), 0u);
+    ASSERT_EQUAL(get<0>(batch[2]), vector<string_view>({ "curly"sv, "funny"sv }));
+}
+
+void TestStatusAndFilters()
+{
+    mt19937 generator(7);
+    SearchServer server("w0"s);
+    AddRandomDocuments(server, generator, 3000, 200);
+    for (int id = 0; id < 3000; id += 11)
+    {
+        server.SetDocumentAttribute(id, "price"s, id % 100);
+    }
+    for (int id = 5; id < 3000; id += 13)
+    {
+        server.RemoveDocument(id);
+    }
+
+    SearchServer::QueryContext context;
+    vector<Document> buffer;
+    for (int i = 0; i < 100; ++i)
+    {
+        const string query = "w"s + to_string(1 + generator() % 199) + " w"s + to_string(1 + generator() % 40)
+                             + " -w"s + to_string(100 + generator() % 100);
+        for (DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT })
+        {
+            const auto by_predicate = server.FindTopDocuments(query, [status](int, DocumentStatus document_status, int)
+                                                              {
+                                                                  return document_status == status;
+                                                              });
+            ASSERT(AreSameResults(server.FindTopDocuments(query, status), by_predicate));
+            ASSERT(AreSameResults(server.FindTopDocuments(execution::par, query, status), by_predicate));
+            server.FindTopDocuments(context, query, status, buffer);
+            ASSERT(AreSameResults(buffer, by_predicate));
+        }
+
+        DocumentFilter filter;
+        filter.min_rating = 2;
+        filter.max_rating = 7;
+        filter.status_mask = DocumentFilter::StatusMask({ DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT });
+        filter.id_modulo = 3;
+        filter.id_remainder = i % 3;
+        if (i % 2 == 0)
+        {
+            filter.attribute_ranges.push_back({ "price"s, 20.0, 70.0 });
+        }
+        const auto matches_filter = [&server, &filter](int document_id, DocumentStatus, int rating)
+        {
+            if (rating < filter.min_rating || rating > filter.max_rating || document_id % 3 != filter.id_remainder)
+            {
+                return false;
+            }
+            if (filter.attribute_ranges.empty())
+            {
+                return true;
+            }
+            // Документ без атрибута имеет значение 0
+            const auto attributes = server.GetDocumentAttributes(document_id);
+            const double price = attributes.empty() ? 0.0 : attributes[0].second;
+            return price >= 20.0 && price <= 70.0;
+        };
+        const auto by_predicate = server.FindTopDocuments(query, matches_filter);
+        ASSERT(AreSameResults(server.FindTopDocuments(query, filter), by_predicate));
+        ASSERT(AreSameResults(server.FindTopDocuments(execution::par, query, filter), by_predicate));
+    }
+
+    DocumentFilter unknown_attribute;
+    unknown_attribute.attribute_ranges.push_back({ "unknown"s, 0.0, 1.0 });
+    ASSERT_THROWS(server.FindTopDocuments("w5"s, unknown_attribute), invalid_argument);
+    ASSERT_THROWS(server.SetDocumentAttribute(5, "price"s, 1.0), out_of_range);
+}
+
+void TestImpacts()
+{
+    mt19937 generator(3);
+    IndexOptions options;
+    options.ranking = RankingModel::BM25;
+    options.impact_ordered_postings = true;
+    SearchServer server("w0"s, options), exact("w0"s, options);
+    AddRandomDocuments(server, generator, 2000, 300);
+    generator.seed(3);
+    AddRandomDocuments(exact, generator, 2000, 300);
+
+    ASSERT(!server.HasCurrentImpacts());
+    server.BuildImpacts();
+    ASSERT(server.HasCurrentImpacts() && server.HasCurrentImpactOrder());
+    for (int i = 0; i < 50; ++i)
+    {
+        const string query = "w"s + to_string(1 + generator() % 299) + " w"s + to_string(1 + generator() % 50)
+                             + " -w"s + to_string(100 + generator() % 100);
+        // Релевантность по квантованным вкладам близка к точной
+        const auto found = server.FindTopDocuments(query);
+        for (const Document& document : found)
+        {
+            const auto reference = exact.FindTopDocuments(query, [&document](int id, DocumentStatus, int)
+                                                          {
+                                                              return id == document.id;
+                                                          });
+            ASSERT_EQUAL(reference.size(), 1u);
+            ASSERT(abs(reference[0].relevance - document.relevance) < 1e-3);
+        }
+        const auto parallel = server.FindTopDocuments(execution::par, query);
+        ASSERT_EQUAL(GetDocumentIds(parallel), GetDocumentIds(found));
+
+        // Без ограничения бюджета поиск по упорядоченным спискам точен
+        const AnytimeResult anytime = server.FindTopDocumentsAnytime(query, SearchBudget{});
+        ASSERT(anytime.exact);
+        ASSERT_EQUAL(GetDocumentIds(anytime.documents), GetDocumentIds(found));
+
+        SearchBudget budget;
+        budget.max_postings = 100;
+        const AnytimeResult limited = server.FindTopDocumentsAnytime(query, budget);
+        ASSERT(limited.processed_postings <= 100);
+    }
+
+    server.AddDocument(100000, "w5 w6"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(!server.HasCurrentImpacts() && !server.HasCurrentImpactOrder());
+}
+
+void TestQueryControl()
+{
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat bird"s, DocumentStatus::ACTUAL, { 2 });
+
+    const SearchResult result = server.FindTopDocuments("cat"s, QueryControl{});
+    ASSERT(result.status == QueryStatus::OK);
+    ASSERT_EQUAL(GetDocumentIds(result.documents), GetDocumentIds(server.FindTopDocuments("cat"s)));
+
+    CancellationToken token;
+    token.Cancel();
+    QueryControl cancelled;
+    cancelled.token = &token;
+    const SearchResult interrupted = server.FindTopDocuments("cat"s, cancelled);
+    ASSERT(interrupted.status == QueryStatus::CANCELLED && interrupted.documents.empty());
+
+    // Контекст пригоден для следующих запросов после прерванного
+    SearchServer::QueryContext context;
+    ASSERT(server.FindTopDocuments(context, "cat"s, DocumentStatusFilter{}, cancelled).status == QueryStatus::CANCELLED);
+    vector<Document> found;
+    server.FindTopDocuments(context, "cat"s, found);
+    ASSERT_EQUAL(found.size(), 2u);
+}
+
+void TestPagination()
+{
+    SearchServer server(""s);
+    for (int id = 0; id < 23; ++id)
+    {
+        server.AddDocument(id, "cat"s + string(id % 4, ' ') + " dog"s + (id % 3 == 0 ? " cat"s : ""s),
+                           DocumentStatus::ACTUAL, { id % 5 });
+    }
+    const ResultPage all = server.FindTopDocumentsAfter("cat"s, SearchCursor{}, 100);
+    ASSERT_EQUAL(all.documents.size(), 23u);
+    ASSERT(!all.has_more);
+
+    vector<Document> paged;
+    SearchCursor cursor;
+    for (bool has_more = true; has_more;)
+    {
+        const ResultPage page = server.FindTopDocumentsAfter("cat"s, cursor, 5);
+        ASSERT(page.documents.size() <= 5u);
+        paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+        has_more = page.has_more;
+        cursor = page.next_cursor;
+    }
+    ASSERT_EQUAL(GetDocumentIds(paged), GetDocumentIds(all.documents));
+    ASSERT_EQUAL(GetDocumentIds(server.FindTopDocumentsAfter("cat"s, SearchCursor{}, 5).documents),
+                 GetDocumentIds(server.FindTopDocuments("cat"s)));
+    ASSERT_THROWS(server.FindTopDocumentsAfter("cat"s, SearchCursor{}, 0), invalid_argument);
+}
+
+// Страницы выдачи в совокупности совпадают с выдачей одной страницей: без повторов и пропусков,
+// в том числе при множестве документов с равной (с точностью EPSILON) релевантностью
+void TestPaginationCoversResults()
+{
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        mt19937 generator(13);
+        IndexOptions options;
+        options.ranking = mode == 0 ? RankingModel::TF_IDF : RankingModel::BM25;
+        SearchServer server("w0"s, options);
+        AddRandomDocuments(server, generator, 12000, 300);
+        if (mode == 2)
+        {
+            server.BuildImpacts();
+        }
+        DocumentFilter filter;
+        filter.min_rating = 2;
+        for (int i = 0; i < 12; ++i)
+        {
+            string query = "w"s + to_string(20 + generator() % 280) + " w"s + to_string(20 + generator() % 280);
+            if (i % 3 == 1)
+            {
+                query = "+"s + query + " -w"s + to_string(1 + generator() % 20);
+            }
+            else if (i % 3 == 2)
+            {
+                query += " w"s + to_string(5 + generator() % 10);
+            }
+            const auto check = [&server, &query](auto predicate)
+            {
+                const vector<Document> all
+                    = server.FindTopDocumentsAfter(query, predicate, SearchCursor{}, 1000000).documents;
+                for (size_t page_size : { 1, 7, 50 })
+                {
+                    vector<Document> paged;
+                    SearchServer::QueryContext context;
+                    SearchCursor cursor;
+                    for (bool has_more = true; has_more;)
+                    {
+                        const ResultPage page = server.FindTopDocumentsAfter(context, query, predicate, cursor, page_size);
+                        ASSERT(page.documents.size() == page_size || !page.has_more);
+                        paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+                        ASSERT(paged.size() <= all.size());
+                        has_more = page.has_more;
+                        cursor = page.next_cursor;
+                    }
+                    ASSERT_EQUAL(GetDocumentIds(paged), GetDocumentIds(all));
+                }
+                ASSERT_EQUAL(GetDocumentIds(server.FindTopDocumentsAfter(query, predicate, SearchCursor{}, 5).documents),
+                             GetDocumentIds(server.FindTopDocuments(query, predicate)));
+            };
+            check(DocumentStatusFilter{});
+            check(filter);
+        }
+    }
+
+    // Цепочка релевантностей с шагом меньше EPSILON: idf / L для длин документов L = 2000..2599
+    SearchServer server(""s);
+    for (int id = 0; id < 600; ++id)
+    {
+        string text = "x"s;
+        for (int i = 1; i < 2000 + id; ++i)
+        {
+            text += " f"s;
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { (id * 7) % 5 });
+        server.AddDocument(1000 + id, "y"s, DocumentStatus::ACTUAL, { 0 });
+    }
+    const vector<Document> all = server.FindTopDocumentsAfter("x"s, SearchCursor{}, 1000).documents;
+    ASSERT_EQUAL(all.size(), 600u);
+    for (size_t page_size : { 1, 3, 10 })
+    {
+        vector<Document> paged;
+        SearchCursor cursor;
+        for (bool has_more = true; has_more;)
+        {
+            const ResultPage page = server.FindTopDocumentsAfter("x"s, cursor, page_size);
+            paged.insert(paged.end(), page.documents.begin(), page.documents.end());
+            // Курсор, не продвигающийся по выдаче, зациклил бы постраничный обход
+            ASSERT(paged.size() <= all.size());
+            has_more = page.has_more;
+            cursor = page.next_cursor;
+        }
+        ASSERT_EQUAL(GetDocumentIds(paged), GetDocumentIds(all));
+    }
+}
+
+void TestRequiredIntersectionPlan()
+{
+    mt19937 generator(11);
+    SearchServer server("w0"s);
+    AddRandomDocuments(server, generator, 4000, 300);
+    for (int i = 0; i < 50; ++i)
+    {
+        const string first = "w"s + to_string(1 + generator() % 40);
+        const string second = "w"s + to_string(1 + generator() % 299);
+        const string optional = "w"s + to_string(1 + generator() % 299);
+        const string query = "+"s + first + " +"s + second + " "s + optional;
+        ASSERT(server.ExplainQuery(query).strategy == QueryStrategy::REQUIRED_INTERSECTION);
+
+        // Результат обязательных слов - результат запроса без "+", из которого оставлены документы с обоими словами
+        const auto contains = [&server](int id, const string& word)
+        {
+            return !get<0>(server.MatchDocument(word, id)).empty();
+        };
+        const auto reference = server.FindTopDocuments(first + " "s + second + " "s + optional,
+                                                       [&](int id, DocumentStatus status, int)
+                                                       {
+                                                           return status == DocumentStatus::ACTUAL
+                                                                  && contains(id, first) && contains(id, second);
+                                                       });
+        ASSERT(AreSameResults(server.FindTopDocuments(query), reference));
+        ASSERT(AreSameResults(server.FindTopDocuments(execution::par, query), reference));
+    }
+}
+
+// Все стратегии, применимые к запросу, дают тот же результат, что и TERM_AT_A_TIME
+void TestQueryStrategiesAgree()
+{
+    bool is_bitmap_planned = false;
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        mt19937 generator(17);
+        IndexOptions options;
+        options.ranking = mode == 1 || mode == 2 ? RankingModel::BM25 : RankingModel::TF_IDF;
+        options.positional_index = mode == 3;
+        SearchServer server("w0"s, options);
+        AddRandomDocuments(server, generator, 12000, 300);
+        if (mode == 2)
+        {
+            server.BuildImpacts();
+        }
+        for (int i = 0; i < 10; ++i)
+        {
+            const string first = "w"s + to_string(1 + generator() % 299);
+            const string second = "w"s + to_string(1 + generator() % 299);
+            const string frequent = "w"s + to_string(1 + generator() % 5);
+            vector<string> queries = { first + " "s + second, first + " "s + frequent + " -"s + second,
+                                       frequent + " "s + second + " -w"s + to_string(1 + generator() % 3),
+                                       "+"s + frequent + " "s + first };
+            string long_query = frequent;
+            for (int j = 0; j < 7; ++j)
+            {
+                long_query += " w"s + to_string(5 + generator() % 100);
+            }
+            queries.push_back(long_query);
+            if (options.positional_index)
+            {
+                queries.push_back("\""s + frequent + " "s + first + "\" "s + second);
+                queries.push_back(frequent + " NEAR/3 "s + first + " "s + second);
+            }
+            for (const string& query : queries)
+            {
+                is_bitmap_planned = is_bitmap_planned || server.ExplainQuery(query).strategy == QueryStrategy::BITMAP;
+                const auto check = [&server, &query](auto predicate)
+                {
+                    SearchServer::QueryContext context;
+                    context.SetStrategy(QueryStrategy::TERM_AT_A_TIME);
+                    vector<Document> expected;
+                    server.FindTopDocuments(context, query, predicate, expected);
+                    for (size_t strategy = 0; strategy < QUERY_STRATEGY_COUNT; ++strategy)
+                    {
+                        context.SetStrategy(static_cast<QueryStrategy>(strategy));
+                        vector<Document> found;
+                        server.FindTopDocuments(context, query, predicate, found);
+                        ASSERT(AreSameResults(found, expected));
+                    }
+                };
+                check(DocumentStatus::ACTUAL);
+                check(DocumentStatus::IRRELEVANT);
+                DocumentFilter filter;
+                filter.min_rating = 3;
+                check(filter);
+                check([](int id, DocumentStatus, int)
+                      {
+                          return id % 3 != 0;
+                      });
+            }
+        }
+    }
+    ASSERT(is_bitmap_planned);
+}
+
+void TestDuplicates()
+{
+    SearchServer server("and with"s);
+    server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(3, "funny pet with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(4, "funny pet and curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(5, "funny funny pet and nasty nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(6, "funny pet and not very nasty rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(7, "very nasty rat and not very funny pet"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(8, "pet with rat and rat and rat"s, DocumentStatus::ACTUAL, { 1, 2 });
+    server.AddDocument(9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
+    ASSERT_EQUAL(server.FindDuplicates(), vector<int>({ 3, 4, 5, 7 }));
+    ASSERT_EQUAL(server.FindDuplicates(execution::par), vector<int>({ 3, 4, 5, 7 }));
+    // Жаккар множеств {funny, pet, nasty, rat} и {funny, pet, not, very, nasty, rat} - 4/6
+    ASSERT_EQUAL(server.FindDuplicates(DuplicateMode::JACCARD, 0.6), vector<int>({ 3, 4, 5, 6, 7 }));
+}
+
+void TestMemoryBudget()
+{
+    SearchServer unlimited(""s);
+    unlimited.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+
+    IndexOptions options;
+    options.memory_budget = unlimited.GetEstimatedMemory() + 512;
+    SearchServer server(""s, options);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_THROWS(server.AddDocument(2, string(4096, 'x'), DocumentStatus::ACTUAL, { 1 }), length_error);
+    // Документ, не поместившийся в бюджет, не меняет индекс
+    ASSERT_EQUAL(server.GetDocumentCount(), 1);
+    ASSERT(server.FindTopDocuments(string(4096, 'x')).empty());
+    ASSERT(server.GetEstimatedMemory() <= options.memory_budget);
+
+    // Поддерживаемая оценка совпадает с полным подсчётом при любых изменениях индекса
+    for (bool positional_index : { false, true })
+    {
+        mt19937 generator(3);
+        IndexOptions tracked_options;
+        tracked_options.positional_index = positional_index;
+        SearchServer tracked("w0"s, tracked_options);
+        AddRandomDocuments(tracked, generator, 1000, 300);
+        ASSERT_EQUAL(tracked.GetEstimatedMemory(), tracked.GetMemoryUsage().Total());
+        tracked.SetDocumentAttribute(5, "price"s, 1.0);
+        tracked.BuildImpacts();
+        ASSERT_EQUAL(tracked.GetEstimatedMemory(), tracked.GetMemoryUsage().Total());
+        for (int id = 0; id < 1000; id += 3)
+        {
+            tracked.RemoveDocument(id);
+        }
+        tracked.RemoveDocument(execution::par, 1);
+        ASSERT_EQUAL(tracked.GetEstimatedMemory(), tracked.GetMemoryUsage().Total());
+    }
+}
+
+// Слова удалённых документов освобождаются: при постоянной смене документов словарь не растёт
+void TestTermRecycling()
+{
+    for (bool positional_index : { false, true })
+    {
+        IndexOptions options;
+        options.positional_index = positional_index;
+        SearchServer server("and"s, options);
+        size_t dictionary_memory = 0;
+        for (int id = 0; id < 20000; ++id)
+        {
+            server.AddDocument(id, "cat u"s + to_string(id) + " u"s + to_string(id + 1), DocumentStatus::ACTUAL, { 1 });
+            if (id >= 100)
+            {
+                server.RemoveDocument(id - 100);
+            }
+            if (id == 5000)
+            {
+                dictionary_memory = server.GetMemoryUsage().dictionary;
+            }
+        }
+        ASSERT(server.GetMemoryUsage().dictionary <= dictionary_memory);
+        ASSERT_EQUAL(server.GetEstimatedMemory(), server.GetMemoryUsage().Total());
+        // Слова с повторно использованными id находят только новые документы
+        vector<int> found_ids = GetDocumentIds(server.FindTopDocuments("u19950"s));
+        sort(found_ids.begin(), found_ids.end());
+        ASSERT_EQUAL(found_ids, vector<int>({ 19949, 19950 }));
+        ASSERT(server.FindTopDocuments("u50"s).empty());
+        ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 5u);
+        const auto [words, status] = server.MatchDocument("cat u19999"s, 19999);
+        ASSERT_EQUAL(words, vector<string_view>({ "cat"sv, "u19999"sv }));
+    }
+}
+
+void TestIndexMemoryPool()
+{
+    mt19937 generator(5);
+    IndexOptions options;
+    options.index_memory = IndexMemoryMode::POOL;
+    SearchServer pooled("w0"s, options), plain("w0"s);
+    AddRandomDocuments(pooled, generator, 1500, 200);
+    generator.seed(5);
+    AddRandomDocuments(plain, generator, 1500, 200);
+    ASSERT(pooled.GetIndexMemoryResource() != plain.GetIndexMemoryResource());
+    for (int id = 0; id < 1500; id += 3)
+    {
+        pooled.RemoveDocument(id);
+        plain.RemoveDocument(id);
+    }
+    for (int i = 0; i < 30; ++i)
+    {
+        const string query = "w"s + to_string(1 + generator() % 199) + " w"s + to_string(1 + generator() % 30);
+        ASSERT(AreSameResults(pooled.FindTopDocuments(query), plain.FindTopDocuments(query)));
+    }
+}
+
+void TestConcurrentRequestQueue()
+{
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    ConcurrentRequestQueue queue(server, chrono::seconds(10));
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&queue]
+                             {
+                                 for (int i = 0; i < 500; ++i)
+                                 {
+                                     queue.AddFindRequest(i % 4 == 0 ? "bird"s : "cat"s);
+                                 }
+                             });
+    }
+    for (thread& t : threads)
+    {
+        t.join();
+    }
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 500);
+    const RequestStatistics statistics = queue.GetStatistics();
+    ASSERT_EQUAL(statistics.request_count, 2000u);
+    ASSERT_EQUAL(statistics.no_result_count, 500u);
+    ASSERT(statistics.latency_p50 <= statistics.latency_p99 && statistics.latency_p99 <= statistics.latency_max);
+
+    // Кольцо завершившегося потока достаётся новому потоку вместе с записанными запросами
+    for (int t = 0; t < 3; ++t)
+    {
+        thread([&queue]
+               {
+                   queue.AddFindRequest("bird"s);
+               })
+            .join();
+    }
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 503);
+    // Поток пишет в очереди, созданные по одному адресу, не путая их кольца
+    for (int i = 0; i < 2; ++i)
+    {
+        ConcurrentRequestQueue local_queue(server);
+        local_queue.AddFindRequest("cat"s);
+        ASSERT_EQUAL(local_queue.GetStatistics().request_count, 1u);
+    }
+
+    // Запросы вне окна статистики не учитываются
+    const auto now = ConcurrentRequestQueue::Clock::now();
+    queue.RecordRequest(0, chrono::milliseconds(5), now + chrono::seconds(5));
+    ASSERT_EQUAL(queue.GetStatistics(now + chrono::seconds(12)).request_count, 1u);
+    ASSERT_EQUAL(queue.GetStatistics(now + chrono::seconds(16)).request_count, 0u);
+}
+} // namespace
+
+void TestSearchQueries(TestRunner& runner)
+{
+    RUN_TEST(runner, TestExcludeStopWordsFromAddedDocumentContent);
+    RUN_TEST(runner, TestMinusWords);
+    RUN_TEST(runner, TestTfIdfRelevance);
+    RUN_TEST(runner, TestBm25Relevance);
+    RUN_TEST(runner, TestPhraseQueries);
+    RUN_TEST(runner, TestNearQueries);
+    RUN_TEST(runner, TestQuotesAreWordsWithoutPositionalIndex);
+    RUN_TEST(runner, TestPrefixQueries);
+    RUN_TEST(runner, TestCaseFolding);
+    RUN_TEST(runner, TestRequiredWords);
+    RUN_TEST(runner, TestMatchDocuments);
+    RUN_TEST(runner, TestStatusAndFilters);
+    RUN_TEST(runner, TestImpacts);
+    RUN_TEST(runner, TestQueryControl);
+    RUN_TEST(runner, TestPagination);
+    RUN_TEST(runner, TestPaginationCoversResults);
+    RUN_TEST(runner, TestRequiredIntersectionPlan);
+    RUN_TEST(runner, TestQueryStrategiesAgree);
+    RUN_TEST(runner, TestDuplicates);
+    RUN_TEST(runner, TestMemoryBudget);
+    RUN_TEST(runner, TestTermRecycling);
+    RUN_TEST(runner, TestIndexMemoryPool);
+    RUN_TEST(runner, TestConcurrentRequestQueue);
+}
+
+void TestSearchServer()
+{
+    TestRunner runner;
+    TestSearchQueries(runner);
+    TestIndexStructures(runner);
+    TestDurability(runner);
+    TestIngest(runner);
+}
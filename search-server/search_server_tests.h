@@ -0,0 +1,28 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+#include "test_framework.h"
+
+// Модульные тесты поискового сервера на test_framework.h. Группы тестов по файлам:
+//     search_server_tests.cpp - запросы: фразы, NEAR, префиксы, регистр, фильтры, ранжирование, страницы
+//     index_tests.cpp         - структуры индекса: словарь, позиции, контейнеры списков документов
+//     durability_tests.cpp    - журнал изменений и контрольные точки
+//     ingest_tests.cpp        - конвейер загрузки и загрузка отображённого файла корпуса
+void TestSearchQueries(TestRunner&);
+void TestIndexStructures(TestRunner&);
+void TestDurability(TestRunner&);
+void TestIngest(TestRunner&);
+
+// Запускает все группы тестов. Если хотя бы один тест провален, завершает программу с кодом 1
+void TestSearchServer();
+
+// id документов результата в порядке выдачи
+std::vector<int> GetDocumentIds(const std::vector<Document>&);
+
+// Путь к файлу теста во временном каталоге системы
+std::string GetTestFilePath(std::string_view name);
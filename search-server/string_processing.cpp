@@ -1,5 +1,8 @@
 #include "string_processing.h"
 
+#include <cstdint>
+#include <cstring>
+
 // Функция преобразует разделенный пробелами текст в вектор строк
 std::vector<std::string> SplitIntoWords(const std::string& text)
 {
@@ -30,32 +33,299 @@ std::vector<std::string> SplitIntoWords(const std::string& text)
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str_v)
 {
-    using namespace std::string_literals;
-
     std::vector<std::string_view> result;
+    SplitIntoWordsView(str_v, result);
+    return result;
+}
+
+
+namespace
+{
+constexpr uint64_t ONES = 0x0101010101010101ull;
+constexpr uint64_t HIGH_BITS = ONES * 0x80;
+
+uint64_t LoadBlock(const char* data)
+{
+    uint64_t block;
+    std::memcpy(&block, data, sizeof(block));
+    return block;
+}
+
+// Блок из 8 байт без старших битов (только ASCII): у заглавных латинских букв ('A'..'Z')
+// устанавливается старший бит байта. Переносов между байтами нет, поэтому маска точная
+uint64_t AsciiUpperMask(uint64_t block)
+{
+    return (ONES * (127 + 'Z' + 1) - block) & ~block & (block + ONES * (127 - ('A' - 1))) & HIGH_BITS;
+}
+
+// true, если в блоке ASCII есть байт меньше ' '
+bool HasControlByte(uint64_t block)
+{
+    return ((block - ONES * ' ') & ~block & HIGH_BITS) != 0;
+}
+
+bool IsContinuation(unsigned char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+// Длина корректной последовательности UTF-8, начинающейся с data[0] (не ASCII), или 0.
+// Отвергаются избыточно длинные формы, суррогаты и символы больше U+10FFFF
+size_t GetSequenceLength(const unsigned char* data, size_t size)
+{
+    const unsigned char lead = data[0];
+    size_t length = 0;
+    unsigned char min_second = 0x80;
+    unsigned char max_second = 0xBF;
+    if (lead >= 0xC2 && lead <= 0xDF)
+    {
+        length = 2;
+    }
+    else if (lead >= 0xE0 && lead <= 0xEF)
+    {
+        length = 3;
+        min_second = lead == 0xE0 ? 0xA0 : 0x80;
+        max_second = lead == 0xED ? 0x9F : 0xBF;
+    }
+    else if (lead >= 0xF0 && lead <= 0xF4)
+    {
+        length = 4;
+        min_second = lead == 0xF0 ? 0x90 : 0x80;
+        max_second = lead == 0xF4 ? 0x8F : 0xBF;
+    }
+    else
+    {
+        return 0;
+    }
 
-    str_v.remove_prefix(0);
-    const int64_t pos_end = str_v.npos;
-    while (true)
+    if (size < length || data[1] < min_second || data[1] > max_second)
+    {
+        return 0;
+    }
+    for (size_t i = 2; i < length; ++i)
+    {
+        if (!IsContinuation(data[i]))
+        {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// Строчная пара символа из диапазона U+0000-U+07FF (до двух байтов в UTF-8). Строчная пара кодируется
+// тем же числом байтов
+char32_t FoldCodePoint(char32_t c)
+{
+    if (c < 0x80)
+    {
+        return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    // Кириллица - самый частый случай
+    if (c >= 0x0410 && c <= 0x042F)
+    {
+        return c + 0x20;
+    }
+    if (c >= 0x0400 && c <= 0x040F)
     {
-        // Убираем лидирующие пробелы
-        while ((!str_v.empty()) && (str_v.front() == ' '))
+        return c + 0x50;
+    }
+    if (c >= 0x0460 && c <= 0x04FF)
+    {
+        if (c == 0x04C0)
+        {
+            return 0x04CF;
+        }
+        if ((c <= 0x0481 || (c >= 0x048A && c <= 0x04BF) || c >= 0x04D0) && c % 2 == 0)
         {
-            str_v.remove_prefix(1);
+            return c + 1;
         }
+        if (c >= 0x04C1 && c <= 0x04CE && c % 2 == 1)
+        {
+            return c + 1;
+        }
+        return c;
+    }
 
-        int64_t space = str_v.find(' ');
-        result.push_back(space == pos_end ? str_v.substr() : str_v.substr(0, space));
-        if (space == pos_end)
+    // Latin-1 (кроме знака умножения)
+    if (c >= 0x00C0 && c <= 0x00DE && c != 0x00D7)
+    {
+        return c + 0x20;
+    }
+    // Latin Extended-A: заглавная и строчная буквы соседние. U+0130 (İ) в нижнем регистре длиннее и не заменяется
+    if (c >= 0x0100 && c <= 0x017F)
+    {
+        if (c == 0x0178)
         {
-            break;
+            return 0x00FF;
+        }
+        const bool upper_even = (c <= 0x012F) || (c >= 0x0132 && c <= 0x0137) || (c >= 0x014A && c <= 0x0177);
+        const bool upper_odd = (c >= 0x0139 && c <= 0x0148) || (c >= 0x0179 && c <= 0x017E);
+        if ((upper_even && c % 2 == 0) || (upper_odd && c % 2 == 1))
+        {
+            return c + 1;
+        }
+        return c;
+    }
+
+    // Греческий алфавит
+    if ((c >= 0x0391 && c <= 0x03A1) || (c >= 0x03A3 && c <= 0x03AB))
+    {
+        return c + 0x20;
+    }
+    switch (c)
+    {
+    case 0x0386:
+        return 0x03AC;
+    case 0x0388:
+    case 0x0389:
+    case 0x038A:
+        return c + 0x25;
+    case 0x038C:
+        return 0x03CC;
+    case 0x038E:
+    case 0x038F:
+        return c + 0x3F;
+    default:
+        return c;
+    }
+}
+
+// Обходит текст: блоки из 8 символов ASCII передаются в ascii_block(позиция, блок), остальные символы
+// до двух байтов - в code_point(позиция, символ). Обход прекращается, если функция вернула true. Возвращает, был ли он прерван
+template <typename AsciiBlockFunction, typename CodePointFunction>
+bool ScanCaseFoldable(const char* data, size_t size, AsciiBlockFunction ascii_block, CodePointFunction code_point)
+{
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    while (i < size)
+    {
+        if (i + 8 <= size)
+        {
+            const uint64_t block = LoadBlock(data + i);
+            if ((block & HIGH_BITS) == 0)
+            {
+                if (ascii_block(i, block))
+                {
+                    return true;
+                }
+                i += 8;
+                continue;
+            }
+        }
+
+        const unsigned char c = bytes[i];
+        if (c < 0x80)
+        {
+            if (code_point(i, static_cast<char32_t>(c)))
+            {
+                return true;
+            }
+            ++i;
+        }
+        else if (c >= 0xC2 && c <= 0xDF && i + 1 < size && IsContinuation(bytes[i + 1]))
+        {
+            if (code_point(i, static_cast<char32_t>(((c & 0x1F) << 6) | (bytes[i + 1] & 0x3F))))
+            {
+                return true;
+            }
+            i += 2;
         }
         else
         {
-            //pos = space + 1;
-            str_v.remove_prefix(space + 1);
+            // Символы длиннее двух байтов и некорректные байты не меняются
+            ++i;
         }
     }
+    return false;
+}
+}
 
-    return result;
+
+bool IsValidText(std::string_view text)
+{
+    const auto* data = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t size = text.size();
+    size_t i = 0;
+    while (i < size)
+    {
+        if (i + 8 <= size)
+        {
+            const uint64_t block = LoadBlock(text.data() + i);
+            if ((block & HIGH_BITS) == 0)
+            {
+                if (HasControlByte(block))
+                {
+                    return false;
+                }
+                i += 8;
+                continue;
+            }
+        }
+
+        if (data[i] < 0x80)
+        {
+            if (data[i] < ' ')
+            {
+                return false;
+            }
+            ++i;
+            continue;
+        }
+        const size_t length = GetSequenceLength(data + i, size - i);
+        if (length == 0)
+        {
+            return false;
+        }
+        i += length;
+    }
+    return true;
+}
+
+
+bool HasUpperCase(std::string_view text)
+{
+    return ScanCaseFoldable(text.data(), text.size(),
+                            [](size_t, uint64_t block)
+                            {
+                                return AsciiUpperMask(block) != 0;
+                            },
+                            [](size_t, char32_t c)
+                            {
+                                return FoldCodePoint(c) != c;
+                            });
+}
+
+
+void FoldCase(char* data, size_t size)
+{
+    ScanCaseFoldable(data, size,
+                     [data](size_t position, uint64_t block)
+                     {
+                         const uint64_t mask = AsciiUpperMask(block);
+                         if (mask != 0)
+                         {
+                             // Старший бит маски, сдвинутый на 2, - это бит 0x20 разницы 'A' и 'a'
+                             block |= mask >> 2;
+                             std::memcpy(data + position, &block, sizeof(block));
+                         }
+                         return false;
+                     },
+                     [data](size_t position, char32_t c)
+                     {
+                         const char32_t folded = FoldCodePoint(c);
+                         if (folded == c)
+                         {
+                             return false;
+                         }
+                         if (folded < 0x80)
+                         {
+                             data[position] = static_cast<char>(folded);
+                         }
+                         else
+                         {
+                             data[position] = static_cast<char>(0xC0 | (folded >> 6));
+                             data[position + 1] = static_cast<char>(0x80 | (folded & 0x3F));
+                         }
+                         return false;
+                     });
 }
@@ -5,11 +5,34 @@
 #include <string_view>
 #include <vector>
 #include <set>
+#include <algorithm>
 
 std::vector<std::string> SplitIntoWords(const std::string&);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view);
 
+// Версия SplitIntoWordsView() с переиспользуемым буфером результата (буфер предварительно очищается).
+// Буфер может использовать любой распределитель, например std::pmr
+template <typename Allocator>
+void SplitIntoWordsView(std::string_view, std::vector<std::string_view, Allocator>&);
+
+// Проверяет, что текст - корректный UTF-8 без управляющих символов (байтов меньше ' ').
+// Блоки из 8 ASCII-символов проверяются несколькими операциями над 64-битным словом
+bool IsValidText(std::string_view);
+
+// true, если в тексте есть заглавные буквы, которые заменит FoldCase()
+bool HasUpperCase(std::string_view);
+
+// Приводит текст к нижнему регистру на месте. Заменяются буквы ASCII, Latin-1, Latin Extended-A,
+// греческого алфавита и кириллицы (U+0400-U+04FF); длина текста в байтах при этом не меняется.
+// Остальные символы и некорректные последовательности UTF-8 остаются как есть
+void FoldCase(char*, size_t);
+
+// Вызывает function(слово в нижнем регистре) и возвращает её результат. Слово без заглавных букв передаётся
+// как есть, иначе - копия в буфере на стеке (слова длиннее буфера копируются в std::string)
+template <typename Function>
+auto WithFoldedCase(std::string_view, Function);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings)
 {
@@ -25,3 +48,53 @@ std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContain
     }
     return non_empty_strings;
 }
+
+
+template <typename Allocator>
+void SplitIntoWordsView(std::string_view str_v, std::vector<std::string_view, Allocator>& result)
+{
+    result.clear();
+
+    const auto pos_end = str_v.npos;
+    while (true)
+    {
+        // Убираем лидирующие пробелы
+        while ((!str_v.empty()) && (str_v.front() == ' '))
+        {
+            str_v.remove_prefix(1);
+        }
+
+        const auto space = str_v.find(' ');
+        result.push_back(space == pos_end ? str_v.substr() : str_v.substr(0, space));
+        if (space == pos_end)
+        {
+            break;
+        }
+        else
+        {
+            str_v.remove_prefix(space + 1);
+        }
+    }
+}
+
+
+template <typename Function>
+auto WithFoldedCase(std::string_view word, Function function)
+{
+    if (!HasUpperCase(word))
+    {
+        return function(word);
+    }
+
+    static constexpr size_t BUFFER_SIZE = 128;
+    if (word.size() <= BUFFER_SIZE)
+    {
+        char buffer[BUFFER_SIZE];
+        std::copy(word.begin(), word.end(), buffer);
+        FoldCase(buffer, word.size());
+        return function(std::string_view(buffer, word.size()));
+    }
+    std::string folded(word);
+    FoldCase(folded.data(), folded.size());
+    return function(std::string_view(folded));
+}
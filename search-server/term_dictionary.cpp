@@ -0,0 +1,317 @@
+#include "term_dictionary.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+
+TermDictionary::TermDictionary()
+    : nodes_(1)     // Корень дерева с пустой меткой
+{}
+
+
+int TermDictionary::Insert(std::string_view word)
+{
+    const int existing_id = Find(word);
+    if (existing_id != NOT_FOUND)
+    {
+        return existing_id;
+    }
+
+    // Метки новых узлов ссылаются на сохранённую в арене копию слова
+    const std::string_view term = StoreTerm(word);
+    int term_id = static_cast<int>(terms_.size());
+    if (free_ids_.empty())
+    {
+        terms_.push_back(term);
+    }
+    else
+    {
+        term_id = free_ids_.back();
+        free_ids_.pop_back();
+        terms_[term_id] = term;
+    }
+    InsertNode(term, term_id);
+    return term_id;
+}
+
+
+void TermDictionary::InsertNode(std::string_view term, int term_id)
+{
+    uint32_t node = 0;
+    std::string_view rest = term;
+    while (!rest.empty())
+    {
+        uint32_t prev = NO_NODE;
+        const uint32_t child = FindChild(node, rest.front(), &prev);
+        if (child == NO_NODE)
+        {
+            // Подходящего ребра нет: добавляем лист, сохраняя порядок братьев
+            Node leaf;
+            leaf.label = rest.data();
+            leaf.label_length = static_cast<uint32_t>(rest.size());
+            leaf.term_id = term_id;
+            leaf.next_sibling = (prev == NO_NODE) ? nodes_[node].first_child : nodes_[prev].next_sibling;
+
+            const uint32_t leaf_index = static_cast<uint32_t>(nodes_.size());
+            nodes_.push_back(leaf);
+            LinkChild(node, prev, leaf_index);
+            return;
+        }
+
+        const std::string_view label = nodes_[child].Label();
+        const size_t common = std::mismatch(label.begin(), label.end(), rest.begin(), rest.end()).first - label.begin();
+        if (common < label.size())
+        {
+            // Слово расходится с меткой посередине: разбиваем ребро промежуточным узлом
+            Node middle;
+            middle.label = label.data();
+            middle.label_length = static_cast<uint32_t>(common);
+            middle.first_child = child;
+            middle.next_sibling = nodes_[child].next_sibling;
+
+            const uint32_t middle_index = static_cast<uint32_t>(nodes_.size());
+            nodes_.push_back(middle);
+            nodes_[child].label += common;
+            nodes_[child].label_length -= static_cast<uint32_t>(common);
+            nodes_[child].next_sibling = NO_NODE;
+            LinkChild(node, prev, middle_index);
+            node = middle_index;
+        }
+        else
+        {
+            node = child;
+        }
+        rest.remove_prefix(common);
+    }
+
+    // Слово закончилось на существующем (или только что созданном промежуточном) узле
+    nodes_[node].term_id = term_id;
+}
+
+
+int TermDictionary::Find(std::string_view word) const
+{
+    const uint32_t node = FindNode(word);
+    return node == NO_NODE ? NOT_FOUND : nodes_[node].term_id;
+}
+
+
+uint32_t TermDictionary::FindNode(std::string_view word) const
+{
+    uint32_t node = 0;
+    while (!word.empty())
+    {
+        const uint32_t child = FindChild(node, word.front());
+        if (child == NO_NODE)
+        {
+            return NO_NODE;
+        }
+        const std::string_view label = nodes_[child].Label();
+        if (word.substr(0, label.size()) != label)
+        {
+            return NO_NODE;
+        }
+        word.remove_prefix(label.size());
+        node = child;
+    }
+
+    return node;
+}
+
+
+std::string_view TermDictionary::GetTerm(int term_id) const
+{
+    return terms_.at(term_id);
+}
+
+
+void TermDictionary::Erase(int term_id)
+{
+    using namespace std::string_literals;
+
+    const uint32_t node = (term_id >= 0 && static_cast<size_t>(term_id) < terms_.size()) ? FindNode(terms_[term_id])
+                                                                                        : NO_NODE;
+    if (node == NO_NODE || nodes_[node].term_id != term_id)
+    {
+        throw std::out_of_range("Invalid term id"s);
+    }
+    // Узлы пути остаются в дереве: метки других слов могут ссылаться на копию удалённого слова в арене
+    nodes_[node].term_id = NOT_FOUND;
+    terms_[term_id] = {};
+    free_ids_.push_back(term_id);
+    ++erased_count_;
+    if (erased_count_ >= COMPACTION_MIN_ERASED && erased_count_ > size())
+    {
+        Compact();
+    }
+}
+
+
+size_t TermDictionary::size() const
+{
+    return terms_.size() - free_ids_.size();
+}
+
+
+size_t TermDictionary::GetIdBound() const
+{
+    return terms_.size();
+}
+
+
+size_t TermDictionary::GetMemoryUsage() const
+{
+    return EstimateVectorMemory(nodes_) + EstimateVectorMemory(child_tables_) + EstimateVectorMemory(terms_)
+        + EstimateVectorMemory(free_ids_) + EstimateVectorMemory(arena_blocks_)
+        + arena_blocks_.size() * EstimateAllocation(ARENA_BLOCK_SIZE);
+}
+
+
+size_t TermDictionary::EstimateTermMemory(size_t length)
+{
+    return length + sizeof(std::string_view) + 2 * sizeof(Node);
+}
+
+
+std::string_view TermDictionary::StoreTerm(std::string_view word)
+{
+    if (word.empty())
+    {
+        return {};
+    }
+
+    if (word.size() > ARENA_BLOCK_SIZE)
+    {
+        // Слово длиннее блока получает собственный блок. Он кладётся в начало списка,
+        // чтобы последним оставался блок, заполняемый в данный момент
+        auto block = std::make_unique<char[]>(word.size());
+        std::memcpy(block.get(), word.data(), word.size());
+        const std::string_view result(block.get(), word.size());
+        arena_blocks_.insert(arena_blocks_.begin(), std::move(block));
+        return result;
+    }
+
+    if (word.size() > ARENA_BLOCK_SIZE - arena_block_used_)
+    {
+        arena_blocks_.push_back(std::make_unique<char[]>(ARENA_BLOCK_SIZE));
+        arena_block_used_ = 0;
+    }
+
+    char* data = arena_blocks_.back().get() + arena_block_used_;
+    std::memcpy(data, word.data(), word.size());
+    arena_block_used_ += word.size();
+    return { data, word.size() };
+}
+
+
+uint32_t TermDictionary::FindChild(uint32_t node, char c, uint32_t* prev) const
+{
+    // Братья упорядочены по первому байту метки (как unsigned char - так же, как сравнивает string_view)
+    const auto key = static_cast<unsigned char>(c);
+    if (nodes_[node].child_table != NO_NODE)
+    {
+        const auto& table = child_tables_[nodes_[node].child_table];
+        if (prev != nullptr)
+        {
+            // Предыдущий брат - ребёнок с ближайшим меньшим первым байтом (нужен только при вставке)
+            *prev = NO_NODE;
+            for (size_t previous_key = key; previous_key-- > 0;)
+            {
+                if (table[previous_key] != NO_NODE)
+                {
+                    *prev = table[previous_key];
+                    break;
+                }
+            }
+        }
+        return table[key];
+    }
+
+    uint32_t previous = NO_NODE;
+    for (uint32_t child = nodes_[node].first_child; child != NO_NODE; child = nodes_[child].next_sibling)
+    {
+        const auto first = static_cast<unsigned char>(nodes_[child].label[0]);
+        if (first == key)
+        {
+            if (prev != nullptr)
+            {
+                *prev = previous;
+            }
+            return child;
+        }
+        if (first > key)
+        {
+            break;
+        }
+        previous = child;
+    }
+
+    if (prev != nullptr)
+    {
+        *prev = previous;
+    }
+    return NO_NODE;
+}
+
+
+void TermDictionary::LinkChild(uint32_t node, uint32_t prev, uint32_t child)
+{
+    if (prev == NO_NODE)
+    {
+        nodes_[node].first_child = child;
+    }
+    else
+    {
+        nodes_[prev].next_sibling = child;
+    }
+
+    const auto key = static_cast<unsigned char>(nodes_[child].label[0]);
+    if (nodes_[node].child_table != NO_NODE)
+    {
+        child_tables_[nodes_[node].child_table][key] = child;
+        return;
+    }
+    size_t child_count = 0;
+    for (uint32_t sibling = nodes_[node].first_child; sibling != NO_NODE; sibling = nodes_[sibling].next_sibling)
+    {
+        ++child_count;
+    }
+    if (child_count < CHILD_TABLE_MIN_SIZE)
+    {
+        return;
+    }
+    nodes_[node].child_table = static_cast<uint32_t>(child_tables_.size());
+    auto& table = child_tables_.emplace_back();
+    table.fill(NO_NODE);
+    for (uint32_t sibling = nodes_[node].first_child; sibling != NO_NODE; sibling = nodes_[sibling].next_sibling)
+    {
+        table[static_cast<unsigned char>(nodes_[sibling].label[0])] = sibling;
+    }
+}
+
+
+void TermDictionary::Compact()
+{
+    // Старая арена нужна, пока оставшиеся слова не скопированы в новую
+    const std::vector<std::unique_ptr<char[]>> old_blocks = std::move(arena_blocks_);
+    arena_blocks_.clear();
+    arena_block_used_ = ARENA_BLOCK_SIZE;
+    const int empty_term_id = nodes_[0].term_id;
+    nodes_ = std::vector<Node>(1);
+    nodes_[0].term_id = empty_term_id;
+    child_tables_.clear();
+    child_tables_.shrink_to_fit();
+
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id)
+    {
+        if (!terms_[term_id].empty())
+        {
+            terms_[term_id] = StoreTerm(terms_[term_id]);
+            InsertNode(terms_[term_id], static_cast<int>(term_id));
+        }
+    }
+    erased_count_ = 0;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Сортированный словарь слов поискового сервера.
+// Каждому слову назначается целочисленный id (в порядке добавления, id удалённых слов используются повторно),
+// сами слова хранятся в блочной "арене" и не зависят от времени жизни текстов документов.
+// Поиск id и перебор слов по префиксу выполняются по сжатому префиксному дереву (radix tree):
+// узлы лежат в одном векторе, дети узла связаны в список, упорядоченный по первому байту метки.
+// У узлов с большим числом детей есть таблица "первый байт - ребёнок" для поиска ребёнка за O(1).
+// Удалённые слова остаются в дереве и арене, пока их не станет больше оставшихся: тогда дерево и арена
+// перестраиваются из оставшихся слов с сохранением их id
+class TermDictionary
+{
+public:
+    // Значение, которое Find() возвращает для отсутствующего слова
+    static constexpr int NOT_FOUND = -1;
+
+    TermDictionary();
+
+    // Возвращает id слова, добавляя его в словарь при необходимости
+    int Insert(std::string_view);
+
+    // Возвращает id слова или NOT_FOUND
+    int Find(std::string_view) const;
+
+    // Возвращает слово по id. Ссылка действительна до удаления слов из словаря (Erase() может перенести
+    // оставшиеся слова в новую арену)
+    std::string_view GetTerm(int) const;
+
+    // Удаляет слово, его id будет назначен одному из следующих новых слов.
+    // Для неизвестного id выбрасывает std::out_of_range
+    void Erase(int);
+
+    // Количество слов в словаре
+    size_t size() const;
+
+    // Граница id слов: id всех слов словаря меньше неё
+    size_t GetIdBound() const;
+
+    // Объём динамической памяти словаря в байтах (узлы дерева, индекс слов и арена)
+    size_t GetMemoryUsage() const;
+
+    // Оценка прироста памяти при добавлении слова длины length (новый лист и, возможно, разделение ребра)
+    static size_t EstimateTermMemory(size_t length);
+
+    // Вызывает function(слово, id) для всех слов с заданным префиксом в лексикографическом порядке.
+    // Время работы пропорционально длине префикса и числу найденных слов
+    template <typename Function>
+    void ForEachWithPrefix(std::string_view, Function) const;
+
+private:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+    static constexpr size_t ARENA_BLOCK_SIZE = 64 * 1024;
+    // Число детей, с которого узел получает таблицу детей
+    static constexpr size_t CHILD_TABLE_MIN_SIZE = 16;
+    // Дерево не перестраивается, пока удалённых слов меньше
+    static constexpr size_t COMPACTION_MIN_ERASED = 1024;
+
+    struct Node
+    {
+        const char* label = nullptr;    // Метка ребра, ведущего в узел (указывает в арену)
+        uint32_t label_length = 0;
+        int term_id = NOT_FOUND;        // id слова, заканчивающегося в этом узле
+        uint32_t first_child = NO_NODE;
+        uint32_t next_sibling = NO_NODE;
+        uint32_t child_table = NO_NODE;   // Номер таблицы детей в child_tables_
+
+        std::string_view Label() const
+        {
+            return { label, label_length };
+        }
+    };
+
+    std::vector<Node> nodes_;
+    // Ребёнок узла по первому байту метки (NO_NODE - ребёнка нет)
+    std::vector<std::array<uint32_t, 256>> child_tables_;
+    // Слова по id. У свободных id - пустые слова
+    std::vector<std::string_view> terms_;
+    std::vector<int> free_ids_;
+    // Удалённые слова, оставшиеся в дереве и арене
+    size_t erased_count_ = 0;
+
+    // Арена для хранения слов
+    std::vector<std::unique_ptr<char[]>> arena_blocks_;
+    size_t arena_block_used_ = ARENA_BLOCK_SIZE;
+
+    // Копирует слово в арену
+    std::string_view StoreTerm(std::string_view);
+
+    // Добавляет в дерево путь к слову, сохранённому в арене, и назначает его последнему узлу id слова
+    void InsertNode(std::string_view, int);
+
+    // Узел, в котором заканчивается слово (NO_NODE, если пути нет)
+    uint32_t FindNode(std::string_view) const;
+
+    // Находит ребёнка узла, метка которого начинается с символа c. prev - предыдущий брат (или NO_NODE)
+    uint32_t FindChild(uint32_t, char, uint32_t* prev = nullptr) const;
+
+    // Ставит child в список детей узла после брата prev (NO_NODE - первым) и в таблицу детей узла.
+    // Следующего брата child задаёт вызывающий
+    void LinkChild(uint32_t, uint32_t prev, uint32_t child);
+
+    // Перестраивает дерево и арену из оставшихся слов
+    void Compact();
+
+    template <typename Function>
+    void VisitSubtree(uint32_t, Function&) const;
+};
+
+
+template <typename Function>
+void TermDictionary::ForEachWithPrefix(std::string_view prefix, Function function) const
+{
+    uint32_t node = 0;
+    while (!prefix.empty())
+    {
+        const uint32_t child = FindChild(node, prefix.front());
+        if (child == NO_NODE)
+        {
+            return;
+        }
+        const std::string_view label = nodes_[child].Label();
+        if (prefix.size() <= label.size())
+        {
+            // Префикс заканчивается внутри метки: всё поддерево ребёнка подходит, если метка начинается с префикса
+            if (label.substr(0, prefix.size()) != prefix)
+            {
+                return;
+            }
+            node = child;
+            break;
+        }
+        if (prefix.substr(0, label.size()) != label)
+        {
+            return;
+        }
+        prefix.remove_prefix(label.size());
+        node = child;
+    }
+
+    VisitSubtree(node, function);
+}
+
+
+template <typename Function>
+void TermDictionary::VisitSubtree(uint32_t node, Function& function) const
+{
+    // Слово узла идёт раньше слов поддерева, дети упорядочены по первому байту метки
+    if (nodes_[node].term_id != NOT_FOUND)
+    {
+        function(terms_[nodes_[node].term_id], nodes_[node].term_id);
+    }
+    for (uint32_t child = nodes_[node].first_child; child != NO_NODE; child = nodes_[child].next_sibling)
+    {
+        VisitSubtree(child, function);
+    }
+}
@@ -68,11 +68,19 @@ void MatchDocuments(const SearchServer& search_server, const std::string& query)
     {
         cout << "Matching for request: "s << query << endl;
         const int document_count = search_server.GetDocumentCount();
+        std::vector<int> document_ids;
+        document_ids.reserve(document_count);
         for (int index = 0; index < document_count; ++index)
         {
-            const int document_id = search_server.GetDocumentId(index);
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+            document_ids.push_back(search_server.GetDocumentId(index));
+        }
+
+        // Запрос разбирается один раз для всех документов
+        const auto results = search_server.MatchDocuments(std::execution::par, query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i)
+        {
+            const auto& [words, status] = results[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     }
     catch (const std::exception& e)
@@ -0,0 +1,132 @@
+#pragma once
+
+// #include для type resolution в объявлениях функций:
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <utility>
+
+#include "document.h"
+#include "term_dictionary.h"
+
+// Элемент прямого индекса: id слова и его частота в документе.
+// Слова документа хранятся плоским массивом, отсортированным по id слова
+struct WordFrequency
+{
+    int word_id = 0;
+    TermFreq term_freq = 0.0f;
+};
+
+// Лёгкое представление словаря частот слов документа только для чтения.
+// Не копирует данные индекса: ссылается на массив прямого индекса и словарь сервера.
+// Действительно, пока не изменилась версия индекса (см. SearchServer::GetIndexVersion()).
+// Элементы - пары (слово, частота), упорядоченные по id слова
+class WordFrequenciesView
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const WordFrequency* position, const TermDictionary* dictionary)
+            : position_(position)
+            , dictionary_(dictionary)
+        {}
+
+        value_type operator*() const
+        {
+            return { dictionary_->GetTerm(position_->word_id), position_->term_freq };
+        }
+
+        Iterator& operator++()
+        {
+            ++position_;
+            return *this;
+        }
+
+        Iterator operator++(int)
+        {
+            Iterator result = *this;
+            ++position_;
+            return result;
+        }
+
+        bool operator==(const Iterator& other) const
+        {
+            return position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const
+        {
+            return position_ != other.position_;
+        }
+
+    private:
+        const WordFrequency* position_;
+        const TermDictionary* dictionary_;
+    };
+
+    WordFrequenciesView() = default;
+
+    WordFrequenciesView(const WordFrequency* begin, const WordFrequency* end,
+                        const TermDictionary* dictionary, uint64_t index_version)
+        : begin_(begin)
+        , end_(end)
+        , dictionary_(dictionary)
+        , index_version_(index_version)
+    {}
+
+    Iterator begin() const
+    {
+        return { begin_, dictionary_ };
+    }
+
+    Iterator end() const
+    {
+        return { end_, dictionary_ };
+    }
+
+    size_t size() const
+    {
+        return static_cast<size_t>(end_ - begin_);
+    }
+
+    bool empty() const
+    {
+        return begin_ == end_;
+    }
+
+    // Возвращает частоту слова в документе (0, если слова в документе нет)
+    double GetFrequency(std::string_view word) const
+    {
+        if (empty())
+        {
+            return 0.0;
+        }
+        const int word_id = dictionary_->Find(word);
+        const WordFrequency* it = std::lower_bound(begin_, end_, word_id,
+                                                   [](const WordFrequency& item, int id)
+                                                   {
+                                                       return item.word_id < id;
+                                                   });
+        return (it != end_ && it->word_id == word_id) ? it->term_freq : 0.0;
+    }
+
+    // Версия индекса, для которой получено представление
+    uint64_t GetIndexVersion() const
+    {
+        return index_version_;
+    }
+
+private:
+    const WordFrequency* begin_ = nullptr;
+    const WordFrequency* end_ = nullptr;
+    const TermDictionary* dictionary_ = nullptr;
+    uint64_t index_version_ = 0;
+};